@@ -21,6 +21,9 @@ limitations under the License.
 
 #include <string.h>
 
+#include <algorithm>
+#include <vector>
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 GrapaBtree::GrapaBtree()
@@ -72,6 +75,11 @@ GrapaError GrapaBtree::OpenFile(const char *fileName, char mode)
 			mFile->Close();
 			return(-1);
 		}
+		if (hdr.version1 > GrapaBlock::FORMAT_VERSION)
+		{
+			mFile->Close();
+			return(-1);
+		}
 		GetFlags(mFlags);
 		if (IsLittleEndianS())
 		{
@@ -313,7 +321,7 @@ u64 GrapaBtree::FirstTree(u64 treePtr)
 	return(0);
 }
 
-GrapaError GrapaBtree::NewTree(u64& treePtr, u8 treeType, u64 parentTree, u8 nodeCount)
+GrapaError GrapaBtree::NewTree(u64& treePtr, u8 treeType, u64 parentTree, u8 nodeCount, bool ranked)
 {
 	GrapaError err=0;
 	GrapaBlockTree kb;
@@ -326,6 +334,7 @@ GrapaError GrapaBtree::NewTree(u64& treePtr, u8 treeType, u64 parentTree, u8 nod
 
 	kb.Init();
 	kb.nodeCount = nodeCount;
+	kb.SetRanked(ranked);
 	kb.parentTree = parentTree;
 	kb.treeType = treeType;
 
@@ -567,6 +576,166 @@ GrapaError GrapaBtree::GetTreeParent(GrapaCursor& cursor, u64& parentTree)
 	return(0);
 }
 
+GrapaError	GrapaBtree::GetTreeRanked(GrapaCursor& cursor, bool& isRanked)
+{
+	GrapaError err = 0;
+	GrapaBlockTree kb;
+
+	isRanked = true;
+
+	if (cursor.mTreeRef==0L) return(-1);
+
+	err = kb.Read(mFile,cursor.mTreeRef);
+	if (err) return(err);
+
+	if (kb.blockType!=GrapaBlock::TREE_BLOCK) return(-1);
+
+	isRanked = kb.GetRanked();
+
+	return(0);
+}
+
+// An unranked tree skips the child weight reads Search needs to fill in mLength, which on a
+// page-width node can be a hundred extra reads per level. Next, Prev and Last still track it.
+GrapaError	GrapaBtree::SetTreeRanked(GrapaCursor& cursor, bool isRanked)
+{
+	GrapaError err = 0;
+	GrapaBlockTree kb;
+
+	if (cursor.mTreeRef==0L) return(-1);
+
+	err = kb.Read(mFile,cursor.mTreeRef);
+	if (err) return(err);
+
+	if (kb.blockType!=GrapaBlock::TREE_BLOCK) return(-1);
+
+	kb.SetRanked(isRanked);
+
+	err = kb.Write(mFile,cursor.mTreeRef);
+	if (err) return(err);
+
+	return(0);
+}
+
+GrapaError	GrapaBtree::GetTreeWidth(GrapaCursor& cursor, u8& nodeCount)
+{
+	GrapaError err = 0;
+	GrapaBlockTree kb;
+
+	nodeCount = 0;
+
+	if (cursor.mTreeRef==0L) return(-1);
+
+	err = kb.Read(mFile,cursor.mTreeRef);
+	if (err) return(err);
+
+	if (kb.blockType!=GrapaBlock::TREE_BLOCK) return(-1);
+
+	nodeCount = kb.nodeCount;
+
+	return(0);
+}
+
+// Rebuilds the nodes of a tree at a new width. The items are laid out in key order in a tree of
+// the smallest height that holds them, with every node but the root at least half full. The tree
+// header keeps its place, so parent and item references into the tree stay valid. With sortItems
+// the items are first checked against CompareKey and re-sorted if any are out of place, which
+// repairs a tree built while its comparison was wrong; the rebuild then happens even at the same
+// width. changed reports whether the tree was rebuilt.
+GrapaError GrapaBtree::ConvertTree(u64 treePtr, u8 nodeCount, bool sortItems, bool& changed)
+{
+	GrapaError err = 0;
+	GrapaBlockTree head;
+	GrapaCursor cursor;
+	std::vector<GrapaBlockNodeLeaf> items;
+	u64 oldRoot,newRoot=0;
+	u8 oldCount;
+	bool sorted = true;
+
+	changed = false;
+
+	if (treePtr==0L || nodeCount < 3 || nodeCount > PAGE_WIDTH) return(-1);
+
+	err = head.Read(mFile,treePtr);
+	if (err) return(err);
+
+	if (head.blockType!=GrapaBlock::TREE_BLOCK) return(-1);
+
+	if (head.nodeCount==(s8)nodeCount && !sortItems) return(0);
+
+	items.reserve(head.itemCount);
+	cursor.Set(treePtr);
+	err = First(cursor);
+	while (!err)
+	{
+		items.emplace_back();
+		err = items.back().Read(mFile,cursor.mNodeRef+1+cursor.mNodeIndex);
+		if (err) return(err);
+		items.back().child = 0;
+		err = Next(cursor);
+	}
+	if (items.size()!=head.itemCount) return(-1);
+
+	if (sortItems)
+	{
+		err = SortItems(treePtr, head, items.data(), items.size(), sorted);
+		if (err) return(err);
+	}
+
+	if (head.nodeCount==(s8)nodeCount && sorted) return(0);
+
+	err = BuildTree(treePtr, head, items.data(), items.size(), nodeCount, nodeCount, newRoot);
+	if (err) return(err);
+
+	oldRoot = head.firstItem;
+	oldCount = (u8)head.nodeCount;
+
+	head.firstItem = newRoot;
+	head.nodeCount = (s8)nodeCount;
+	err = head.Write(mFile,treePtr);
+	if (err) return(err);
+
+	changed = true;
+	return FreeNodes(oldRoot, oldCount);
+}
+
+// Fills an empty tree with itemCount items, building the nodes bottom-up instead of inserting
+// one item at a time. Nodes are filled to fillPercent of their width, and written in key order
+// so a tree built in a fresh file lies in sequential pages. The items must be in key order;
+// with sortItems they are checked against CompareKey and sorted if they are not.
+GrapaError GrapaBtree::LoadTree(u64 treePtr, GrapaBlockNodeLeaf* items, u64 itemCount, bool sortItems, u8 fillPercent)
+{
+	GrapaError err = 0;
+	GrapaBlockTree head;
+	u64 newRoot=0;
+	u8 fillCount;
+	bool sorted = true;
+
+	if (treePtr==0L || fillPercent < 50 || fillPercent > 100) return(-1);
+
+	err = head.Read(mFile,treePtr);
+	if (err) return(err);
+
+	if (head.blockType!=GrapaBlock::TREE_BLOCK) return(-1);
+	if (head.firstItem || head.itemCount) return(-1);
+
+	fillCount = (u8)((((u64)head.nodeCount) * fillPercent + 99) / 100);
+	if (fillCount < 3) fillCount = (u8)head.nodeCount;
+
+	if (sortItems)
+	{
+		err = SortItems(treePtr, head, items, itemCount, sorted);
+		if (err) return(err);
+	}
+
+	err = BuildTree(treePtr, head, items, itemCount, (u8)head.nodeCount, fillCount, newRoot);
+	if (err) return(err);
+
+	head.firstItem = newRoot;
+	head.itemCount = itemCount;
+	return head.Write(mFile,treePtr);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 GrapaError	GrapaBtree::NewData(u8 dataType, u64 parentTree, u64 dataSize, u64 growBlockSize, u64 growBlocks, u64& itemPtr, bool clear)
@@ -1033,7 +1202,7 @@ GrapaError	GrapaBtree::Search(GrapaCursor& cursor)
 
 	if (head.blockType!=GrapaBlock::TREE_BLOCK) return(-1);
 
-	found = SearchRc(head.firstItem, cursor, result);
+	found = SearchRc(head.firstItem, cursor, result, head.GetRanked());
 	cursor.mValueType = result.valueType;
 	cursor.mKey = result.key;
 	cursor.mValue = result.value;
@@ -1353,6 +1522,92 @@ GrapaError	GrapaBtree::Prev(GrapaCursor& cursor)
 	return(err);
 }
 
+// Places the cursor on the first item at or after the cursor's key, or with pLast on the last item
+// at or before it. Without pInclusive an item equal to the key is passed over. The key need not
+// be in the tree, so this is where a walk between two bounds starts.
+GrapaError	GrapaBtree::Seek(GrapaCursor& cursor, bool pLast, bool pInclusive)
+{
+	GrapaError err = 0;
+	GrapaBlockTree head;
+	GrapaBlockNodeHeader page;
+	GrapaBlockNodeLeaf leaves[PAGE_WIDTH];
+	GrapaBlockNodeLeaf found{};
+	GrapaCursor leafCursor;
+	u64 node, foundNode = 0;
+	s8 l, h, pos, foundIndex = 0, match;
+
+	cursor.mNodeRef = 0;
+	cursor.mNodeIndex = 0;
+	cursor.mLength = 0;
+
+	if (cursor.mTreeRef==0L) return(-1);
+
+	err = head.Read(mFile,cursor.mTreeRef);
+	if (err) return(err);
+	cursor.mTreeType = head.treeType;
+
+	if (head.blockType!=GrapaBlock::TREE_BLOCK) return(-1);
+
+	// An item goes right of the key when it is greater, or equal and the walk wants equal items
+	// on that side. The items of a node are in order, so a binary search finds the first one.
+	node = head.firstItem;
+	while (node)
+	{
+		err = page.Read(mFile,node);
+		if (err) return(err);
+		if (page.blockType!=GrapaBlock::NODE_BLOCK || page.leafCount > PAGE_WIDTH) return(-1);
+		err = ReadLeaves(node, 0, page.leafCount, leaves);
+		if (err) return(err);
+
+		l = 0;
+		h = page.leafCount;
+		while (l < h)
+		{
+			pos = l + (h-l)/2;
+			switch(cursor.mValueType)
+			{
+				case SU64_ITEM:
+				case TREE_ITEM:
+				case SDATA_ITEM:
+					match = GrapaBtree::CompareKey(leaves[pos].key, cursor.mKey);
+					break;
+				default:
+					match = -1;
+					leafCursor.Set(cursor.mTreeRef,leaves[pos].valueType,leaves[pos].key,leaves[pos].value);
+					leafCursor.mTreeType = cursor.mTreeType;
+					err = CompareKey(SEARCH_MODE,cursor,leafCursor,match);
+					if (err) return(err);
+			}
+			if (match > 0 || (match == 0 && pInclusive != pLast)) h = pos; else l = pos + 1;
+		}
+
+		if (!pLast && l < page.leafCount)
+		{
+			foundNode = node;
+			foundIndex = l;
+			found = leaves[l];
+		}
+		else if (pLast && l > 0)
+		{
+			foundNode = node;
+			foundIndex = l - 1;
+			found = leaves[l - 1];
+		}
+		node = l ? leaves[l - 1].child : page.firstChild;
+	}
+
+	if (foundNode==0) return(-1);
+
+	cursor.mValueType = found.valueType;
+	cursor.mKey = found.key;
+	cursor.mValue = found.value;
+	cursor.mFlags = found.flags;
+	cursor.mNodeRef = foundNode;
+	cursor.mNodeIndex = foundIndex;
+
+	return(0);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 GrapaError GrapaBtree::CompareKey(s16 compareType, GrapaCursor& dataCursor, GrapaCursor& treeCursor, s8& result)
@@ -1368,12 +1623,37 @@ GrapaError GrapaBtree::DeleteKey(GrapaCursor& treeCursor)
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool GrapaBtree::SearchNode(u64 rootNode, GrapaCursor& key, s8& pos, u64& child, GrapaBlockNodeLeaf& foundKey, s16 compareType)
+// Reads count leaves of a node starting at first with one file access.
+GrapaError GrapaBtree::ReadLeaves(u64 rootNode, s8 first, s8 count, GrapaBlockNodeLeaf* leaves)
+{
+	GrapaError err;
+	s8 i;
+	if (count <= 0) return(0);
+	err = mFile->Read(GrapaBlockNodeLeaf::GetOffset(rootNode, first), GrapaBlock::BLOCKSIZE, 0, ((u64)count)*GrapaBlockNodeLeaf::GetSize(), leaves);
+	if (err) return(err);
+	for (i = 0; i < count; i++)
+		leaves[i].BigEndian();
+	return(0);
+}
+
+GrapaError GrapaBtree::WriteLeaves(u64 rootNode, s8 first, s8 count, GrapaBlockNodeLeaf* leaves)
+{
+	GrapaError err;
+	s8 i;
+	if (count <= 0) return(0);
+	for (i = 0; i < count; i++)
+		leaves[i].BigEndian();
+	err = mFile->Write(GrapaBlockNodeLeaf::GetOffset(rootNode, first), GrapaBlock::BLOCKSIZE, 0, ((u64)count)*GrapaBlockNodeLeaf::GetSize(), leaves);
+	for (i = 0; i < count; i++)
+		leaves[i].BigEndian();
+	return(err);
+}
+
+bool GrapaBtree::SearchNode(u64 rootNode, GrapaCursor& key, s8& pos, u64& child, GrapaBlockNodeLeaf& foundKey, s16 compareType, bool ranked)
 {
 	GrapaBlockNodeHeader page;
 	GrapaCursor leafCursor;
-	GrapaBlockNodeLeaf priorKey;
-	u64 foundOffset;
+	GrapaBlockNodeLeaf leaves[PAGE_WIDTH];
 	s8 match;
 	GrapaError err;
 	s8 l,h,last;
@@ -1382,13 +1662,19 @@ bool GrapaBtree::SearchNode(u64 rootNode, GrapaCursor& key, s8& pos, u64& child,
 	if (key.mValueType==BDATA_ITEM)
 		return SearchNodeFrag(rootNode,key,pos,child,foundKey,compareType);
 
-	foundOffset = 0;
 	child = 0;
 	pos = 0;
 
 	err = page.Read(mFile,rootNode);
 	if (err) return(false);
 
+	if (page.leafCount > PAGE_WIDTH) return(false);
+
+	// The whole node comes in with one read; the search itself touches no more of the file
+	// unless the tree compares by value.
+	err = ReadLeaves(rootNode, 0, page.leafCount, leaves);
+	if (err) return(false);
+
 	child = page.firstChild;
 
 	l = 0;
@@ -1398,20 +1684,16 @@ bool GrapaBtree::SearchNode(u64 rootNode, GrapaCursor& key, s8& pos, u64& child,
 	while (h >= l)
 	{
 		pos = l + (h-l)/2;
-		foundOffset = rootNode+1+pos;
-		err = foundKey.Read(mFile,foundOffset);
-		if (err) return(false);
 		switch(key.mValueType)
 		{
 			case SU64_ITEM:
 			case TREE_ITEM:
 			case SDATA_ITEM:
-				//match = foundKey.key - key.mKey;
-				match = GrapaBtree::CompareKey(foundKey.key, key.mKey);
+				match = GrapaBtree::CompareKey(leaves[pos].key, key.mKey);
 				break;
 			default:
 				match = -1;
-				leafCursor.Set(key.mTreeRef,foundKey.valueType,foundKey.key,foundKey.value);
+				leafCursor.Set(key.mTreeRef,leaves[pos].valueType,leaves[pos].key,leaves[pos].value);
 				leafCursor.mTreeType = key.mTreeType;
 				err = CompareKey(compareType,key,leafCursor,match);
 				if (err) return(false);
@@ -1423,25 +1705,14 @@ bool GrapaBtree::SearchNode(u64 rootNode, GrapaCursor& key, s8& pos, u64& child,
 	if (match < 0) pos++;
 
 	if (pos)
-	{
-		if (foundOffset == (rootNode+pos))
-			child = foundKey.child;
-		else
-		{
-			err = priorKey.Read(mFile,rootNode+pos);
-			if (err) return(false);
-			child = priorKey.child;
-		}
-	}
+		child = leaves[pos-1].child;
 
-	if (page.leafCount && foundOffset != (rootNode+1+pos))
-	{
-		foundOffset = rootNode+1+pos;
-		err = foundKey.Read(mFile,foundOffset);
-		if (err) return(false);
-	}
+	// Past the last leaf there is no key to report, and a full node has no slot there to read.
+	if (pos < page.leafCount)
+		foundKey = leaves[pos];
 
-	// Could conditionally do this based on whether the weight feature is enabled for this tree
+	if (!ranked)
+		return(match == 0);
 
 	if ( (pos || match <= 0) && page.firstChild)
 	{
@@ -1452,24 +1723,19 @@ bool GrapaBtree::SearchNode(u64 rootNode, GrapaCursor& key, s8& pos, u64& child,
 	if (match==0) last++;
 	for (h=0;h<last;h++)
 	{
-		err = priorKey.Read(mFile,rootNode+1+h);
-		if (!err)
+		if (leaves[h].child)
 		{
-			if (priorKey.child)
-			{
-				err = page.Read(mFile,priorKey.child);
-				key.mLength += page.weight;
-			}
-			leafCursor.Set(key.mTreeRef,priorKey.valueType,priorKey.key,priorKey.value);
-			leafCursor.mTreeType = key.mTreeType;
-			err = GetWeight(leafCursor,itemWeight);
-			key.mLength += itemWeight;
+			err = page.Read(mFile,leaves[h].child);
+			key.mLength += page.weight;
 		}
+		leafCursor.Set(key.mTreeRef,leaves[h].valueType,leaves[h].key,leaves[h].value);
+		leafCursor.mTreeType = key.mTreeType;
+		err = GetWeight(leafCursor,itemWeight);
+		key.mLength += itemWeight;
 	}
 	if (pos && match)
 	{
-		err = priorKey.Read(mFile,rootNode+1+pos-1);
-		leafCursor.Set(key.mTreeRef,priorKey.valueType,priorKey.key,priorKey.value);
+		leafCursor.Set(key.mTreeRef,leaves[pos-1].valueType,leaves[pos-1].key,leaves[pos-1].value);
 		leafCursor.mTreeType = key.mTreeType;
 		err = GetWeight(leafCursor,itemWeight);
 		key.mLength += itemWeight;
@@ -1543,10 +1809,21 @@ GrapaError GrapaBtree::InsInPage(GrapaBlockTree& head, GrapaCursor& treekey, u64
 	GrapaError err;
 	s8 i;
 	GrapaCursor cursor;
+	GrapaBlockNodeLeaf leaves[PAGE_WIDTH];
 
-	for (i=page.leafCount;i>pos;i--)
+	// Shift the tail of the node up one slot with a single read and write, then repoint the
+	// children that moved with it.
+	if (page.leafCount > pos)
 	{
-		MoveLeaf(treekey.mTreeRef,head,page,rootNode,i-1,page,rootNode,i);
+		err = ReadLeaves(rootNode, pos, page.leafCount - pos, leaves);
+		if (err) return(err);
+		err = WriteLeaves(rootNode, pos + 1, page.leafCount - pos, leaves);
+		if (err) return(err);
+		for (i = 0; i < page.leafCount - pos; i++)
+		{
+			err = UpdateChildInfo(leaves[i].child, rootNode, pos + i + 2);
+			if (err) return(err);
+		}
 	}
 
 	err = UpdateLeafInfo(&key,rootNode,pos);
@@ -1564,7 +1841,7 @@ GrapaError GrapaBtree::InsInPage(GrapaBlockTree& head, GrapaCursor& treekey, u64
 	return(0);
 }
 
-bool GrapaBtree::SearchRc(u64 rootNode, GrapaCursor& key, GrapaBlockNodeLeaf& foundKey)
+bool GrapaBtree::SearchRc(u64 rootNode, GrapaCursor& key, GrapaBlockNodeLeaf& foundKey, bool ranked)
 {
 	GrapaError theErr;
 	u64 child;
@@ -1578,14 +1855,14 @@ bool GrapaBtree::SearchRc(u64 rootNode, GrapaCursor& key, GrapaBlockNodeLeaf& fo
 	if (node.blockType!=GrapaBlock::NODE_BLOCK)
 		return(false);
 
-	if (SearchNode(rootNode,key,nodeIndex,child,foundKey,SEARCH_MODE))
+	if (SearchNode(rootNode,key,nodeIndex,child,foundKey,SEARCH_MODE,ranked))
 	{
 		key.mNodeRef = rootNode;
 		key.mNodeIndex = nodeIndex;
 		return(true);
 	}
 
-	return(SearchRc(child,key,foundKey));
+	return(SearchRc(child,key,foundKey,ranked));
 }
 
 GrapaError GrapaBtree::SetKey(GrapaBlockTree& head, GrapaBlockNodeLeaf& leaf, GrapaCursor& cursor)
@@ -1626,7 +1903,7 @@ GrapaError GrapaBtree::InsertRc(u64 headRef, GrapaBlockTree& head, u64 rootNode,
 		return(0);
 	}
 
-	if (SearchNode(rootNode,key,pos,child,fKey,INSERT_MODE))
+	if (SearchNode(rootNode,key,pos,child,fKey,INSERT_MODE,head.GetRanked()))
 	{
 		// if exact matching, then return an error
 		//return(-1);
@@ -1940,7 +2217,7 @@ GrapaError GrapaBtree::PurgeRc(u64 headRef, GrapaBlockTree& head, u64 rootNode,
 
 	if (rootTree.blockType!=GrapaBlock::NODE_BLOCK) return(-1);
 
-	if (SearchNode(rootNode,key,pos,child,fKey,DELETE_MODE))
+	if (SearchNode(rootNode,key,pos,child,fKey,DELETE_MODE,head.GetRanked()))
 	{
 		err = tempKey.Read(mFile,rootNode+1+pos);
 		if (err) return(err);
@@ -2320,6 +2597,150 @@ void GrapaBtree::MirgeLeft(u64 headRef, GrapaBlockTree& head, u64 rootOffset, s8
 	theErr = rootTree.Write(mFile,rootOffset);
 }
 
+// Orders the items by CompareKey, leaving them alone when they already are. sorted reports whether
+// they were.
+GrapaError GrapaBtree::SortItems(u64 headRef, GrapaBlockTree& head, GrapaBlockNodeLeaf* items, u64 itemCount, bool& sorted)
+{
+	u64 i;
+	auto before = [&](const GrapaBlockNodeLeaf& a, const GrapaBlockNodeLeaf& b) {
+		GrapaCursor ca, cb;
+		s8 result = CMP_EQ;
+		ca.Set(headRef,a.valueType,a.key,a.value,a.flags);
+		ca.mTreeType = head.treeType;
+		cb.Set(headRef,b.valueType,b.key,b.value,b.flags);
+		cb.mTreeType = head.treeType;
+		CompareKey(INSERT_MODE,ca,cb,result);
+		return result==CMP_GT;
+	};
+	sorted = true;
+	for (i=1;i<itemCount && sorted;i++)
+		sorted = !before(items[i],items[i-1]);
+	if (!sorted)
+		std::stable_sort(items,items+itemCount,before);
+	return(0);
+}
+
+// Builds nodes nodeCount wide holding the items, with at most fillCount items in each, in a tree
+// of the smallest height that holds them. rootRef is 0 when there are no items.
+GrapaError GrapaBtree::BuildTree(u64 headRef, GrapaBlockTree& head, GrapaBlockNodeLeaf* items, u64 itemCount, u8 nodeCount, u8 fillCount, u64& rootRef)
+{
+	GrapaError err;
+	u64 capacity,weight=0,next=0;
+	u32 height;
+
+	rootRef = 0;
+	if (itemCount==0) return(0);
+
+	height = 1;
+	capacity = fillCount;
+	while (capacity < itemCount && capacity < (((u64)-1) >> 8))
+	{
+		capacity = capacity * (((u64)fillCount) + 1) + fillCount;
+		height++;
+	}
+
+	err = BuildNode(headRef, head, items, next, itemCount, height, nodeCount, fillCount, headRef, -1, rootRef, weight);
+	if (err)
+	{
+		FreeNodes(rootRef, nodeCount);
+		rootRef = 0;
+	}
+	return(err);
+}
+
+// Builds the subtree for the itemCount items from items[next] on. height 1 is a bottom node; above
+// that the items are spread as evenly as possible over the fewest children that can hold them,
+// counting fillCount items to a node.
+GrapaError GrapaBtree::BuildNode(u64 headRef, GrapaBlockTree& head, GrapaBlockNodeLeaf* items, u64& next, u64 itemCount, u32 height, u8 nodeCount, u8 fillCount, u64 parent, s8 parentIndex, u64& nodeRef, u64& weight)
+{
+	GrapaError err;
+	GrapaBlockNodeHeader page;
+	GrapaBlockNodeLeaf leaves[PAGE_WIDTH];
+	GrapaCursor leafCursor;
+	u64 span,children,share,extra,i,count,childRef,childWeight,itemWeight;
+	u32 h;
+	u8 leafCount = 0;
+
+	weight = 0;
+	nodeRef = NewPage((((u64)nodeCount)+1)*GrapaBlock::BLOCKSIZE,true);
+	if (nodeRef==0) return(-1);
+
+	page.Init();
+	page.parent = parent;
+	page.parentIndex = parentIndex;
+
+	span = 0;
+	for (h=1;h<height;h++)
+		span = span * (((u64)fillCount)+1) + fillCount;
+	children = (height > 1) ? (itemCount + span + 1) / (span + 1) : 1;
+	share = (itemCount - (children - 1)) / children;
+	extra = (itemCount - (children - 1)) % children;
+
+	for (i=0;i<children;i++)
+	{
+		if (height > 1)
+		{
+			err = BuildNode(headRef, head, items, next, share + ((i < extra) ? 1 : 0), height - 1, nodeCount, fillCount, nodeRef, (s8)i, childRef, childWeight);
+			if (err) return(err);
+			if (i==0) page.firstChild = childRef; else leaves[leafCount-1].child = childRef;
+			page.weight += childWeight;
+			if (i==children-1) break;
+			count = 1;
+		}
+		else
+			count = itemCount;
+		while (count--)
+		{
+			if (leafCount >= nodeCount) return(-1);
+			leaves[leafCount] = items[next++];
+			leafCursor.Set(headRef,leaves[leafCount].valueType,leaves[leafCount].key,leaves[leafCount].value,leaves[leafCount].flags);
+			leafCursor.mTreeType = head.treeType;
+			err = GetWeight(leafCursor,itemWeight);
+			page.weight += itemWeight;
+			leafCount++;
+		}
+	}
+
+	page.leafCount = leafCount;
+	err = WriteLeaves(nodeRef, 0, leafCount, leaves);
+	if (err) return(err);
+	err = page.Write(mFile,nodeRef);
+	if (err) return(err);
+
+	weight = page.weight;
+	return(0);
+}
+
+// Returns the node pages of a subtree to the free list, leaving the items they point at alone.
+GrapaError GrapaBtree::FreeNodes(u64 pagePos, u8 nodeCount)
+{
+	GrapaError err;
+	GrapaBlockNodeHeader node;
+	GrapaBlockNodeLeaf leaves[PAGE_WIDTH];
+	u8 i;
+
+	if (pagePos==0L)
+		return(0);
+
+	err = node.Read(mFile,pagePos);
+	if (err) return(err);
+
+	if (node.blockType==GrapaBlock::NODE_BLOCK && node.leafCount <= PAGE_WIDTH)
+	{
+		err = ReadLeaves(pagePos, 0, node.leafCount, leaves);
+		if (err) return(err);
+		err = FreeNodes(node.firstChild, nodeCount);
+		if (err) return(err);
+		for (i=0;i<node.leafCount;i++)
+		{
+			err = FreeNodes(leaves[i].child, nodeCount);
+			if (err) return(err);
+		}
+	}
+
+	return PurgePage(pagePos,(((u64)nodeCount)+1)*GrapaBlock::BLOCKSIZE);
+}
+
 GrapaError GrapaBtree::EmptyItem(u64 headRef, GrapaBlockTree& head, u64 pagePos)
 {
 	GrapaBlockNodeHeader node;
@@ -2579,8 +3000,8 @@ u64 GrapaBtree::NewPage(u64 byteCount, bool clear)
 	GrapaError err = 0;
 	GrapaBlockPage hr;
 	u64 offset;
-	u8 buffer[GrapaBlock::BLOCKSIZE];
-	u64 i;
+	u8 buffer[GrapaBlock::COPYSIZE];
+	u64 i,n;
 	GrapaBlockFileHeader hdr;
 	GrapaBlockFirst fst;
 	u64 blockCount;
@@ -2607,10 +3028,12 @@ u64 GrapaBtree::NewPage(u64 byteCount, bool clear)
 
 	if ((offset)&&(clear))
 	{
-		memset(buffer,0,GrapaBlock::BLOCKSIZE);
-		for(i=0;i<blockCount;i++)
+		memset(buffer,0,GrapaBlock::COPYSIZE);
+		for(i=0;i<blockCount*GrapaBlock::BLOCKSIZE;i+=n)
 		{
-			err = mFile->Write( offset, GrapaBlock::BLOCKSIZE, i*GrapaBlock::BLOCKSIZE, GrapaBlock::BLOCKSIZE, buffer);
+			n = blockCount*GrapaBlock::BLOCKSIZE - i;
+			if (n > GrapaBlock::COPYSIZE) n = GrapaBlock::COPYSIZE;
+			err = mFile->Write( offset, GrapaBlock::BLOCKSIZE, i, n, buffer);
 			if (err)
 			{
 				fst.blockCount -= blockCount;
@@ -19,8 +19,12 @@ public:
 	enum { BYTE_DATA = 0, FREC_DATA, LAST_DATA, };
 	enum { DATA_STORE=0, LAST_STORE, };
 	enum { SEARCH_MODE=0, INSERT_MODE, DELETE_MODE, LAST_MODE, };
-	enum { ENCODE_NONE = 0, ENCODE_ZIP = 0x01, ENCODE_AES = 0x02, };
-	enum { NODE_WIDTH=5 };
+	enum { ENCODE_NONE = 0, ENCODE_ZIP = 0x01, ENCODE_AES = 0x02, ENCODE_COLUMN = 0x04, };
+	// A node is a header block plus nodeCount leaf blocks. PAGE_WIDTH fills a 4 KB page, which
+	// keeps large trees three or four levels deep.
+	enum { NODE_WIDTH=5, PAGE_WIDTH=127 };
+	// Percent of each node LoadTree fills, leaving room for later inserts before nodes split.
+	enum { LOAD_FILL=90 };
 	enum { CMP_LT=-1, CMP_EQ=0, CMP_GT=1, };
 
 	u8 mFlags;
@@ -58,7 +62,7 @@ public:
     virtual GrapaError SetFileTree  (u64 firstTree, bool deleteExisting=true);
     virtual u64 FirstTree        (u64 treePtr);
 
-	virtual GrapaError NewTree      (u64& treePtr, u8 treeType, u64 parentTree=0L, u8 nodeCount=NODE_WIDTH);
+	virtual GrapaError NewTree      (u64& treePtr, u8 treeType, u64 parentTree=0L, u8 nodeCount=NODE_WIDTH, bool ranked=true);
     virtual GrapaError DeleteTree   (u64 treePtr);
     virtual GrapaError EmptyTree    (GrapaCursor& cursor);
     virtual GrapaError SetTreeIndex (GrapaCursor& cursor, u64 indexTree);
@@ -71,6 +75,11 @@ public:
 	virtual GrapaError GetTreeType  (GrapaCursor& cursor, u8& treeType);
 	virtual GrapaError SetTreeType  (GrapaCursor& cursor, u8 treeType);
 	virtual GrapaError GetTreeParent(GrapaCursor& cursor, u64& parentTree);
+	virtual GrapaError GetTreeRanked(GrapaCursor& cursor, bool& isRanked);
+	virtual GrapaError SetTreeRanked(GrapaCursor& cursor, bool isRanked);
+	virtual GrapaError GetTreeWidth (GrapaCursor& cursor, u8& nodeCount);
+	virtual GrapaError ConvertTree  (u64 treePtr, u8 nodeCount, bool sortItems, bool& changed);
+	virtual GrapaError LoadTree     (u64 treePtr, GrapaBlockNodeLeaf* items, u64 itemCount, bool sortItems, u8 fillPercent=LOAD_FILL);
 
 	// need to add a minByteCount and maxByteCount,
 	// and then a way to get the first available block within a size range
@@ -100,6 +109,7 @@ public:
     virtual GrapaError Last         (GrapaCursor& cursor);
     virtual GrapaError Next         (GrapaCursor& cursor);
     virtual GrapaError Prev         (GrapaCursor& cursor);
+    virtual GrapaError Seek         (GrapaCursor& cursor, bool pLast = false, bool pInclusive = true);
 
 protected:
 	u8 mBuffer[GrapaBlock::COPYSIZE];
@@ -108,8 +118,10 @@ protected:
 	GrapaError FindFirstX(u64 offset, GrapaCursor& cursor);
 	GrapaError FindLastX(u64 offset, GrapaCursor& cursor);
 
-	bool SearchNode(u64 rootNode, GrapaCursor& key, s8& pos, u64& child, GrapaBlockNodeLeaf& foundKey, s16 compareType);
-	bool SearchRc(u64 rootNode, GrapaCursor& key, GrapaBlockNodeLeaf& foundKey);
+	GrapaError ReadLeaves(u64 rootNode, s8 first, s8 count, GrapaBlockNodeLeaf* leaves);
+	GrapaError WriteLeaves(u64 rootNode, s8 first, s8 count, GrapaBlockNodeLeaf* leaves);
+	bool SearchNode(u64 rootNode, GrapaCursor& key, s8& pos, u64& child, GrapaBlockNodeLeaf& foundKey, s16 compareType, bool ranked);
+	bool SearchRc(u64 rootNode, GrapaCursor& key, GrapaBlockNodeLeaf& foundKey, bool ranked);
 	GrapaError InsInPage(GrapaBlockTree& head, GrapaCursor& treekey, u64 rootNode, GrapaBlockNodeHeader& page, GrapaBlockNodeLeaf& key, s8 pos);
 
 	void RotateLeafLeft(u64 headRef, GrapaBlockTree& head, s8 pos, u64 rootPage, GrapaBlockNodeHeader& rootTree, 
@@ -135,6 +147,11 @@ protected:
 	GrapaError EmptyItem(u64 headRef, GrapaBlockTree& head, u64 pagePos);
 	GrapaError AppendNode(u64 headRef, GrapaBlockTree& head, GrapaBlockNodeLeaf& promKey);
 
+	GrapaError SortItems(u64 headRef, GrapaBlockTree& head, GrapaBlockNodeLeaf* items, u64 itemCount, bool& sorted);
+	GrapaError BuildTree(u64 headRef, GrapaBlockTree& head, GrapaBlockNodeLeaf* items, u64 itemCount, u8 nodeCount, u8 fillCount, u64& rootRef);
+	GrapaError BuildNode(u64 headRef, GrapaBlockTree& head, GrapaBlockNodeLeaf* items, u64& next, u64 itemCount, u32 height, u8 nodeCount, u8 fillCount, u64 parent, s8 parentIndex, u64& nodeRef, u64& weight);
+	GrapaError FreeNodes(u64 pagePos, u8 nodeCount);
+
 	void RotateParrentRight(u64 headRef, GrapaBlockTree& head, u64 middleOffset, GrapaBlockNodeHeader& middleTree);
 	void RotateParrentLeft(u64 headRef, GrapaBlockTree& head, u64 middleOffset, GrapaBlockNodeHeader& middleTree);
 
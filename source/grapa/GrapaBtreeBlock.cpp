@@ -139,6 +139,12 @@ void GrapaBlockTree::BigEndian()
 void GrapaBlockTree::Init() { memset(&blockType, 0, GetSize()); blockType = GrapaBlock::TREE_BLOCK; }
 bool GrapaBlockTree::GetDirty() { return((flags & 0x80) == 0x80); }
 void GrapaBlockTree::SetDirty(bool isDirty) { if (isDirty) flags |= 0x80; else flags &= 0x7F; }
+bool GrapaBlockTree::GetRanked() { return((flags & 0x40) == 0); }
+void GrapaBlockTree::SetRanked(bool isRanked) { if (isRanked) flags &= 0xBF; else flags |= 0x40; }
+bool GrapaBlockTree::GetDeferred() { return((flags & 0x20) == 0x20); }
+void GrapaBlockTree::SetDeferred(bool isDeferred) { if (isDeferred) flags |= 0x20; else flags &= 0xDF; }
+bool GrapaBlockTree::GetUnique() { return((flags & 0x10) == 0x10); }
+void GrapaBlockTree::SetUnique(bool isUnique) { if (isUnique) flags |= 0x10; else flags &= 0xEF; }
 GrapaError GrapaBlockTree::Write(GrapaFile *pFile, u64 blockPos)
 {
 	if (!pFile) return(-1);
@@ -161,7 +167,7 @@ void GrapaBlockFileHeader::BigEndian()
 	firstTree = BE_S64(firstTree);
 	firstBlock = BE_S64(firstBlock);
 }
-void GrapaBlockFileHeader::Init() { memset(&blockType, 0, GetSize()); blockType = GrapaBlock::FILE_BLOCK; fileRef1 = 'B'; fileRef2 = 'T'; blockSize = GrapaBlock::BLOCKSIZE; }
+void GrapaBlockFileHeader::Init() { memset(&blockType, 0, GetSize()); blockType = GrapaBlock::FILE_BLOCK; fileRef1 = 'B'; fileRef2 = 'T'; version1 = GrapaBlock::FORMAT_VERSION; blockSize = GrapaBlock::BLOCKSIZE; }
 GrapaError GrapaBlockFileHeader::Write(GrapaFile *pFile, u64 blockPos)
 {
 	if (!pFile) return(-1);
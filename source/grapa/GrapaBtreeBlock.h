@@ -12,6 +12,9 @@ class GrapaBlock
 public:
 	// for some reason, changing BLOCKSIZE to 16 (and BLOCKS32 to 2) results in a problem...need to debug this
 	enum { BLOCKSIZE = 32, BLOCKS32 = 1, COPYSIZE = 1024 };
+	// version1 in the file header; 1 added page-width trees and the unranked tree flag, 2 ordered
+	// index keys by field type
+	enum { FORMAT_VERSION = 2 };
 	enum { FILE_BLOCK = 0, FIRST_BLOCK, TREE_BLOCK, NODE_BLOCK, LEAF_BLOCK, DATA_BLOCK, PAGE_BLOCK, };
 };
 
@@ -109,7 +112,7 @@ class GrapaBlockTree
 public:
 	struct{
 		u8 blockType;	// TREE_BLOCK
-		u8 flags;		// 0x80=dirty
+		u8 flags;		// 0x80=dirty, 0x40=unranked (Search leaves mLength at 0), 0x20=index not maintained, 0x10=unique index
 		s8 nodeCount;	// Need to leave this as signed. The logic in GrapaCore.cpp depends on negative.
 		u8 treeType;
 		u8 storeType;
@@ -127,6 +130,12 @@ public:
 	void Init();
 	bool GetDirty();
 	void SetDirty(bool isDirty);
+	bool GetRanked();
+	void SetRanked(bool isRanked);
+	bool GetDeferred();
+	void SetDeferred(bool isDeferred);
+	bool GetUnique();
+	void SetUnique(bool isUnique);
 	GrapaError Write(GrapaFile *pFile, u64 blockPos);
 	GrapaError Read(GrapaFile *pFile, u64 blockPos);
 };
@@ -28,12 +28,22 @@ limitations under the License.
 #include "GrapaTime.h"
 #include "GrapaFloat.h"
 #include "GrapaMem.h"
+#include "GrapaVector.h"
+
+#include <vector>
+#include <climits>
+#include <string>
+#include <unordered_map>
+
+static int GrapaDBCompareValue(u8 pType, const GrapaBYTE& a, const GrapaBYTE& b);
+static bool GrapaDBSlot(u8* pSlot, u64 pSize, u64 pIsRaw, u64& pStart, u64& pLength);
 
 ////////////////////////////////////////////////////////////////////////////////
 
 GrapaError GrapaDB::Create(const char *fileName, u8 treeType, u64& firstTree)
 {
 	firstTree = 0;
+	mByteKeys = false;
 	GrapaError err = GrapaBtree::Create(fileName);
 	if (err) return(err);
 	err = CreateRoot(treeType, firstTree);
@@ -41,9 +51,25 @@ GrapaError GrapaDB::Create(const char *fileName, u8 treeType, u64& firstTree)
 	return(err);
 }
 
+// Index trees in a file written before FORMAT_VERSION 2 hold their keys in byte order. They are
+// searched in that order until ConvertFile re-sorts them; opening the file never changes it.
 GrapaError GrapaDB::OpenFile(const char *fileName, char mode)
 {
-	return GrapaBtree::OpenFile(fileName, mode);
+	GrapaError err;
+	GrapaBlockFileHeader hdr;
+
+	mByteKeys = false;
+	err = GrapaBtree::OpenFile(fileName, mode);
+	if (err) return(err);
+
+	err = hdr.Read(mFile,0);
+	if (err)
+	{
+		mFile->Close();
+		return(err);
+	}
+	mByteKeys = hdr.version1 < 2;
+	return(0);
 }
 
 u64 GrapaDB::RootTree(u8& pNewType)
@@ -92,12 +118,12 @@ GrapaError GrapaDB::CloseFile()
 	return GrapaBtree::CloseFile();
 }
 
-GrapaError GrapaDB::NewTree(u64& treePtr, u8 treeType, u64 parentTree, u8 nodeCount)
+GrapaError GrapaDB::NewTree(u64& treePtr, u8 treeType, u64 parentTree, u8 nodeCount, bool ranked)
 {
 	GrapaError err;
 	GrapaDBTable table;
 
-	err = GrapaBtree::NewTree(treePtr,treeType,parentTree,nodeCount); 
+	err = GrapaBtree::NewTree(treePtr,treeType,parentTree,nodeCount,ranked); 
 	if (err) return(err);
 
 	switch (treeType)
@@ -123,6 +149,31 @@ GrapaError GrapaDB::DumpFile(GrapaFile *pDumpFile)
 	return DumpTree(0, pDumpFile);
 }
 
+// Brings a file up to the layout new files get: row tables and their indexes are rebuilt with
+// page-width nodes. Files written before FORMAT_VERSION 1 read fine without this; it only makes
+// their big trees shallow. Index keys still in byte order are re-sorted by field type as they go.
+GrapaError GrapaDB::ConvertFile(u64& pCount)
+{
+	GrapaError err;
+	GrapaBlockFileHeader hdr;
+	bool byteKeys = mByteKeys;
+
+	pCount = 0;
+	mByteKeys = false;
+	err = ConvertTheTree(FirstTree(0), true, pCount);
+	if (!err)
+		err = hdr.Read(mFile,0);
+	if (!err && hdr.version1 < GrapaBlock::FORMAT_VERSION)
+	{
+		hdr.version1 = GrapaBlock::FORMAT_VERSION;
+		err = hdr.Write(mFile,0);
+	}
+	if (err)
+		mByteKeys = byteKeys;
+
+	return(err);
+}
+
 GrapaError GrapaDB::DumpTree(u64 pTreeRef, GrapaFile *pDumpFile)
 {
 	GrapaError err = 0;
@@ -180,7 +231,13 @@ GrapaError GrapaDB::CreateTable(u64 firstTree, u8 pTreeType, u64 pTableId, Grapa
 		if (!err) return(-1);
 	}
 
-	err = NewTree(pTable.mRef,pTreeType,firstTree);
+	// Row tables and their indexes are the trees that grow with the data. They get page-width
+	// nodes, and as nothing reads a row's position they skip the rank bookkeeping in Search.
+	// Column tables address field data by record position, so they stay ranked.
+	if (pTreeType == RTABLE_TREE)
+		err = NewTree(pTable.mRef,pTreeType,firstTree,PAGE_WIDTH,false);
+	else
+		err = NewTree(pTable.mRef,pTreeType,firstTree);
 	if (err) return(err);
 
 	pTable.mRefType = pTreeType;
@@ -982,7 +1039,8 @@ GrapaError GrapaDB::FindFreeIndexId(GrapaDBIndex& pIndex, u64 minId, u64& pIndex
 	return(0);
 }
 
-GrapaError GrapaDB::CreateIndex(GrapaDBTable& pTable, u64 pIndexId, GrapaDU64Array& pIndexList, GrapaDBIndex& pIndex)
+// A unique index refuses a second record with the same values in its fields, once any of them is set.
+GrapaError GrapaDB::CreateIndex(GrapaDBTable& pTable, u64 pIndexId, GrapaDU64Array& pIndexList, GrapaDBIndex& pIndex, bool pUnique)
 {
 	GrapaError err;
 	GrapaCursor indexCursor;
@@ -1007,9 +1065,26 @@ GrapaError GrapaDB::CreateIndex(GrapaDBTable& pTable, u64 pIndexId, GrapaDU64Arr
 	pIndex.mRef = 0;
 	pIndex.mTable = pTable;
 
-	err = NewTree(pIndex.mRef,RTABLE_TREE,indexRef);
+	// GrapaGroup opens row tables without filling in mRefType, so ask the record tree.
+	u8 recType = 0;
+	indexCursor.Set(pTable.mRecRef);
+	GetTreeType(indexCursor,recType);
+	if (recType == RTABLE_TREE)
+		err = NewTree(pIndex.mRef,RTABLE_TREE,indexRef,PAGE_WIDTH,false);
+	else
+		err = NewTree(pIndex.mRef,RTABLE_TREE,indexRef);
 	if (err) return(err);
 
+	if (pUnique)
+	{
+		GrapaBlockTree head;
+		err = head.Read(mFile,pIndex.mRef);
+		if (err) return(err);
+		head.SetUnique(true);
+		err = head.Write(mFile,pIndex.mRef);
+		if (err) return(err);
+	}
+
 	indexCursor.Set(indexRef,TREE_ITEM,pIndex.mId,pIndex.mRef);
 	err = Insert(indexCursor);
 	if (err) return(err);
@@ -1131,6 +1206,42 @@ GrapaError GrapaDB::RefreshIndex(GrapaDBIndex& pIndex)
 	return(0);
 }
 
+// Stops maintaining an index until RebuildIndexes. Its items are dropped, since the first change
+// would leave them stale, and searches pass it over meanwhile.
+GrapaError GrapaDB::DeferIndex(GrapaDBTable& pTable, u64 pIndexId)
+{
+	GrapaError err;
+	GrapaCursor indexCursor;
+	GrapaBlockTree head;
+	u64 indexRef;
+
+	indexCursor.Set(pTable.mRecRef);
+	err = GetTreeIndex(indexCursor,indexRef);
+	if (err) return(err);
+	if (indexRef==0 || pIndexId==0) return(-1);
+
+	indexCursor.Set(indexRef,TREE_ITEM,pIndexId);
+	err = Search(indexCursor);
+	if (err) return(err);
+
+	err = head.Read(mFile,indexCursor.mValue);
+	if (err) return(err);
+	if (head.GetDeferred()) return(0);
+	err = FreeNodes(head.firstItem,(u8)head.nodeCount);
+	if (err) return(err);
+	head.firstItem = 0;
+	head.itemCount = 0;
+	head.SetDeferred(true);
+	return head.Write(mFile,indexCursor.mValue);
+}
+
+// Builds every deferred index of the table again and maintains it from then on. pCount is the
+// number rebuilt.
+GrapaError GrapaDB::RebuildIndexes(GrapaDBTable& pTable, u64& pCount)
+{
+	return LoadIndexes(pTable, true, &pCount);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 GrapaError GrapaDB::CreateIndexField(GrapaDBIndex& pIndex, u64 pIndexFieldId, u64 pFieldId)
@@ -1300,7 +1411,8 @@ GrapaError GrapaDB::CreateRecord(GrapaDBTable& pTable, GrapaCursor& pCursor)
 				while (!err)
 				{
 					tableCursor.Set(indexCursor.mValue,RPTR_ITEM,pCursor.mKey);
-					err = Insert(tableCursor);
+					if (!IndexDeferred(indexCursor.mValue))
+						err = Insert(tableCursor);
 					err = Next(indexCursor);
 					if (!err && indexCursor.mKey==0)
 						err = Next(indexCursor);
@@ -1344,6 +1456,10 @@ GrapaError GrapaDB::CreateRecord(GrapaDBTable& pTable, GrapaCursor& pCursor)
 								if (err) return(err);
 								err = dbField.Read(this,itemCursor.mValue);
 								if (err) return(err);
+								if (ColumnEndsBefore(tableCursor.mValue, pCursor.mLength))
+									break;
+								err = ExpandField(tableCursor, dbField);
+								if (err) return(err);
 								err = InsertDataValue(tableCursor.mValue, pCursor.mLength*dbField.mDictSize, dbField.mDictSize, NULL);
 							}
 							break;
@@ -1361,7 +1477,8 @@ GrapaError GrapaDB::CreateRecord(GrapaDBTable& pTable, GrapaCursor& pCursor)
 				while (!err)
 				{
 					tableCursor.Set(indexCursor.mValue,CPTR_ITEM,pCursor.mKey,0);
-					err = Insert(tableCursor);
+					if (!IndexDeferred(indexCursor.mValue))
+						err = Insert(tableCursor);
 					err = Next(indexCursor);
 					if (!err && indexCursor.mKey==0)
 						err = Next(indexCursor);
@@ -1378,6 +1495,236 @@ GrapaError GrapaDB::CreateRecord(GrapaDBTable& pTable, GrapaCursor& pCursor)
 	return(0);
 }
 
+// Creates pCount empty records in an empty row table, with ids from pFirstId on, and builds the
+// record tree over them bottom-up. pRecordRefs receives each record's data block. The indexes are
+// left empty; LoadIndexes fills them once the fields are set.
+GrapaError GrapaDB::LoadRecords(GrapaDBTable& pTable, u64 pFirstId, u64 pCount, u64* pRecordRefs)
+{
+	GrapaError err;
+	GrapaCursor tableCursor,indexCursor,dtField;
+	GrapaDBField dbField;
+	u64 indexTree=0,itemCount=0,i,j;
+	u8 treeType=0;
+
+	tableCursor.Set(pTable.mRecRef);
+	err = GetTreeType(tableCursor,treeType);
+	if (err) return(err);
+	if (treeType!=RTABLE_TREE) return(-1);
+	err = GetTreeSize(tableCursor,itemCount);
+	if (err) return(err);
+	if (itemCount) return(-1);
+	err = GetTreeIndex(tableCursor,indexTree);
+	if (err) return(err);
+
+	indexCursor.Set(indexTree);
+	err = First(indexCursor);
+	if (err) return(err);
+	dtField.Set(indexCursor.mValue);
+	err = First(dtField); //This is the DICT field
+	if (err) return(err);
+	err = dbField.Read(this,dtField.mValue);
+	if (err) return(err);
+
+	std::vector<GrapaBlockNodeLeaf> items(pCount);
+	for (i=0;i<pCount;i++)
+	{
+		err = NewData(BYTE_DATA, pTable.mRecRef, dbField.mDictSize, dbField.mDictSize, 1, pRecordRefs[i], true);
+		if (!err && pRecordRefs[i]==0) err = -1;
+		if (err) break;
+		items[i].Init();
+		items[i].valueType = RREC_ITEM;
+		items[i].key = pFirstId + i;
+		items[i].value = pRecordRefs[i];
+	}
+	if (!err)
+		err = LoadTree(pTable.mRecRef, items.data(), pCount, false);
+	if (err)
+	{
+		for (j=0;j<i;j++)
+			DeleteData(pRecordRefs[j]);
+	}
+	return(err);
+}
+
+// Fills each empty index of a row or column table with every record, sorted once by the index's
+// fields and built bottom-up. Indexes that already hold items are left alone, and so are deferred
+// ones unless pDeferred is set. A unique index that finds two records with the same values is
+// left empty and deferred, and the error returned once the other indexes are built. pCount is
+// the number of indexes built.
+GrapaError GrapaDB::LoadIndexes(GrapaDBTable& pTable, bool pDeferred, u64* pCount)
+{
+	GrapaError err,result=0;
+	GrapaCursor tableCursor,indexCursor,recCursor;
+	GrapaBlockTree head;
+	std::vector<GrapaBlockNodeLeaf> ptrs,items;
+	u64 indexTree=0,itemCount=0,i;
+	u8 treeType=0,ptrType;
+	bool sorted,clash;
+
+	if (pCount) *pCount = 0;
+
+	tableCursor.Set(pTable.mRecRef);
+	err = GetTreeType(tableCursor,treeType);
+	if (err) return(err);
+	switch (treeType)
+	{
+		case RTABLE_TREE: ptrType = RPTR_ITEM; break;
+		case CTABLE_TREE: ptrType = CPTR_ITEM; break;
+		default: return(-1);
+	}
+	err = GetTreeSize(tableCursor,itemCount);
+	if (err) return(err);
+	err = GetTreeIndex(tableCursor,indexTree);
+	if (err) return(err);
+
+	ptrs.reserve(itemCount);
+	recCursor.Set(pTable.mRecRef);
+	err = First(recCursor);
+	while (!err)
+	{
+		ptrs.emplace_back();
+		ptrs.back().Init();
+		ptrs.back().valueType = ptrType;
+		ptrs.back().key = recCursor.mKey;
+		err = Next(recCursor);
+	}
+
+	indexCursor.Set(indexTree);
+	err = First(indexCursor);
+	if (!err && indexCursor.mKey==0)
+		err = Next(indexCursor);
+	while (!err)
+	{
+		err = head.Read(mFile,indexCursor.mValue);
+		if (err) return(err);
+		if (head.GetDeferred() ? pDeferred : (head.itemCount==0 && ptrs.size()))
+		{
+			items = ptrs;
+			err = SortItems(indexCursor.mValue, head, items.data(), items.size(), sorted);
+			if (err) return(err);
+			clash = false;
+			for (i=1;i<items.size() && head.GetUnique() && !clash;i++)
+				clash = IndexKeyEqual(indexCursor.mValue, ptrType, items[i-1].key, items[i].key);
+			if (clash)
+			{
+				result = -1;
+				if (!head.GetDeferred())
+				{
+					head.SetDeferred(true);
+					err = head.Write(mFile,indexCursor.mValue);
+					if (err) return(err);
+				}
+			}
+			else
+			{
+				err = LoadTree(indexCursor.mValue, items.data(), items.size(), false);
+				if (err) return(err);
+				err = head.Read(mFile,indexCursor.mValue);
+				if (!err && head.GetDeferred())
+				{
+					head.SetDeferred(false);
+					err = head.Write(mFile,indexCursor.mValue);
+				}
+				if (err) return(err);
+				if (pCount) (*pCount)++;
+			}
+		}
+		err = Next(indexCursor);
+		if (!err && indexCursor.mKey==0)
+			err = Next(indexCursor);
+	}
+
+	return(result);
+}
+
+// Whether two records hold the same values in an index's fields. Only set values count, so records
+// with none of the fields set never match.
+bool GrapaDB::IndexKeyEqual(u64 indexRef, u8 ptrType, u64 key1, u64 key2)
+{
+	GrapaError err;
+	GrapaCursor ptr1,ptr2,rec1,rec2,fieldCursor;
+	GrapaCHAR value1,value2;
+	u64 fieldsRef=0;
+	bool set = false;
+
+	fieldCursor.Set(indexRef);
+	err = GetTreeIndex(fieldCursor,fieldsRef);
+	if (err || fieldsRef==0) return(false);
+	ptr1.Set(indexRef,ptrType,key1);
+	ptr2.Set(indexRef,ptrType,key2);
+	if (PtrToRec(ptr1,rec1) || PtrToRec(ptr2,rec2)) return(false);
+
+	fieldCursor.Set(fieldsRef);
+	err = First(fieldCursor);
+	while (!err)
+	{
+		GrapaDBField field;
+		GrapaCursor itemCursor;
+		if (FindRecordField(rec1,fieldCursor.mValue,itemCursor,field)) return(false);
+		if (GetRecordField(rec1,field,value1)) value1.SetLength(0);
+		if (GetRecordField(rec2,field,value2)) value2.SetLength(0);
+		if (CompareKeyValue(field.mType,value1,value2)) return(false);
+		if (value1.mLength) set = true;
+		err = Next(fieldCursor);
+	}
+	return(set);
+}
+
+// Fails when another record already holds the values that recCursor's record will have in the
+// fields of a unique index once pFieldList is written. Fields missing from pFieldList keep the
+// record's current values.
+GrapaError GrapaDB::CheckUnique(u64 indexRef, GrapaCursor& recCursor, GrapaDBFieldValueArray& pFieldList)
+{
+	GrapaError err;
+	GrapaCursor fieldCursor;
+	GrapaDBCursor searchCursor;
+	GrapaDBFieldValueArray values;
+	GrapaBlockTree head;
+	u64 fieldsRef=0;
+	s32 i,fieldCount = pFieldList.Count();
+	bool set = false;
+
+	err = head.Read(mFile,indexRef);
+	if (err) return(err);
+	if (!head.GetUnique() || head.GetDeferred()) return(0);
+
+	fieldCursor.Set(indexRef);
+	err = GetTreeIndex(fieldCursor,fieldsRef);
+	if (err || fieldsRef==0) return(err);
+
+	fieldCursor.Set(fieldsRef);
+	err = First(fieldCursor);
+	while (!err)
+	{
+		GrapaDBFieldValue* given = NULL;
+		for (i=0;i<fieldCount && given==NULL;i++)
+			if (pFieldList.GetFieldAt(i)->mId == fieldCursor.mValue)
+				given = pFieldList.GetFieldAt(i);
+		if (given)
+		{
+			values.Append(*given, given->mValue);
+			if (given->mValue.mLength) set = true;
+		}
+		else
+		{
+			GrapaDBField field;
+			GrapaCursor itemCursor;
+			GrapaCHAR value;
+			err = FindRecordField(recCursor, fieldCursor.mValue, itemCursor, field);
+			if (err) return(err);
+			if (GetRecordField(itemCursor, field, value)) value.SetLength(0);
+			values.Append(field, value);
+			if (value.mLength) set = true;
+		}
+		err = Next(fieldCursor);
+	}
+	if (!set) return(0);
+
+	searchCursor.SetSearch(this,indexRef,true,&values);
+	if (Search(searchCursor)) return(0);
+	return((searchCursor.mKey == recCursor.mKey) ? 0 : (GrapaError)-1);
+}
+
 GrapaError GrapaDB::DeleteRecord(GrapaDBTable& pTable, GrapaCursor& pCursor)
 {
 	GrapaError err;
@@ -1434,6 +1781,10 @@ GrapaError GrapaDB::DeleteRecord(GrapaDBTable& pTable, GrapaCursor& pCursor)
 							if (err) return(err);
 							err = dbField.Read(this,itemCursor.mValue);
 							if (err) return(err);
+							if (ColumnEndsBefore(tableCursor.mValue, delOffset))
+								break;
+							err = ExpandField(tableCursor, dbField);
+							if (err) return(err);
 							err = DeleteDataValue(tableCursor.mValue, delOffset*dbField.mDictSize, dbField.mDictSize, &rsize);
 							break;
 
@@ -1452,7 +1803,8 @@ GrapaError GrapaDB::DeleteRecord(GrapaDBTable& pTable, GrapaCursor& pCursor)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-GrapaError GrapaDB::SetRecordField(GrapaCursor& cursor, GrapaDBFieldValueArray& pFieldList)
+// With pIndexes false the table's indexes are not updated, for a caller that rebuilds them after.
+GrapaError GrapaDB::SetRecordField(GrapaCursor& cursor, GrapaDBFieldValueArray& pFieldList, bool pIndexes)
 {
 	GrapaError err;
 	GrapaCursor recCursor,tableCursor,indexCursor;
@@ -1471,16 +1823,41 @@ GrapaError GrapaDB::SetRecordField(GrapaCursor& cursor, GrapaDBFieldValueArray&
 	if (err) return(err);
 
 	recCursor.mTreeType = tree.treeType;
-	indexTree = tree.indexTree;
+	indexTree = pIndexes ? tree.indexTree : 0;
 	storeTree = tree.storeTree;
 
+	// A unique index refuses the change before anything is written.
+	if (indexTree && (recCursor.mTreeType == RTABLE_TREE || recCursor.mTreeType == CTABLE_TREE))
+	{
+		indexCursor.Set(indexTree);
+		err = First(indexCursor);
+		if (!err && indexCursor.mKey==0)
+			err = Next(indexCursor);
+		while (!err)
+		{
+			for(i=0;i<fieldCount;i++)
+			{
+				if (IndexHasField(indexCursor,pFieldList.GetFieldAt(i)->mId))
+				{
+					err = CheckUnique(indexCursor.mValue,recCursor,pFieldList);
+					if (err) return(err);
+					break;
+				}
+			}
+			err = Next(indexCursor);
+			if (!err && indexCursor.mKey==0)
+				err = Next(indexCursor);
+		}
+	}
+
 	indexCursor.Set(indexTree);
 	err = First(indexCursor);
 	if (!err && indexCursor.mKey==0)
 		err = Next(indexCursor);
 	while (!err)
 	{
-		for(i=0;i<fieldCount;i++)
+		bool deferred = IndexDeferred(indexCursor.mValue);
+		for(i=0;i<fieldCount && !deferred;i++)
 		{
 			dbFieldValue = pFieldList.GetFieldAt(i);
 			if (IndexHasField(indexCursor,dbFieldValue->mId))
@@ -1703,6 +2080,8 @@ GrapaError GrapaDB::SetRecordField(GrapaCursor& cursor, GrapaDBFieldValueArray&
 				tableCursor.Set(storeTree, SDATA_ITEM, dbFieldValue->mId);
 				err = Search(tableCursor);
 				if (err) return(err);
+				err = ExpandField(tableCursor, *dbFieldValue);
+				if (err) return(err);
 				if (dbFieldValue->mDictSize == 1)
 				{
 					switch (dbFieldValue->mType)
@@ -1850,7 +2229,8 @@ GrapaError GrapaDB::SetRecordField(GrapaCursor& cursor, GrapaDBFieldValueArray&
 		err = Next(indexCursor);
 	while (!err)
 	{
-		for(i=0;i<fieldCount;i++)
+		bool deferred = IndexDeferred(indexCursor.mValue);
+		for(i=0;i<fieldCount && !deferred;i++)
 		{
 			dbFieldValue = pFieldList.GetFieldAt(i);
 			if (IndexHasField(indexCursor,dbFieldValue->mId))
@@ -2075,6 +2455,24 @@ GrapaError GrapaDB::GetRecordField(GrapaCursor& cursor, GrapaDBField& field, Gra
 			err = Search(fieldCursor);
 			if (err) return(err);
 
+			err = GetDataSize(fieldCursor.mValue, growBlockSize, dataSize, dataLength, compressType);
+			if (!err && (compressType & ENCODE_COLUMN))
+			{
+				std::vector<u8> slot;
+				u64 start, length;
+				err = ReadColumnSlot(fieldCursor.mValue, recCursor.mLength, slot);
+				if (err) return(err);
+				if (slot.size() != field.mDictSize) return((GrapaError)-1);
+				if (GrapaDBSlot(slot.data(), field.mDictSize, isRaw, start, length))
+				{
+					buffer.SetLength(length, false);
+					if (length) memcpy(buffer.GetPtr(), &slot[start], (size_t)length);
+				}
+				if (isRaw && field.mDictSize > 1)
+					buffer.mToken = slot[(field.mDictSize <= ((u64)128) + isRaw) ? 1 : 2];
+				break;
+			}
+
 			if (field.mDictSize == 1)
 			{
 				err = GetDataValue(fieldCursor.mValue, field.mDictSize*recCursor.mLength, 1, h, &returnSize);
@@ -2309,192 +2707,1566 @@ GrapaError GrapaDB::PrevDb(GrapaDBCursor& cursor)
 	return(0);
 }
 
-////////////////////////////////////////////////////////////////////////////////
-
-// need to update to use a field list for indexes that have multiple fields
-// and would need to match up the compar fields to the index fields
-GrapaError GrapaDB::LocateIndex(GrapaCursor& cursor, u64 indexRef, u64 fieldId)
+// Places pRange.mCursor on the first item of the index at pIndexRef that is inside the bounds,
+// starting from mUpper when mReverse is set. With pAfterId the walk instead picks up after that
+// record, which is how a caller carries on from where an earlier walk stopped.
+GrapaError GrapaDB::FirstRange(GrapaDBRange& pRange, u64 pIndexRef, u64 pAfterId)
 {
 	GrapaError err;
-	GrapaCursor indexCursor;
-	GrapaCursor indexField;
-	u64 indexFieldsRef;
+	GrapaDBCursor& cursor = pRange.mCursor;
+	GrapaDBFieldValueArray& from = pRange.mReverse ? pRange.mUpper : pRange.mLower;
+	bool fromIn = pRange.mReverse ? pRange.mUpperIn : pRange.mLowerIn;
 
-	cursor.Set(indexRef);
-	err = First(cursor);
-	if (!err && cursor.mKey==0)
-		err = Next(cursor);
-	while (!err)
+	cursor.SetSearch(this,pIndexRef,true,&from);
+	if (pAfterId)
 	{
-		indexCursor.Set(cursor.mValue);
-		err = GetTreeIndex(indexCursor,indexFieldsRef);
+		// index items are ordered by their record's values and then by record id, so seeking
+		// with a record finds its place even if it has since left the index
+		err = First(cursor);
 		if (err) return(err);
-		if (indexFieldsRef==0) return(-1);
-		indexField.Set(indexFieldsRef);
-		err = First(indexField);
-		if ((!err) && (indexField.mValue == fieldId))
-		{
-			return(0);
-		}
-		err = Next(cursor);
-		if (!err && cursor.mKey==0)
-			err = Next(cursor);
+		cursor.Set(pIndexRef,cursor.mValueType,pAfterId);
+		err = Seek(cursor,pRange.mReverse,false);
 	}
-	return((GrapaError)-1);
+	else if (from.Count())
+		err = Seek(cursor,pRange.mReverse,fromIn);
+	else if (pRange.mReverse)
+		err = Last(cursor);
+	else
+		err = First(cursor);
+	if (err) return(err);
+
+	if (!InRange(pRange,true,true)) return((GrapaError)-1);
+	return(0);
 }
 
-bool GrapaDB::IndexHasField(GrapaCursor& cursor, u64 fieldId)
+// Moves pRange.mCursor to the next index item, and fails once it passes the far bound.
+GrapaError GrapaDB::NextRange(GrapaDBRange& pRange)
 {
 	GrapaError err;
-	GrapaCursor indexCursor;
-	GrapaCursor indexField;
-	u64 indexFieldsRef;
+	if (pRange.mReverse)
+		err = Prev(pRange.mCursor);
+	else
+		err = Next(pRange.mCursor);
+	if (err) return(err);
+	if (!InRange(pRange,pRange.mReverse,!pRange.mReverse)) return((GrapaError)-1);
+	return(0);
+}
 
-	indexCursor.Set(cursor.mValue);
-	err = GetTreeIndex(indexCursor,indexFieldsRef);
-	if (err) return(false);
-	indexField.Set(indexFieldsRef);
-	err = First(indexField);
-	while(!err)
+bool GrapaDB::InRange(GrapaDBRange& pRange, bool pLower, bool pUpper)
+{
+	GrapaDBCursor bound;
+	s8 result;
+
+	if (pLower && pRange.mLower.Count())
 	{
-		if (indexField.mValue == fieldId)
-			return(true);
-		err = Next(indexField);
+		bound.SetSearch(this,pRange.mCursor.mTreeRef,true,&pRange.mLower);
+		if (CompareKey(SEARCH_MODE,bound,pRange.mCursor,result)) return(false);
+		if (result < 0 || (result == 0 && !pRange.mLowerIn)) return(false);
 	}
-	return(false);
+	if (pUpper && pRange.mUpper.Count())
+	{
+		bound.SetSearch(this,pRange.mCursor.mTreeRef,true,&pRange.mUpper);
+		if (CompareKey(SEARCH_MODE,bound,pRange.mCursor,result)) return(false);
+		if (result > 0 || (result == 0 && !pRange.mUpperIn)) return(false);
+	}
+	return(true);
 }
 
-////////////////////////////////////////////////////////////////////////////////
-
-GrapaError GrapaDB::GetDataTypeRecord(u64 tableRef, u64& tableDT)
+// Sets up pScan over pScan.mTable for the fields of its columns and reads the first batch. An
+// error means there are no records.
+GrapaError GrapaDB::FirstScan(GrapaDBScan& pScan)
 {
-	GrapaError err=0;
-	GrapaCursor tableCursor;
-	u64 indexTree=0;
-	tableDT = 0;
-	tableCursor.Set(tableRef);
-	err = GetTreeIndex(tableCursor,indexTree);
-	if (err) return(err);
-	tableCursor.Set(indexTree);
-	err = Search(tableCursor);
-	if (err) return(err);
-	tableDT = tableCursor.mValue;
-	return(0);
-}
+	GrapaError err;
+	GrapaCursor cursor;
+	GrapaBlockTree tree;
+	u64 growBlockSize, dataSize;
+	u8 compressType = 0;
 
-////////////////////////////////////////////////////////////////////////////////
+	err = tree.Read(mFile, pScan.mTable.mRecRef);
+	if (err) return(err);
+	pScan.mTreeType = tree.treeType;
+	pScan.mPos = 0;
+	pScan.mCount = 0;
+	pScan.mKeys = pScan.mTreeType != CTABLE_TREE;
 
-GrapaError GrapaDB::InsertIntoIndex(u64 tableRef, u8 pValueType, u64 resId, u64 recordRef)
-{
-	GrapaError err=0;
-	GrapaCursor indexTableCursor,indexCursor;
-	u64 indexRef;
+	cursor.Set(pScan.mTable.mRecRef);
+	err = GetTreeSize(cursor, pScan.mRecords);
+	if (err) return(err);
+
+	for (GrapaDBColumn& column : pScan.mColumns)
+	{
+		column.mRef = 0;
+		column.mSize = 0;
+		column.mMore = false;
+		column.mCode = GrapaDBColumnCode();
+		if (pScan.mTreeType != CTABLE_TREE || tree.storeTree == 0)
+			continue;
+		switch (column.mField.mStore)
+		{
+		case GrapaDBField::STORE_FIX:
+			cursor.Set(tree.storeTree, SDATA_ITEM, column.mField.mId);
+			if (Search(cursor)) break;
+			column.mRef = cursor.mValue;
+			if (GetDataSize(column.mRef, growBlockSize, dataSize, column.mSize, compressType))
+				column.mSize = 0;
+			else if ((compressType & ENCODE_COLUMN) && column.mCode.Read(this, column.mRef))
+				column.mRef = 0;
+			break;
+		case GrapaDBField::STORE_VAR:
+		case GrapaDBField::STORE_PAR:
+			pScan.mKeys = true;
+			cursor.Set(tree.storeTree, TREE_ITEM, column.mField.mId);
+			if (Search(cursor)) break;
+			column.mRef = cursor.mValue;
+			column.mCursor.Set(column.mRef);
+			column.mMore = First(column.mCursor) == 0;
+			break;
+		}
+	}
+
+	if (pScan.mKeys)
+	{
+		pScan.mCursor.Set(pScan.mTable.mRecRef);
+		err = First(pScan.mCursor);
+		if (err) return(err);
+	}
+	return(NextScan(pScan));
+}
+
+// A fixed field of a column table keeps one slot of mDictSize bytes per record, in record order:
+// a header with the set bit and the length, the token for a RAW field, then the value. The slots
+// of a batch are read in one go and the values are left where they are. An encoded field has its
+// blocks decoded into the same slots, unless the scan takes runs and the batch is a whole block
+// of runs, which then comes over as its distinct slots and how many records hold each.
+GrapaError GrapaDB::NextScan(GrapaDBScan& pScan)
+{
+	GrapaError err;
+	GrapaCHAR value;
+	u64 n = pScan.mRecords - pScan.mPos, i;
+	u64 returnSize = 0, growBlockSize, dataSize, dataLength;
+	u8 compressType = 0;
+
+	if (n > pScan.mBatch) n = pScan.mBatch;
+	pScan.mCount = 0;
+	if (n == 0) return(-1);
+
+	for (GrapaDBColumn& column : pScan.mColumns)
+		column.Clear(n);
+
+	if (pScan.mTreeType != CTABLE_TREE)
+	{
+		for (i = 0; i < n; i++)
+		{
+			for (GrapaDBColumn& column : pScan.mColumns)
+			{
+				if (GetRecordField(pScan.mCursor, column.mField, value) == 0 && value.mBytes)
+					column.Put(i, value.mBytes, value.mLength);
+			}
+			Next(pScan.mCursor);
+		}
+		pScan.mPos += n;
+		pScan.mCount = n;
+		return(0);
+	}
+
+	if (pScan.mKeys)
+	{
+		pScan.mKeyList.resize(n);
+		for (i = 0; i < n; i++)
+		{
+			pScan.mKeyList[i] = pScan.mCursor.mKey;
+			Next(pScan.mCursor);
+		}
+	}
+
+	for (GrapaDBColumn& column : pScan.mColumns)
+	{
+		if (column.mRef == 0)
+			continue;
+		switch (column.mField.mStore)
+		{
+		case GrapaDBField::STORE_FIX:
+			{
+				u64 size = column.mField.mDictSize;
+				GrapaDBColumnCode& code = column.mCode;
+				u8 blockCode;
+				if (size == 0)
+					break;
+				if (code.mSize)
+				{
+					u64 rows = (code.mRecords > pScan.mPos) ? code.mRecords - pScan.mPos : 0;
+					u64 block = pScan.mPos / code.mRows;
+					if (rows > n) rows = n;
+					if (pScan.mRuns && pScan.mPos % code.mRows == 0 && rows == n && n == code.Count(block) && (code.mCode[block] == GrapaDBColumnCode::RLE || code.mCode[block] == GrapaDBColumnCode::DICT))
+					{
+						std::vector<u8> slots;
+						std::vector<u64> runs;
+						err = code.ReadBlock(this, column.mRef, block, blockCode, column.mBlock);
+						if (err) return(err);
+						if (!GrapaDBColumnCode::Runs(blockCode, size, column.mBlock, n, slots, runs))
+							return(-1);
+						column.Clear(runs.size());
+						column.mData.swap(slots);
+						column.mRuns.swap(runs);
+						column.Slots(column.mRuns.size());
+						break;
+					}
+					column.mData.assign(n * size, 0);
+					for (u64 at = pScan.mPos; at < pScan.mPos + rows; )
+					{
+						block = at / code.mRows;
+						u64 first = at % code.mRows, last = code.Count(block);
+						if (last - first > pScan.mPos + rows - at) last = first + pScan.mPos + rows - at;
+						err = code.ReadBlock(this, column.mRef, block, blockCode, column.mBlock);
+						if (err) return(err);
+						if (!GrapaDBColumnCode::Decode(blockCode, size, column.mBlock, code.Count(block), first, last, &column.mData[(at - pScan.mPos) * size]))
+							return(-1);
+						at += last - first;
+					}
+					column.Slots(rows);
+					break;
+				}
+				u64 from = pScan.mPos * size;
+				u64 length = (from < column.mSize) ? column.mSize - from : 0;
+				if (length > n * size) length = n * size;
+				if (length == 0)
+					break;
+				// a field ends after the last byte written, which can leave its last slot short
+				column.mData.assign((size_t)(((length + size - 1) / size) * size), 0);
+				err = GetDataValue(column.mRef, from, length, column.mData.data(), &returnSize);
+				if (err) return(err);
+				column.Slots((returnSize + size - 1) / size);
+			}
+			break;
+		case GrapaDBField::STORE_VAR:
+		case GrapaDBField::STORE_PAR:
+			for (i = 0; i < n && column.mMore; i++)
+			{
+				while (column.mMore && column.mCursor.mKey < pScan.mKeyList[i])
+					column.mMore = Next(column.mCursor) == 0;
+				if (!column.mMore || column.mCursor.mKey != pScan.mKeyList[i])
+					continue;
+				if (GetDataSize(column.mCursor.mValue, growBlockSize, dataSize, dataLength, compressType) || dataLength == 0)
+					continue;
+				u64 at = column.mData.size();
+				column.mData.resize(at + dataLength);
+				err = GetDataValue(column.mCursor.mValue, 0, dataLength, &column.mData[at], &returnSize);
+				if (err) return(err);
+				column.mStart[i] = at;
+				column.mLength[i] = returnSize;
+				column.mSet[i] = returnSize ? 1 : 0;
+			}
+			break;
+		}
+	}
+
+	pScan.mPos += n;
+	pScan.mCount = n;
+	return(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The slots of a fixed field of a column table, one for each of pRecords, from plain or encoded
+// storage. Slots past the end of a short field are left unset.
+GrapaError GrapaDB::ReadColumn(u64 pItemRef, u64 pSize, u64 pRecords, std::vector<u8>& pSlots)
+{
+	GrapaError err;
+	u64 growBlockSize, dataSize, dataLength, returnSize = 0, b;
+	u8 encodeType = 0, code;
+
+	err = GetDataSize(pItemRef, growBlockSize, dataSize, dataLength, encodeType);
+	if (err) return(err);
+	pSlots.assign((size_t)(pRecords * pSize), 0);
+	if ((encodeType & ENCODE_COLUMN) == 0)
+	{
+		if (dataLength > pSlots.size()) dataLength = pSlots.size();
+		if (dataLength) err = GetDataValue(pItemRef, 0, dataLength, pSlots.data(), &returnSize);
+		return(err);
+	}
+
+	GrapaDBColumnCode column;
+	std::vector<u8> block;
+	err = column.Read(this, pItemRef);
+	if (err) return(err);
+	if (column.mSize != pSize) return(-1);
+	for (b = 0; b < column.mBlocks && b * column.mRows < pRecords; b++)
+	{
+		u64 first = b * column.mRows, count = column.Count(b);
+		if (first + count > pRecords) count = pRecords - first;
+		err = column.ReadBlock(this, pItemRef, b, code, block);
+		if (err) return(err);
+		if (!GrapaDBColumnCode::Decode(code, pSize, block, column.Count(b), 0, count, &pSlots[first * pSize]))
+			return(-1);
+	}
+	return(0);
+}
+
+// One slot of an encoded field, read from the block that holds it.
+GrapaError GrapaDB::ReadColumnSlot(u64 pItemRef, u64 pIndex, std::vector<u8>& pSlot)
+{
+	GrapaError err;
+	GrapaDBColumnCode column;
+	std::vector<u8> block;
+	u8 code;
+
+	err = column.Read(this, pItemRef, false);
+	if (err) return(err);
+	pSlot.assign((size_t)column.mSize, 0);
+	if (pIndex >= column.mRecords)
+		return(0);
+	u64 b = pIndex / column.mRows;
+	err = column.ReadBlock(this, pItemRef, b, code, block);
+	if (err) return(err);
+	u64 i = pIndex % column.mRows;
+	if (!GrapaDBColumnCode::Decode(code, column.mSize, block, column.Count(b), i, i + 1, pSlot.data()))
+		return(-1);
+	return(0);
+}
+
+// Whether the field at pItemRef is encoded and holds no slot at or past pIndex. Those slots read
+// as unset, so a record added or removed there leaves the encoding as it is.
+bool GrapaDB::ColumnEndsBefore(u64 pItemRef, u64 pIndex)
+{
+	GrapaDBColumnCode column;
+	u64 growBlockSize, dataSize, dataLength;
+	u8 encodeType = 0;
+
+	if (GetDataSize(pItemRef, growBlockSize, dataSize, dataLength, encodeType) || (encodeType & ENCODE_COLUMN) == 0)
+		return(false);
+	if (column.Read(this, pItemRef, false))
+		return(false);
+	return(pIndex >= column.mRecords);
+}
+
+// Encodes a fixed field of a column table block by block; see GrapaDBColumnCode. A field that would
+// not get smaller is left plain. Compacting again starts over from the slots.
+GrapaError GrapaDB::CompactField(GrapaDBTable& pTable, GrapaDBField& pField, GrapaDBCompact& pInfo)
+{
+	GrapaError err;
+	GrapaBlockTree tree;
+	GrapaCursor cursor;
+	std::vector<u8> slots, item;
+	u64 records = 0, itemRef = 0, returnSize = 0;
+
+	pInfo = GrapaDBCompact();
+	err = tree.Read(mFile, pTable.mRecRef);
+	if (err) return(err);
+	if (tree.treeType != CTABLE_TREE || tree.storeTree == 0 || pField.mStore != GrapaDBField::STORE_FIX || pField.mDictSize == 0)
+		return(-1);
+
+	cursor.Set(pTable.mRecRef);
+	err = GetTreeSize(cursor, records);
+	if (err) return(err);
+	cursor.Set(tree.storeTree, SDATA_ITEM, pField.mId);
+	err = Search(cursor);
+	if (err) return(err);
+
+	err = ReadColumn(cursor.mValue, pField.mDictSize, records, slots);
+	if (err) return(err);
+	GrapaDBColumnCode::Build(pField.mType, pField.mDictSize, slots, records, item, pInfo.mBlocks);
+	pInfo.mRecords = records;
+	pInfo.mRaw = slots.size();
+	pInfo.mSize = item.size();
+	if (item.size() >= slots.size())
+	{
+		pInfo.mSize = slots.size();
+		for (u64& b : pInfo.mBlocks) b = 0;
+		pInfo.mBlocks[GrapaDBColumnCode::PLAIN] = (records + GrapaDBColumnCode::BLOCK_ROWS - 1) / GrapaDBColumnCode::BLOCK_ROWS;
+		return(ExpandField(cursor, pField));
+	}
+
+	err = NewData(FREC_DATA, tree.storeTree, 0, GrapaDBColumnCode::BLOCK_ROWS, 1, itemRef, true);
+	if (err) return(err);
+	err = SetDataSize(itemRef, item.size(), item.size(), ENCODE_COLUMN);
+	if (!err) err = SetDataValue(itemRef, 0, item.size(), item.data(), &returnSize);
+	if (err)
+	{
+		DeleteData(itemRef);
+		return(err);
+	}
+	err = DeleteData(cursor.mValue);
+	if (err) return(err);
+	cursor.mValue = itemRef;
+	return(Update(cursor));
+}
+
+// Puts an encoded field back into plain slots before it is written to; pItemCursor is on the
+// field's item and is left on the new one. A plain field is left as it is.
+GrapaError GrapaDB::ExpandField(GrapaCursor& pItemCursor, const GrapaDBField& pField)
+{
+	GrapaError err;
+	GrapaDBColumnCode column;
+	std::vector<u8> slots;
+	u64 growBlockSize, dataSize, dataLength, itemRef = 0, returnSize = 0;
+	u8 encodeType = 0;
+
+	err = GetDataSize(pItemCursor.mValue, growBlockSize, dataSize, dataLength, encodeType);
+	if (err) return(err);
+	if ((encodeType & ENCODE_COLUMN) == 0)
+		return(0);
+
+	err = column.Read(this, pItemCursor.mValue, false);
+	if (!err) err = ReadColumn(pItemCursor.mValue, pField.mDictSize, column.mRecords, slots);
+	if (err) return(err);
+
+	err = NewData(FREC_DATA, pItemCursor.mTreeRef, 0, pField.mDictSize, pField.mGrow, itemRef, true);
+	if (err) return(err);
+	if (slots.size())
+	{
+		err = SetDataSize(itemRef, slots.size(), slots.size(), ENCODE_NONE);
+		if (!err) err = SetDataValue(itemRef, 0, slots.size(), slots.data(), &returnSize);
+		if (err)
+		{
+			DeleteData(itemRef);
+			return(err);
+		}
+	}
+	err = DeleteData(pItemCursor.mValue);
+	if (err) return(err);
+	pItemCursor.mValue = itemRef;
+	return(Update(pItemCursor));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// need to update to use a field list for indexes that have multiple fields
+// and would need to match up the compar fields to the index fields
+GrapaError GrapaDB::LocateIndex(GrapaCursor& cursor, u64 indexRef, u64 fieldId)
+{
+	GrapaError err;
+	GrapaCursor indexCursor;
+	GrapaCursor indexField;
+	u64 indexFieldsRef;
+
+	cursor.Set(indexRef);
+	err = First(cursor);
+	if (!err && cursor.mKey==0)
+		err = Next(cursor);
+	while (!err)
+	{
+		indexCursor.Set(cursor.mValue);
+		err = GetTreeIndex(indexCursor,indexFieldsRef);
+		if (err) return(err);
+		if (indexFieldsRef==0) return(-1);
+		indexField.Set(indexFieldsRef);
+		err = First(indexField);
+		if ((!err) && (indexField.mValue == fieldId) && !IndexDeferred(cursor.mValue))
+		{
+			return(0);
+		}
+		err = Next(cursor);
+		if (!err && cursor.mKey==0)
+			err = Next(cursor);
+	}
+	return((GrapaError)-1);
+}
+
+bool GrapaDB::IndexHasField(GrapaCursor& cursor, u64 fieldId)
+{
+	GrapaError err;
+	GrapaCursor indexCursor;
+	GrapaCursor indexField;
+	u64 indexFieldsRef;
+
+	indexCursor.Set(cursor.mValue);
+	err = GetTreeIndex(indexCursor,indexFieldsRef);
+	if (err) return(false);
+	indexField.Set(indexFieldsRef);
+	err = First(indexField);
+	while(!err)
+	{
+		if (indexField.mValue == fieldId)
+			return(true);
+		err = Next(indexField);
+	}
+	return(false);
+}
+
+// Whether record changes leave the index alone until RebuildIndexes.
+bool GrapaDB::IndexDeferred(u64 indexRef)
+{
+	GrapaBlockTree head;
+	if (indexRef==0 || head.Read(mFile,indexRef)) return(false);
+	return(head.GetDeferred());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+GrapaError GrapaDB::GetDataTypeRecord(u64 tableRef, u64& tableDT)
+{
+	GrapaError err=0;
+	GrapaCursor tableCursor;
+	u64 indexTree=0;
+	tableDT = 0;
+	tableCursor.Set(tableRef);
+	err = GetTreeIndex(tableCursor,indexTree);
+	if (err) return(err);
+	tableCursor.Set(indexTree);
+	err = Search(tableCursor);
+	if (err) return(err);
+	tableDT = tableCursor.mValue;
+	return(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+GrapaError GrapaDB::InsertIntoIndex(u64 tableRef, u8 pValueType, u64 resId, u64 recordRef)
+{
+	GrapaError err=0;
+	GrapaCursor indexTableCursor,indexCursor;
+	u64 indexRef;
 
 	indexTableCursor.Set(tableRef);
 	err = GetTreeIndex(indexTableCursor,indexRef);
 	if (err) return(err);
 
-	indexTableCursor.Set(indexRef);
-	err = First(indexTableCursor);
-	if (!err && indexTableCursor.mKey==0)
-		err = Next(indexTableCursor);
-	while (!err)
+	indexTableCursor.Set(indexRef);
+	err = First(indexTableCursor);
+	if (!err && indexTableCursor.mKey==0)
+		err = Next(indexTableCursor);
+	while (!err)
+	{
+		indexCursor.Set(indexTableCursor.mValue,pValueType,resId,recordRef);
+		if (!IndexDeferred(indexTableCursor.mValue))
+			err = Insert(indexCursor);
+		if (err) return(err);
+		err = Next(indexTableCursor);
+		if (!err && indexTableCursor.mKey==0)
+			err = Next(indexTableCursor);
+	}
+
+	return(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+GrapaError GrapaDB::CompareKey(s16 compareType, GrapaCursor& dataCursor, GrapaCursor& treeCursor, s8& result)
+{
+	GrapaError err=0;
+	GrapaCursor cursor;
+
+	result = -1;
+
+	switch(treeCursor.mValueType)
+	{
+		case DTYPE_ITEM:
+			// this item is the same as a DbData item, but for the data type dictionary
+			//result = treeCursor.mKey - dataCursor.mKey;
+			result = GrapaBtree::CompareKey(treeCursor.mKey, dataCursor.mKey);
+			break;
+
+		case GREC_ITEM: 
+		case RREC_ITEM:
+		case CREC_ITEM:
+		case GPTR_ITEM:
+		case RPTR_ITEM:
+		case CPTR_ITEM:
+			switch(dataCursor.mValueType)
+			{
+				case SEARCH_ITEM: // Searching an index using a set of search fields
+					err = CompareSearchKey(compareType, dataCursor, treeCursor, result);
+					//if (err) return(err);
+					break;
+
+				case GREC_ITEM: 
+				case RREC_ITEM:
+				case CREC_ITEM:
+				case GPTR_ITEM:
+				case RPTR_ITEM:
+				case CPTR_ITEM:
+					err = CompareRecordKey(compareType, dataCursor, treeCursor, result);
+					//if (err) return(err);
+					break;
+
+				case DTYPE_ITEM:
+				default:
+					return(-1);
+			}
+			break;
+
+		case SEARCH_ITEM:
+		default:
+			return(-1);
+	}
+
+	if (err)
+		result = GrapaBtree::CompareKey(treeCursor.mKey, dataCursor.mKey);
+
+	if (result==0)
+	{
+		// if the values end up to be the same, then lets compare the key's just to be sure.
+		switch(dataCursor.mValueType)
+		{
+			case GREC_ITEM:
+			case RREC_ITEM:
+			case CREC_ITEM:
+			case GPTR_ITEM:
+			case RPTR_ITEM:
+			case CPTR_ITEM:
+				switch (compareType)
+				{
+					case SEARCH_MODE:
+						if (dataCursor.mKey)
+							result = GrapaBtree::CompareKey(treeCursor.mKey, dataCursor.mKey);
+						break;
+					case INSERT_MODE:
+					case DELETE_MODE:
+						result = GrapaBtree::CompareKey(treeCursor.mKey, dataCursor.mKey);
+						break;
+				}
+				break;
+		}
+	}
+	
+	return(0);
+}
+
+static void GrapaDBToFloat(const GrapaBYTE& pValue, GrapaFloat& pFloat)
+{
+	if (pValue.mToken == GrapaTokenType::FLOAT)
+		pFloat.FromBytes(pValue);
+	else
+	{
+		GrapaInt i;
+		i.FromBytes(pValue);
+		pFloat = i;
+	}
+}
+
+// Orders two values of a field of type pType. INT and TIME values are big-endian two's complement
+// of any length, so they compare by sign and then as if sign-extended to the same length. FLOAT
+// values, and numbers held against them, compare by value. Everything else compares byte by byte,
+// a value before any longer one that starts with it, which for text is the order strcmp gives. An
+// unset value sorts first.
+static int GrapaDBCompareValue(u8 pType, const GrapaBYTE& a, const GrapaBYTE& b)
+{
+	u64 la = a.mBytes ? a.mLength : 0;
+	u64 lb = b.mBytes ? b.mLength : 0;
+	if (la == 0 || lb == 0)
+		return((la < lb) ? -1 : ((la > lb) ? 1 : 0));
+
+	const u8* pa = (const u8*)a.mBytes;
+	const u8* pb = (const u8*)b.mBytes;
+	switch (pType)
+	{
+	case GrapaTokenType::INT:
+	case GrapaTokenType::TIME:
+		if (a.mToken != GrapaTokenType::FLOAT && b.mToken != GrapaTokenType::FLOAT)
+		{
+			bool negA = (pa[0] & 0x80) != 0;
+			bool negB = (pb[0] & 0x80) != 0;
+			if (negA != negB) return(negA ? -1 : 1);
+			u64 n = (la > lb) ? la : lb;
+			for (u64 i = 0; i < n; i++)
+			{
+				u8 ca = (i < n - la) ? (negA ? 0xFF : 0) : pa[i - (n - la)];
+				u8 cb = (i < n - lb) ? (negB ? 0xFF : 0) : pb[i - (n - lb)];
+				if (ca != cb) return((ca < cb) ? -1 : 1);
+			}
+			return(0);
+		}
+		// fall through
+	case GrapaTokenType::FLOAT:
+		{
+			GrapaFloat fa, fb;
+			GrapaDBToFloat(a, fa);
+			GrapaDBToFloat(b, fb);
+			if (fa < fb) return(-1);
+			if (fb < fa) return(1);
+			return(0);
+		}
+	}
+
+	int cr = memcmp(pa, pb, (size_t)((la < lb) ? la : lb));
+	if (cr) return(cr);
+	return((la < lb) ? -1 : ((la > lb) ? 1 : 0));
+}
+
+int GrapaDB::CompareValue(u8 pType, const GrapaBYTE& a, const GrapaBYTE& b)
+{
+	return(GrapaDBCompareValue(pType, a, b));
+}
+
+// Orders two index keys of a field of type pType, as the file's index trees hold them.
+int GrapaDB::CompareKeyValue(u8 pType, const GrapaBYTE& a, const GrapaBYTE& b)
+{
+	return(GrapaDBCompareValue(mByteKeys ? (u8)GrapaTokenType::RAW : pType, a, b));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Where the value of a fixed slot starts and how long it is, or false if the slot is not set. A
+// one-byte slot holds its value in the low 7 bits, which are cleared of the set bit in place.
+static bool GrapaDBSlot(u8* pSlot, u64 pSize, u64 pIsRaw, u64& pStart, u64& pLength)
+{
+	pStart = 0;
+	pLength = 0;
+	if ((pSlot[0] & 0x80) == 0)
+		return(false);
+	if (pSize == 1)
+	{
+		pSlot[0] &= 0x7F;
+		pLength = 1;
+		return(true);
+	}
+	if (pSize <= 128 + pIsRaw)
+	{
+		pStart = 1 + pIsRaw;
+		pLength = pSlot[0] & 0x7F;
+	}
+	else
+	{
+		pStart = 2 + pIsRaw;
+		pLength = ((u64)(pSlot[0] & 0x7F)) << 8 | (u64)pSlot[1];
+	}
+	if (pStart + pLength > pSize)
+		pLength = 0;
+	return(true);
+}
+
+// The value of a set INT or TIME slot as an s64, if it has 1 to 8 bytes.
+static bool GrapaDBSlotInt(const u8* pSlot, u64 pSize, s64& pValue)
+{
+	if (pSize == 1)
+	{
+		pValue = pSlot[0] & 0x7F;
+		return(true);
+	}
+	u64 head = (pSize <= 128) ? 1 : 2;
+	u64 len = (head == 1) ? (u64)(pSlot[0] & 0x7F) : (((u64)(pSlot[0] & 0x7F)) << 8 | (u64)pSlot[1]);
+	if (len == 0 || len > 8 || head + len > pSize)
+		return(false);
+	const u8* p = pSlot + head;
+	u64 v = (p[0] & 0x80) ? ~(u64)0 : 0;
+	for (u64 j = 0; j < len; j++)
+		v = (v << 8) | p[j];
+	pValue = (s64)v;
+	return(true);
+}
+
+// The slot SetRecordField writes for an INT or TIME value, in its fewest bytes.
+static bool GrapaDBIntSlot(s64 pValue, u64 pSize, u8* pSlot)
+{
+	memset(pSlot, 0, (size_t)pSize);
+	if (pSize == 1)
+	{
+		if (pValue < 0 || pValue > 127)
+			return(false);
+		pSlot[0] = 0x80 | (u8)pValue;
+		return(true);
+	}
+	u64 head = (pSize <= 128) ? 1 : 2, len = 1, j;
+	while (len < 8 && (pValue < -((s64)1 << (len * 8 - 1)) || pValue >= ((s64)1 << (len * 8 - 1))))
+		len++;
+	if (head + len > pSize)
+		return(false);
+	if (head == 1)
+		pSlot[0] = 0x80 | (u8)len;
+	else
+	{
+		pSlot[0] = 0x80;
+		pSlot[1] = (u8)len;
+	}
+	for (j = 0; j < len; j++)
+		pSlot[head + len - 1 - j] = (u8)((u64)pValue >> (j * 8));
+	return(true);
+}
+
+static void GrapaDBPutU(std::vector<u8>& pOut, u64 pValue, u8 pBytes)
+{
+	for (u8 i = pBytes; i > 0; i--)
+		pOut.push_back((u8)(pValue >> ((i - 1) * 8)));
+}
+
+static u64 GrapaDBGetU(const u8* pIn, u8 pBytes)
+{
+	u64 v = 0;
+	for (u8 i = 0; i < pBytes; i++)
+		v = (v << 8) | pIn[i];
+	return(v);
+}
+
+static u8 GrapaDBBitWidth(u64 pValue)
+{
+	u8 w = 0;
+	for (; pValue; pValue >>= 1)
+		w++;
+	return(w);
+}
+
+// Packs each value into pWidth bits, lowest bit first.
+static void GrapaDBPackBits(std::vector<u8>& pOut, const std::vector<u64>& pValues, u8 pWidth)
+{
+	u64 at = pOut.size(), bit = 0;
+	pOut.resize(at + (pValues.size() * pWidth + 7) / 8, 0);
+	for (u64 v : pValues)
+	{
+		for (u64 left = pWidth; left; )
+		{
+			u64 shift = bit & 7, take = 8 - shift;
+			if (take > left) take = left;
+			pOut[at + (bit >> 3)] |= (u8)((v & ((1u << take) - 1)) << shift);
+			v >>= take;
+			bit += take;
+			left -= take;
+		}
+	}
+}
+
+static u64 GrapaDBUnpackBits(const u8* pIn, u64 i, u8 pWidth)
+{
+	u64 bit = i * pWidth, v = 0, got = 0;
+	while (got < pWidth)
+	{
+		u64 shift = bit & 7, take = 8 - shift;
+		if (take > pWidth - got) take = pWidth - got;
+		v |= ((u64)((pIn[bit >> 3] >> shift) & ((1u << take) - 1))) << got;
+		bit += take;
+		got += take;
+	}
+	return(v);
+}
+
+u64 GrapaDBColumnCode::Count(u64 pBlock) const
+{
+	u64 first = pBlock * mRows;
+	if (first >= mRecords)
+		return(0);
+	return((mRecords - first < mRows) ? mRecords - first : mRows);
+}
+
+// The item is a version byte, the slot size, the record count, the records in a block and the
+// block count, then an offset for each block and one for the end, then a code for each block.
+GrapaError GrapaDBColumnCode::Read(GrapaDB* pDb, u64 pItemRef, bool pDirectory)
+{
+	GrapaError err;
+	u8 head[HEAD_SIZE];
+	u64 returnSize = 0, b;
+
+	mOffset.clear();
+	mCode.clear();
+	err = pDb->GetDataValue(pItemRef, 0, HEAD_SIZE, head, &returnSize);
+	if (err) return(err);
+	if (returnSize != HEAD_SIZE || head[0] != 1)
+		return(-1);
+	mSize = GrapaDBGetU(&head[1], 8);
+	mRecords = GrapaDBGetU(&head[9], 8);
+	mRows = GrapaDBGetU(&head[17], 4);
+	mBlocks = GrapaDBGetU(&head[21], 4);
+	if (mSize == 0 || mRows == 0 || mBlocks != (mRecords + mRows - 1) / mRows)
+		return(-1);
+	if (!pDirectory)
+		return(0);
+
+	std::vector<u8> directory((size_t)(mBlocks * 9 + 8));
+	err = pDb->GetDataValue(pItemRef, HEAD_SIZE, directory.size(), directory.data(), &returnSize);
+	if (err) return(err);
+	if (returnSize != directory.size())
+		return(-1);
+	mOffset.resize((size_t)(mBlocks + 1));
+	for (b = 0; b <= mBlocks; b++)
+		mOffset[b] = GrapaDBGetU(&directory[b * 8], 8);
+	mCode.assign(directory.begin() + (mBlocks + 1) * 8, directory.end());
+	return(0);
+}
+
+// Reads one block, from the directory if Read loaded it or else from the item.
+GrapaError GrapaDBColumnCode::ReadBlock(GrapaDB* pDb, u64 pItemRef, u64 pBlock, u8& pCode, std::vector<u8>& pBytes) const
+{
+	GrapaError err;
+	u64 from, to, returnSize = 0;
+
+	if (pBlock >= mBlocks)
+		return(-1);
+	if (mCode.size() == mBlocks)
+	{
+		from = mOffset[pBlock];
+		to = mOffset[pBlock + 1];
+		pCode = mCode[pBlock];
+	}
+	else
+	{
+		u8 entry[16];
+		err = pDb->GetDataValue(pItemRef, HEAD_SIZE + pBlock * 8, 16, entry, &returnSize);
+		if (err) return(err);
+		if (returnSize != 16) return(-1);
+		from = GrapaDBGetU(&entry[0], 8);
+		to = GrapaDBGetU(&entry[8], 8);
+		err = pDb->GetDataValue(pItemRef, HEAD_SIZE + (mBlocks + 1) * 8 + pBlock, 1, &pCode, &returnSize);
+		if (err) return(err);
+		if (returnSize != 1) return(-1);
+	}
+	if (to < from)
+		return(-1);
+	pBytes.resize((size_t)(to - from));
+	if (to == from)
+		return(0);
+	err = pDb->GetDataValue(pItemRef, from, to - from, pBytes.data(), &returnSize);
+	if (err) return(err);
+	return((returnSize == to - from) ? 0 : -1);
+}
+
+// Encodes pRecords slots of pSize bytes into a whole item, counting the blocks given each code in
+// pBlocks.
+void GrapaDBColumnCode::Build(u8 pType, u64 pSize, const std::vector<u8>& pSlots, u64 pRecords, std::vector<u8>& pItem, u64* pBlocks)
+{
+	u64 blocks = (pRecords + BLOCK_ROWS - 1) / BLOCK_ROWS, b;
+	std::vector<u8> body, block;
+	std::vector<u64> offsets;
+	std::vector<u8> codes;
+
+	pItem.clear();
+	pItem.push_back(1);
+	GrapaDBPutU(pItem, pSize, 8);
+	GrapaDBPutU(pItem, pRecords, 8);
+	GrapaDBPutU(pItem, BLOCK_ROWS, 4);
+	GrapaDBPutU(pItem, blocks, 4);
+
+	u64 start = HEAD_SIZE + (blocks + 1) * 8 + blocks;
+	for (b = 0; b < blocks; b++)
+	{
+		u64 count = (pRecords - b * BLOCK_ROWS < BLOCK_ROWS) ? pRecords - b * BLOCK_ROWS : BLOCK_ROWS;
+		u8 code = Encode(pType, pSize, &pSlots[b * BLOCK_ROWS * pSize], count, block);
+		offsets.push_back(start + body.size());
+		codes.push_back(code);
+		body.insert(body.end(), block.begin(), block.end());
+		if (pBlocks) pBlocks[code]++;
+	}
+	offsets.push_back(start + body.size());
+	for (u64 offset : offsets)
+		GrapaDBPutU(pItem, offset, 8);
+	pItem.insert(pItem.end(), codes.begin(), codes.end());
+	pItem.insert(pItem.end(), body.begin(), body.end());
+}
+
+// Picks the smallest encoding for pCount slots and writes it to pBlock. Runs win ties, as a scan can
+// take them without expanding them.
+//   PLAIN	the slots
+//   RLE	a run count, then for each run its length and its slot
+//   DICT	an entry count, the distinct slots, a bit width, then an index into them for each slot
+//   FOR	a flag byte, a bitmap of the set slots if any are not set, the least value, a bit width,
+//			then each set value less the least
+//   DELTA	as FOR, but the first value and the least step, then each step less the least step
+u8 GrapaDBColumnCode::Encode(u8 pType, u64 pSize, const u8* pSlots, u64 pCount, std::vector<u8>& pBlock)
+{
+	u64 i;
+	u8 code = PLAIN;
+	u64 best = pCount * pSize;
+
+	pBlock.clear();
+	if (pCount == 0)
+		return(code);
+
+	u64 runs = 0;
+	for (i = 0; i < pCount; i++)
+		if (i == 0 || memcmp(&pSlots[i * pSize], &pSlots[(i - 1) * pSize], (size_t)pSize) != 0)
+			runs++;
+	u64 rleSize = 2 + runs * (2 + pSize);
+	if (rleSize <= best) { best = rleSize; code = RLE; }
+
+	std::unordered_map<std::string, u64> entries;
+	std::vector<u64> index((size_t)pCount);
+	std::vector<u64> firsts;
+	for (i = 0; i < pCount; i++)
+	{
+		auto found = entries.emplace(std::string((const char*)&pSlots[i * pSize], (size_t)pSize), firsts.size());
+		if (found.second) firsts.push_back(i);
+		index[i] = found.first->second;
+	}
+	u8 dictWidth = GrapaDBBitWidth(firsts.size() - 1);
+	u64 dictSize = 2 + firsts.size() * pSize + 1 + (pCount * dictWidth + 7) / 8;
+	if (dictSize < best) { best = dictSize; code = DICT; }
+
+	bool numeric = pType == GrapaTokenType::INT || pType == GrapaTokenType::TIME;
+	std::vector<s64> values;
+	std::vector<u64> present;
+	std::vector<u8> check((size_t)pSize);
+	for (i = 0; i < pCount && numeric; i++)
+	{
+		const u8* slot = &pSlots[i * pSize];
+		s64 v;
+		if ((slot[0] & 0x80) == 0)
+		{
+			for (u64 j = 0; j < pSize && numeric; j++)
+				numeric = slot[j] == 0;
+			present.push_back(0);
+			continue;
+		}
+		numeric = GrapaDBSlotInt(slot, pSize, v) && GrapaDBIntSlot(v, pSize, check.data()) && memcmp(check.data(), slot, (size_t)pSize) == 0;
+		values.push_back(v);
+		present.push_back(1);
+	}
+	u64 m = values.size(), bitmap = (m < pCount) ? (pCount + 7) / 8 : 0;
+	s64 least = 0, most = 0, step = 0, stepMost = 0;
+	u8 forWidth = 0, deltaWidth = 0;
+	if (numeric)
+	{
+		for (i = 0; i < m; i++)
+		{
+			if (i == 0 || values[i] < least) least = values[i];
+			if (i == 0 || values[i] > most) most = values[i];
+		}
+		forWidth = GrapaDBBitWidth((u64)most - (u64)least);
+		u64 forSize = 1 + bitmap + 8 + 1 + (m * forWidth + 7) / 8;
+		if (forSize < best) { best = forSize; code = FOR; }
+		if (m >= 2)
+		{
+			for (i = 1; i < m; i++)
+			{
+				s64 d = (s64)((u64)values[i] - (u64)values[i - 1]);
+				if (i == 1 || d < step) step = d;
+				if (i == 1 || d > stepMost) stepMost = d;
+			}
+			deltaWidth = GrapaDBBitWidth((u64)stepMost - (u64)step);
+			u64 deltaSize = 1 + bitmap + 16 + 1 + ((m - 1) * deltaWidth + 7) / 8;
+			if (deltaSize < best) { best = deltaSize; code = DELTA; }
+		}
+	}
+
+	std::vector<u64> packed;
+	switch (code)
+	{
+	case PLAIN:
+		pBlock.assign(pSlots, pSlots + pCount * pSize);
+		break;
+	case RLE:
+		GrapaDBPutU(pBlock, runs, 2);
+		for (i = 0; i < pCount; )
+		{
+			u64 j = i + 1;
+			while (j < pCount && memcmp(&pSlots[j * pSize], &pSlots[i * pSize], (size_t)pSize) == 0)
+				j++;
+			GrapaDBPutU(pBlock, j - i, 2);
+			pBlock.insert(pBlock.end(), &pSlots[i * pSize], &pSlots[i * pSize] + pSize);
+			i = j;
+		}
+		break;
+	case DICT:
+		GrapaDBPutU(pBlock, firsts.size(), 2);
+		for (u64 first : firsts)
+			pBlock.insert(pBlock.end(), &pSlots[first * pSize], &pSlots[first * pSize] + pSize);
+		pBlock.push_back(dictWidth);
+		GrapaDBPackBits(pBlock, index, dictWidth);
+		break;
+	case FOR:
+	case DELTA:
+		pBlock.push_back(bitmap ? 1 : 0);
+		if (bitmap)
+			GrapaDBPackBits(pBlock, present, 1);
+		if (code == FOR)
+		{
+			GrapaDBPutU(pBlock, (u64)least, 8);
+			pBlock.push_back(forWidth);
+			for (i = 0; i < m; i++)
+				packed.push_back((u64)values[i] - (u64)least);
+			GrapaDBPackBits(pBlock, packed, forWidth);
+		}
+		else
+		{
+			GrapaDBPutU(pBlock, (u64)values[0], 8);
+			GrapaDBPutU(pBlock, (u64)step, 8);
+			pBlock.push_back(deltaWidth);
+			for (i = 1; i < m; i++)
+				packed.push_back((u64)values[i] - (u64)values[i - 1] - (u64)step);
+			GrapaDBPackBits(pBlock, packed, deltaWidth);
+		}
+		break;
+	}
+	return(code);
+}
+
+// Writes slots pFirst up to pLast of a block of pCount slots to pSlots.
+bool GrapaDBColumnCode::Decode(u8 pCode, u64 pSize, const std::vector<u8>& pBlock, u64 pCount, u64 pFirst, u64 pLast, u8* pSlots)
+{
+	const u8* p = pBlock.data();
+	u64 length = pBlock.size(), i;
+
+	if (pFirst > pLast || pLast > pCount)
+		return(false);
+	memset(pSlots, 0, (size_t)((pLast - pFirst) * pSize));
+	switch (pCode)
+	{
+	case PLAIN:
+		if (length < pCount * pSize)
+			return(false);
+		memcpy(pSlots, &p[pFirst * pSize], (size_t)((pLast - pFirst) * pSize));
+		return(true);
+	case RLE:
+		{
+			if (length < 2)
+				return(false);
+			u64 runs = GrapaDBGetU(p, 2), at = 2, row = 0;
+			if (length < 2 + runs * (2 + pSize))
+				return(false);
+			for (u64 r = 0; r < runs && row < pLast; r++, at += 2 + pSize)
+			{
+				u64 count = GrapaDBGetU(&p[at], 2);
+				for (i = (row < pFirst) ? pFirst : row; i < row + count && i < pLast; i++)
+					memcpy(&pSlots[(i - pFirst) * pSize], &p[at + 2], (size_t)pSize);
+				row += count;
+			}
+			return(true);
+		}
+	case DICT:
+		{
+			if (length < 2)
+				return(false);
+			u64 entries = GrapaDBGetU(p, 2), at = 2 + entries * pSize;
+			if (length < at + 1)
+				return(false);
+			u8 width = p[at++];
+			if (width > 16 || length < at + (pCount * width + 7) / 8)
+				return(false);
+			for (i = pFirst; i < pLast; i++)
+			{
+				u64 k = GrapaDBUnpackBits(&p[at], i, width);
+				if (k >= entries)
+					return(false);
+				memcpy(&pSlots[(i - pFirst) * pSize], &p[2 + k * pSize], (size_t)pSize);
+			}
+			return(true);
+		}
+	case FOR:
+	case DELTA:
+		{
+			if (length < 1)
+				return(false);
+			const u8* bitmap = (p[0] & 1) ? &p[1] : NULL;
+			u64 at = 1 + (bitmap ? (pCount + 7) / 8 : 0), head = (pCode == FOR) ? 9 : 17, m = 0;
+			if (length < at + head)
+				return(false);
+			u64 value = GrapaDBGetU(&p[at], 8);
+			u64 step = (pCode == DELTA) ? GrapaDBGetU(&p[at + 8], 8) : 0;
+			u8 width = p[at + head - 1];
+			at += head;
+			for (i = 0; i < pCount; i++)
+				if (bitmap == NULL || GrapaDBUnpackBits(bitmap, i, 1))
+					m++;
+			u64 packed = (pCode == FOR) ? m : (m ? m - 1 : 0);
+			if (width > 64 || length < at + (packed * width + 7) / 8)
+				return(false);
+			u64 base = value, k = 0;
+			for (i = 0; i < pLast; i++)
+			{
+				if (bitmap && !GrapaDBUnpackBits(bitmap, i, 1))
+					continue;
+				if (pCode == FOR)
+				{
+					if (i >= pFirst)
+						value = base + GrapaDBUnpackBits(&p[at], k, width);
+				}
+				else if (k)
+					value += step + GrapaDBUnpackBits(&p[at], k - 1, width);
+				if (i >= pFirst && !GrapaDBIntSlot((s64)value, pSize, &pSlots[(i - pFirst) * pSize]))
+					return(false);
+				k++;
+			}
+			return(true);
+		}
+	}
+	return(false);
+}
+
+// The distinct slots of an RLE or DICT block in pSlots, and how many of the block's slots hold each
+// in pRuns, without expanding the block.
+bool GrapaDBColumnCode::Runs(u8 pCode, u64 pSize, const std::vector<u8>& pBlock, u64 pCount, std::vector<u8>& pSlots, std::vector<u64>& pRuns)
+{
+	const u8* p = pBlock.data();
+	u64 length = pBlock.size(), i;
+
+	pSlots.clear();
+	pRuns.clear();
+	if (length < 2)
+		return(false);
+	u64 entries = GrapaDBGetU(p, 2);
+	switch (pCode)
 	{
-		indexCursor.Set(indexTableCursor.mValue,pValueType,resId,recordRef);
-		err = Insert(indexCursor);
-		if (err) return(err);
-		err = Next(indexTableCursor);
-		if (!err && indexTableCursor.mKey==0)
-			err = Next(indexTableCursor);
+	case RLE:
+		if (length < 2 + entries * (2 + pSize))
+			return(false);
+		for (i = 0; i < entries; i++)
+		{
+			const u8* run = &p[2 + i * (2 + pSize)];
+			pRuns.push_back(GrapaDBGetU(run, 2));
+			pSlots.insert(pSlots.end(), run + 2, run + 2 + pSize);
+		}
+		return(true);
+	case DICT:
+		{
+			u64 at = 2 + entries * pSize;
+			if (length < at + 1)
+				return(false);
+			u8 width = p[at++];
+			if (width > 16 || length < at + (pCount * width + 7) / 8)
+				return(false);
+			pRuns.assign((size_t)entries, 0);
+			for (i = 0; i < pCount; i++)
+			{
+				u64 k = GrapaDBUnpackBits(&p[at], i, width);
+				if (k >= entries)
+					return(false);
+				pRuns[k]++;
+			}
+			pSlots.assign(&p[2], &p[2] + entries * pSize);
+			return(true);
+		}
 	}
+	return(false);
+}
 
-	return(0);
+const char* GrapaDBColumnCode::Name(u8 pCode)
+{
+	switch (pCode)
+	{
+	case PLAIN: return("plain");
+	case RLE: return("rle");
+	case DICT: return("dict");
+	case FOR: return("for");
+	case DELTA: return("delta");
+	}
+	return("");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-// Need to fix the comparisons. Numbers are being compared as strings...which isn't right.
-// Compare needs to be based on the field type
+void GrapaDBColumn::Clear(u64 pCount)
+{
+	mData.clear();
+	mStart.assign(pCount, 0);
+	mLength.assign(pCount, 0);
+	mSet.assign(pCount, 0);
+	mRuns.clear();
+}
 
-GrapaError GrapaDB::CompareKey(s16 compareType, GrapaCursor& dataCursor, GrapaCursor& treeCursor, s8& result)
+// Finds the values in the first pCount slots of a fixed field, read into mData.
+void GrapaDBColumn::Slots(u64 pCount)
 {
-	GrapaError err=0;
-	GrapaCursor cursor;
+	u64 size = mField.mDictSize, i, start, length;
+	u64 isRaw = (mField.mType == (u8)GrapaTokenType::RAW) ? 1 : 0;
+	for (i = 0; i < pCount && (i + 1) * size <= mData.size(); i++)
+	{
+		if (!GrapaDBSlot(&mData[i * size], size, isRaw, start, length))
+			continue;
+		mStart[i] = i * size + start;
+		mLength[i] = length;
+		mSet[i] = length ? 1 : 0;
+	}
+}
 
-	result = -1;
+void GrapaDBColumn::Put(u64 i, const void* pValue, u64 pLength)
+{
+	if (pLength == 0)
+		return;
+	mStart[i] = mData.size();
+	mLength[i] = pLength;
+	mSet[i] = 1;
+	mData.insert(mData.end(), (const u8*)pValue, (const u8*)pValue + pLength);
+}
 
-	switch(treeCursor.mValueType)
+void GrapaDBColumn::Value(u64 i, GrapaBYTE& pValue) const
+{
+	pValue.SetLength(0);
+	pValue.FromDbType(mField.mType);
+	if (mSet[i])
 	{
-		case DTYPE_ITEM:
-			// this item is the same as a DbData item, but for the data type dictionary
-			//result = treeCursor.mKey - dataCursor.mKey;
-			result = GrapaBtree::CompareKey(treeCursor.mKey, dataCursor.mKey);
-			break;
+		pValue.SetLength(mLength[i], false);
+		memcpy(pValue.mBytes, &mData[mStart[i]], (size_t)mLength[i]);
+	}
+}
 
-		case GREC_ITEM: 
-		case RREC_ITEM:
-		case CREC_ITEM:
-		case GPTR_ITEM:
-		case RPTR_ITEM:
-		case CPTR_ITEM:
-			switch(dataCursor.mValueType)
+// INT and TIME values are big-endian two's complement, so up to 8 bytes sign-extend into an s64.
+bool GrapaDBColumn::Decode()
+{
+	u64 n = mSet.size(), i, j;
+	bool all = true;
+	switch (mField.mType)
+	{
+	case GrapaTokenType::INT:
+	case GrapaTokenType::TIME:
+		mInts.assign(n, 0);
+		for (i = 0; i < n; i++)
+		{
+			if (!mSet[i])
+				continue;
+			if (mLength[i] > 8)
 			{
-				case SEARCH_ITEM: // Searching an index using a set of search fields
-					err = CompareSearchKey(compareType, dataCursor, treeCursor, result);
-					//if (err) return(err);
-					break;
+				all = false;
+				continue;
+			}
+			const u8* p = &mData[mStart[i]];
+			u64 v = (p[0] & 0x80) ? ~(u64)0 : 0;
+			for (j = 0; j < mLength[i]; j++)
+				v = (v << 8) | p[j];
+			mInts[i] = (s64)v;
+		}
+		return(all);
+	case GrapaTokenType::FLOAT:
+		{
+			GrapaCHAR value;
+			GrapaFloat f;
+			mFloats.assign(n, 0.0);
+			mExact.assign(n, 1);
+			for (i = 0; i < n; i++)
+			{
+				if (!mSet[i])
+					continue;
+				Value(i, value);
+				GrapaDBToFloat(value, f);
+				if (f.IsDouble(mFloats[i]))
+					continue;
+				mFloats[i] = f.ToDouble();
+				mExact[i] = 0;
+				all = false;
+			}
+		}
+		return(all);
+	}
+	return(false);
+}
 
-				case GREC_ITEM: 
-				case RREC_ITEM:
-				case CREC_ITEM:
-				case GPTR_ITEM:
-				case RPTR_ITEM:
-				case CPTR_ITEM:
-					err = CompareRecordKey(compareType, dataCursor, treeCursor, result);
-					//if (err) return(err);
-					break;
+////////////////////////////////////////////////////////////////////////////////
 
-				case DTYPE_ITEM:
-				default:
-					return(-1);
+GrapaDBAggregate::GrapaDBAggregate(u8 pType)
+{
+	mType = pType;
+	mCount = 0;
+	mSum = 0;
+	mSumPart = 0;
+	mSumDouble = 0.0;
+	mWide = false;
+	mMinInt = mMaxInt = 0;
+	mMinFloat = mMaxFloat = 0.0;
+}
+
+bool GrapaDBAggregate::Numeric() const
+{
+	return(mType == GrapaTokenType::INT || mType == GrapaTokenType::FLOAT);
+}
+
+// Sums in an s64 and carries into mSum before it would overflow. pCount adds the value that many
+// times.
+void GrapaDBAggregate::AddInt(s64 pValue, u64 pCount)
+{
+	if (pCount != 1)
+	{
+		u64 a = (pValue < 0) ? (u64)0 - (u64)pValue : (u64)pValue;
+		if (pCount && a > (u64)LLONG_MAX / pCount)
+		{
+			mSum = mSum + GrapaInt(pValue) * pCount;
+			return;
+		}
+		pValue *= (s64)pCount;
+	}
+	if ((pValue > 0 && mSumPart > LLONG_MAX - pValue) || (pValue < 0 && mSumPart < LLONG_MIN - pValue))
+	{
+		mSum = mSum + mSumPart;
+		mSumPart = 0;
+	}
+	mSumPart += pValue;
+}
+
+// Sums in a double while every step is exact: Knuth's two-sum, and for a run the product checked
+// with fma. A value that would round, or is not a double to begin with, is added to mSumFloat as
+// the stored GrapaFloat.
+void GrapaDBAggregate::AddFloat(GrapaDBColumn& pColumn, u64 i, u64 pCount)
+{
+	if (pColumn.mExact[i])
+	{
+		d64 x = pColumn.mFloats[i];
+		d64 p = x * (d64)pCount;
+		if (pCount == 1 || fma(x, (d64)pCount, -p) == 0.0)
+		{
+			d64 s = mSumDouble + p;
+			d64 v = s - mSumDouble;
+			if ((mSumDouble - (s - v)) + (p - v) == 0.0)
+			{
+				mSumDouble = s;
+				return;
 			}
-			break;
+		}
+	}
+	GrapaCHAR value;
+	GrapaFloat f;
+	pColumn.Value(i, value);
+	GrapaDBToFloat(value, f);
+	if (pCount == 1)
+		mSumFloat = mSumFloat + f;
+	else
+		mSumFloat = mSumFloat + f * (s64)pCount;
+}
 
-		case SEARCH_ITEM:
-		default:
-			return(-1);
+// Once an integer needs more than 64 bits the bounds are kept as stored values from then on.
+void GrapaDBAggregate::Widen()
+{
+	if (mWide)
+		return;
+	if (mCount)
+	{
+		Min(mMin);
+		Max(mMax);
 	}
+	mWide = true;
+}
 
-	if (err)
-		result = GrapaBtree::CompareKey(treeCursor.mKey, dataCursor.mKey);
+void GrapaDBAggregate::Add(GrapaDBColumn& pColumn, u64 i, u64 pCount)
+{
+	if (!pColumn.mSet[i])
+		return;
+	bool first = mCount == 0;
+	GrapaCHAR value;
+	switch (mType)
+	{
+	case GrapaTokenType::INT:
+	case GrapaTokenType::TIME:
+		if (pColumn.mLength[i] <= 8 && !mWide)
+		{
+			s64 v = pColumn.mInts[i];
+			if (first || v < mMinInt) mMinInt = v;
+			if (first || v > mMaxInt) mMaxInt = v;
+			if (mType == GrapaTokenType::INT)
+				AddInt(v, pCount);
+			mCount += pCount;
+			return;
+		}
+		Widen();
+		pColumn.Value(i, value);
+		if (mType == GrapaTokenType::INT)
+		{
+			if (pColumn.mLength[i] <= 8)
+				AddInt(pColumn.mInts[i], pCount);
+			else
+			{
+				GrapaInt a;
+				a.FromBytes(value);
+				mSum = mSum + a * pCount;
+			}
+		}
+		break;
+	case GrapaTokenType::FLOAT:
+		{
+			d64 v = pColumn.mFloats[i];
+			AddFloat(pColumn, i, pCount);
+			if (first || v < mMinFloat) { mMinFloat = v; pColumn.Value(i, mMin); }
+			if (first || v > mMaxFloat) { mMaxFloat = v; pColumn.Value(i, mMax); }
+			mCount += pCount;
+		}
+		return;
+	default:
+		pColumn.Value(i, value);
+		break;
+	}
+	if (first || GrapaDBCompareValue(mType, value, mMin) < 0) mMin.FROM(value);
+	if (first || GrapaDBCompareValue(mType, value, mMax) > 0) mMax.FROM(value);
+	mCount += pCount;
+}
 
-	if (result==0)
+// Takes the values of a batch. The set values are packed to the front of the decoded array, and
+// the bounds and the sum are taken over that. A batch sum of s64 values is only taken in one go
+// when no partial sum can overflow. FLOAT values are summed one at a time so that each step can be
+// checked. A batch of runs is taken a run at a time.
+void GrapaDBAggregate::Add(GrapaDBColumn& pColumn)
+{
+	u64 n = pColumn.mSet.size(), i, k = 0;
+	bool ints = mType == GrapaTokenType::INT || mType == GrapaTokenType::TIME;
+	bool all = pColumn.Decode();
+	if (!pColumn.mRuns.empty())
 	{
-		// if the values end up to be the same, then lets compare the key's just to be sure.
-		switch(dataCursor.mValueType)
+		for (i = 0; i < n; i++)
+			Add(pColumn, i, pColumn.mRuns[i]);
+		return;
+	}
+	if (!all || (ints && mWide))
+	{
+		for (i = 0; i < n; i++)
+			Add(pColumn, i);
+		return;
+	}
+
+	if (ints)
+	{
+		s64* v = pColumn.mInts.data();
+		for (i = 0; i < n; i++)
+			if (pColumn.mSet[i]) v[k++] = v[i];
+		if (k == 0)
+			return;
+		s64 lo = v[0], hi = v[0];
+		GrapaVector::BoundsS64(v, k, lo, hi);
+		if (mCount == 0 || lo < mMinInt) mMinInt = lo;
+		if (mCount == 0 || hi > mMaxInt) mMaxInt = hi;
+		if (mType == GrapaTokenType::INT)
 		{
-			case GREC_ITEM:
-			case RREC_ITEM:
-			case CREC_ITEM:
-			case GPTR_ITEM:
-			case RPTR_ITEM:
-			case CPTR_ITEM:
-				switch (compareType)
-				{
-					case SEARCH_MODE:
-						if (dataCursor.mKey)
-							result = GrapaBtree::CompareKey(treeCursor.mKey, dataCursor.mKey);
-						break;
-					case INSERT_MODE:
-					case DELETE_MODE:
-						result = GrapaBtree::CompareKey(treeCursor.mKey, dataCursor.mKey);
-						break;
-				}
-				break;
+			u64 a = (lo < 0) ? (u64)0 - (u64)lo : (u64)lo;
+			u64 b = (hi < 0) ? (u64)0 - (u64)hi : (u64)hi;
+			if (b > a) a = b;
+			if (a <= (u64)LLONG_MAX / k)
+				AddInt(GrapaVector::SumS64(v, k));
+			else
+				for (i = 0; i < k; i++) AddInt(v[i]);
 		}
+		mCount += k;
+		return;
 	}
-	
-	return(0);
+
+	for (i = 0; i < n; i++)
+		if (pColumn.mSet[i]) AddFloat(pColumn, i);
+	d64* v = pColumn.mFloats.data();
+	for (i = 0; i < n; i++)
+		if (pColumn.mSet[i]) v[k++] = v[i];
+	if (k == 0)
+		return;
+	d64 lo = v[0], hi = v[0];
+	GrapaVector::BoundsF64(v, k, lo, hi);
+	u64 count = k;
+	bool first = mCount == 0;
+	bool newMin = first || lo < mMinFloat, newMax = first || hi > mMaxFloat;
+	for (i = 0, k = 0; i < n && (newMin || newMax); i++)
+	{
+		if (!pColumn.mSet[i])
+			continue;
+		if (newMin && v[k] == lo) { mMinFloat = lo; pColumn.Value(i, mMin); newMin = false; }
+		if (newMax && v[k] == hi) { mMaxFloat = hi; pColumn.Value(i, mMax); newMax = false; }
+		k++;
+	}
+	mCount += count;
+}
+
+GrapaInt GrapaDBAggregate::Sum() const
+{
+	return(mSum + mSumPart);
+}
+
+GrapaFloat GrapaDBAggregate::SumFloat() const
+{
+	GrapaFloat part(false, 53, 0, GrapaInt(0));
+	part.FromDouble(mSumDouble);
+	return(mSumFloat + part);
+}
+
+void GrapaDBAggregate::Min(GrapaCHAR& pValue) const
+{
+	if (mCount && !mWide && (mType == GrapaTokenType::INT || mType == GrapaTokenType::TIME))
+	{
+		pValue.FROM(GrapaInt(mMinInt).getBytes());
+		pValue.FromDbType(mType);
+	}
+	else if (mCount)
+		pValue.FROM(mMin);
+	else
+		pValue.SetLength(0);
+}
+
+void GrapaDBAggregate::Max(GrapaCHAR& pValue) const
+{
+	if (mCount && !mWide && (mType == GrapaTokenType::INT || mType == GrapaTokenType::TIME))
+	{
+		pValue.FROM(GrapaInt(mMaxInt).getBytes());
+		pValue.FromDbType(mType);
+	}
+	else if (mCount)
+		pValue.FROM(mMax);
+	else
+		pValue.SetLength(0);
 }
 
 GrapaError GrapaDB::CompareRecordKey(s16 compareType, GrapaCursor& dataCursor, GrapaCursor& treeCursor, s8& result)
@@ -2524,6 +4296,15 @@ GrapaError GrapaDB::CompareRecordKey(s16 compareType, GrapaCursor& dataCursor, G
 						result = 0;
 						return(0);
 					}
+					// records sit in their own tree by record id; only pointer trees are ordered by field values
+					switch (treeCursor.mValueType)
+					{
+						case GREC_ITEM:
+						case RREC_ITEM:
+						case CREC_ITEM:
+							result = GrapaBtree::CompareKey(treeCursor.mKey, dataCursor.mKey);
+							return(0);
+					}
 					break;
 				case GPTR_ITEM: 
 				case RPTR_ITEM:
@@ -2572,23 +4353,23 @@ GrapaError GrapaDB::CompareRecordKey(s16 compareType, GrapaCursor& dataCursor, G
 			break;
 	}
 
+	// records with the same values are equal here, and CompareKey orders them by id
+	result = 0;
 	cursor.Set(indexRef);
 	err = First(cursor);
 	while(!err)
 	{
-		// need to pull these into the treeItemCursor datatype for the comparison
-		err = GetRecordField(dataItemCursor,cursor.mValue,name1);
-		err = GetRecordField(treeItemCursor,cursor.mValue,name2);
-
-		char* n1 = (char*)name1.mBytes;
-		char* n2 = (char*)name2.mBytes;
+		GrapaDBField field;
+		GrapaCursor fieldCursor;
+		name1.SetLength(0);
+		name2.SetLength(0);
+		if (FindRecordField(treeItemCursor,cursor.mValue,fieldCursor,field) == 0)
+		{
+			if (GetRecordField(dataItemCursor,field,name1)) name1.SetLength(0);
+			if (GetRecordField(fieldCursor,field,name2)) name2.SetLength(0);
+		}
 
-		// the following conditions should never happen...unless the value really is NULL
-		if (name1.mBytes==NULL  || name1.mLength==0) n1 = (char*)"";
-		if (name2.mBytes==NULL  || name2.mLength==0) n2 = (char*)"";
-		
-		// need to compare based on the treeItemCursor datatype
-		int cr = strcmp(n2, n1);
+		int cr = CompareKeyValue(field.mType, name2, name1);
 		if (cr)
 		{
 			result = (cr > 0) ? 1 : ((cr < 0) ? -1 : 0);
@@ -2627,18 +4408,9 @@ GrapaError GrapaDB::CompareSearchKey(s16 compareType, GrapaCursor& dataCursor, G
 		GrapaCursor treeItemCursor;
 		err = PtrToRec(treeCursor, treeItemCursor);
 
-		// need to pull this into the treeItemCursor datatype for the comparison
-		err = GetRecordField(treeItemCursor,*fv,name2);
+		if (GetRecordField(treeItemCursor,*fv,name2)) name2.SetLength(0);
 
-		char* n1 = (char*)fv->mValue.mBytes;
-		char* n2 = (char*)name2.mBytes;
-
-		// the following conditions should never happen...unless the value really is NULL
-		if (fv->mValue.mBytes==NULL  || fv->mValue.mLength==0) n1 = (char*)"";
-		if (name2.mBytes==NULL  || name2.mLength==0) n2 = (char*)"";
-
-		// need to compare based on the treeItemCursor datatype
-		int cr = strcmp(n2, n1);
+		int cr = CompareKeyValue(fv->mType, name2, fv->mValue);
 		result = (cr > 0) ? 1 : ((cr < 0) ? -1 : 0);
 		if (result<0)
 		{
@@ -2776,7 +4548,8 @@ GrapaError GrapaDB::DeleteKeyIndexes(GrapaCursor& treeCursor)
 							tableCursor.Set(indexTableCursor.mValue,CPTR_ITEM,treeCursor.mKey);
 							break;
 					}
-					err = GrapaBtree::Delete(tableCursor);
+					if (!IndexDeferred(indexTableCursor.mValue))
+						err = GrapaBtree::Delete(tableCursor);
 					// Ignore the error...the index could have already been deleted
 					// Maybe do a search first and then only delete if it exists? But this adds a search cost.
 					//if (err) return(err);
@@ -3368,6 +5141,79 @@ GrapaError GrapaDB::DumpTheTree(GrapaCHAR& dbWrite, const char *leader, u64 tabl
 	return(0);
 }
 
+GrapaError GrapaDB::ConvertTheTree(u64 firstTree, bool pRows, u64& pCount)
+{
+	GrapaError err=0;
+	GrapaCursor cursor;
+	u64 indexRef=0;
+	u64 storeTree=0;
+	u8 storeType=0;
+	u8 treeType=0;
+	u8 nodeCount=0;
+
+	if (firstTree==0)
+		return((GrapaError)-1);
+
+	cursor.Set(firstTree);
+	err = GetTreeIndex(cursor,indexRef);
+	if (err) return(err);
+	err = GetTreeStore(cursor,storeTree,storeType);
+	if (err) return(err);
+	err = GetTreeType(cursor,treeType);
+	if (err) return(err);
+	err = GetTreeWidth(cursor,nodeCount);
+	if (err) return(err);
+
+	cursor.Set(firstTree);
+	err = First(cursor);
+	while (!err)
+	{
+		switch (cursor.mValueType)
+		{
+			case TREE_ITEM:
+			case GREC_ITEM:
+				if (cursor.mValue == indexRef) break; // converted below as the index
+				err = ConvertTheTree(cursor.mValue, pRows, pCount);
+				if (err) return(err);
+				break;
+		}
+		err = Next(cursor);
+	}
+
+	if (storeTree && storeType==DATA_STORE)
+	{
+		err = ConvertTheTree(storeTree, pRows, pCount);
+		if (err) return(err);
+	}
+
+	// The index list of a column table, and the field lists hung off an index list, keep the width
+	// CreateTable and CreateIndex give them.
+	if (indexRef)
+	{
+		err = ConvertTheTree(indexRef, pRows && treeType!=CTABLE_TREE && treeType!=SU64_TREE, pCount);
+		if (err) return(err);
+	}
+
+	// Index trees written while CompareRecordKey could not find records by id are out of order, so
+	// every RTABLE tree is also re-sorted where needed.
+	if (treeType==RTABLE_TREE)
+	{
+		bool widen = pRows && nodeCount!=PAGE_WIDTH;
+		bool changed = false;
+		err = ConvertTree(firstTree, widen ? (u8)PAGE_WIDTH : nodeCount, true, changed);
+		if (err) return(err);
+		if (widen)
+		{
+			cursor.Set(firstTree);
+			err = SetTreeRanked(cursor, false);
+			if (err) return(err);
+		}
+		if (changed) pCount++;
+	}
+
+	return(0);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void GrapaDBCursor::SetSearch(GrapaDB* pDb, u64 pTreeRef, bool pUsingIndex, GrapaDBFieldValueArray* pData)
@@ -3520,6 +5366,17 @@ GrapaError GrapaDBFieldValueArray::Append(GrapaDB *pDb, GrapaDBTable& pTable, u6
 	return(0);
 }
 
+// For a field already opened, so a caller setting it on many records reads its definition once.
+GrapaError GrapaDBFieldValueArray::Append(const GrapaDBField& pField, const GrapaBYTE& pValue, s16 pCmp)
+{
+	GrapaDBFieldValue* dbFieldValue = new GrapaDBFieldValue();
+	*(GrapaDBField*)dbFieldValue = pField;
+	dbFieldValue->mValue.FROM(pValue);
+	dbFieldValue->mCmp = pCmp;
+	GrapaVoidArray::Append((void*)dbFieldValue);
+	return(0);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //	20-Jun-01	cmatichuk	Created
 
@@ -7,7 +7,10 @@
 
 #include "GrapaBtree.h"
 #include "GrapaValue.h"
+#include "GrapaInt.h"
+#include "GrapaFloat.h"
 #include <string.h>
+#include <vector>
 
 class GrapaDBTable;
 class GrapaDBIndex;
@@ -15,6 +18,9 @@ class GrapaDBField;
 class GrapaDBFieldArray;
 class GrapaDBFieldValueArray;
 class GrapaDBCursor;
+class GrapaDBRange;
+class GrapaDBScan;
+class GrapaDBCompact;
 
 class GrapaDB : public GrapaBtree
 {
@@ -24,7 +30,7 @@ public:
 	enum { IPTR_STORE=LAST_STORE, };
 	enum { NULL_CMP=0, LT_CMP, LTEQ_CMP, EQ_CMP, GTEQ_CMP, GT_CMP, };
 public:
-    GrapaDB() : mDumpFile(NULL) {}
+    GrapaDB() : mDumpFile(NULL), mByteKeys(false) {}
 public:
 
 	virtual GrapaError Create(const char *pFileName, u8 treeType, u64& firstTree);
@@ -52,13 +58,13 @@ public:
 
 	virtual GrapaError GetData(u64 itemPtr, GrapaCHAR& pValue);
 
-	// Need a way to disable the indexes, and then refresh after all the work is done
 	virtual GrapaError FindFreeIndexId(GrapaDBIndex& pIndex, u64 pMinId, u64& pIndexId);
-	// Need a unique capability. By default, the ID is unique.
-	virtual GrapaError CreateIndex(GrapaDBTable& pTable, u64 pIndexId, GrapaDU64Array& pIndexList, GrapaDBIndex& pIndex);
+	virtual GrapaError CreateIndex(GrapaDBTable& pTable, u64 pIndexId, GrapaDU64Array& pIndexList, GrapaDBIndex& pIndex, bool pUnique = false);
 	virtual GrapaError OpenIndex(GrapaDBTable& pTable, u64 pIndexId, GrapaDU64Array& pIndexList, GrapaDBIndex& pIndex);
 	virtual GrapaError DeleteIndex(GrapaDBTable& pTable, u64 pIndexId);
 	virtual GrapaError RefreshIndex(GrapaDBIndex& pIndex);
+	virtual GrapaError DeferIndex(GrapaDBTable& pTable, u64 pIndexId);
+	virtual GrapaError RebuildIndexes(GrapaDBTable& pTable, u64& pCount);
 
 	virtual GrapaError CreateIndexField(GrapaDBIndex& pIndex, u64 pIndexFieldId, u64 pFieldId);
 	virtual GrapaError OpenIndexField(GrapaDBIndex& pIndex, u64 pIndexFieldId, u64& pFieldId);
@@ -69,9 +75,11 @@ public:
 	// Need and OpenTransaction, CommitTransaction, and CancelTransaction.
 	virtual GrapaError CreateRecord(GrapaDBTable& pTable, GrapaCursor& pCursor);
 	virtual GrapaError DeleteRecord(GrapaDBTable& pTable, GrapaCursor& pCursor);
+	virtual GrapaError LoadRecords(GrapaDBTable& pTable, u64 pFirstId, u64 pCount, u64* pRecordRefs);
+	virtual GrapaError LoadIndexes(GrapaDBTable& pTable, bool pDeferred = false, u64* pCount = NULL);
 
 	virtual GrapaError FindRecordField(GrapaCursor& pCursor, u64 fieldId, GrapaCursor& recCursor, GrapaDBField& pField);
-	virtual GrapaError SetRecordField(GrapaCursor& pCursor, GrapaDBFieldValueArray& pFieldList);
+	virtual GrapaError SetRecordField(GrapaCursor& pCursor, GrapaDBFieldValueArray& pFieldList, bool pIndexes = true);
 	virtual GrapaError GetRecordField(GrapaCursor& pCursor, GrapaDBField& pField, GrapaBYTE& pValue);
 	virtual GrapaError GetRecordField(GrapaCursor& pCursor, u64 pFieldId, GrapaBYTE& pValue);
 
@@ -80,9 +88,17 @@ public:
 	virtual GrapaError LastDb(GrapaDBCursor& pCursor);
 	virtual GrapaError NextDb(GrapaDBCursor& pCursor);
 	virtual GrapaError PrevDb(GrapaDBCursor& pCursor);
+	virtual GrapaError FirstRange(GrapaDBRange& pRange, u64 pIndexRef, u64 pAfterId = 0);
+	virtual GrapaError NextRange(GrapaDBRange& pRange);
+	virtual GrapaError FirstScan(GrapaDBScan& pScan);
+	virtual GrapaError NextScan(GrapaDBScan& pScan);
+	virtual GrapaError CompactField(GrapaDBTable& pTable, GrapaDBField& pField, GrapaDBCompact& pInfo);
+	virtual GrapaError ExpandField(GrapaCursor& pItemCursor, const GrapaDBField& pField);
+	static int CompareValue(u8 pType, const GrapaBYTE& a, const GrapaBYTE& b);
+	int CompareKeyValue(u8 pType, const GrapaBYTE& a, const GrapaBYTE& b);
 
 	// override...don't change parameter list or it will break the override
-	virtual GrapaError NewTree(u64& treePtr, u8 treeType, u64 parentTree = 0LL, u8 nodeCount = NODE_WIDTH);
+	virtual GrapaError NewTree(u64& treePtr, u8 treeType, u64 parentTree = 0LL, u8 nodeCount = NODE_WIDTH, bool ranked = true);
 	virtual GrapaError CompareKey(s16 pCompareType, GrapaCursor& pUserCursor, GrapaCursor& pTreeCursor, s8& pResult);
 	virtual GrapaError DeleteKey(GrapaCursor& pTreeCursor);
 	virtual GrapaError Delete(GrapaCursor& cursor);
@@ -91,9 +107,11 @@ public:
 	virtual GrapaError DeleteKeyIndexes(GrapaCursor& pTreeCursor);
 	virtual GrapaError DumpFile(GrapaFile *pDumpFile = NULL);
 	virtual GrapaError DumpTree(u64 pTreeRef = 0, GrapaFile *pDumpFile = NULL);
+	virtual GrapaError ConvertFile(u64& pCount);
 
 protected:
 	GrapaFile *mDumpFile;
+	bool mByteKeys;		// index keys in the file still compare byte by byte, as before FORMAT_VERSION 2
 
 public: // should be protected, and explosed to GrapaDBField with friend...but doesn't work on g++
 	GrapaError GetDataTypeRecord(u64 tableRef, u64& tableDT);
@@ -114,6 +132,13 @@ protected:
 	GrapaError InsertIntoIndex(u64 tableRef, u8 pValueType, u64 resId, u64 recordRef);
 
 	bool IndexHasField(GrapaCursor& cursor, u64 fieldId);
+	bool IndexDeferred(u64 indexRef);
+	bool IndexKeyEqual(u64 indexRef, u8 ptrType, u64 key1, u64 key2);
+	GrapaError CheckUnique(u64 indexRef, GrapaCursor& recCursor, GrapaDBFieldValueArray& pFieldList);
+	bool InRange(GrapaDBRange& pRange, bool pLower, bool pUpper);
+	GrapaError ReadColumn(u64 pItemRef, u64 pSize, u64 pRecords, std::vector<u8>& pSlots);
+	GrapaError ReadColumnSlot(u64 pItemRef, u64 pIndex, std::vector<u8>& pSlot);
+	bool ColumnEndsBefore(u64 pItemRef, u64 pIndex);
 
 	GrapaError DumpTheStructure(GrapaCHAR& dbWrite, GrapaCursor& cursor, u64 tableDT);
 	GrapaError DumpTheGroupStructure(GrapaCHAR& dbWrite, GrapaCursor& cursor);
@@ -132,6 +157,7 @@ protected:
 	GrapaError DumpTheValue(GrapaCHAR& dbWrite, char *leader, GrapaCursor& cursor);
 	GrapaError DumpTheTreeItem(GrapaCHAR& dbWrite, char *leader, GrapaCursor& cursor);
 	GrapaError DumpTheTree(GrapaCHAR& dbWrite, const char *leader, u64 tableId, u64 firstTree);
+	GrapaError ConvertTheTree(u64 firstTree, bool pRows, u64& pCount);
 };
 
 // need a way for user to extend the dict field definition
@@ -173,7 +199,7 @@ class GrapaDBFieldArray : public GrapaVoidArray
 {
 public:
 	GrapaDBFieldArray(u32 pCount=0) : GrapaVoidArray(pCount) {};
-	~GrapaDBFieldArray();
+	virtual ~GrapaDBFieldArray();
 public:
 	GrapaError Append(GrapaDB *pDb, GrapaDBTable& pTable, u64 pFieldId);
 	GrapaError Append(GrapaDBField *pField);
@@ -197,6 +223,7 @@ public:
 	~GrapaDBFieldValueArray();
 public:
 	GrapaError Append(GrapaDB *pDb, GrapaDBTable& pTable, u64 pFieldId, const GrapaBYTE& pValue, s16 pCmp = GrapaDB::EQ_CMP);
+	GrapaError Append(const GrapaDBField& pField, const GrapaBYTE& pValue, s16 pCmp = GrapaDB::EQ_CMP);
 	GrapaDBFieldValue* GetFieldAt(u32 i) {return((GrapaDBFieldValue*)GetAt(i));}
 };
 
@@ -234,6 +261,155 @@ public:
     void SetSearch(GrapaDB* pDb, u64 pTreeRef, bool pUsingIndex, GrapaDBFieldValueArray* pData);
 };
 
+// Walks an index in order between two bounds, one item at a time, so only the items read are
+// touched. Each bound holds values for a leading run of the index fields; a bound with no values
+// leaves that end open. mCursor is on the current index item.
+class GrapaDBRange
+{
+public:
+	GrapaDBFieldValueArray mLower;
+	GrapaDBFieldValueArray mUpper;
+	bool mLowerIn;
+	bool mUpperIn;
+	bool mReverse;
+	GrapaDBCursor mCursor;
+public:
+	GrapaDBRange() { mLowerIn = true; mUpperIn = true; mReverse = false; }
+};
+
+// The encoded form of a fixed field of a column table, written by GrapaDB::CompactField. The slots
+// are cut into blocks of mRows records, and each block is kept in whichever encoding is smallest
+// for it: PLAIN slots, RLE runs of equal slots, DICT indexes into the distinct slots of the block,
+// or for INT and TIME fields FOR offsets from the least value and DELTA offsets between values.
+// An encoding is only used if it gives back every slot byte for byte. The item starts with the
+// slot size, the record count, and a directory of where each block starts and how it is encoded,
+// so a single slot or a single block is read without the rest.
+class GrapaDBColumnCode
+{
+public:
+	enum { PLAIN = 0, RLE, DICT, FOR, DELTA, LAST_CODE, };
+	enum { BLOCK_ROWS = 4096, HEAD_SIZE = 25, };
+	u64 mSize;
+	u64 mRecords;
+	u64 mRows;
+	u64 mBlocks;
+	std::vector<u64> mOffset;	// where each block starts, then where the last one ends
+	std::vector<u8> mCode;
+public:
+	GrapaDBColumnCode() { mSize = 0; mRecords = 0; mRows = BLOCK_ROWS; mBlocks = 0; }
+	u64 Count(u64 pBlock) const;
+	GrapaError Read(GrapaDB* pDb, u64 pItemRef, bool pDirectory = true);
+	GrapaError ReadBlock(GrapaDB* pDb, u64 pItemRef, u64 pBlock, u8& pCode, std::vector<u8>& pBytes) const;
+	static void Build(u8 pType, u64 pSize, const std::vector<u8>& pSlots, u64 pRecords, std::vector<u8>& pItem, u64* pBlocks);
+	static u8 Encode(u8 pType, u64 pSize, const u8* pSlots, u64 pCount, std::vector<u8>& pBlock);
+	static bool Decode(u8 pCode, u64 pSize, const std::vector<u8>& pBlock, u64 pCount, u64 pFirst, u64 pLast, u8* pSlots);
+	static bool Runs(u8 pCode, u64 pSize, const std::vector<u8>& pBlock, u64 pCount, std::vector<u8>& pSlots, std::vector<u64>& pRuns);
+	static const char* Name(u8 pCode);
+};
+
+// What CompactField did to a field: its records, the bytes its slots took before and take now,
+// and how many blocks went to each encoding.
+class GrapaDBCompact
+{
+public:
+	u64 mRecords;
+	u64 mRaw;
+	u64 mSize;
+	u64 mBlocks[GrapaDBColumnCode::LAST_CODE];
+public:
+	GrapaDBCompact() { mRecords = 0; mRaw = 0; mSize = 0; for (u64& b : mBlocks) b = 0; }
+};
+
+// The values of one field for the records of a GrapaDBScan batch. Value i is mLength[i] bytes at
+// mStart[i] in mData, and mSet[i] is 0 where the record has no value. Decode fills mInts for INT
+// and TIME fields, or mFloats for FLOAT fields, with 0 where there is no value, and says whether
+// every value could be held that way. A FLOAT value that is not exactly a double gets its nearest
+// double and a 0 in mExact. When mRuns is not empty the batch came from a run-length or
+// dictionary block and value i stands for mRuns[i] records, in no particular order.
+class GrapaDBColumn
+{
+public:
+	GrapaDBField mField;
+	std::vector<u8> mData;
+	std::vector<u64> mStart;
+	std::vector<u64> mLength;
+	std::vector<u8> mSet;
+	std::vector<s64> mInts;
+	std::vector<d64> mFloats;
+	std::vector<u8> mExact;
+	std::vector<u64> mRuns;
+	u64 mRef;
+	u64 mSize;
+	GrapaDBColumnCode mCode;
+	std::vector<u8> mBlock;
+	GrapaCursor mCursor;
+	bool mMore;
+public:
+	GrapaDBColumn() { mRef = 0; mSize = 0; mMore = false; }
+	void Clear(u64 pCount);
+	void Put(u64 i, const void* pValue, u64 pLength);
+	void Slots(u64 pCount);
+	void Value(u64 i, GrapaBYTE& pValue) const;
+	bool Decode();
+};
+
+// Reads fields of a table a batch of records at a time, in record order. In a column table a fixed
+// field is read straight from its column, a batch of slots at a time, and a variable field is
+// walked alongside the records; other tables read each record. After each call mCount records are
+// in the batch, and each of mColumns holds their values for its field. A caller that takes counted
+// values sets mRuns, and an encoded column then hands over the runs of a block as they are.
+class GrapaDBScan
+{
+public:
+	GrapaDBTable mTable;
+	std::vector<GrapaDBColumn> mColumns;
+	u64 mBatch;
+	u64 mCount;
+	u64 mPos;
+	u64 mRecords;
+	u8 mTreeType;
+	bool mKeys;
+	GrapaCursor mCursor;
+	std::vector<u64> mKeyList;
+	bool mRuns;
+public:
+	GrapaDBScan() { mBatch = 4096; mCount = 0; mPos = 0; mRecords = 0; mTreeType = 0; mKeys = false; mRuns = false; }
+};
+
+// The count, sum and bounds of the values of one field. A whole batch is taken by vector kernels
+// when Decode holds every value of it; otherwise, and for each row of a group, values are taken
+// one at a time. INT sums are exact. FLOAT values are compared as doubles, and the bounds keep the
+// stored value. They are summed as doubles while that is exact, and otherwise as GrapaFloat. Other
+// types are counted and bounded but not summed.
+class GrapaDBAggregate
+{
+public:
+	u8 mType;
+	u64 mCount;
+	GrapaInt mSum;
+	s64 mSumPart;
+	GrapaFloat mSumFloat;
+	d64 mSumDouble;
+	bool mWide;
+	s64 mMinInt, mMaxInt;
+	d64 mMinFloat, mMaxFloat;
+	GrapaCHAR mMin, mMax;
+public:
+	GrapaDBAggregate(u8 pType = 0);
+	void Add(GrapaDBColumn& pColumn);
+	void Add(GrapaDBColumn& pColumn, u64 i, u64 pCount = 1);	// after pColumn.Decode()
+	void Count() { mCount++; }
+	bool Numeric() const;
+	GrapaInt Sum() const;
+	GrapaFloat SumFloat() const;
+	void Min(GrapaCHAR& pValue) const;
+	void Max(GrapaCHAR& pValue) const;
+protected:
+	void AddInt(s64 pValue, u64 pCount = 1);
+	void AddFloat(GrapaDBColumn& pColumn, u64 i, u64 pCount = 1);
+	void Widen();
+};
+
 #endif // _GrapaDB_
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -62,6 +62,7 @@ GrapaLocalDatabase::GrapaLocalDatabase()
 #endif
 	vScriptState = NULL;
 	mDb = NULL;
+	mLiveDb = NULL;
 	mLocation.FROM("grapa: ");
 	mVar = false;
 	mHomeDir.FROM(gSystem->mWorkDir);
@@ -83,6 +84,7 @@ GrapaLocalDatabase::GrapaLocalDatabase(GrapaScriptState* pTokenState)
 	mSep = '/';
 #endif
 	mDb = NULL;
+	mLiveDb = NULL;
 	mLocation.FROM("grapa: ");
 	mVar = false;
 	mHomeDir.FROM(gSystem->mWorkDir);
@@ -116,6 +118,7 @@ GrapaLocalDatabase::~GrapaLocalDatabase()
 
 void GrapaLocalDatabase::CLEAR()
 {
+	DatabaseRelease();
 	if (mDb)
 	{
 		if (mVar)
@@ -123,7 +126,7 @@ void GrapaLocalDatabase::CLEAR()
 			delete mDb;
 		}
 		else
-			gSystem->mGroupQueue.CloseFile(mDb);
+			gSystem->mGroupQueue.CloseFile(mDb, this);
 		mDb = NULL;
 	}
 	mDirId = 0;
@@ -132,6 +135,7 @@ void GrapaLocalDatabase::CLEAR()
 	mHomeDirType = 0;
 	mVar = false;
 	mFile.Close();
+	mMapFile.Close();
 }
 
 GrapaError GrapaLocalDatabase::DirectoryList(GrapaCHAR& pName, GrapaRuleEvent* pTable)
@@ -490,6 +494,7 @@ GrapaError GrapaLocalDatabase::DirectoryCreate(GrapaCHAR& pName, GrapaCHAR& pTyp
 
 GrapaError GrapaLocalDatabase::DirectoryDelete(GrapaCHAR& pName)
 {
+	GrapaGroupHandle handle(this);
 	GrapaError err = 0;
 	if (mDb==NULL)
 	{
@@ -721,7 +726,8 @@ GrapaError GrapaLocalDatabase::DirectorySwitchSingle(GrapaCHAR& pName)
 				mDirType = 0;
 				if (!mVar)
 				{
-					gSystem->mGroupQueue.CloseFile(mDb);
+					DatabaseRelease();
+					gSystem->mGroupQueue.CloseFile(mDb, this);
 					mDb = NULL;
 				}
 				mDatabasePath->CLEAR();
@@ -802,7 +808,13 @@ GrapaError GrapaLocalDatabase::DirectorySwitchSingle(GrapaCHAR& pName)
 		if (mDb==NULL)
 		{
 			if (!mVar)
-				mDb = gSystem->mGroupQueue.OpenFile(path, &mFile, GrapaReadWrite);
+			{
+				// A mapped file is served from the OS page cache, so it gets no buffer pool.
+				if (gSystem->mFileMap)
+					mDb = gSystem->mGroupQueue.OpenFile(path, &mMapFile, GrapaReadWrite, 0);
+				else
+					mDb = gSystem->mGroupQueue.OpenFile(path, &mFile, GrapaReadWrite, GrapaFileCache::DEFAULT_SIZE, gSystem->mFileLog);
+			}
 			if (mDb)
 			{
 				mDirId = mDb->mValue.RootTree(mDirType);
@@ -852,7 +864,8 @@ GrapaError GrapaLocalDatabase::DirectorySwitchSingle(GrapaCHAR& pName)
 						mDirType = 0;
 						if (!mVar)
 						{
-							gSystem->mGroupQueue.CloseFile(mDb);
+							DatabaseRelease();
+							gSystem->mGroupQueue.CloseFile(mDb, this);
 							mDb = NULL;
 						}
 					}
@@ -907,6 +920,7 @@ GrapaError GrapaLocalDatabase::DirectorySwitch(u64 pId)
 
 GrapaError GrapaLocalDatabase::DatabaseCreate(GrapaCHAR& pName, GrapaCHAR& pType)
 {
+	GrapaGroupHandle handle(this);
 	GrapaError err = 0;
 	u64 newDirId;
 	if (mDb == NULL)
@@ -917,7 +931,11 @@ GrapaError GrapaLocalDatabase::DatabaseCreate(GrapaCHAR& pName, GrapaCHAR& pType
 			DirectoryFullPath(path);
 			path.Append("/");
 			path.Append(pName);
-			GrapaGroupEvent*e = gSystem->mGroupQueue.Create(path, &mFile, pType);
+			GrapaGroupEvent*e;
+			if (gSystem->mFileMap)
+				e = gSystem->mGroupQueue.Create(path, &mMapFile, pType, 0);
+			else
+				e = gSystem->mGroupQueue.Create(path, &mFile, pType, GrapaFileCache::DEFAULT_SIZE, gSystem->mFileLog);
 			gSystem->mGroupQueue.CloseFile(e);
 		}
 	}
@@ -936,6 +954,7 @@ GrapaError GrapaLocalDatabase::DatabaseCreate(GrapaCHAR& pName, GrapaCHAR& pType
 
 void GrapaLocalDatabase::DatabaseSet(GrapaCHARFile& pValue)
 { 
+	DatabaseRelease();
 	mHomeDir.FROM("");
 	mDatabasePath->CLEAR();
 	if (mDb)
@@ -944,7 +963,7 @@ void GrapaLocalDatabase::DatabaseSet(GrapaCHARFile& pValue)
 		mDirType = 0;
 		if (!mVar)
 		{
-			gSystem->mGroupQueue.CloseFile(mDb);
+			gSystem->mGroupQueue.CloseFile(mDb, this);
 			mDb = NULL;
 		}
 		mVar = false;
@@ -961,6 +980,7 @@ void GrapaLocalDatabase::DatabaseSet(GrapaCHARFile& pValue)
 
 GrapaError GrapaLocalDatabase::DataCreate(const GrapaCHAR& pName)
 {
+	GrapaGroupHandle handle(this);
 	GrapaError err = 0;
 	if (mDb == NULL)
 	{
@@ -987,6 +1007,7 @@ GrapaError GrapaLocalDatabase::DataCreate(const GrapaCHAR& pName)
 
 GrapaError GrapaLocalDatabase::DataDelete(const GrapaCHAR& pName)
 {
+	GrapaGroupHandle handle(this);
 	GrapaError err = 0;
 	if (mDb == NULL)
 	{
@@ -1011,6 +1032,7 @@ GrapaError GrapaLocalDatabase::DataDelete(const GrapaCHAR& pName)
 
 void GrapaLocalDatabase::DataDelete(u64 pId)
 {
+	GrapaGroupHandle handle(this);
 	GrapaError err = 0;
 	if (mDb == NULL) return;
 	err = mDb->mValue.DeleteEntry(mDirId, mDirType, pId);
@@ -1019,6 +1041,7 @@ void GrapaLocalDatabase::DataDelete(u64 pId)
 
 GrapaError GrapaLocalDatabase::FieldCreate(GrapaCHAR& pName, GrapaCHAR& fieldType, GrapaCHAR& storeType, u64 storeSize, u64 storeGrow)
 {
+	GrapaGroupHandle handle(this);
 	GrapaError err = 0;
 	if (mDb == NULL) return(-1);
 	u8 listType = GrapaTokenType::STR;
@@ -1036,9 +1059,9 @@ GrapaError GrapaLocalDatabase::FieldCreate(GrapaCHAR& pName, GrapaCHAR& fieldTyp
 	if (storeType.mLength)
 	{
 
-		if (storeType.StrCmp("FIX") == 0) { listType = GrapaTokenType::STR; listStore = GrapaDBField::STORE_VAR; }
-		else if (storeType.StrCmp("VAR") == 0) { listType = GrapaTokenType::TABLE; listStore = GrapaDBField::STORE_VAR; }
-		else if (storeType.StrCmp("PAR") == 0) { listType = GrapaTokenType::RAW; listStore = GrapaDBField::STORE_VAR; }
+		if (storeType.StrCmp("FIX") == 0) listStore = GrapaDBField::STORE_FIX;
+		else if (storeType.StrCmp("VAR") == 0) listStore = GrapaDBField::STORE_VAR;
+		else if (storeType.StrCmp("PAR") == 0) listStore = GrapaDBField::STORE_PAR;
 	}
 	if (storeSize == 0) storeSize = 32;
 	if (storeGrow == 0) storeGrow = 8;
@@ -1054,6 +1077,7 @@ GrapaError GrapaLocalDatabase::FieldCreate(GrapaCHAR& pName, GrapaCHAR& fieldTyp
 
 GrapaError GrapaLocalDatabase::FieldDelete(GrapaCHAR& pName)
 {
+	GrapaGroupHandle handle(this);
 	GrapaError err = 0;
 	if (mDb == NULL) return(-1);
 	u64 dirId = mDirId;
@@ -1066,6 +1090,65 @@ GrapaError GrapaLocalDatabase::FieldDelete(GrapaCHAR& pName)
 	return(err);
 }
 
+GrapaError GrapaLocalDatabase::IndexCreate(const std::vector<GrapaCHAR>& pFields, bool pUnique)
+{
+	GrapaGroupHandle handle(this);
+	if (mDb == NULL) return(-1);
+	GrapaError err = mDb->mValue.CreateFieldIndex(mDirId, mDirType, pFields, pUnique);
+	mDb->mValue.FlushFile();
+	return(err);
+}
+
+GrapaError GrapaLocalDatabase::IndexDelete(const std::vector<GrapaCHAR>& pFields)
+{
+	GrapaGroupHandle handle(this);
+	if (mDb == NULL) return(-1);
+	GrapaError err = mDb->mValue.DeleteFieldIndex(mDirId, mDirType, pFields);
+	mDb->mValue.FlushFile();
+	return(err);
+}
+
+GrapaError GrapaLocalDatabase::IndexSuspend(u64& pCount)
+{
+	GrapaGroupHandle handle(this);
+	pCount = 0;
+	if (mDb == NULL) return(-1);
+	GrapaError err = mDb->mValue.SuspendIndexes(mDirId, mDirType, pCount);
+	mDb->mValue.FlushFile();
+	return(err);
+}
+
+GrapaError GrapaLocalDatabase::IndexRebuild(u64& pCount)
+{
+	GrapaGroupHandle handle(this);
+	pCount = 0;
+	if (mDb == NULL) return(-1);
+	GrapaError err = mDb->mValue.Reindex(mDirId, mDirType, pCount);
+	mDb->mValue.FlushFile();
+	return(err);
+}
+
+GrapaError GrapaLocalDatabase::IndexRange(const std::vector<GrapaCHAR>& pFields, const std::vector<GrapaCHAR>& pLower, const std::vector<GrapaCHAR>& pUpper, bool pLowerIn, bool pUpperIn, bool pReverse, const GrapaCHAR& pAfter, u64 pLimit, GrapaGroupBatch& pRows)
+{
+	if (mDb == NULL) return(-1);
+	return(mDb->mValue.RangeEntries(mDirId, mDirType, pFields, pLower, pUpper, pLowerIn, pUpperIn, pReverse, pAfter, pLimit, pRows));
+}
+
+GrapaError GrapaLocalDatabase::FieldAggregate(const GrapaCHAR& pField, const GrapaCHAR& pBy, std::vector<GrapaCHAR>& pGroups, std::vector<GrapaDBAggregate>& pResults)
+{
+	if (mDb == NULL) return(-1);
+	return(mDb->mValue.AggregateEntries(mDirId, mDirType, pField, pBy, pGroups, pResults));
+}
+
+GrapaError GrapaLocalDatabase::FieldCompact(const GrapaCHAR& pField, std::vector<GrapaCHAR>& pNames, std::vector<GrapaDBCompact>& pInfo)
+{
+	GrapaGroupHandle handle(this);
+	if (mDb == NULL) return(-1);
+	GrapaError err = mDb->mValue.CompactFields(mDirId, mDirType, pField, pNames, pInfo);
+	mDb->mValue.FlushFile();
+	return(err);
+}
+
 GrapaError GrapaLocalDatabase::FieldInfo(const GrapaCHAR& pName, const GrapaCHAR& pField, GrapaRuleEvent* pTable)
 {
 	GrapaError err = 0;
@@ -1150,6 +1233,7 @@ GrapaError GrapaLocalDatabase::FieldInfo(const GrapaCHAR& pName, const GrapaCHAR
 
 GrapaError GrapaLocalDatabase::FieldSet(const GrapaCHAR& pName, const GrapaCHAR& pField, const GrapaCHAR& pValue)
 {
+	GrapaGroupHandle handle(this);
 	GrapaError err = 0;
 	if (mDb == NULL)
 	{
@@ -1238,6 +1322,7 @@ GrapaError GrapaLocalDatabase::FieldGet(const GrapaCHAR& pName, const GrapaCHAR&
 
 GrapaError GrapaLocalDatabase::FieldSet(u64 pId, const GrapaCHAR& pField, const GrapaCHAR& pValue)
 {
+	GrapaGroupHandle handle(this);
 	GrapaError err = 0;
 	if (mDb == NULL) return(-1);
 	GrapaCHAR field(pField);
@@ -1536,6 +1621,99 @@ void GrapaLocalDatabase::DatabaseDump(u64 pId, GrapaCHARFile& dump)
     }
 }
 
+GrapaError GrapaLocalDatabase::DatabaseConvert(u64& pCount)
+{
+	GrapaGroupHandle handle(this);
+	pCount = 0;
+	if (mDb == NULL) return(-1);
+	return mDb->mValue.ConvertGroup(pCount);
+}
+
+// A negative size or rate leaves that setting as it is.
+GrapaError GrapaLocalDatabase::DatabaseCache(s64 pSize, s64 pRate, GrapaFileCacheStats& pStats)
+{
+	GrapaError err = 0;
+	memset(&pStats, 0, sizeof(pStats));
+	if (mDb == NULL) return(-1);
+	// A snapshot has no pool of its own; it reads through the live database's.
+	GrapaGroupEvent* db = mLiveDb ? mLiveDb : mDb;
+	if (pSize >= 0)
+		err = db->mValue.SetCache((u64)pSize);
+	if (!err && pRate >= 0)
+		err = db->mValue.SetFlush((u64)pRate);
+	db->mValue.CacheStats(pStats);
+	return(err);
+}
+
+GrapaError GrapaLocalDatabase::DatabaseCheckpoint()
+{
+	if (mDb == NULL) return(-1);
+	return (mLiveDb ? mLiveDb : mDb)->mValue.Checkpoint();
+}
+
+GrapaError GrapaLocalDatabase::DatabaseBegin()
+{
+	if (mDb == NULL) return(-1);
+	return mDb->mValue.Begin(this);
+}
+
+GrapaError GrapaLocalDatabase::DatabaseCommit()
+{
+	if (mDb == NULL) return(-1);
+	return mDb->mValue.Commit(this);
+}
+
+GrapaError GrapaLocalDatabase::DatabaseRollback()
+{
+	if (mDb == NULL) return(-1);
+	return mDb->mValue.Rollback(this);
+}
+
+GrapaError GrapaLocalDatabase::DatabaseLoad(GrapaGroupBatch& pBatch, u64& pCount)
+{
+	GrapaGroupHandle handle(this);
+	pCount = 0;
+	if (mDb == NULL) return(-1);
+	GrapaError err = mDb->mValue.LoadEntries(mDirId, mDirType, pBatch, pCount);
+	mDb->mValue.FlushFile();
+	return(err);
+}
+
+// Switches reads to a snapshot of the database as it stands now, taken between group operations
+// so it holds none of one half done. Opening another replaces it. The snapshot reads from the
+// current directory on, and writes through it fail.
+GrapaError GrapaLocalDatabase::DatabaseSnapshot()
+{
+	GrapaError err;
+	if (mDb == NULL) return(-1);
+	DatabaseRelease();
+	err = mDb->mValue.Snapshot(mSnapshotFile);
+	if (err) return(err);
+	GrapaGroupEvent* snapshot = new GrapaGroupEvent(GrapaCHAR(), &mSnapshotFile);
+	err = snapshot->mValue.OpenFile(GrapaCHAR(), GrapaReadOnly);
+	if (err)
+	{
+		delete snapshot;
+		mSnapshotFile.Close();
+		return(err);
+	}
+	mLiveDb = mDb;
+	mDb = snapshot;
+	return(0);
+}
+
+// Goes back to reading the live database. The snapshot's page versions are freed once no other
+// snapshot needs them.
+GrapaError GrapaLocalDatabase::DatabaseRelease()
+{
+	if (mLiveDb == NULL) return(-1);
+	delete mDb;
+	mDb = mLiveDb;
+	mLiveDb = NULL;
+	mSnapshotFile.Close();
+	return(0);
+}
+
 //void GrapaLocalDatabase::Running()
 //{
 //
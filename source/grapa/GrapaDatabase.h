@@ -7,6 +7,7 @@
 
 #include "GrapaGroup.h"
 #include "GrapaFileIO.h"
+#include "GrapaFileMap.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -60,6 +61,15 @@ public:
 	virtual GrapaError FieldCreate(GrapaCHAR& pName, GrapaCHAR& fieldType, GrapaCHAR& storeType, u64 storeSize, u64 storeGrow);
 	virtual GrapaError FieldDelete(GrapaCHAR& pName);
 
+	virtual GrapaError IndexCreate(const std::vector<GrapaCHAR>& pFields, bool pUnique);
+	virtual GrapaError IndexDelete(const std::vector<GrapaCHAR>& pFields);
+	virtual GrapaError IndexSuspend(u64& pCount);
+	virtual GrapaError IndexRebuild(u64& pCount);
+	virtual GrapaError IndexRange(const std::vector<GrapaCHAR>& pFields, const std::vector<GrapaCHAR>& pLower, const std::vector<GrapaCHAR>& pUpper, bool pLowerIn, bool pUpperIn, bool pReverse, const GrapaCHAR& pAfter, u64 pLimit, GrapaGroupBatch& pRows);
+
+	virtual GrapaError FieldAggregate(const GrapaCHAR& pField, const GrapaCHAR& pBy, std::vector<GrapaCHAR>& pGroups, std::vector<GrapaDBAggregate>& pResults);
+	virtual GrapaError FieldCompact(const GrapaCHAR& pField, std::vector<GrapaCHAR>& pNames, std::vector<GrapaDBCompact>& pInfo);
+
 	virtual GrapaError FieldInfo(const GrapaCHAR& pName, const GrapaCHAR& pField, GrapaRuleEvent* pTable);
 
 	virtual GrapaError FieldSet(const GrapaCHAR& pName, const GrapaCHAR& pField, const GrapaCHAR& pValue);
@@ -73,6 +83,15 @@ public:
 
 	virtual void DatabaseDump(u64 pId, GrapaCHAR& pFileName);
 	virtual void DatabaseDump(u64 pId, GrapaCHARFile& mFile);
+	virtual GrapaError DatabaseConvert(u64& pCount);
+	virtual GrapaError DatabaseCache(s64 pSize, s64 pRate, GrapaFileCacheStats& pStats);
+	virtual GrapaError DatabaseCheckpoint();
+	virtual GrapaError DatabaseBegin();
+	virtual GrapaError DatabaseCommit();
+	virtual GrapaError DatabaseRollback();
+	virtual GrapaError DatabaseLoad(GrapaGroupBatch& pBatch, u64& pCount);
+	virtual GrapaError DatabaseSnapshot();
+	virtual GrapaError DatabaseRelease();
 
 public:
 	u64 mDirId;
@@ -84,6 +103,11 @@ public:
 
 protected:
 	GrapaFileIO mFile;
+	GrapaFileMap mMapFile;
+	// While a snapshot is open, mDb reads it through mSnapshotFile and mLiveDb is the database
+	// it was taken of.
+	GrapaFileSnapshot mSnapshotFile;
+	GrapaGroupEvent* mLiveDb;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -24,10 +24,23 @@ public:
 	virtual GrapaError Create(const char *fileName) = 0;
 	virtual GrapaError Delete(const char *fileName) = 0;
 	virtual GrapaError Flush() = 0;
+	// Returns once everything written so far is on stable storage.
+	virtual GrapaError Sync() { return Flush(); }
 	virtual GrapaError Purge(u64 blockCount, u16 blockSize) = 0;
 	virtual GrapaError Write(u64 blockPos, u16 blockSize, u64 offset, u64 length, const void *b) = 0;
 	virtual GrapaError Read(u64 blockPos, u16 blockSize, u64 offset, u64 length, void *b) = 0;
 	virtual GrapaError Append(u64 length, const void *b) = 0;
+	// Writes count buffers back to back from byte pos. Files that can gather override this.
+	virtual GrapaError WriteV(u64 pos, u64 count, const void* const* b, const u64* lengths)
+	{
+		for (u64 i = 0; i < count; i++)
+		{
+			GrapaError err = Write(0, 0, pos, lengths[i], b[i]);
+			if (err) return(err);
+			pos += lengths[i];
+		}
+		return(0);
+	}
 protected:
 	bool mOpened;
 	char mMode;
@@ -20,23 +20,55 @@ limitations under the License.
 #include "GrapaMem.h"
 
 #include <string.h>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+#include <thread>
 
 class GrapaCacheBlock
 {
 public:
 	u64 key;
-	u64 prev,next;
-	u8 dirty,inuse;
-	u8 value[GrapaFileCache::BLOCKPAGESIZE];
+	u32 pin;
+	u8 dirty,inuse,used;
+	// The bytes changed since the page was last logged.
+	u32 lo,hi;
+	// Where the log ended after the commit that last logged the page.
+	u64 logged;
+	u8* value;
 };
 
+static u64 GrapaFileCacheNow()
+{
+	return (u64)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 GrapaFileCache::GrapaFileCache()
 {
-	mLocalyAllocated = false;
-	mCacheWidth = 0;
-	mCacheHeight = 0;
+	mCacheCount = 0;
+	mCacheHand = 0;
 	mCache = NULL;
-	mFirstCache = NULL;
+	mCacheData = NULL;
+	mCacheFree = NULL;
+	mCacheFreeCount = 0;
+	mFileSize = 0;
+	mDiskSize = 0;
+	mSizeLoaded = false;
+	memset(&mStats, 0, sizeof(mStats));
+	mLogOn = false;
+	mTxn = false;
+	mTxnEnd = 0;
+	mTxnSum = 0;
+	mTxnSize = 0;
+	mPending = 0;
+	mEpoch = 0;
+	mFlusher.vCache = this;
+	mFlushRate = 0;
+	mFlushCredit = 0;
+	mFlushNext = 0;
+	mFlushBytes = 0;
+	mFlushTime = 0;
+	mFlushEnd = 0;
 	mFile = NULL;
 }
 
@@ -46,414 +78,1231 @@ void GrapaFileCache::SetFile(GrapaFile *pFile)
 	mFile = pFile;
 }
 
-GrapaError GrapaFileCache::SetCache(u64 pSize, void *pCache)
+// Sizes the pool in BLOCKPAGESIZE pages. Less than two pages turns caching off, and reads and
+// writes go straight to the file. Dirty pages are written back before the pool is replaced.
+GrapaError GrapaFileCache::SetCache(u64 pSize)
 {
-	u64 sizeCalc;
-
-	FreeCache();
-
-	if (pSize < sizeof(GrapaCacheBlock))
-		return(0);
+	GrapaError err = 0;
+	u64 count = pSize / GrapaFileCache::BLOCKPAGESIZE;
 
-	mCacheHeight = DEFAULT_HEIGHT;
-	mCacheWidth = DEFAULT_SIZE / (mCacheHeight * sizeof(GrapaCacheBlock) + sizeof(u64));
+	mCritical.WaitCritical();
 
-	if (pCache)
+	if (mLog.Opened() && (mTxn || mPending))
+		err = -1;
+	if (!err && mCacheCount && mFile)
+		err = FlushCache();
+	if (err)
 	{
-		sizeCalc = pSize;
+		mCritical.LeaveCritical();
+		return(err);
+	}
 
-		mCacheHeight = DEFAULT_HEIGHT;
-		mCacheWidth = sizeCalc / (mCacheHeight * sizeof(GrapaCacheBlock) + sizeof(u64));
+	FreeCache();
 
-		if (mCacheWidth <= 4)
+	if (count >= 2)
+	{
+		mCache = (GrapaCacheBlock*)GrapaMem::Create(count * sizeof(GrapaCacheBlock));
+		mCacheData = (u8*)GrapaMem::Create(count * GrapaFileCache::BLOCKPAGESIZE);
+		mCacheFree = (u64*)GrapaMem::Create(count * sizeof(u64));
+		if (mCache == NULL || mCacheData == NULL || mCacheFree == NULL)
 		{
-			mCacheHeight = sizeCalc / sizeof(GrapaCacheBlock) / 4;
-			mCacheWidth = sizeCalc / (mCacheHeight * sizeof(GrapaCacheBlock) + sizeof(u64));
+			FreeCache();
+			err = -1;
 		}
+		else
+		{
+			mCacheCount = count;
+			ClearCache();
+		}
+	}
+
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+void GrapaFileCache::GetStats(GrapaFileCacheStats& pStats)
+{
+	mCritical.WaitCritical();
+	pStats = mStats;
+	pStats.size = mCacheCount * GrapaFileCache::BLOCKPAGESIZE;
+	pStats.pages = mCacheCount;
+	pStats.used = mCacheMap.size();
+	pStats.dirty = 0;
+	pStats.pinned = 0;
+	pStats.syncs = mLog.Syncs();
+	pStats.snapshots = 0;
+	pStats.versions = 0;
+	pStats.rate = mFlushRate;
+	pStats.backlog = 0;
+	for (std::map<u64, u64>::iterator s = mSnapshots.begin(); s != mSnapshots.end(); s++)
+		pStats.snapshots += s->second;
+	for (std::unordered_map<u64, std::map<u64, std::vector<u8> > >::iterator v = mVersions.begin(); v != mVersions.end(); v++)
+		pStats.versions += v->second.size();
+	for (u64 i = 0; i < mCacheCount; i++)
+	{
+		if (!mCache[i].inuse) continue;
+		if (mCache[i].dirty) pStats.dirty++;
+		if (mCache[i].dirty && mCache[i].hi <= mCache[i].lo) pStats.backlog++;
+		if (mCache[i].pin) pStats.pinned++;
+	}
+	mCritical.LeaveCritical();
+}
 
-		if (mCacheWidth == 0)
-			mCacheWidth = 1;
+// Takes effect when the next file is opened or created. The log needs a pool to hold changes
+// until they commit, so a file with no pool is not logged.
+void GrapaFileCache::SetLog(bool pLog)
+{
+	mCritical.WaitCritical();
+	mLogOn = pLog;
+	mCritical.LeaveCritical();
+}
 
-		sizeCalc = pSize - mCacheWidth * sizeof(u64);
-		mCacheHeight = ((sizeCalc / mCacheWidth) - sizeof(u64)) / sizeof(GrapaCacheBlock);
+// Sets how many bytes a second the flusher writes back, and 0 stops it. It runs while a file is
+// open; the setting carries over to the next one.
+GrapaError GrapaFileCache::SetFlush(u64 pRate)
+{
+	mFlusher.Stop();
+	mCritical.WaitCritical();
+	mFlushRate = pRate;
+	mFlushCredit = 0;
+	mFlushBytes = 0;
+	mFlushTime = GrapaFileCacheNow();
+	mStats.throughput = 0;
+	mCritical.LeaveCritical();
+	return StartFlusher();
+}
 
-		if (mCacheWidth==0 || mCacheHeight==0)
-		{
-			mCacheWidth = 0;
-			mCacheHeight = 0;
-		}
+// A checkpoint on demand: every dirty page goes back in one pass in file order, the file is
+// synced, and the log is emptied. Not while a transaction is open.
+GrapaError GrapaFileCache::SyncFile()
+{
+	GrapaError err = 0;
+	if (!mFile) return((GrapaError)-1);
+	mCritical.WaitCritical();
+	if (mTxn)
+		err = -1;
+	if (!err)
+		err = CommitLog();
+	if (!err && mCacheCount)
+		err = FlushCache();
+	if (!err)
+		err = GrapaFileLog::FileSync(mFile);
+	if (!err && mLog.Opened())
+		err = mLog.Reset();
+	if (!err)
+		mStats.checkpoints++;
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+// Starts a transaction. Changes made until Commit or Rollback, through any user of the file,
+// belong to it. Only one can be open at a time.
+GrapaError GrapaFileCache::Begin()
+{
+	GrapaError err = 0;
+	if (!mFile) return((GrapaError)-1);
+	mCritical.WaitCritical();
+	if (!mLog.Opened() || mTxn)
+		err = -1;
+	if (!err)
+		err = CommitLog();
+	// Committed pages reach the file first, so a rollback can read them back from it.
+	if (!err)
+		err = FlushCache();
+	if (!err)
+		err = LoadSize();
+	if (!err)
+	{
+		mTxn = true;
+		mTxnEnd = mLog.End();
+		mTxnSum = mLog.Sum();
+		mTxnSize = mFileSize;
 	}
+	mCritical.LeaveCritical();
+	return(err);
+}
 
-	if (!pCache)
+// Commits the open transaction, or with pExplicit false, the operation just finished; that is
+// left alone while a transaction is open, and joins it. pEnd is how far the log must be synced
+// for the commit to be durable, or 0 when a checkpoint has already made it so.
+GrapaError GrapaFileCache::Commit(bool pExplicit, u64& pEnd)
+{
+	GrapaError err = 0;
+	pEnd = 0;
+	if (!mFile) return((GrapaError)-1);
+	mCritical.WaitCritical();
+	if (!mLog.Opened())
+		err = pExplicit ? -1 : 0;
+	else if (pExplicit || !mTxn)
 	{
-		sizeCalc = (mCacheHeight * sizeof(GrapaCacheBlock) + sizeof(u64)) * mCacheWidth;
-		pCache = (GrapaCacheBlock*) GrapaMem::Create(sizeCalc);
-		if (pCache == NULL)
+		err = CommitLog();
+		pEnd = mLog.End();
+		if (!err && mLog.End() > GrapaFileLog::CHECKPOINTSIZE)
 		{
-			mCacheWidth = 0;
-			mCacheHeight = 0;
-			return((GrapaError)-1);
+			err = Checkpoint();
+			pEnd = 0;
 		}
-		mLocalyAllocated = true;
 	}
+	mCritical.LeaveCritical();
+	return(err);
+}
 
-	mCache = (GrapaCacheBlock*)pCache;
-	mFirstCache = (u64*) (((s8*)mCache) + sizeof(GrapaCacheBlock) * mCacheWidth*mCacheHeight);
-
-	ClearCache();
+// Runs outside the pool's lock, so committers on other threads can add their records meanwhile
+// and share the sync.
+GrapaError GrapaFileCache::SyncLog(u64 pEnd)
+{
+	return mLog.Sync(pEnd);
+}
 
-	return(0);
+GrapaError GrapaFileCache::Rollback()
+{
+	GrapaError err;
+	if (!mFile) return((GrapaError)-1);
+	mCritical.WaitCritical();
+	if (mTxn)
+		err = RollbackLog();
+	else
+		err = -1;
+	mCritical.LeaveCritical();
+	return(err);
 }
 
+// A log left by a database that did not close cleanly is replayed before the file is used.
 GrapaError GrapaFileCache::Open(const char *fileName, char mode)
 {
+	GrapaError err;
 	if (!mFile) return((GrapaError)-1);
-	return mFile->Open(fileName,mode);
+	mFlusher.Stop();
+	mCritical.WaitCritical();
+	if (mCacheCount)
+	{
+		FlushCache();
+		ClearCache();
+	}
+	mTxn = false;
+	mStats.recovered = 0;
+	err = mFile->Open(fileName,mode);
+	if (!err && mode != GrapaReadOnly)
+		err = GrapaFileLog::Recover(fileName, mFile, mStats.recovered);
+	if (!err && mode != GrapaReadOnly && mLogOn && mCacheCount)
+		err = mLog.Create(fileName);
+	mCritical.LeaveCritical();
+	if (!err && mode != GrapaReadOnly)
+		err = StartFlusher();
+	return(err);
 }
 
+// A transaction still open when the file closes is rolled back. The log is deleted once the
+// file holds everything in it.
 GrapaError GrapaFileCache::Close()
 {
-	Flush();
+	GrapaError err;
+	// The flusher syncs the file outside the lock, so it stops before the file can close.
+	mFlusher.Stop();
+	if (mFile)
+	{
+		mCritical.WaitCritical();
+		if (mTxn)
+			RollbackLog();
+		mCritical.LeaveCritical();
+	}
+	err = Flush();
 	if (!mFile) return((GrapaError)-1);
+	mCritical.WaitCritical();
+	if (!err)
+		err = Checkpoint();
+	if (mCacheCount)
+		ClearCache();
+	mLog.Close(err == 0);
+	mCritical.LeaveCritical();
 	return mFile->Close();
 }
 
 GrapaError GrapaFileCache::GetSize(u64& pSize)
 {
+	GrapaError err;
 	if (!mFile) return((GrapaError)-1);
-	return mFile->GetSize(pSize);
+	mCritical.WaitCritical();
+	if (mCacheCount)
+	{
+		err = LoadSize();
+		pSize = mFileSize;
+	}
+	else
+		err = mFile->GetSize(pSize);
+	mCritical.LeaveCritical();
+	return(err);
 }
 
 GrapaError GrapaFileCache::SetSize(u64 pSize)
 {
+	GrapaError err = 0;
 	if (!mFile) return((GrapaError)-1);
-	return mFile->SetSize(pSize);
+	mCritical.WaitCritical();
+	if (mLog.Opened())
+		err = Checkpoint();
+	if (!err)
+		err = SaveVersions(pSize, (u64)-1);
+	if (!err && mCacheCount)
+		err = TruncateCache(pSize);
+	if (!err)
+		err = GrapaFileLog::FileSetSize(mFile, pSize);
+	if (!err)
+		mDiskSize = pSize;
+	else
+		mSizeLoaded = false;
+	mCritical.LeaveCritical();
+	return(err);
 }
 
 GrapaError GrapaFileCache::Create(const char *fileName)
 {
+	GrapaError err;
 	if (!mFile) return((GrapaError)-1);
-	return mFile->Create(fileName);
+	mFlusher.Stop();
+	mCritical.WaitCritical();
+	if (mCacheCount)
+	{
+		FlushCache();
+		ClearCache();
+	}
+	mTxn = false;
+	err = mFile->Create(fileName);
+	if (!err && mLogOn && mCacheCount)
+		err = mLog.Create(fileName);
+	else if (!err)
+		GrapaFileLog::Remove(fileName);
+	mCritical.LeaveCritical();
+	if (!err)
+		err = StartFlusher();
+	return(err);
 }
 
 GrapaError GrapaFileCache::Delete(const char *fileName)
 {
 	if (!mFile) return((GrapaError)-1);
+	GrapaFileLog::Remove(fileName);
 	return mFile->Delete(fileName);
 }
 
 GrapaError GrapaFileCache::Flush()
 {
-	return FlushCache();
+	GrapaError err;
+	if (!mFile) return((GrapaError)-1);
+	mCritical.WaitCritical();
+	// With a log, a commit already makes the changes safe; the pages go back lazily.
+	if (mLog.Opened())
+		err = mTxn ? 0 : CommitLog();
+	else
+		err = FlushCache();
+	mCritical.LeaveCritical();
+	if (err) return(err);
+	return mFile->Flush();
 }
 
 GrapaError GrapaFileCache::Purge(u64 blockCount, u16 blockSize)
 {
-	GrapaError err;
+	GrapaError err = 0;
 	if (!mFile) return((GrapaError)-1);
-	err = mFile->Purge(blockCount,blockSize);
-	if (err) return(err);
-	return(0);
+	mCritical.WaitCritical();
+	if (mTxn)
+	{
+		// Purge runs as the file closes, with a block count that may include blocks from the
+		// transaction being rolled back, so the file keeps its size.
+		err = RollbackLog();
+		mCritical.LeaveCritical();
+		return(err);
+	}
+	if (mLog.Opened())
+		err = Checkpoint();
+	if (!err)
+		err = SaveVersions(blockCount * blockSize, (u64)-1);
+	if (!err && mCacheCount)
+		err = TruncateCache(blockCount * blockSize);
+	if (!err)
+		err = GrapaFileLog::FileSetSize(mFile, ((u64)blockCount) * blockSize);
+	if (!err)
+		mDiskSize = blockCount * blockSize;
+	else
+		mSizeLoaded = false;
+	mCritical.LeaveCritical();
+	return(err);
 }
 
 GrapaError GrapaFileCache::Write(u64 blockPos, u16 blockSize, u64 offset, u64 length, const void *value)
 {
-	return SetCache(blockPos, blockSize, offset, value, length, true);
+	GrapaError err;
+	if (!mFile) return((GrapaError)-1);
+	mCritical.WaitCritical();
+	err = SaveVersions(blockPos * blockSize + offset, length);
+	if (!err && mCacheCount)
+		err = SetCache(blockPos * blockSize + offset, value, length);
+	else if (!err)
+		err = mFile->Write(blockPos, blockSize, offset, length, value);
+	mCritical.LeaveCritical();
+	return(err);
 }
 
 GrapaError GrapaFileCache::Read(u64 blockPos, u16 blockSize, u64 offset, u64 length, void *value)
 {
-	return GetCache(blockPos, blockSize, offset, value, length);
+	GrapaError err;
+	if (!mFile) return((GrapaError)-1);
+	mCritical.WaitCritical();
+	if (mCacheCount)
+		err = GetCache(blockPos * blockSize + offset, value, length);
+	else
+		err = mFile->Read(blockPos, blockSize, offset, length, value);
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+// A snapshot sees the file as it stands now. Each one opens a new epoch, and a page written after
+// that first keeps its image from before the write, once for every snapshot that could read it.
+// During a transaction the pages it changed are still on disk as they were at Begin, so those
+// images come from the file, and the snapshot sees none of the transaction.
+GrapaError GrapaFileCache::OpenSnapshot(u64& pEpoch, u64& pSize)
+{
+	GrapaError err;
+	pEpoch = 0;
+	pSize = 0;
+	if (!mFile) return((GrapaError)-1);
+	mCritical.WaitCritical();
+	if (mCacheCount)
+	{
+		err = LoadSize();
+		pSize = mTxn ? mTxnSize : mFileSize;
+	}
+	else
+		err = mFile->GetSize(pSize);
+	if (!err)
+	{
+		mEpoch++;
+		if (mTxn)
+		{
+			std::vector<u64> pages;
+			for (u64 i = 0; i < mCacheCount; i++)
+				if (mCache[i].inuse && mCache[i].hi > mCache[i].lo)
+					pages.push_back(mCache[i].key);
+			for (std::unordered_map<u64, u64>::iterator spilled = mSpill.begin(); spilled != mSpill.end(); spilled++)
+				pages.push_back(spilled->first);
+			for (size_t i = 0; !err && i < pages.size(); i++)
+			{
+				std::vector<u8> image(GrapaFileCache::BLOCKPAGESIZE);
+				err = ReadDiskPage(pages[i], mDiskSize, image.data());
+				if (!err)
+					mVersions[pages[i]][mEpoch].swap(image);
+			}
+		}
+	}
+	if (!err)
+	{
+		mSnapshots[mEpoch]++;
+		pEpoch = mEpoch;
+	}
+	else
+		ReclaimVersions();
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+// Page images no open snapshot can read are dropped as a snapshot closes.
+void GrapaFileCache::CloseSnapshot(u64 pEpoch)
+{
+	mCritical.WaitCritical();
+	std::map<u64, u64>::iterator s = mSnapshots.find(pEpoch);
+	if (s != mSnapshots.end() && --s->second == 0)
+		mSnapshots.erase(s);
+	ReclaimVersions();
+	mCritical.LeaveCritical();
+}
+
+// Each page comes from its oldest image saved at or after the snapshot's epoch. A page with none
+// has not changed since the snapshot opened, and is read as it stands. The lock is taken a page at
+// a time, so writers get in between the pages of a long read. A page they change keeps its image
+// for this snapshot, so the rest of the read still sees the file as of the epoch.
+GrapaError GrapaFileCache::ReadSnapshot(u64 pEpoch, u64 pSize, u64 pos, u64 length, void *value)
+{
+	GrapaError err = 0;
+	if (!mFile) return((GrapaError)-1);
+	if (length && pos + length > pSize)
+		return((GrapaError)-1);
+	while (length && !err)
+	{
+		u64 blockPos = pos / GrapaFileCache::BLOCKPAGESIZE;
+		u64 offset = pos % GrapaFileCache::BLOCKPAGESIZE;
+		u64 valueLength = (length < (GrapaFileCache::BLOCKPAGESIZE - offset)) ? length : GrapaFileCache::BLOCKPAGESIZE - offset;
+		const u8* image = NULL;
+		mCritical.WaitCritical();
+		std::unordered_map<u64, std::map<u64, std::vector<u8> > >::iterator found = mVersions.find(blockPos);
+		if (found != mVersions.end())
+		{
+			std::map<u64, std::vector<u8> >::iterator version = found->second.lower_bound(pEpoch);
+			if (version != found->second.end())
+				image = version->second.data();
+		}
+		if (image)
+			GrapaMem::MemCopy(value, &image[offset], valueLength);
+		else if (mCacheCount)
+			err = GetCache(pos, value, valueLength);
+		else
+			err = mFile->Read(0, 0, pos, valueLength, value);
+		mCritical.LeaveCritical();
+		value = &((s8*)value)[valueLength];
+		pos += valueLength;
+		length -= valueLength;
+	}
+	return(err);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 void GrapaFileCache::FreeCache()
 {
-	Close();
-	if (mLocalyAllocated && mCache) GrapaMem::Delete(mCache);
-	mLocalyAllocated = false;
-	mCacheWidth = 0;
-	mCacheHeight = 0;
+	GrapaMem::Delete(mCache);
+	GrapaMem::Delete(mCacheData);
+	GrapaMem::Delete(mCacheFree);
 	mCache = NULL;
-	mFirstCache = NULL;
+	mCacheData = NULL;
+	mCacheFree = NULL;
+	mCacheFreeCount = 0;
+	mCacheCount = 0;
+	mCacheHand = 0;
+	mCacheMap.clear();
+	mPending = 0;
+	mSpill.clear();
+	mSizeLoaded = false;
 }
 
 GrapaError GrapaFileCache::ClearCache()
 {
-	u64 width,height;
-	if (mCache == 0LL) return(-1);
-	for (width=0;width<mCacheWidth;width++)
+	if (mCache == NULL) return(-1);
+	for (u64 i = 0; i < mCacheCount; i++)
 	{
-		GrapaCacheBlock *cache = &mCache[width*mCacheHeight];
-		for (height=0;height<mCacheHeight;height++)
-		{
-			cache[height].key = 0;
-			cache[height].dirty = false;
-			cache[height].inuse = false;
-			cache[height].next = height + 1;
-			cache[height].prev = height - 1;
-		}
-		cache[mCacheHeight-1].next = 0;
-		cache[0].prev = mCacheHeight-1;
-		mFirstCache[width] = 0;
+		mCache[i].key = 0;
+		mCache[i].pin = 0;
+		mCache[i].dirty = false;
+		mCache[i].inuse = false;
+		mCache[i].used = false;
+		mCache[i].lo = 0;
+		mCache[i].hi = 0;
+		mCache[i].logged = 0;
+		mCache[i].value = &mCacheData[i * GrapaFileCache::BLOCKPAGESIZE];
+		mCacheFree[i] = mCacheCount - 1 - i;
 	}
+	mCacheFreeCount = mCacheCount;
+	mCacheHand = 0;
+	mCacheMap.clear();
+	mPending = 0;
+	mSpill.clear();
+	mSizeLoaded = false;
 	return(0);
 }
 
-u64 GrapaFileCache::FindCache(GrapaCacheBlock *cache, u64 key, u64 first)
+// The cache keeps two sizes. mFileSize includes dirty pages not yet written, and is what
+// GetSize reports. mDiskSize is what the file holds, and bounds what a page load may read.
+GrapaError GrapaFileCache::LoadSize()
 {
-	u64 ptr = first;
-	do
-	{
-		if (!cache[ptr].inuse)
-			break;
-		if (cache[ptr].key == key)
-			return ptr;
-		ptr = cache[ptr].next;
-	} while (ptr != first);
-	return -1;
+	GrapaError err;
+	if (mSizeLoaded) return(0);
+	err = mFile->GetSize(mDiskSize);
+	if (err) return(err);
+	mFileSize = mDiskSize;
+	mSizeLoaded = true;
+	return(0);
 }
 
-u64 GrapaFileCache::FindCacheFree(GrapaCacheBlock *cache, u64 first)
+// CLOCK: free frames go first, then the hand sweeps, clearing reference bits and taking the
+// first unpinned frame it has already cleared. A dirty victim writes back every dirty page, or
+// with the flusher running, only itself, after two sweeps have found no clean page. Pages with
+// changes not yet logged are passed over for two sweeps, then spilled to the log. With the
+// flusher running, a dirty page whose log is not yet synced is passed over for one more sweep,
+// so a page the flusher has already synced goes back without a sync. Only when every page still
+// waits on the log is it synced here, under the lock; the lock is never let go mid-write.
+GrapaError GrapaFileCache::FindCacheFree(u64& frame)
 {
-	u64 ptr = first;
-	do
+	GrapaError err;
+	if (mCacheFreeCount)
 	{
-		ptr = cache[ptr].prev;
-		if (!cache[ptr].inuse || !cache[ptr].dirty)
-			return ptr;
-	} while (ptr != first);
-	return -1;
+		frame = mCacheFree[--mCacheFreeCount];
+		return(0);
+	}
+	for (u64 sweep = 0; sweep < 4 * mCacheCount; sweep++)
+	{
+		GrapaCacheBlock& block = mCache[mCacheHand];
+		frame = mCacheHand;
+		mCacheHand = (mCacheHand + 1) % mCacheCount;
+		if (block.pin)
+			continue;
+		if (block.used)
+		{
+			block.used = false;
+			continue;
+		}
+		if (block.dirty && mFlushRate && sweep < 2 * mCacheCount)
+			continue;
+		if (block.hi > block.lo)
+		{
+			if (sweep < 2 * mCacheCount)
+				continue;
+			err = Spill(frame);
+			if (err) return(err);
+		}
+		if (block.dirty && mFlushRate && mLog.Opened() && !mLog.Synced(block.logged))
+		{
+			if (sweep < 3 * mCacheCount)
+				continue;
+			err = mLog.Sync(block.logged);
+			if (err) return(err);
+		}
+		if (block.dirty)
+		{
+			mStats.stalls++;
+			err = mFlushRate ? WriteRun(&frame, 1) : FlushCache();
+			if (err) return(err);
+		}
+		mCacheMap.erase(block.key);
+		block.inuse = false;
+		mStats.evictions++;
+		return(0);
+	}
+	return((GrapaError)-1);
 }
 
-GrapaError GrapaFileCache::GetCacheBlock(u64 blockPos, void* value)
+GrapaError GrapaFileCache::GetCacheBlock(u64 blockPos, bool load, u64& frame)
 {
 	GrapaError err;
 
-	if (mCacheWidth)
+	std::unordered_map<u64, u64>::iterator found = mCacheMap.find(blockPos);
+	if (found != mCacheMap.end())
 	{
-		u64 width = blockPos%mCacheWidth;
-		u64 first = mFirstCache[width];
-
-		GrapaCacheBlock *cache = &mCache[width*mCacheHeight];
+		frame = found->second;
+		mCache[frame].used = true;
+		mStats.hits++;
+		return(0);
+	}
+	mStats.misses++;
 
-		u64 ptr = FindCache(cache,blockPos,first);
+	err = FindCacheFree(frame);
+	if (err) return(err);
 
-		if (ptr != -1)
+	GrapaCacheBlock& block = mCache[frame];
+	std::unordered_map<u64, u64>::iterator spilled = mSpill.find(blockPos);
+	bool spill = spilled != mSpill.end();
+	if (spill && load)
+	{
+		err = mLog.Read(spilled->second, GrapaFileCache::BLOCKPAGESIZE, block.value);
+		if (err)
 		{
-			GrapaMem::MemCopy(value,&cache[ptr].value,GrapaFileCache::BLOCKPAGESIZE);
-			if (ptr != first)
+			mCacheFree[mCacheFreeCount++] = frame;
+			return(err);
+		}
+	}
+	else if (load)
+	{
+		u64 pagePos = blockPos * GrapaFileCache::BLOCKPAGESIZE;
+		u64 diskLength = 0;
+		if (mDiskSize > pagePos)
+			diskLength = (mDiskSize - pagePos < GrapaFileCache::BLOCKPAGESIZE) ? mDiskSize - pagePos : GrapaFileCache::BLOCKPAGESIZE;
+		if (diskLength)
+		{
+			err = mFile->Read(blockPos, GrapaFileCache::BLOCKPAGESIZE, 0, diskLength, block.value);
+			if (err)
 			{
-				mFirstCache[width] = ptr;
-				cache[cache[ptr].prev].next = cache[ptr].next;
-				cache[cache[ptr].next].prev = cache[ptr].prev;
-				cache[ptr].prev = cache[first].prev;
-				cache[ptr].next = first;
-				cache[cache[first].prev].next = ptr;
-				cache[first].prev = ptr;
+				mCacheFree[mCacheFreeCount++] = frame;
+				return(err);
 			}
-			return(0);
 		}
+		if (diskLength < GrapaFileCache::BLOCKPAGESIZE)
+			memset(&block.value[diskLength], 0, GrapaFileCache::BLOCKPAGESIZE - diskLength);
 	}
 
-	if (!mFile) return((GrapaError)-1);
+	block.key = blockPos;
+	block.dirty = false;
+	block.inuse = true;
+	block.used = true;
+	block.lo = 0;
+	block.hi = 0;
+	block.logged = 0;
+	// A spilled page comes back as changed in full; it is logged again when it commits.
+	if (spill)
+	{
+		mSpill.erase(spilled);
+		block.dirty = true;
+		block.hi = GrapaFileCache::BLOCKPAGESIZE;
+		mPending++;
+	}
+	// The first page holds the file header, which every tree operation reads.
+	block.pin = blockPos == 0 ? 1 : 0;
+	mCacheMap[blockPos] = frame;
 
-	err = mFile->Read(blockPos,GrapaFileCache::BLOCKPAGESIZE,0,GrapaFileCache::BLOCKPAGESIZE,value);
+	return(0);
+}
+
+GrapaError GrapaFileCache::GetCache(u64 pos, void* value, u64 length)
+{
+	GrapaError err;
+	u64 frame;
+
+	err = LoadSize();
 	if (err) return(err);
+	if (length && pos + length > mFileSize)
+		return((GrapaError)-1);
 
-	err = SetCacheBlock(blockPos,value,false);
-	//if (err) return(err);
+	while (length)
+	{
+		u64 offset = pos % GrapaFileCache::BLOCKPAGESIZE;
+		u64 valueLength = (length < (GrapaFileCache::BLOCKPAGESIZE - offset)) ? length : GrapaFileCache::BLOCKPAGESIZE - offset;
+		err = GetCacheBlock(pos / GrapaFileCache::BLOCKPAGESIZE, true, frame);
+		if (err) return(err);
+		GrapaMem::MemCopy(value, &mCache[frame].value[offset], valueLength);
+		value = &((s8*)value)[valueLength];
+		pos += valueLength;
+		length -= valueLength;
+	}
 
 	return(0);
 }
 
-GrapaError GrapaFileCache::SetCacheBlock(u64 blockPos, const void* value, bool dirty)
+GrapaError GrapaFileCache::SetCache(u64 pos, const void* value, u64 length)
 {
-	GrapaError err = 0;
+	GrapaError err;
+	u64 frame;
+
+	err = LoadSize();
+	if (err) return(err);
 
-	if (!mCacheWidth)
+	while (length)
 	{
-		if (dirty)
+		u64 offset = pos % GrapaFileCache::BLOCKPAGESIZE;
+		u64 valueLength = (length < (GrapaFileCache::BLOCKPAGESIZE - offset)) ? length : GrapaFileCache::BLOCKPAGESIZE - offset;
+		err = GetCacheBlock(pos / GrapaFileCache::BLOCKPAGESIZE, valueLength != GrapaFileCache::BLOCKPAGESIZE, frame);
+		if (err) return(err);
+		GrapaMem::MemCopy(&mCache[frame].value[offset], value, valueLength);
+		mCache[frame].dirty = true;
+		if (mLog.Opened())
 		{
-			if (mFile == NULL) return((GrapaError)-1);
-			err = mFile->Write(blockPos,GrapaFileCache::BLOCKPAGESIZE,0,GrapaFileCache::BLOCKPAGESIZE,value);
-			if (err) return(err);
-			return(0);
+			GrapaCacheBlock& block = mCache[frame];
+			if (block.hi <= block.lo)
+			{
+				block.lo = (u32)offset;
+				block.hi = (u32)(offset + valueLength);
+				mPending++;
+			}
+			else
+			{
+				if (offset < block.lo) block.lo = (u32)offset;
+				if (offset + valueLength > block.hi) block.hi = (u32)(offset + valueLength);
+			}
 		}
+		value = &((s8*)value)[valueLength];
+		pos += valueLength;
+		length -= valueLength;
+		if (pos > mFileSize)
+			mFileSize = pos;
 	}
 
-	if (!mCacheWidth) return(0);
-
-	u64 width = blockPos%mCacheWidth;
-	u64 first = mFirstCache[width];
+	return(0);
+}
 
-	GrapaCacheBlock *cache = &mCache[width*mCacheHeight];
+// Drops the pages past pSize and zeroes the tail of the page it ends in, so a later extension
+// reads zeros as the file would.
+GrapaError GrapaFileCache::TruncateCache(u64 pSize)
+{
+	GrapaError err;
 
-	u64 ptr = FindCache(cache,blockPos,first);
+	err = LoadSize();
+	if (err) return(err);
 
-	if (ptr == -1)
+	for (u64 i = 0; i < mCacheCount; i++)
 	{
-		ptr = FindCacheFree(cache,first);
+		GrapaCacheBlock& block = mCache[i];
+		if (!block.inuse)
+			continue;
+		u64 pagePos = block.key * GrapaFileCache::BLOCKPAGESIZE;
+		if (pagePos >= pSize)
+		{
+			mCacheMap.erase(block.key);
+			block.inuse = false;
+			block.dirty = false;
+			block.pin = 0;
+			mCacheFree[mCacheFreeCount++] = i;
+		}
+		else if (pagePos + GrapaFileCache::BLOCKPAGESIZE > pSize)
+			memset(&block.value[pSize - pagePos], 0, (size_t)(pagePos + GrapaFileCache::BLOCKPAGESIZE - pSize));
 	}
+	if (mFileSize > pSize)
+		mFileSize = pSize;
 
-	if (ptr != -1)
+	err = FlushCache();
+	if (err) return(err);
+
+	mFileSize = pSize;
+	return(0);
+}
+
+GrapaError GrapaFileCache::WriteRun(u64* frames, u64 count)
+{
+	GrapaError err;
+	u64 blockPos = mCache[frames[0]].key;
+	u64 pagePos = blockPos * GrapaFileCache::BLOCKPAGESIZE;
+	u64 length = count * GrapaFileCache::BLOCKPAGESIZE;
+
+	if (pagePos + length > mFileSize)
+		length = mFileSize > pagePos ? mFileSize - pagePos : 0;
+
+	if (length)
 	{
-		if (ptr != first)
+		// The frames are scattered through the pool, so they go out as one gathered write.
+		const void* pages[GrapaFileCache::MAX_BATCH];
+		u64 lengths[GrapaFileCache::MAX_BATCH];
+		u64 remaining = length;
+		for (u64 i = 0; i < count; i++)
 		{
-			cache[cache[ptr].prev].next = cache[ptr].next;
-			cache[cache[ptr].next].prev = cache[ptr].prev;
-			cache[ptr].prev = cache[first].prev;
-			cache[ptr].next = first;
-			cache[cache[first].prev].next = ptr;
-			cache[first].prev = ptr;
-			first = mFirstCache[width] = ptr;
+			pages[i] = mCache[frames[i]].value;
+			lengths[i] = remaining < GrapaFileCache::BLOCKPAGESIZE ? remaining : GrapaFileCache::BLOCKPAGESIZE;
+			remaining -= lengths[i];
 		}
-		if (cache[first].dirty)
-			dirty = true;
+		err = GrapaFileLog::FileWrite(mFile, pagePos, count, pages, lengths);
 	}
 	else
+		err = 0;
+	if (err) return(err);
+
+	for (u64 i = 0; i < count; i++)
+		mCache[frames[i]].dirty = false;
+	if (length)
+	{
+		mStats.writebacks += count;
+		mStats.writes++;
+	}
+	if (pagePos + length > mDiskSize)
+		mDiskSize = pagePos + length;
+	return(0);
+}
+
+GrapaError GrapaFileCache::FlushCache()
+{
+	GrapaError err;
+	std::vector<u64> dirty;
+
+	if (!mFile)
+		return((GrapaError)-1);
+
+	for (u64 i = 0; i < mCacheCount; i++)
+		if (mCache[i].inuse && mCache[i].dirty && mCache[i].hi <= mCache[i].lo)
+			dirty.push_back(i);
+	if (dirty.empty())
+		return(0);
+
+	// A page reaches the file only after the log records describing it are on disk.
+	if (mLog.Opened())
+	{
+		err = mLog.Sync(mLog.End());
+		if (err) return(err);
+	}
+
+	std::sort(dirty.begin(), dirty.end(), [this](u64 a, u64 b) { return mCache[a].key < mCache[b].key; });
+
+	u64 first = 0;
+	for (u64 i = 1; i <= dirty.size(); i++)
 	{
-		first = mFirstCache[width] = cache[first].prev;
-		if (cache[first].inuse && cache[first].dirty)
+		if (i == dirty.size() || i - first == GrapaFileCache::MAX_BATCH || mCache[dirty[i]].key != mCache[dirty[i - 1]].key + 1)
 		{
-			if (mFile == NULL) return((GrapaError)-1);
-			err = mFile->Write(cache[first].key,GrapaFileCache::BLOCKPAGESIZE,0,GrapaFileCache::BLOCKPAGESIZE,&cache[first].value);
+			err = WriteRun(&dirty[first], i - first);
 			if (err) return(err);
-			cache[first].dirty = false;
+			first = i;
 		}
 	}
+	return(0);
+}
 
-	cache[first].key = blockPos;
-	GrapaMem::MemCopy(&cache[first].value,value,GrapaFileCache::BLOCKPAGESIZE);
-	cache[first].dirty = dirty;
-	cache[first].inuse = true;
-
+// Logs the whole page as part of the current commit and frees its frame. Until that commit, a
+// read of the page takes it from the log; after it, the page is copied to the file.
+GrapaError GrapaFileCache::Spill(u64 frame)
+{
+	GrapaError err;
+	GrapaCacheBlock& block = mCache[frame];
+	GrapaFileLogEntry entry;
+	entry.kind = GrapaFileLog::PAGE_RECORD;
+	entry.length = GrapaFileCache::BLOCKPAGESIZE;
+	entry.pos = block.key * GrapaFileCache::BLOCKPAGESIZE;
+	entry.data = block.value;
+	err = mLog.Append(1, &entry);
+	if (err) return(err);
+	mSpill[block.key] = entry.at;
+	block.lo = 0;
+	block.hi = 0;
+	block.dirty = false;
+	mPending--;
 	return(0);
 }
 
-GrapaError GrapaFileCache::GetCache(u64 blockPosX, u16 blockSizeX, u64 offsetX, void* value, u64 length)
+// Logs every change made since the last commit, then a commit record holding the file size, in
+// one gathered write. The pages stay dirty and are written back as usual, after a log sync.
+GrapaError GrapaFileCache::CommitLog()
 {
-	u8 valueBlock[GrapaFileCache::BLOCKPAGESIZE];
-	u64 valueLength;
-	u64 blockPos = (blockPosX * blockSizeX) / GrapaFileCache::BLOCKPAGESIZE;
-	u64 offset = offsetX + (blockPosX * blockSizeX) % GrapaFileCache::BLOCKPAGESIZE;
+	GrapaError err;
+	if (!mLog.Opened()) return(0);
+	if (mPending == 0 && mSpill.empty() && !mTxn) return(0);
+	err = LoadSize();
+	if (err) return(err);
 
-	if (offset > GrapaFileCache::BLOCKPAGESIZE)
+	std::vector<GrapaFileLogEntry> entries;
+	entries.reserve(mPending + 1);
+	for (u64 i = 0; i < mCacheCount; i++)
 	{
-		u64 jumpBlock = offset/GrapaFileCache::BLOCKPAGESIZE;
-		blockPos += jumpBlock;
-		offset -= jumpBlock*GrapaFileCache::BLOCKPAGESIZE;
+		GrapaCacheBlock& block = mCache[i];
+		if (!block.inuse || block.hi <= block.lo)
+			continue;
+		GrapaFileLogEntry entry;
+		entry.kind = GrapaFileLog::PAGE_RECORD;
+		entry.length = block.hi - block.lo;
+		entry.pos = block.key * GrapaFileCache::BLOCKPAGESIZE + block.lo;
+		entry.data = &block.value[block.lo];
+		entries.push_back(entry);
 	}
+	GrapaFileLogEntry commit;
+	commit.kind = GrapaFileLog::COMMIT_RECORD;
+	commit.length = 0;
+	commit.pos = mFileSize;
+	commit.data = NULL;
+	entries.push_back(commit);
+	err = mLog.Append(entries.size(), entries.data());
+	if (err) return(err);
 
-	if (offset)
+	for (u64 i = 0; i < mCacheCount; i++)
 	{
-		GetCacheBlock(blockPos,&valueBlock);
-		//above will error if reading past the end of the file
-		valueLength = (length < (GrapaFileCache::BLOCKPAGESIZE-offset)) ? length : GrapaFileCache::BLOCKPAGESIZE-offset;
-		GrapaMem::MemCopy(value,&valueBlock[offset],valueLength);
-		value = &((s8*)value)[valueLength];
-		length -= valueLength;
-		blockPos++;
+		if (mCache[i].hi > mCache[i].lo)
+			mCache[i].logged = mLog.End();
+		mCache[i].lo = 0;
+		mCache[i].hi = 0;
 	}
+	mPending = 0;
+	mTxn = false;
+	mStats.commits++;
 
-	while (length)
+	if (mSpill.empty())
+		return(0);
+	err = mLog.Sync(mLog.End());
+	if (err) return(err);
+	std::vector<u8> page(GrapaFileCache::BLOCKPAGESIZE);
+	for (std::unordered_map<u64, u64>::iterator spilled = mSpill.begin(); spilled != mSpill.end(); spilled++)
 	{
-		if (length >= GrapaFileCache::BLOCKPAGESIZE)
-		{
-			GetCacheBlock(blockPos,value);
-			value = &((s8*)value)[GrapaFileCache::BLOCKPAGESIZE];
-			length -= GrapaFileCache::BLOCKPAGESIZE;
-		}
-		else
+		u64 pagePos = spilled->first * GrapaFileCache::BLOCKPAGESIZE;
+		u64 length = 0;
+		if (mFileSize > pagePos)
+			length = (mFileSize - pagePos < GrapaFileCache::BLOCKPAGESIZE) ? mFileSize - pagePos : GrapaFileCache::BLOCKPAGESIZE;
+		if (length == 0)
+			continue;
+		err = mLog.Read(spilled->second, length, page.data());
+		const void* b = page.data();
+		if (!err)
+			err = GrapaFileLog::FileWrite(mFile, pagePos, 1, &b, &length);
+		if (err) return(err);
+		if (pagePos + length > mDiskSize)
+			mDiskSize = pagePos + length;
+	}
+	mSpill.clear();
+	return(0);
+}
+
+// Drops every change made since Begin. The pages holding them leave the pool and are read again
+// from the file, which Begin brought up to date, and the log is cut back to where it was.
+GrapaError GrapaFileCache::RollbackLog()
+{
+	for (u64 i = 0; i < mCacheCount; i++)
+	{
+		GrapaCacheBlock& block = mCache[i];
+		if (!block.inuse || block.hi <= block.lo)
+			continue;
+		mCacheMap.erase(block.key);
+		block.inuse = false;
+		block.dirty = false;
+		block.used = false;
+		block.pin = 0;
+		block.lo = 0;
+		block.hi = 0;
+		mCacheFree[mCacheFreeCount++] = i;
+	}
+	mPending = 0;
+	mSpill.clear();
+	mFileSize = mTxnSize;
+	mTxn = false;
+	return mLog.Truncate(mTxnEnd, mTxnSum);
+}
+
+// Brings the file up to date with the log and syncs it, then empties the log.
+GrapaError GrapaFileCache::Checkpoint()
+{
+	GrapaError err;
+	if (!mLog.Opened()) return(0);
+	if (mTxn) return((GrapaError)-1);
+	err = CommitLog();
+	if (err) return(err);
+	if (mLog.End() <= GrapaFileLog::HEADERSIZE)
+		return(0);
+	err = FlushCache();
+	if (!err)
+		err = GrapaFileLog::FileSync(mFile);
+	if (!err)
+		err = mLog.Reset();
+	if (!err)
+		mStats.checkpoints++;
+	return(err);
+}
+
+GrapaError GrapaFileCache::StartFlusher()
+{
+	if (mFlushRate == 0 || mFlusher.Started() || !Opened())
+		return(0);
+	return mFlusher.Start(false);
+}
+
+// One round of the flusher. It earns a tenth of a second at its rate and spends it on dirty pages
+// in file order, from where the last round stopped and wrapping at the end. Each run of adjacent
+// pages is one write, with the lock let go between runs, so a writer waits behind one run at
+// most. A page goes back only once the log holding its last commit is synced, and that sync is
+// done outside the lock. When the pool is clean and no commit has come in since the last round,
+// the file is synced and the log emptied, so the checkpoint seldom falls to a writer.
+void GrapaFileCache::FlushRound()
+{
+	GrapaError err = 0;
+	u64 now = GrapaFileCacheNow();
+	u64 end = 0;
+	bool log, work = false, clean = true, quiet;
+
+	mCritical.WaitCritical();
+	if (mFile == NULL || !mFile->Opened() || mCacheCount == 0)
+	{
+		mCritical.LeaveCritical();
+		return;
+	}
+	u64 most = mFlushRate > GrapaFileCache::BLOCKPAGESIZE ? mFlushRate : GrapaFileCache::BLOCKPAGESIZE;
+	mFlushCredit += mFlushRate / 10;
+	if (mFlushCredit > most)
+		mFlushCredit = most;
+	log = mLog.Opened();
+	if (log)
+		end = mLog.End();
+	quiet = end == mFlushEnd;
+	mFlushEnd = end;
+	for (u64 i = 0; i < mCacheCount && !work; i++)
+		if (mCache[i].inuse && mCache[i].dirty && mCache[i].hi <= mCache[i].lo)
+			work = true;
+	mCritical.LeaveCritical();
+
+	if (work && log)
+		err = mLog.Sync(end);
+
+	while (!err && work && !mFlusher.mStop)
+	{
+		std::vector<u64> dirty;
+		u64 count = 0;
+		mCritical.WaitCritical();
+		for (u64 i = 0; i < mCacheCount && mFlushCredit >= GrapaFileCache::BLOCKPAGESIZE; i++)
+			if (mCache[i].inuse && mCache[i].dirty && mCache[i].hi <= mCache[i].lo && (!log || mCache[i].logged <= end))
+				dirty.push_back(i);
+		if (!dirty.empty())
 		{
-			GetCacheBlock(blockPos,&valueBlock);
-			GrapaMem::MemCopy(value,&valueBlock,length);
-			value = &((s8*)value)[length];
-			length = 0;
+			std::sort(dirty.begin(), dirty.end(), [this](u64 a, u64 b) { return mCache[a].key < mCache[b].key; });
+			u64 first = 0;
+			while (first < dirty.size() && mCache[dirty[first]].key < mFlushNext)
+				first++;
+			if (first == dirty.size())
+				first = 0;
+			u64 room = mFlushCredit / GrapaFileCache::BLOCKPAGESIZE;
+			if (room > GrapaFileCache::MAX_BATCH)
+				room = GrapaFileCache::MAX_BATCH;
+			count = 1;
+			while (count < room && first + count < dirty.size() && mCache[dirty[first + count]].key == mCache[dirty[first + count - 1]].key + 1)
+				count++;
+			mFlushNext = mCache[dirty[first + count - 1]].key + 1;
+			err = WriteRun(&dirty[first], count);
+			if (!err)
+			{
+				mFlushCredit -= count * GrapaFileCache::BLOCKPAGESIZE;
+				mFlushBytes += count * GrapaFileCache::BLOCKPAGESIZE;
+				mStats.flushed += count;
+			}
 		}
-		blockPos++;
+		mCritical.LeaveCritical();
+		if (count == 0)
+			break;
+	}
+
+	mCritical.WaitCritical();
+	if (now - mFlushTime >= 1000)
+	{
+		mStats.throughput = mFlushBytes * 1000 / (now - mFlushTime);
+		mFlushBytes = 0;
+		mFlushTime = now;
+	}
+	for (u64 i = 0; i < mCacheCount && clean; i++)
+		if (mCache[i].inuse && mCache[i].dirty)
+			clean = false;
+	bool idle = !err && log && quiet && clean && !mTxn && mPending == 0 && mSpill.empty() && mLog.End() == end && end > GrapaFileLog::HEADERSIZE;
+	mCritical.LeaveCritical();
+	if (!idle)
+		return;
+
+	// Everything up to end is in the file; once that is synced, those records are not needed.
+	if (GrapaFileLog::FileSync(mFile))
+		return;
+	mCritical.WaitCritical();
+	if (!mTxn && mSpill.empty() && mLog.End() == end)
+	{
+		if (mLog.Reset() == 0)
+			mStats.checkpoints++;
+		mFlushEnd = mLog.End();
 	}
+	mCritical.LeaveCritical();
+}
 
+// The page as it stands, from the pool or the file, and zero past the end of the file.
+GrapaError GrapaFileCache::ReadPage(u64 blockPos, u8* value)
+{
+	GrapaError err;
+	u64 frame, size;
+	if (mCacheCount == 0)
+	{
+		err = mFile->GetSize(size);
+		if (err) return(err);
+		return ReadDiskPage(blockPos, size, value);
+	}
+	err = LoadSize();
+	if (err) return(err);
+	if (blockPos * GrapaFileCache::BLOCKPAGESIZE >= mFileSize)
+	{
+		memset(value, 0, GrapaFileCache::BLOCKPAGESIZE);
+		return(0);
+	}
+	err = GetCacheBlock(blockPos, true, frame);
+	if (err) return(err);
+	GrapaMem::MemCopy(value, mCache[frame].value, GrapaFileCache::BLOCKPAGESIZE);
 	return(0);
 }
 
-GrapaError GrapaFileCache::SetCache(u64 blockPosX, u16 blockSizeX, u64 offsetX, const void* value, u64 length, bool dirty)
+// The page as the file holds it, given the file's size.
+GrapaError GrapaFileCache::ReadDiskPage(u64 blockPos, u64 pSize, u8* value)
 {
-	u8 valueBlock[GrapaFileCache::BLOCKPAGESIZE];
-	u64 valueLength;
-	u64 blockPos = (blockPosX * blockSizeX) / GrapaFileCache::BLOCKPAGESIZE;
-	u64 offset = offsetX + (blockPosX * blockSizeX) % GrapaFileCache::BLOCKPAGESIZE;
+	GrapaError err = 0;
+	u64 pagePos = blockPos * GrapaFileCache::BLOCKPAGESIZE;
+	u64 length = 0;
+	if (pSize > pagePos)
+		length = (pSize - pagePos < GrapaFileCache::BLOCKPAGESIZE) ? pSize - pagePos : GrapaFileCache::BLOCKPAGESIZE;
+	if (length)
+		err = mFile->Read(blockPos, GrapaFileCache::BLOCKPAGESIZE, 0, length, value);
+	if (length < GrapaFileCache::BLOCKPAGESIZE)
+		memset(&value[length], 0, (size_t)(GrapaFileCache::BLOCKPAGESIZE - length));
+	return(err);
+}
 
-	if (offset > GrapaFileCache::BLOCKPAGESIZE)
+// Saves the images of the pages in [pos, pos + length) before a write or a truncation changes
+// them. A page needs one when some open snapshot has no image of it saved since it opened, and
+// that is so exactly when the newest snapshot is newer than the page's newest image. An image is
+// read in full before it goes into mVersions, so a snapshot never finds one half made.
+GrapaError GrapaFileCache::SaveVersions(u64 pos, u64 length)
+{
+	GrapaError err;
+	u64 size;
+	if (mSnapshots.empty() || length == 0)
+		return(0);
+	u64 newest = mSnapshots.rbegin()->first;
+	if (mCacheCount)
 	{
-		u64 jumpBlock = offset/GrapaFileCache::BLOCKPAGESIZE;
-		blockPos += jumpBlock;
-		offset -= jumpBlock*GrapaFileCache::BLOCKPAGESIZE;
+		err = LoadSize();
+		size = mFileSize;
 	}
-
-	if (offset)
+	else
+		err = mFile->GetSize(size);
+	if (err) return(err);
+	// Bytes past the end of the file are past the end of every snapshot.
+	if (pos >= size)
+		return(0);
+	u64 end = (length < size - pos) ? pos + length : size;
+	for (u64 blockPos = pos / GrapaFileCache::BLOCKPAGESIZE; blockPos * GrapaFileCache::BLOCKPAGESIZE < end; blockPos++)
 	{
-		GetCacheBlock(blockPos,&valueBlock);
-		//above will error if reading past the end of the file
-		valueLength = (length < (GrapaFileCache::BLOCKPAGESIZE-offset)) ? length : GrapaFileCache::BLOCKPAGESIZE-offset;
-		GrapaMem::MemCopy(&valueBlock[offset],value,valueLength);
-		value = &((s8*)value)[valueLength];
-		length -= valueLength;
-		SetCacheBlock(blockPos,&valueBlock,dirty);
-		blockPos++;
+		std::unordered_map<u64, std::map<u64, std::vector<u8> > >::iterator found = mVersions.find(blockPos);
+		if (found != mVersions.end() && !found->second.empty() && found->second.rbegin()->first >= newest)
+			continue;
+		std::vector<u8> image(GrapaFileCache::BLOCKPAGESIZE);
+		err = ReadPage(blockPos, image.data());
+		if (err) return(err);
+		mVersions[blockPos][mEpoch].swap(image);
 	}
+	return(0);
+}
 
-	while (length)
+// An image serves the snapshots opened after the page's previous image was saved, up to and
+// including its own epoch. One with no such snapshot open is dropped.
+void GrapaFileCache::ReclaimVersions()
+{
+	if (mSnapshots.empty())
+	{
+		mVersions.clear();
+		return;
+	}
+	std::unordered_map<u64, std::map<u64, std::vector<u8> > >::iterator page = mVersions.begin();
+	while (page != mVersions.end())
 	{
-		if (length >= GrapaFileCache::BLOCKPAGESIZE)
+		u64 previous = 0;
+		std::map<u64, std::vector<u8> >::iterator version = page->second.begin();
+		while (version != page->second.end())
 		{
-			SetCacheBlock(blockPos,value,dirty);
-			value = &((s8*)value)[GrapaFileCache::BLOCKPAGESIZE];
-			length -= GrapaFileCache::BLOCKPAGESIZE;
+			std::map<u64, u64>::iterator s = mSnapshots.upper_bound(previous);
+			previous = version->first;
+			if (s == mSnapshots.end() || s->first > version->first)
+				version = page->second.erase(version);
+			else
+				version++;
 		}
+		if (page->second.empty())
+			page = mVersions.erase(page);
 		else
-		{
-			GetCacheBlock(blockPos,&valueBlock);
-			GrapaMem::MemCopy(&valueBlock,value,length);
-			value = &((s8*)value)[length];
-			length = 0;
-			SetCacheBlock(blockPos,&valueBlock,dirty);
-		}
-		blockPos++;
+			page++;
 	}
+}
 
-	return(0);
+////////////////////////////////////////////////////////////////////////////////
+
+GrapaError GrapaFileSnapshot::Attach(GrapaFileCache* pCache)
+{
+	GrapaError err;
+	Close();
+	if (pCache == NULL) return((GrapaError)-1);
+	err = pCache->OpenSnapshot(mEpoch, mSize);
+	if (!err)
+		mCache = pCache;
+	return(err);
 }
 
-GrapaError GrapaFileCache::FlushCache()
+GrapaError GrapaFileSnapshot::Close()
 {
-	GrapaError err = 0;
-	u64 width;
+	if (mCache == NULL) return(0);
+	mCache->CloseSnapshot(mEpoch);
+	mCache = NULL;
+	mEpoch = 0;
+	mSize = 0;
+	return(0);
+}
 
-	if (!mFile)
-		return((GrapaError)-1);
+GrapaError GrapaFileSnapshot::Read(u64 blockPos, u16 blockSize, u64 offset, u64 length, void *b)
+{
+	if (mCache == NULL) return((GrapaError)-1);
+	return mCache->ReadSnapshot(mEpoch, mSize, blockPos * blockSize + offset, length, b);
+}
 
-	for (width=0;width<mCacheWidth;width++)
+// Sleeps in short steps so Stop, which waits for this to return, is not held up.
+void GrapaFileFlusher::Running()
+{
+	SendCondition();
+	while (!mStop)
 	{
-		u64 first = mFirstCache[width];
-		GrapaCacheBlock *cache = &mCache[width*mCacheHeight];
-		u64 ptr = first;
-		do
-		{
-			if (!cache[ptr].inuse)
-				break;
-			if (cache[ptr].dirty)
-			{
-				err = mFile->Write(cache[ptr].key,GrapaFileCache::BLOCKPAGESIZE,0,GrapaFileCache::BLOCKPAGESIZE,&cache[ptr].value);
-				if (err) return(err);
-				cache[ptr].dirty = false;
-			}
-			ptr = cache[ptr].next;
-		} while (ptr != first);
+		for (u32 i = 0; i < 10 && !mStop; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		if (!mStop && vCache)
+			vCache->FlushRound();
 	}
-	ClearCache();
-	return mFile->Flush();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -6,20 +6,65 @@
 #define _GrapaFileCACHE_
 
 #include "GrapaFile.h"
+#include "GrapaFileLog.h"
 #include "GrapaBtree.h"
+#include "GrapaThread.h"
+
+#include <unordered_map>
+#include <map>
+#include <vector>
 
 class GrapaCacheBlock;
 
+class GrapaFileCacheStats
+{
+public:
+	u64 size, pages, used, dirty, pinned;
+	u64 hits, misses, evictions, writebacks, writes;
+	u64 commits, syncs, checkpoints, recovered;
+	u64 snapshots, versions;
+	u64 rate, flushed, throughput, backlog, stalls;
+};
+
+class GrapaFileCache;
+
+// Writes back a GrapaFileCache's dirty pages in the background, a round every tenth of a second.
+class GrapaFileFlusher : public GrapaThread
+{
+public:
+	GrapaFileCache* vCache;
+	GrapaFileFlusher() : vCache(NULL) {}
+
+private:
+	virtual void Starting() {}
+	virtual void Running();
+	virtual void Stopping() {}
+};
+
+// Buffer pool over a GrapaFile. Pages are replaced with CLOCK, pinned pages are never evicted,
+// and dirty pages are written back in page order with contiguous runs gathered into one write.
+// With a log, changes reach the file only once their commit is in the log and synced; a page
+// holding changes not yet logged is spilled to the log rather than written back. With a flusher
+// running, writers leave dirty pages to it and only write one back when no clean page is left.
 class GrapaFileCache : public GrapaFile
 {
+	friend class GrapaFileFlusher;
 public:
-	enum { BLOCKSIZE=GrapaBlock::BLOCKSIZE, BLOCKSPERPAGE=8, BLOCKPAGESIZE=BLOCKSIZE*BLOCKSPERPAGE, };
-	enum { DEFAULT_HEIGHT=4, DEFAULT_SIZE=(1024*8*4)};
+	enum { BLOCKSIZE=GrapaBlock::BLOCKSIZE, BLOCKSPERPAGE=128, BLOCKPAGESIZE=BLOCKSIZE*BLOCKSPERPAGE, };
+	enum { DEFAULT_SIZE=(1024*1024), MAX_BATCH=64 };
 public:
     GrapaFileCache();
 	virtual ~GrapaFileCache() { Close(); FreeCache();}
     virtual void    SetFile(GrapaFile *pFile=NULL);
-    virtual GrapaError SetCache(u64 pSize=DEFAULT_SIZE, void *pCache=NULL);
+    virtual GrapaError SetCache(u64 pSize=DEFAULT_SIZE);
+	virtual void    GetStats(GrapaFileCacheStats& pStats);
+	virtual void    SetLog(bool pLog);
+	virtual GrapaError SetFlush(u64 pRate);
+	virtual GrapaError SyncFile();
+	virtual GrapaError Begin();
+	virtual GrapaError Commit(bool pExplicit, u64& pEnd);
+	virtual GrapaError SyncLog(u64 pEnd);
+	virtual GrapaError Rollback();
 	virtual bool    Opened() { return mFile?mFile->Opened():mOpened; }
 	virtual GrapaError Open(const char *fileName, char mode = GrapaReadOnly);
 	virtual GrapaError Close();
@@ -32,31 +77,92 @@ public:
 	virtual GrapaError Write(u64 blockPos, u16 blockSize, u64 offset, u64 length, const void *b);
 	virtual GrapaError Read(u64 blockPos, u16 blockSize, u64 offset, u64 length, void *b);
 	virtual GrapaError Append(u64 length, const void *b) {return(0);}
+	virtual GrapaError OpenSnapshot(u64& pEpoch, u64& pSize);
+	virtual void    CloseSnapshot(u64 pEpoch);
+	virtual GrapaError ReadSnapshot(u64 pEpoch, u64 pSize, u64 pos, u64 length, void *b);
 
 protected:
 	virtual GrapaError ClearCache();
-	virtual GrapaError GetCacheBlock(u64 blockPos, void* value);
-	virtual GrapaError SetCacheBlock(u64 blockPos, const void* value, bool dirty);
+	virtual GrapaError GetCacheBlock(u64 blockPos, bool load, u64& frame);
 	virtual GrapaError FlushCache();
+	virtual GrapaError TruncateCache(u64 pSize);
+	virtual GrapaError CommitLog();
+	virtual GrapaError RollbackLog();
+	virtual GrapaError Checkpoint();
 
 protected:
 	virtual void    FreeCache();
-	virtual GrapaError GetCache(u64 blockPos, u16 blockSize, u64 offset, void* value, u64 length);
-	virtual GrapaError SetCache(u64 blockPos, u16 blockSize, u64 offset, const void* value, u64 length, bool dirty);
+	virtual GrapaError GetCache(u64 pos, void* value, u64 length);
+	virtual GrapaError SetCache(u64 pos, const void* value, u64 length);
 
 private:
-	u64 FindCache(GrapaCacheBlock *cache, u64 key, u64 first);
-	u64 FindCacheFree(GrapaCacheBlock *cache, u64 first);
+	GrapaError FindCacheFree(u64& frame);
+	GrapaError WriteRun(u64* frames, u64 count);
+	GrapaError Spill(u64 frame);
+	GrapaError LoadSize();
+	GrapaError ReadPage(u64 blockPos, u8* value);
+	GrapaError ReadDiskPage(u64 blockPos, u64 pSize, u8* value);
+	GrapaError SaveVersions(u64 pos, u64 length);
+	void ReclaimVersions();
+	GrapaError StartFlusher();
+	void FlushRound();
 
 protected:
 	GrapaFile *mFile;
 
 protected:
-	u64 mCacheWidth,mCacheHeight;
+	GrapaCritical mCritical;
+	u64 mCacheCount, mCacheHand;
 	GrapaCacheBlock *mCache;
-	u64* mFirstCache;
-	bool mLocalyAllocated;
+	u8* mCacheData;
+	u64* mCacheFree;
+	u64 mCacheFreeCount;
+	std::unordered_map<u64, u64> mCacheMap;
+	u64 mFileSize, mDiskSize;
+	bool mSizeLoaded;
+	GrapaFileCacheStats mStats;
+	GrapaFileLog mLog;
+	bool mLogOn, mTxn;
+	u64 mTxnEnd, mTxnSum, mTxnSize;
+	u64 mPending;
+	std::unordered_map<u64, u64> mSpill;
+	// Open snapshots by epoch, with how many share each, and the images of the pages written
+	// since, by page and the epoch they were saved in.
+	u64 mEpoch;
+	std::map<u64, u64> mSnapshots;
+	std::unordered_map<u64, std::map<u64, std::vector<u8> > > mVersions;
+	// Bytes a second the flusher may write, what it has left of that, the page it goes on from,
+	// and what it has written since mFlushTime, for the throughput counter. mFlushEnd is where
+	// the log ended at the last round, to tell when commits have stopped.
+	GrapaFileFlusher mFlusher;
+	u64 mFlushRate, mFlushCredit, mFlushNext, mFlushBytes, mFlushTime, mFlushEnd;
+
+};
+
+// Read-only view of a GrapaFileCache as it stood when Attach was called. Writes through the
+// cache after that leave what the snapshot reads unchanged; writes through the snapshot fail.
+class GrapaFileSnapshot : public GrapaFile
+{
+public:
+	GrapaFileSnapshot() : mCache(NULL), mEpoch(0), mSize(0) {}
+	virtual ~GrapaFileSnapshot() { Close(); }
+	virtual GrapaError Attach(GrapaFileCache* pCache);
+	virtual bool    Opened() { return mCache != NULL; }
+	virtual GrapaError Open(const char *fileName, char mode = GrapaReadOnly) { return mCache ? 0 : -1; }
+	virtual GrapaError Close();
+	virtual GrapaError GetSize(u64& pSize) { pSize = mSize; return mCache ? 0 : -1; }
+	virtual GrapaError SetSize(u64 pSize) { return(-1); }
+	virtual GrapaError Create(const char *fileName) { return(-1); }
+	virtual GrapaError Delete(const char *fileName) { return(-1); }
+	virtual GrapaError Flush() { return(0); }
+	virtual GrapaError Purge(u64 blockCount, u16 blockSize) { return(0); }
+	virtual GrapaError Write(u64 blockPos, u16 blockSize, u64 offset, u64 length, const void *b) { return(-1); }
+	virtual GrapaError Read(u64 blockPos, u16 blockSize, u64 offset, u64 length, void *b);
+	virtual GrapaError Append(u64 length, const void *b) { return(-1); }
 
+protected:
+	GrapaFileCache* mCache;
+	u64 mEpoch, mSize;
 };
 
 #endif //_GrapaFileCACHE_
@@ -37,7 +37,6 @@ limitations under the License.
 #define close _close
 #define write _write
 #define read _read
-#define sched_yield _Thrd_yield
 #endif
 #endif
 
@@ -50,12 +49,21 @@ limitations under the License.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <thread>
+#include <errno.h>
+#include <limits.h>
+#include <vector>
 
 #if defined(__MINGW32__) || defined(__GNUC__)
 #include <sys/ioctl.h>
 #endif
 
+#ifndef _WIN32
+#include <sys/uio.h>
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+#endif
+
 //http://stackoverflow.com/questions/22372316/how-to-get-usb-connected-hard-disk-serial-in-linux
 //http://stackoverflow.com/questions/20291022/ioctl-and-hdreg-to-get-information-on-harddrives
 
@@ -192,6 +200,20 @@ GrapaError GrapaFileIO::Flush()
 	return(0);
 }
 
+GrapaError GrapaFileIO::Sync()
+{
+	if (!Opened()) return((GrapaError)-1);
+	if (mMode == GrapaReadOnly) return(0);
+#if defined(_WIN32)
+	if (_commit(mFp)) return((GrapaError)-1);
+#elif defined(__APPLE__)
+	if (fsync(mFp)) return((GrapaError)-1);
+#else
+	if (fdatasync(mFp)) return((GrapaError)-1);
+#endif
+	return(0);
+}
+
 GrapaError GrapaFileIO::Purge(u64 blockCount, u16 blockSize)
 {
 	GrapaError err;
@@ -202,70 +224,103 @@ GrapaError GrapaFileIO::Purge(u64 blockCount, u16 blockSize)
 	return(0);
 }
 
+// Writes and reads go to an explicit offset with pwrite and pread, which leave the file position
+// alone, so threads can share the descriptor. pwrite extends the file as needed. Both may move
+// fewer bytes than asked, so they loop until done.
 GrapaError GrapaFileIO::Write(u64 blockPos, u16 blockSize, u64 offset, u64 length, const void *b)
 {
-	GrapaError err;
-	u64 len = 0, len2 = 0;
-	u64 endPos = 0, total = 0;
-	u64 fileSize = 0L;
+	u64 pos = blockPos * blockSize + offset;
+	const char* p = (const char*)b;
 
 	if (!Opened()) return((GrapaError)-1);
-	if (length == 0) return(0);
-	err = GetSize(fileSize);
-	if (err)
-		return((GrapaError)-1);
-	if (fileSize<(blockPos*blockSize + offset + length))
-	{
-		err = SetSize(blockPos*blockSize + offset + length);
-		if (err)
-			return((GrapaError)-1);
-	}
-	endPos = lseek(mFp, (blockPos*blockSize + offset), SEEK_SET);
-	if (endPos != (blockPos*blockSize + offset))
+#ifdef _WIN32
+	if (length && lseek(mFp, pos, SEEK_SET) != (s64)pos)
 		return((GrapaError)-1);
-
+#endif
 	while (length)
 	{
-		len = length < 131072 ? length : 131072;
-		len2 = write(mFp, &(((char*)b)[total]), (u32)len);
-		if (len2 < 0)
-			return((GrapaError)-1);
-		if (len != len2)
+#ifdef _WIN32
+		int len = write(mFp, p, (u32)(length < 0x40000000 ? length : 0x40000000));
+#else
+		ssize_t len = pwrite(mFp, p, (size_t)length, (off_t)pos);
+		if (len < 0 && errno == EINTR)
+			continue;
+#endif
+		if (len <= 0)
 			return((GrapaError)-1);
-		length -= len2;
-		total += len2;
-		//std::this_thread::sleep_for(std::chrono::milliseconds(0));
-		sched_yield();
+		pos += len;
+		p += len;
+		length -= len;
 	}
-	if (length != 0)
-		return((GrapaError)-1);
-	return 0;
+	return(0);
 }
 
 GrapaError GrapaFileIO::Read(u64 blockPos, u16 blockSize, u64 offset, u64 length, void *b)
 {
-	u64 len=0,len2=0;
-	u64 endPos = 0, total = 0;
+	u64 pos = blockPos * blockSize + offset;
+	char* p = (char*)b;
+
 	if (!Opened()) return((GrapaError)-1);
-	endPos = lseek(mFp, (blockPos * blockSize + offset), SEEK_SET);
-	if (endPos != (blockPos * blockSize + offset))
+#ifdef _WIN32
+	if (lseek(mFp, pos, SEEK_SET) != (s64)pos)
 		return((GrapaError)-1);
+#endif
 	while (length)
 	{
-		len = length < 131072 ? length : 131072;
-		len2 = read(mFp, &(((char*)b)[total]), (u32)len);
-		if (len2 < 0)
+#ifdef _WIN32
+		int len = read(mFp, p, (u32)(length < 0x40000000 ? length : 0x40000000));
+#else
+		ssize_t len = pread(mFp, p, (size_t)length, (off_t)pos);
+		if (len < 0 && errno == EINTR)
+			continue;
+#endif
+		// Zero bytes is the end of the file, short of what was asked for.
+		if (len <= 0)
 			return((GrapaError)-1);
-		if (len != len2)
+		pos += len;
+		p += len;
+		length -= len;
+	}
+	return(0);
+}
+
+// One pwritev per IOV_MAX buffers. A short write resumes partway through the buffer it stopped in.
+GrapaError GrapaFileIO::WriteV(u64 pos, u64 count, const void* const* b, const u64* lengths)
+{
+	if (!Opened()) return((GrapaError)-1);
+#ifdef _WIN32
+	return GrapaFile::WriteV(pos, count, b, lengths);
+#else
+	std::vector<struct iovec> iov;
+	iov.reserve(count);
+	for (u64 i = 0; i < count; i++)
+	{
+		if (lengths[i] == 0) continue;
+		struct iovec v;
+		v.iov_base = (void*)b[i];
+		v.iov_len = (size_t)lengths[i];
+		iov.push_back(v);
+	}
+	u64 first = 0;
+	while (first < iov.size())
+	{
+		u64 n = iov.size() - first;
+		ssize_t len = pwritev(mFp, &iov[first], (int)(n < IOV_MAX ? n : IOV_MAX), (off_t)pos);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
 			return((GrapaError)-1);
-		length -= len2;
-		total += len2;
-		//std::this_thread::sleep_for(std::chrono::milliseconds(0));
-		sched_yield();
+		pos += len;
+		while (first < iov.size() && (size_t)len >= iov[first].iov_len)
+			len -= iov[first++].iov_len;
+		if (len)
+		{
+			iov[first].iov_base = (char*)iov[first].iov_base + len;
+			iov[first].iov_len -= len;
+		}
 	}
-	if (length!=0)
-		return((GrapaError)-1);
 	return(0);
+#endif
 }
 
 GrapaError GrapaFileIO::Append(u64 length, const void *b)
@@ -275,11 +330,7 @@ GrapaError GrapaFileIO::Append(u64 length, const void *b)
 	if (!Opened()) return((GrapaError)-1);
 	err = GetSize(endPos);
 	if (err) return(err);
-	err = SetSize(endPos + length);
-	if (err) return(err);
-	err = Write(0, 0, endPos, length, b);
-	if (err) return(err);
-	return 0;
+	return Write(0, 0, endPos, length, b);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
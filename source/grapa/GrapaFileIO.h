@@ -21,10 +21,12 @@ public:
 	virtual GrapaError Create(const char *fileName);
 	virtual GrapaError Delete(const char *fileName);
 	virtual GrapaError Flush();
+	virtual GrapaError Sync();
 	virtual GrapaError Purge(u64 blockCount, u16 blockSize);
 	virtual GrapaError Write(u64 blockPos, u16 blockSize, u64 offset, u64 length, const void *b);
 	virtual GrapaError Read(u64 blockPos, u16 blockSize, u64 offset, u64 length, void *b);
 	virtual GrapaError Append(u64 length, const void *b);
+	virtual GrapaError WriteV(u64 pos, u64 count, const void* const* b, const u64* lengths);
 };
 
 #endif //_GrapaFileIO_
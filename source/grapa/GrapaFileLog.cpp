@@ -0,0 +1,356 @@
+// GrapaFileLog.cpp
+/*
+Copyright 2022 Chris Ernest Matichuk
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http ://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissionsand
+limitations under the License.
+*/
+////////////////////////////////////////////////////////////////////////////////
+
+#include "GrapaFileLog.h"
+
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+class GrapaFileLogHeader
+{
+public:
+	char magic[8];
+	u64 version;
+	u64 salt;
+	u64 sum;
+};
+
+class GrapaFileLogRecord
+{
+public:
+	u32 kind;
+	u32 length;
+	u64 pos;
+	u64 salt;
+	u64 sum;
+};
+
+static const char gFileLogMagic[8] = { 'G','r','a','p','a','W','A','L' };
+#ifdef GRAPA_WALFAULT
+static std::atomic<s64> gFileLogFault(0);
+static std::atomic<bool> gFileLogCrashed(false);
+#else
+static const bool gFileLogCrashed = false;
+#endif
+
+// FNV-1a. The sum field itself is left out when a header or record is summed.
+static u64 GrapaFileLogSum(u64 sum, const void* b, u64 length)
+{
+	const u8* p = (const u8*)b;
+	for (u64 i = 0; i < length; i++)
+	{
+		sum ^= p[i];
+		sum *= 0x100000001b3ULL;
+	}
+	return(sum);
+}
+
+// The part of a write of length bytes that reaches the file: all of it, half for the write a
+// fault lands on, and none after that. Faults exist only in test builds, made with GRAPA_WALFAULT.
+static u64 GrapaFileLogFault(u64 length)
+{
+#ifdef GRAPA_WALFAULT
+	if (gFileLogCrashed) return(0);
+	if (gFileLogFault <= 0 || --gFileLogFault > 0) return(length);
+	gFileLogCrashed = true;
+	return(length / 2);
+#else
+	return(length);
+#endif
+}
+
+GrapaFileLog::GrapaFileLog()
+{
+	mEnd = 0;
+	mSynced = 0;
+	mSyncs = 0;
+	mSum = 0;
+	mSalt = 0;
+}
+
+GrapaError GrapaFileLog::Create(const char* fileName)
+{
+	GrapaError err;
+	Close(false);
+	if (fileName == NULL || fileName[0] == 0) return((GrapaError)-1);
+	mName = std::string(fileName) + ".wal";
+	err = mFile.Create(mName.c_str());
+	if (err) return(err);
+	mSalt = (u64)std::chrono::system_clock::now().time_since_epoch().count();
+	err = WriteHeader();
+	if (err) mFile.Close();
+	return(err);
+}
+
+GrapaError GrapaFileLog::WriteHeader()
+{
+	GrapaError err;
+	GrapaFileLogHeader hdr;
+	memcpy(hdr.magic, gFileLogMagic, sizeof(hdr.magic));
+	hdr.version = 1;
+	hdr.salt = mSalt;
+	hdr.sum = GrapaFileLogSum(0xcbf29ce484222325ULL, &hdr, sizeof(hdr) - sizeof(hdr.sum));
+	const void* b = &hdr;
+	u64 length = GrapaFileLog::HEADERSIZE;
+	err = FileWrite(&mFile, 0, 1, &b, &length);
+	if (err) return(err);
+	mEnd = GrapaFileLog::HEADERSIZE;
+	mSynced = 0;
+	mSum = mSalt;
+	return(0);
+}
+
+GrapaError GrapaFileLog::Close(bool pDelete)
+{
+	mSyncCritical.WaitCritical();
+	if (mFile.Opened())
+	{
+		mFile.Close();
+		if (pDelete && !gFileLogCrashed)
+			mFile.Delete(mName.c_str());
+	}
+	mEnd = 0;
+	mSynced = 0;
+	mSyncCritical.LeaveCritical();
+	return(0);
+}
+
+// Writes the records back to back in one gathered write. The log end only moves once the write
+// has returned, so a sync that reads it covers every record before it.
+GrapaError GrapaFileLog::Append(u64 count, GrapaFileLogEntry* entries)
+{
+	GrapaError err;
+	if (!mFile.Opened()) return((GrapaError)-1);
+	std::vector<GrapaFileLogRecord> records(count);
+	std::vector<const void*> buffers;
+	std::vector<u64> lengths;
+	buffers.reserve(count * 2);
+	lengths.reserve(count * 2);
+	u64 sum = mSum;
+	u64 at = mEnd;
+	for (u64 i = 0; i < count; i++)
+	{
+		GrapaFileLogRecord& rec = records[i];
+		rec.kind = entries[i].kind;
+		rec.length = entries[i].length;
+		rec.pos = entries[i].pos;
+		rec.salt = mSalt;
+		sum = GrapaFileLogSum(sum, &rec, sizeof(rec) - sizeof(rec.sum));
+		sum = GrapaFileLogSum(sum, entries[i].data, rec.length);
+		rec.sum = sum;
+		buffers.push_back(&rec);
+		lengths.push_back(GrapaFileLog::RECORDSIZE);
+		if (rec.length)
+		{
+			buffers.push_back(entries[i].data);
+			lengths.push_back(rec.length);
+		}
+		entries[i].at = at + GrapaFileLog::RECORDSIZE;
+		at += GrapaFileLog::RECORDSIZE + rec.length;
+	}
+	err = FileWrite(&mFile, mEnd, buffers.size(), buffers.data(), lengths.data());
+	if (err) return(err);
+	mSum = sum;
+	mEnd = at;
+	return(0);
+}
+
+GrapaError GrapaFileLog::Read(u64 pos, u64 length, void* b)
+{
+	return mFile.Read(0, 0, pos, length, b);
+}
+
+GrapaError GrapaFileLog::Sync(u64 pEnd)
+{
+	GrapaError err = 0;
+	mSyncCritical.WaitCritical();
+	if (mSynced < pEnd && mFile.Opened())
+	{
+		u64 end = mEnd;
+		err = FileSync(&mFile);
+		if (!err)
+		{
+			mSynced = end;
+			mSyncs++;
+		}
+	}
+	mSyncCritical.LeaveCritical();
+	return(err);
+}
+
+// Drops the records past pEnd, for a rollback. pSum is the chained sum at pEnd.
+GrapaError GrapaFileLog::Truncate(u64 pEnd, u64 pSum)
+{
+	GrapaError err;
+	mSyncCritical.WaitCritical();
+	err = FileSetSize(&mFile, pEnd);
+	if (!err)
+	{
+		mEnd = pEnd;
+		mSum = pSum;
+		if (mSynced > pEnd)
+			mSynced = pEnd;
+	}
+	mSyncCritical.LeaveCritical();
+	return(err);
+}
+
+// Empties the log once a checkpoint has made the database file hold everything in it. The new
+// salt invalidates any old record that survives a crash before the truncate reaches the disk.
+GrapaError GrapaFileLog::Reset()
+{
+	GrapaError err;
+	mSyncCritical.WaitCritical();
+	err = FileSetSize(&mFile, 0);
+	if (!err)
+	{
+		mSalt++;
+		err = WriteHeader();
+	}
+	mSyncCritical.LeaveCritical();
+	return(err);
+}
+
+// Replays the log left beside fileName by a database that did not close cleanly. Every record
+// up to the last intact commit is written to pFile in log order, the file is cut to the size
+// that commit recorded and synced, and the log is deleted. Records of a transaction that never
+// committed all lie past that commit, since a rollback truncates the log.
+GrapaError GrapaFileLog::Recover(const char* fileName, GrapaFile* pFile, u64& pCommits)
+{
+	GrapaError err = 0;
+	pCommits = 0;
+	// Tables held in memory have no name and no log.
+	if (fileName == NULL || fileName[0] == 0) return(0);
+	std::string name = std::string(fileName) + ".wal";
+	GrapaFileIO log;
+	GrapaFileLogHeader hdr;
+	GrapaFileLogRecord rec;
+	std::vector<u8> data;
+	u64 size = 0, end = 0, fileSize = 0;
+
+	if (log.Open(name.c_str(), GrapaReadOnly))
+		return(0);
+	log.GetSize(size);
+
+	bool valid = size >= GrapaFileLog::HEADERSIZE && log.Read(0, 0, 0, GrapaFileLog::HEADERSIZE, &hdr) == 0;
+	valid = valid && memcmp(hdr.magic, gFileLogMagic, sizeof(hdr.magic)) == 0;
+	valid = valid && hdr.sum == GrapaFileLogSum(0xcbf29ce484222325ULL, &hdr, sizeof(hdr) - sizeof(hdr.sum));
+
+	u64 sum = hdr.salt;
+	u64 pos = GrapaFileLog::HEADERSIZE;
+	while (valid && pos + GrapaFileLog::RECORDSIZE <= size)
+	{
+		if (log.Read(0, 0, pos, GrapaFileLog::RECORDSIZE, &rec)) break;
+		if (rec.salt != hdr.salt || (rec.kind != GrapaFileLog::PAGE_RECORD && rec.kind != GrapaFileLog::COMMIT_RECORD)) break;
+		if (pos + GrapaFileLog::RECORDSIZE + rec.length > size) break;
+		data.resize(rec.length);
+		if (rec.length && log.Read(0, 0, pos + GrapaFileLog::RECORDSIZE, rec.length, data.data())) break;
+		u64 check = GrapaFileLogSum(GrapaFileLogSum(sum, &rec, sizeof(rec) - sizeof(rec.sum)), data.data(), rec.length);
+		if (check != rec.sum) break;
+		sum = check;
+		pos += GrapaFileLog::RECORDSIZE + rec.length;
+		if (rec.kind == GrapaFileLog::COMMIT_RECORD)
+		{
+			end = pos;
+			fileSize = rec.pos;
+			pCommits++;
+		}
+	}
+
+	pos = GrapaFileLog::HEADERSIZE;
+	while (!err && pos < end)
+	{
+		err = log.Read(0, 0, pos, GrapaFileLog::RECORDSIZE, &rec);
+		data.resize(rec.length);
+		if (!err && rec.length)
+			err = log.Read(0, 0, pos + GrapaFileLog::RECORDSIZE, rec.length, data.data());
+		if (!err && rec.kind == GrapaFileLog::PAGE_RECORD)
+		{
+			const void* b = data.data();
+			u64 length = rec.length;
+			err = FileWrite(pFile, rec.pos, 1, &b, &length);
+		}
+		pos += GrapaFileLog::RECORDSIZE + rec.length;
+	}
+	if (!err && end)
+		err = FileSetSize(pFile, fileSize);
+	if (!err && end)
+		err = FileSync(pFile);
+
+	log.Close();
+	if (!err && !gFileLogCrashed)
+		log.Delete(name.c_str());
+	return(err);
+}
+
+void GrapaFileLog::Remove(const char* fileName)
+{
+	if (gFileLogCrashed || fileName == NULL || fileName[0] == 0) return;
+	GrapaFileIO log;
+	log.Delete((std::string(fileName) + ".wal").c_str());
+}
+
+GrapaError GrapaFileLog::FileWrite(GrapaFile* pFile, u64 pos, u64 count, const void* const* b, const u64* lengths)
+{
+	u64 total = 0;
+	for (u64 i = 0; i < count; i++)
+		total += lengths[i];
+	if (total == 0) return(0);
+	u64 keep = GrapaFileLogFault(total);
+	if (keep == total)
+		return pFile->WriteV(pos, count, b, lengths);
+	std::vector<u64> torn(lengths, lengths + count);
+	u64 n = 0;
+	for (; n < count && keep; n++)
+	{
+		if (torn[n] > keep)
+			torn[n] = keep;
+		keep -= torn[n];
+	}
+	if (n)
+		pFile->WriteV(pos, n, b, torn.data());
+	return(0);
+}
+
+GrapaError GrapaFileLog::FileSetSize(GrapaFile* pFile, u64 pSize)
+{
+	if (gFileLogCrashed) return(0);
+	return pFile->SetSize(pSize);
+}
+
+GrapaError GrapaFileLog::FileSync(GrapaFile* pFile)
+{
+	if (gFileLogCrashed) return(0);
+	return pFile->Sync();
+}
+
+#ifdef GRAPA_WALFAULT
+void GrapaFileLog::SetFault(s64 pWrites)
+{
+	gFileLogCrashed = false;
+	gFileLogFault = pWrites;
+}
+
+s64 GrapaFileLog::GetFault()
+{
+	return gFileLogCrashed ? -1 : gFileLogFault.load();
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
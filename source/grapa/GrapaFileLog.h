@@ -0,0 +1,78 @@
+// GrapaFileLog.h
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _GrapaFileLog_
+#define _GrapaFileLog_
+
+#include "GrapaFileIO.h"
+#include "GrapaThread.h"
+
+#include <atomic>
+#include <string>
+
+// One record for the log: new contents for a byte range of a page, or a commit that ends a
+// transaction and records the file size. Append fills in where the data landed in the log.
+class GrapaFileLogEntry
+{
+public:
+	u32 kind;
+	u32 length;
+	u64 pos;
+	const void* data;
+	u64 at;
+};
+
+// Write-ahead log for a database file, kept beside it as <file>.wal. Each record's checksum is
+// chained from the one before, seeded by a salt in the log header, so recovery stops at the
+// first torn record and ignores anything left from before the last checkpoint. Sync is a group
+// commit: a committer whose records an earlier sync already covered returns without syncing.
+class GrapaFileLog
+{
+public:
+	enum { PAGE_RECORD = 1, COMMIT_RECORD = 2, };
+	enum { HEADERSIZE = 32, RECORDSIZE = 32, CHECKPOINTSIZE = 4 * 1024 * 1024, };
+public:
+	GrapaFileLog();
+	virtual ~GrapaFileLog() { Close(false); }
+	bool Opened() { return mFile.Opened(); }
+	GrapaError Create(const char* fileName);
+	GrapaError Close(bool pDelete);
+	GrapaError Append(u64 count, GrapaFileLogEntry* entries);
+	GrapaError Read(u64 pos, u64 length, void* b);
+	GrapaError Sync(u64 pEnd);
+	GrapaError Truncate(u64 pEnd, u64 pSum);
+	GrapaError Reset();
+	u64 End() { return mEnd; }
+	bool Synced(u64 pEnd) { return mSynced >= pEnd; }
+	u64 Sum() { return mSum; }
+	u64 Syncs() { return mSyncs; }
+
+	static GrapaError Recover(const char* fileName, GrapaFile* pFile, u64& pCommits);
+	static void Remove(const char* fileName);
+
+	// Every write, sync and truncate of a database file goes through these. In test builds, made
+	// with GRAPA_WALFAULT defined, SetFault arms a simulated kill: the given write is torn in half
+	// and everything after it is dropped.
+	static GrapaError FileWrite(GrapaFile* pFile, u64 pos, u64 count, const void* const* b, const u64* lengths);
+	static GrapaError FileSetSize(GrapaFile* pFile, u64 pSize);
+	static GrapaError FileSync(GrapaFile* pFile);
+#ifdef GRAPA_WALFAULT
+	static void SetFault(s64 pWrites);
+	static s64 GetFault();
+#endif
+
+protected:
+	GrapaError WriteHeader();
+
+protected:
+	GrapaFileIO mFile;
+	std::string mName;
+	GrapaCritical mSyncCritical;
+	std::atomic<u64> mEnd, mSynced, mSyncs;
+	u64 mSum, mSalt;
+};
+
+#endif //_GrapaFileLog_
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,203 @@
+// GrapaFileMap.cpp
+/*
+Copyright 2022 Chris Ernest Matichuk
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http ://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissionsand
+limitations under the License.
+*/
+////////////////////////////////////////////////////////////////////////////////
+
+#include "GrapaFileMap.h"
+#include "GrapaMem.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+GrapaFileMap::GrapaFileMap()
+{
+	mMap = NULL;
+	mMapSize = 0;
+	mSize = 0;
+}
+
+// Maps at least pSize bytes, rounded up to the next MAPGROW step. Bytes past the end of the file
+// are reserved but never touched; SetSize and Write extend the file before using them.
+GrapaError GrapaFileMap::Map(u64 pSize)
+{
+#ifdef _WIN32
+	return((GrapaError)-1);
+#else
+	if (mMap && pSize <= mMapSize)
+		return(0);
+	Unmap();
+	u64 mapSize = ((pSize / GrapaFileMap::MAPGROW) + 1) * GrapaFileMap::MAPGROW;
+	int prot = PROT_READ;
+	if (mMode != GrapaReadOnly)
+		prot |= PROT_WRITE;
+	void* map = mmap(NULL, (size_t)mapSize, prot, MAP_SHARED, mFp, 0);
+	if (map == MAP_FAILED)
+		return((GrapaError)-1);
+	mMap = (u8*)map;
+	mMapSize = mapSize;
+	return(0);
+#endif
+}
+
+void GrapaFileMap::Unmap()
+{
+#ifndef _WIN32
+	if (mMap)
+		munmap(mMap, (size_t)mMapSize);
+#endif
+	mMap = NULL;
+	mMapSize = 0;
+}
+
+GrapaError GrapaFileMap::Open(const char *fileName, char mode)
+{
+	GrapaError err = GrapaFileIO::Open(fileName, mode);
+	if (err) return(err);
+	mCritical.WaitCritical();
+	err = GrapaFileIO::GetSize(mSize);
+	if (!err)
+		Map(mSize);
+	mCritical.LeaveCritical();
+	return(0);
+}
+
+GrapaError GrapaFileMap::Close()
+{
+	mCritical.WaitCritical();
+	Unmap();
+	mSize = 0;
+	mCritical.LeaveCritical();
+	return GrapaFileIO::Close();
+}
+
+GrapaError GrapaFileMap::GetSize(u64& pSize)
+{
+	if (!mMap) return GrapaFileIO::GetSize(pSize);
+	pSize = mSize;
+	return(0);
+}
+
+GrapaError GrapaFileMap::SetSize(u64 pSize)
+{
+	GrapaError err = 0;
+	if (!mMap) return GrapaFileIO::SetSize(pSize);
+	mCritical.WaitCritical();
+#ifndef _WIN32
+	if (ftruncate(mFp, pSize))
+		err = -1;
+#endif
+	if (!err)
+	{
+		mSize = pSize;
+		Map(pSize);
+	}
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+GrapaError GrapaFileMap::Create(const char *fileName)
+{
+	GrapaError err = GrapaFileIO::Create(fileName);
+	if (err) return(err);
+	mCritical.WaitCritical();
+	mSize = 0;
+	Map(0);
+	mCritical.LeaveCritical();
+	return(0);
+}
+
+GrapaError GrapaFileMap::Flush()
+{
+#ifndef _WIN32
+	mCritical.WaitCritical();
+	if (mMap && mSize)
+		msync(mMap, (size_t)mSize, MS_ASYNC);
+	mCritical.LeaveCritical();
+#endif
+	return GrapaFileIO::Flush();
+}
+
+GrapaError GrapaFileMap::Sync()
+{
+#ifndef _WIN32
+	mCritical.WaitCritical();
+	if (mMap && mSize)
+		msync(mMap, (size_t)mSize, MS_SYNC);
+	mCritical.LeaveCritical();
+#endif
+	return GrapaFileIO::Sync();
+}
+
+GrapaError GrapaFileMap::Purge(u64 blockCount, u16 blockSize)
+{
+	if (!mMap) return GrapaFileIO::Purge(blockCount, blockSize);
+	return SetSize(((u64)blockCount)*blockSize);
+}
+
+GrapaError GrapaFileMap::Write(u64 blockPos, u16 blockSize, u64 offset, u64 length, const void *b)
+{
+	GrapaError err = 0;
+	if (!mMap) return GrapaFileIO::Write(blockPos, blockSize, offset, length, b);
+	if (length == 0) return(0);
+	u64 pos = blockPos * blockSize + offset;
+	mCritical.WaitCritical();
+	if (pos + length > mSize)
+	{
+#ifndef _WIN32
+		if (ftruncate(mFp, pos + length))
+			err = -1;
+#endif
+		if (!err)
+		{
+			mSize = pos + length;
+			Map(mSize);
+		}
+	}
+	if (!err && mMap)
+		GrapaMem::MemCopy(&mMap[pos], b, length);
+	mCritical.LeaveCritical();
+	if (!err && !mMap)
+		return GrapaFileIO::Write(blockPos, blockSize, offset, length, b);
+	return(err);
+}
+
+GrapaError GrapaFileMap::Read(u64 blockPos, u16 blockSize, u64 offset, u64 length, void *b)
+{
+	GrapaError err = 0;
+	if (!mMap) return GrapaFileIO::Read(blockPos, blockSize, offset, length, b);
+	u64 pos = blockPos * blockSize + offset;
+	mCritical.WaitCritical();
+	bool mapped = mMap != NULL;
+	if (mapped && pos + length > mSize)
+		err = -1;
+	else if (mapped)
+		GrapaMem::MemCopy(b, &mMap[pos], length);
+	mCritical.LeaveCritical();
+	if (!mapped)
+		return GrapaFileIO::Read(blockPos, blockSize, offset, length, b);
+	return(err);
+}
+
+////////////////////////////////////////////////////////////////////////// Mapped, each buffer is a copy into the map; pwritev would bypass the tracked size.
+GrapaError GrapaFileMap::WriteV(u64 pos, u64 count, const void* const* b, const u64* lengths)
+{
+	if (!mMap) return GrapaFileIO::WriteV(pos, count, b, lengths);
+	return GrapaFile::WriteV(pos, count, b, lengths);
+}
+
+////////
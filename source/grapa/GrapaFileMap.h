@@ -0,0 +1,45 @@
+// GrapaFileMap.h
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _GrapaFileMap_
+#define _GrapaFileMap_
+
+#include "GrapaFileIO.h"
+#include "GrapaThread.h"
+
+// File backend that serves reads and writes from a shared memory map of the file. The map is
+// reserved in MAPGROW steps past the end of the file, so extending the file rarely remaps it.
+// Where the file cannot be mapped, every call falls through to GrapaFileIO.
+class GrapaFileMap : public GrapaFileIO
+{
+public:
+	enum { MAPGROW = 64 * 1024 * 1024 };
+public:
+	GrapaFileMap();
+	virtual ~GrapaFileMap() { Close(); }
+	virtual GrapaError Open(const char *fileName, char mode = GrapaReadOnly);
+	virtual GrapaError Close();
+	virtual GrapaError GetSize(u64& pSize);
+	virtual GrapaError SetSize(u64 pSize);
+	virtual GrapaError Create(const char *fileName);
+	virtual GrapaError Flush();
+	virtual GrapaError Sync();
+	virtual GrapaError Purge(u64 blockCount, u16 blockSize);
+	virtual GrapaError Write(u64 blockPos, u16 blockSize, u64 offset, u64 length, const void *b);
+	virtual GrapaError Read(u64 blockPos, u16 blockSize, u64 offset, u64 length, void *b);
+	virtual GrapaError WriteV(u64 pos, u64 count, const void* const* b, const u64* lengths);
+
+protected:
+	GrapaError Map(u64 pSize);
+	void Unmap();
+
+protected:
+	GrapaCritical mCritical;
+	u8* mMap;
+	u64 mMapSize, mSize;
+};
+
+#endif //_GrapaFileMap_
+
+////////////////////////////////////////////////////////////////////////////////
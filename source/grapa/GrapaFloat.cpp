@@ -197,6 +197,113 @@ GrapaFloat& GrapaFloat::operator =(const GrapaInt& that)
 	return *this;
 }
 
+// Native double fast path. A value whose mantissa fits in 53 bits, with an exponent well inside the
+// double range, is exactly a double. Arithmetic on such values runs on the FPU when the double result
+// is provably exact, and is rebuilt into the same form the GrapaInt route would leave; anything else
+// falls through to the GrapaInt route.
+static bool _floatnative(const GrapaFloat& pValue, d64& pDouble)
+{
+	if (pValue.mNaN || pValue.mData.dataSigned || pValue.mData.GetCount() > 2 || pValue.mExp > 400 || pValue.mExp < -400)
+		return false;
+	u64 m = pValue.mData.GetLimb(0);
+	s64 e = pValue.mExp - pValue.mBits + 1;
+	if ((m >> 53) || e < -460)
+		return false;
+	pDouble = ldexp((d64)m, (int)e);
+	if (pValue.mSigned)
+		pDouble = -pDouble;
+	return true;
+}
+
+// Nonzero pValue as an odd mantissa with mExp = floor(log2 |pValue|), the form Truncate leaves.
+static void _floatfromnative(GrapaFloat& pResult, d64 pValue)
+{
+	int e;
+	u64 m = (u64)ldexp(frexp(fabs(pValue), &e), 53);
+	s64 bits = 53;
+	while (!(m & 0xFF))
+	{
+		m >>= 8;
+		bits -= 8;
+	}
+	while (!(m & 1))
+	{
+		m >>= 1;
+		bits--;
+	}
+	pResult.mData = (s64)m;
+	pResult.mBits = bits;
+	pResult.mExp = e - 1;
+	pResult.mSigned = pValue < 0;
+	// With an odd mantissa Truncate only has work to do when there are more bits than mMax + mExtra.
+	s64 keep = (pResult.mFix || pResult.mExp >= 0) ? pResult.mBits - pResult.mExp : pResult.mBits;
+	if (keep > pResult.mMax + pResult.mExtra)
+		pResult.Truncate();
+}
+
+// x + y, or false when the sum is not exact (Knuth's two-sum leaves a nonzero error) or is zero.
+static bool _floataddnative(const GrapaFloat& a, const GrapaFloat& b, bool pNegate, GrapaFloat& pResult)
+{
+	d64 x, y;
+	if (!_floatnative(a, x) || !_floatnative(b, y))
+		return false;
+	if (pNegate)
+		y = -y;
+	d64 s = x + y;
+	d64 v = s - x;
+	if (s == 0.0 || (x - (s - v)) + (y - v) != 0.0)
+		return false;
+	_floatfromnative(pResult, s);
+	pResult.mTrunc = a.mTrunc || b.mTrunc;
+	return true;
+}
+
+// x * y, or false when the product is not exact (Dekker's two-product leaves a nonzero error) or is zero.
+static bool _floatmulnative(const GrapaFloat& a, const GrapaFloat& b, GrapaFloat& pResult)
+{
+	d64 x, y;
+	if (a.mTrunc || b.mTrunc || !_floatnative(a, x) || !_floatnative(b, y))
+		return false;
+	d64 p = x * y;
+	d64 c = 134217729.0 * x;
+	d64 xh = c - (c - x);
+	d64 xl = x - xh;
+	c = 134217729.0 * y;
+	d64 yh = c - (c - y);
+	d64 yl = y - yh;
+	if (p == 0.0 || ((xh * yh - p) + xh * yl + xl * yh) + xl * yl != 0.0)
+		return false;
+	_floatfromnative(pResult, p);
+	return true;
+}
+
+// Sign of a - b as the comparisons see it: at display precision a fixed point difference below
+// 2^(1 - mMax) truncates to zero, any other nonzero difference survives.
+static bool _floatcmpnative(const GrapaFloat& a, const GrapaFloat& b, int& pCmp)
+{
+	d64 x, y;
+	s64 max = a.mMax > b.mMax ? a.mMax : b.mMax;
+	if (max < 1 || max > 1000 || !_floatnative(a, x) || !_floatnative(b, y))
+		return false;
+	if (x == y)
+	{
+		pCmp = 0;
+		return true;
+	}
+	pCmp = x > y ? 1 : -1;
+	if (a.mFix && b.mFix)
+	{
+		// The rounded difference s brackets the exact one, s + e, against the power of two t.
+		d64 t = ldexp(1.0, (int)(1 - max));
+		d64 s = x - y;
+		d64 v = s - x;
+		d64 e = (x - (s - v)) + (-y - v);
+		if (fabs(s) < t || (fabs(s) == t && e != 0.0 && (e < 0.0) != (s < 0.0)))
+			pCmp = 0;
+	}
+	return true;
+}
+
 void GrapaFloat::Add(GrapaFloat& A, GrapaFloat& B, GrapaFloat& result)
 {
 	s64 bitsDelta = (A.mBits - A.mExp) - (B.mBits - B.mExp);
@@ -236,8 +343,10 @@ void GrapaFloat::Add(GrapaFloat& A, GrapaFloat& B, GrapaFloat& result)
 
 GrapaFloat GrapaFloat::operator +(const GrapaFloat& bi) const
 {
-	GrapaFloat A(*this), B(bi);
 	GrapaFloat result(mFix && bi.mFix ? true : false, mMax > bi.mMax ? mMax : bi.mMax, mExtra > bi.mExtra ? mExtra : bi.mExtra, 0);
+	if (_floataddnative(*this, bi, false, result))
+		return result;
+	GrapaFloat A(*this), B(bi);
 	Add(A, B, result);
 	return result;
 }
@@ -271,9 +380,11 @@ GrapaFloat GrapaFloat::operator++(int)
 
 GrapaFloat GrapaFloat::operator -(const GrapaFloat& bi) const
 {
+	GrapaFloat result(mFix&&bi.mFix?true:false, mMax > bi.mMax ? mMax : bi.mMax, mExtra>bi.mExtra?mExtra:bi.mExtra, 0);
+	if (_floataddnative(*this, bi, true, result))
+		return result;
 	GrapaFloat A(*this), B(bi);
 	B.mSigned = !B.mSigned;
-	GrapaFloat result(mFix&&bi.mFix?true:false, mMax > bi.mMax ? mMax : bi.mMax, mExtra>bi.mExtra?mExtra:bi.mExtra, 0);
 	Add(A, B, result);
 	return result;
 }
@@ -307,6 +418,10 @@ GrapaFloat GrapaFloat::operator--(int x)
 GrapaFloat GrapaFloat::operator *(const GrapaFloat& bi) const
 {
 	GrapaFloat result(mFix && bi.mFix ? true : false, mMax > bi.mMax ? mMax : bi.mMax, mExtra > bi.mExtra ? mExtra : bi.mExtra, 0);
+	result.mFix = mFix;
+	result.mMax = mMax;
+	if (_floatmulnative(*this, bi, result))
+		return result;
 	if (mTrunc || bi.mTrunc)
 	{
 		GrapaInt a(mData);
@@ -325,8 +440,6 @@ GrapaFloat GrapaFloat::operator *(const GrapaFloat& bi) const
 	result.mTrunc = mTrunc || bi.mTrunc;
 	result.mBits = result.mData.bitCount();
 	result.mExp = mExp + bi.mExp + (result.mBits - (mBits + bi.mBits - 1));
-	result.mFix = mFix;
-	result.mMax = mMax;
 	result.Truncate();
 	return result;
 }
@@ -390,6 +503,9 @@ bool GrapaFloat::operator !=(const GrapaFloat& bi2) const
 
 bool GrapaFloat::Equals(const GrapaFloat& bi) const
 {
+	int cmp;
+	if (_floatcmpnative(*this, bi, cmp))
+		return cmp == 0;
 	GrapaFloat result(*this - bi);
 	result.Truncate(true);
 	if (result.mData.IsZero())
@@ -399,6 +515,9 @@ bool GrapaFloat::Equals(const GrapaFloat& bi) const
 
 bool GrapaFloat::operator >(const GrapaFloat& bi) const
 {
+	int cmp;
+	if (_floatcmpnative(*this, bi, cmp))
+		return cmp > 0;
 	GrapaFloat result(*this - bi);
 	result.Truncate(true);
 	if (result.mData.IsZero())
@@ -414,6 +533,9 @@ bool GrapaFloat::operator >(s64 i1) const
 
 bool GrapaFloat::operator <(const GrapaFloat& bi) const
 {
+	int cmp;
+	if (_floatcmpnative(*this, bi, cmp))
+		return cmp < 0;
 	GrapaFloat result(*this - bi);
 	result.Truncate(true);
 	if (result.mData.IsZero())
@@ -720,55 +842,375 @@ GrapaFloat GrapaFloat::Root2(const GrapaFloat& pexp) const
 	return (*this).Pow2(one / pexp);
 }
 
-GrapaFloat GrapaFloat::Pi(const GrapaFloat& pexp)
+// Pi, e and ln 2 cached by precision and shared across threads. A request at or below the precision
+// of the cached value truncates it; a request above it computes the constant and replaces the entry.
+struct GrapaFloatConstant
 {
-	if (pexp.mMax > 64)
+	GrapaCritical mLock;
+	GrapaFloat mValue;
+	bool mValid;
+	GrapaFloatConstant() { mValid = false; }
+};
+
+static GrapaFloatConstant gFloatPi, gFloatE, gFloatLn2;
+
+static GrapaFloat _floatconstant(GrapaFloatConstant& pConst, bool pFix, s64 pMax, s64 pExtra, GrapaFloat (*pCompute)(s64 pMax, s64 pExtra))
+{
+	GrapaFloat result;
+	bool found = false;
+	pConst.mLock.WaitCritical();
+	if (pConst.mValid && pConst.mValue.mMax + pConst.mValue.mExtra >= pMax + pExtra)
+	{
+		result = pConst.mValue;
+		found = true;
+	}
+	pConst.mLock.LeaveCritical();
+	if (!found)
 	{
-		s64 maxbits = pexp.mMax;
-		maxbits += pexp.mExtra + 2;
-		GrapaFloat c13591409(false, maxbits, pexp.mExtra, 13591409);
-		GrapaFloat c545140134(false, maxbits, pexp.mExtra, 545140134);
-		GrapaFloat c640320(false, maxbits, pexp.mExtra, 640320);
-		GrapaFloat c = GrapaFloat(false, maxbits, pexp.mExtra, 12) / ((c640320.Pow(3)).Root(2));
+		result = pCompute(pMax, pExtra);
+		pConst.mLock.WaitCritical();
+		if (!pConst.mValid || pConst.mValue.mMax + pConst.mValue.mExtra < result.mMax + result.mExtra)
+		{
+			pConst.mValue = result;
+			pConst.mValid = true;
+		}
+		pConst.mLock.LeaveCritical();
+	}
+	result.mFix = pFix;
+	result.mMax = pMax;
+	result.mExtra = pExtra;
+	result.Truncate();
+	return result;
+}
 
-		c640320.mSigned = true;
+static bool _floatisone(const GrapaFloat& pValue)
+{
+	return !pValue.mNaN && !pValue.mSigned && pValue.mBits == 1 && pValue.mExp == 0;
+}
 
-		GrapaFloat f1k(false, maxbits, pexp.mExtra, 1);
-		GrapaFloat f3k(false, maxbits, pexp.mExtra, 1);
-		GrapaFloat f6k(false, maxbits, pexp.mExtra, 1);
-		GrapaFloat c640320_pow(false, maxbits, pexp.mExtra, 0);
+// Fixed point evaluation for the transcendental functions. A GrapaInt v stands for v / 2^w.
+// Series are summed by binary splitting over exact integers, so the terms cost integer multiplies
+// and each series ends in a single division. Arguments are cut bit-burst style into pieces of
+// 8, 8, 16, 32, ... bits; the pieces' results combine by e^(a+b) = e^a e^b or angle addition.
+static GrapaInt _floatshl(const GrapaInt& v, s64 n)
+{
+	if (n == 0 || v.IsZero())
+		return v;
+	if (v.dataSigned)
+		return -_floatshl(-v, n);
+	GrapaInt t(v);
+	return n > 0 ? t << (u64)n : t >> (u64)(-n);
+}
 
-		GrapaFloat result(c13591409);
-		GrapaFloat temp(false, maxbits, pexp.mExtra, 0), temp2(false, maxbits, pexp.mExtra, 0);
-		s64 i = 0;
-		do
-		{
-			i++;
-			f1k = f1k * (i);
-			f3k = f3k * ((i * 3 - 2) * (i * 3 - 1) * (i * 3));
-			f6k = f6k * ((i * 6 - 5) * (i * 6 - 4) * (i * 6 - 3) * (i * 6 - 2) * (i * 6 - 1) * (i * 6));
-			c640320_pow = c640320.Pow(3 * i);
-			temp = (c13591409 + (c545140134 * i)) * f6k;
-			temp2 = c640320_pow * (f3k * f1k * f1k * f1k);
-			temp = temp / temp2;
-			result = result + temp;
-		} while (temp.mBits && temp.mExp > -pexp.mMax);
-
-		if (pexp.mBits != 1 || pexp.mData.GetItem(0) == 1)
-			temp = (result * c).Pow2(pexp);
-		else
-			temp = result * c;
-		temp2 = GrapaFloat(false, maxbits, pexp.mExtra, 1) / temp;
+static GrapaInt _floattofixed(const GrapaFloat& x, s64 w)
+{
+	GrapaInt v = _floatshl(x.mData, w + x.mExp - x.mBits + 1);
+	return x.mSigned ? -v : v;
+}
+
+static GrapaFloat _floatfromfixed(const GrapaInt& v, s64 w, s64 pMax, s64 pExtra)
+{
+	GrapaFloat result(true, pMax, pExtra, v);
+	if (!result.mData.IsZero())
+		result.mExp -= w;
+	result.Truncate();
+	return result;
+}
+
+static GrapaInt _floatfixmul(const GrapaInt& a, const GrapaInt& b, s64 w)
+{
+	return _floatshl(a * b, -w);
+}
+
+static GrapaInt _floatfixdiv(const GrapaInt& a, const GrapaInt& b, s64 w)
+{
+	if (b.IsZero())
+		return GrapaInt(0);
+	GrapaInt n = _floatshl(a.dataSigned ? -a : a, w);
+	GrapaInt q = n / (b.dataSigned ? -b : b);
+	return (a.dataSigned != b.dataSigned) ? -q : q;
+}
+
+static d64 _floatfixtodouble(const GrapaInt& v, s64 w)
+{
+	if (v.IsZero())
+		return 0.0;
+	GrapaInt a = v.dataSigned ? -v : v;
+	s64 bits = (s64)a.bitCount();
+	s64 shift = bits > 62 ? bits - 62 : 0;
+	if (shift)
+		a = a >> (u64)shift;
+	d64 d = ldexp((d64)a.LongValue(), (int)(shift - w));
+	return v.dataSigned ? -d : d;
+}
+
+static GrapaInt _floatfixfromdouble(d64 d, s64 w)
+{
+	return _floatshl(GrapaInt((s64)llround(ldexp(d, 52))), w - 52);
+}
+
+static d64 _floatlog2(const GrapaInt& v)
+{
+	s64 bits = (s64)(v.dataSigned ? -v : v).bitCount();
+	return log2(fabs(_floatfixtodouble(v, bits))) + bits;
+}
+
+// Terms a..b-1 of a series whose ratio of successive terms is pBase * pP(k) / (pQ(k) * 2^pShift).
+// On return T / Q is the sum over k in [a, b) of the ratios multiplied from a to k, and P is the
+// product of the numerators. pP is NULL for a constant numerator.
+static void _floatsplit(const GrapaInt& pBase, s64 (*pP)(s64), s64 (*pQ)(s64), s64 pShift, s64 a, s64 b, GrapaInt& P, GrapaInt& Q, GrapaInt& T)
+{
+	if (b - a == 1)
+	{
+		P = pP ? pBase * pP(a) : pBase;
+		Q = _floatshl(GrapaInt(pQ(a)), pShift);
+		T = P;
+		return;
+	}
+	s64 m = (a + b) / 2;
+	GrapaInt P2, Q2, T2;
+	_floatsplit(pBase, pP, pQ, pShift, a, m, P, Q, T);
+	_floatsplit(pBase, pP, pQ, pShift, m, b, P2, Q2, T2);
+	T = T * Q2 + P * T2;
+	P = P * P2;
+	Q = Q * Q2;
+}
+
+// 1 plus the series above from term 1, taking terms until they drop below 2^-w.
+static GrapaInt _floatseries(const GrapaInt& pBase, s64 (*pP)(s64), s64 (*pQ)(s64), s64 pShift, s64 w)
+{
+	GrapaInt one = GrapaInt(1) << (u64)w;
+	if (pBase.IsZero())
+		return one;
+	d64 lb = _floatlog2(pBase) - pShift;
+	d64 t = 0;
+	s64 n = 0;
+	while (t > -(d64)w - 4)
+	{
+		n++;
+		t += lb - log2((d64)pQ(n));
+		if (pP)
+			t += log2((d64)pP(n));
+	}
+	GrapaInt P, Q, T;
+	_floatsplit(pBase, pP, pQ, pShift, 1, n + 1, P, Q, T);
+	return one + _floatfixdiv(T, Q, w);
+}
+
+static s64 _floatqexp(s64 k) { return k; }
+static s64 _floatqsin(s64 k) { return (2 * k) * (2 * k + 1); }
+static s64 _floatqcos(s64 k) { return (2 * k - 1) * (2 * k); }
+static s64 _floatpln2(s64 k) { return 2 * k - 1; }
+static s64 _floatqln2(s64 k) { return 9 * (2 * k + 1); }
+
+// The bits of ax (scale w) from lo to hi places after the point, as an integer over 2^hi. The first
+// piece also carries the integer part.
+static GrapaInt _floatpiece(const GrapaInt& ax, s64 w, s64 lo, s64 hi)
+{
+	GrapaInt u = _floatshl(ax, hi - w);
+	if (lo > 0)
+		u = u - _floatshl(_floatshl(ax, lo - w), hi - lo);
+	return u;
+}
+
+static GrapaInt _floatfixexp(const GrapaInt& x, s64 w)
+{
+	GrapaInt ax = x.dataSigned ? -x : x;
+	GrapaInt result = GrapaInt(1) << (u64)w;
+	for (s64 lo = 0, hi = 8; lo < w; lo = hi, hi *= 2)
+	{
+		if (hi > w)
+			hi = w;
+		GrapaInt u = _floatpiece(ax, w, lo, hi);
+		if (u.IsZero())
+			continue;
+		GrapaInt e = _floatseries(x.dataSigned ? -u : u, NULL, _floatqexp, hi, w);
+		result = _floatfixmul(result, e, w);
+	}
+	return result;
+}
+
+// sin and cos of a non-negative fixed point x.
+static void _floatfixsincos(const GrapaInt& x, s64 w, GrapaInt& s, GrapaInt& c)
+{
+	s = GrapaInt(0);
+	c = GrapaInt(1) << (u64)w;
+	for (s64 lo = 0, hi = 8; lo < w; lo = hi, hi *= 2)
+	{
+		if (hi > w)
+			hi = w;
+		GrapaInt u = _floatpiece(x, w, lo, hi);
+		if (u.IsZero())
+			continue;
+		GrapaInt u2 = -(u * u);
+		GrapaInt sp = _floatfixmul(_floatshl(u, w - hi), _floatseries(u2, NULL, _floatqsin, 2 * hi, w), w);
+		GrapaInt cp = _floatseries(u2, NULL, _floatqcos, 2 * hi, w);
+		GrapaInt ns = _floatfixmul(s, cp, w) + _floatfixmul(c, sp, w);
+		c = _floatfixmul(c, cp, w) - _floatfixmul(s, sp, w);
+		s = ns;
+	}
+}
+
+// Working precisions for the Newton iterations below, each about double the one before, ending at w.
+static s64 _floatladder(s64 w, s64* pSteps)
+{
+	s64 n = 0;
+	for (s64 p = w; p > 48 && n < 64; p = p / 2 + 16)
+		pSteps[n++] = p;
+	return n;
+}
+
+// ln m for fixed point m in [1, 2) by Newton's iteration y += m e^-y - 1.
+static GrapaInt _floatfixln(const GrapaInt& m, s64 w)
+{
+	s64 steps[64];
+	s64 n = _floatladder(w, steps);
+	s64 wp = 52;
+	GrapaInt y = _floatfixfromdouble(log(_floatfixtodouble(m, w)), wp);
+	while (n--)
+	{
+		y = _floatshl(y, steps[n] - wp);
+		wp = steps[n];
+		GrapaInt e = _floatfixexp(-y, wp);
+		y = y + _floatfixmul(_floatshl(m, wp - w), e, wp) - (GrapaInt(1) << (u64)wp);
+	}
+	return _floatshl(y, w - wp);
+}
+
+// atan x for fixed point |x| <= 1 by Newton's iteration y += (x cos y - sin y) / (cos y + x sin y).
+static GrapaInt _floatfixatan(const GrapaInt& x, s64 w)
+{
+	s64 steps[64];
+	s64 n = _floatladder(w, steps);
+	s64 wp = 52;
+	GrapaInt y = _floatfixfromdouble(atan(_floatfixtodouble(x, w)), wp);
+	while (n--)
+	{
+		y = _floatshl(y, steps[n] - wp);
+		wp = steps[n];
+		GrapaInt xp = _floatshl(x, wp - w);
+		GrapaInt s, c;
+		_floatfixsincos(y.dataSigned ? -y : y, wp, s, c);
+		if (y.dataSigned)
+			s = -s;
+		y = y + _floatfixdiv(_floatfixmul(xp, c, wp) - s, c + _floatfixmul(xp, s, wp), wp);
+	}
+	return _floatshl(y, w - wp);
+}
+
+// ln 2 = 2 atanh(1/3) = (2/3) sum (1/9)^k / (2k+1).
+static GrapaFloat _floatln2(s64 pMax, s64 pExtra)
+{
+	s64 w = pMax + pExtra + 32;
+	GrapaInt v = _floatseries(GrapaInt(1), _floatpln2, _floatqln2, 0, w) * (s64)2;
+	v = v / (u64)3;
+	return _floatfromfixed(v, w, pMax, pExtra);
+}
+
+// Chudnovsky series for Pi to pMax bits.
+static GrapaFloat _floatpi(s64 pMax, s64 pExtra)
+{
+	s64 maxbits = pMax;
+	maxbits += pExtra + 2;
+	GrapaFloat c13591409(false, maxbits, pExtra, 13591409);
+	GrapaFloat c545140134(false, maxbits, pExtra, 545140134);
+	GrapaFloat c640320(false, maxbits, pExtra, 640320);
+	GrapaFloat c = GrapaFloat(false, maxbits, pExtra, 12) / ((c640320.Pow(3)).Root(2));
+
+	c640320.mSigned = true;
+
+	GrapaFloat f1k(false, maxbits, pExtra, 1);
+	GrapaFloat f3k(false, maxbits, pExtra, 1);
+	GrapaFloat f6k(false, maxbits, pExtra, 1);
+	GrapaFloat c640320_pow(false, maxbits, pExtra, 0);
+
+	GrapaFloat result(c13591409);
+	GrapaFloat temp(false, maxbits, pExtra, 0), temp2(false, maxbits, pExtra, 0);
+	s64 i = 0;
+	do
+	{
+		i++;
+		f1k = f1k * (i);
+		f3k = f3k * ((i * 3 - 2) * (i * 3 - 1) * (i * 3));
+		f6k = f6k * ((i * 6 - 5) * (i * 6 - 4) * (i * 6 - 3) * (i * 6 - 2) * (i * 6 - 1) * (i * 6));
+		c640320_pow = c640320.Pow(3 * i);
+		temp = (c13591409 + (c545140134 * i)) * f6k;
+		temp2 = c640320_pow * (f3k * f1k * f1k * f1k);
+		temp = temp / temp2;
+		result = result + temp;
+	} while (temp.mBits && temp.mExp > -pMax);
+
+	temp = result * c;
+	temp2 = GrapaFloat(false, maxbits, pExtra, 1) / temp;
+
+
+	temp2.mMax = pMax;
+	temp2.mFix = true;
+	temp2.Truncate();
 
+	return (temp2);
 
-		temp2.mMax = pexp.mMax;
-		temp2.mFix = true;
-		temp2.Truncate();
+	// (1).float(1000,10).pi()
+	// 247
+}
+
+// e^x = 2^k e^r with r = x - k ln 2 and |r| <= ln 2 / 2. e^r comes back as a fixed point v of scale w,
+// with w covering pBits fractional bits of e^x. Returns false when x is out of range.
+static bool _floatexpfixed(const GrapaFloat& x, s64 pBits, GrapaInt& v, s64& w, s64& k)
+{
+	d64 dx = x.ToDouble();
+	if (x.mNaN || !(fabs(dx) < 1.0e15))
+		return false;
+	k = (s64)floor(dx / 0.69314718055994530942 + 0.5);
+	w = pBits + 32 + (k > 0 ? k : 0);
+	if (k < -(pBits + 32))
+	{
+		v = GrapaInt(0);
+		return true;
+	}
+	s64 kb = 2;
+	for (s64 a = k < 0 ? -k : k; a; a >>= 1)
+		kb++;
+	GrapaInt r = _floattofixed(x, w + kb);
+	if (k)
+		r = r - _floattofixed(_floatconstant(gFloatLn2, true, w + kb, 0, _floatln2), w + kb) * k;
+	v = _floatfixexp(_floatshl(r, -kb), w);
+	return true;
+}
 
-		return (temp2);
+// sin and cos of x at scale w, from |x| = q pi / 2 + r with 0 <= r < pi / 2.
+static void _floatsincos(const GrapaFloat& x, s64 w, GrapaInt& s, GrapaInt& c)
+{
+	s64 w2 = w + 8 + (x.mExp > 0 ? x.mExp : 0);
+	GrapaFloat ax(x);
+	ax.mSigned = false;
+	GrapaInt X = _floattofixed(ax, w2);
+	GrapaInt half = _floattofixed(_floatconstant(gFloatPi, true, w2, 0, _floatpi), w2 - 1);
+	GrapaInt q = X / half;
+	GrapaInt rs, rc;
+	_floatfixsincos(_floatshl(X - q * half, w - w2), w, rs, rc);
+	switch (q.GetItem(0) & 3)
+	{
+	case 0: s = rs; c = rc; break;
+	case 1: s = rc; c = -rs; break;
+	case 2: s = -rs; c = -rc; break;
+	default: s = -rc; c = rs; break;
+	}
+	if (x.mSigned)
+		s = -s;
+}
 
-		// (1).float(1000,10).pi()
-		// 247
+GrapaFloat GrapaFloat::Pi(const GrapaFloat& pexp)
+{
+	if (pexp.mMax > 64)
+	{
+		if (_floatisone(pexp))
+			return _floatconstant(gFloatPi, true, pexp.mMax, pexp.mExtra, _floatpi);
+		GrapaFloat result = _floatconstant(gFloatPi, true, pexp.mMax + pexp.mExtra + 2, pexp.mExtra, _floatpi).Pow2(pexp);
+		result.mMax = pexp.mMax;
+		result.mFix = true;
+		result.Truncate();
+		return result;
 	}
 	else
 	{
@@ -837,78 +1279,36 @@ GrapaFloat GrapaFloat::Pi(const GrapaFloat& pexp)
 	*/
 }
 
-GrapaFloat GrapaFloat::E(const GrapaFloat& pexp)
+static GrapaFloat _floatexp(const GrapaFloat& pexp)
 {
-	GrapaFloat z(pexp);
-	if (z.mTrunc)
+	GrapaInt v;
+	s64 w, k;
+	if (!_floatexpfixed(pexp, pexp.mMax + pexp.mExtra, v, w, k))
 	{
-		z = GrapaFloat(true, pexp.mMax, pexp.mExtra, 1) * z;
-		z.mTrunc = false;
+		GrapaFloat result(true, pexp.mMax, pexp.mExtra, 0);
+		result.mNaN = true;
+		return result;
 	}
-	z.mFix = true;
-	z.mMax = pexp.mMax + pexp.mExtra;;
-	s64 maxbits = z.mMax;
-	GrapaFloat result(true, maxbits, pexp.mExtra, 1);
-	GrapaFloat pow(true, maxbits, pexp.mExtra, 1);
-	GrapaFloat fact(true, maxbits, pexp.mExtra, 1);
-	GrapaFloat temp(true, maxbits, pexp.mExtra, 0);
-	GrapaFloat lasttemp(true, maxbits, pexp.mExtra, 0);
-	s64 i = 0;
-	s64 oldExp = result.mExp;
-	temp.mExp = result.mExp;
-	bool checklasttemp = true;
-	do
-	{
-		i++;
-		oldExp = temp.mExp;
-		if (z.mExp != 0 || z.mBits>1)
-			pow = pow * z;
-		fact = fact * i;
-		pow.mFix = false;
-		pow.mMax = pow.mData.bitCount();
-		if (pow.mMax<maxbits)
-			pow.mMax = maxbits;
-		temp = pow / fact;
-		pow.mFix = true;
-		pow.mMax = maxbits;
-		result = result + temp;
-		if (checklasttemp && (temp.mExp > lasttemp.mExp || temp > lasttemp))
-		{
-			lasttemp = temp;
-			continue;
-		}
-		checklasttemp = false;
-
-	} while (temp.mExp > 0 || temp.mExp > -z.mMax);
-	result.mMax = pexp.mMax;
-	result.Truncate();
-	return(result);
-
-	/*
-	u64 n = pexp.mMax / 6;
-	GrapaCHAR estr("2.");
-	u64 prec=10^n;
-	*/
-
-	/*
-	def espig(n):
-		estr = '2.'
-		prec = 10 ** n
-		ys = [1 for _ in range(2, n + 1)]
-
-		while len(estr) <= n:
-			carover, asum, remainders = 0, 0, []
+	return _floatfromfixed(v, w - k, pexp.mMax, pexp.mExtra);
+}
 
-			for x, y in zip(range(n, 1, -1), ys):
-				asum = carover + prec * y
-				carover, remainder = divmod(asum, x)
-				remainders.append(remainder)
+static GrapaFloat _floate(s64 pMax, s64 pExtra)
+{
+	return _floatexp(GrapaFloat(true, pMax, pExtra, 1));
+}
 
-			ys = remainders
-		estr += str(asum // 2)
+GrapaFloat GrapaFloat::E(const GrapaFloat& pexp)
+{
+	if (_floatisone(pexp))
+		return _floatconstant(gFloatE, true, pexp.mMax, pexp.mExtra, _floate);
+	return _floatexp(pexp);
+}
 
-	return estr
-	*/
+void GrapaFloat::PrecomputeConstants(s64 pMax, s64 pExtra)
+{
+	_floatconstant(gFloatPi, true, pMax + pExtra + 2, pExtra, _floatpi);
+	_floatconstant(gFloatE, true, pMax, pExtra, _floate);
+	_floatconstant(gFloatLn2, true, pMax + pExtra, pExtra, _floatln2);
 }
 
 GrapaFloat GrapaFloat::Abs() const
@@ -919,60 +1319,33 @@ GrapaFloat GrapaFloat::Abs() const
 
 GrapaFloat GrapaFloat::LnBase() const
 {
-	GrapaFloat z(*this);
-	if (z.mTrunc)
+	if (mNaN || mData.IsZero())
 	{
-		z = z * GrapaFloat(mFix, mMax, mExtra, 1);
-		z.mTrunc = false;
+		GrapaFloat result(mFix, mMax, mExtra, 0);
+		result.mNaN = true;
+		return result;
 	}
-	z.mFix = true;
-	z.mMax += mExtra;
-	s64 maxbits = z.mMax;
-	z.mSigned = false;
-	GrapaFloat one(true, maxbits, mExtra, 1);
-	GrapaFloat m((z - one) / (z + one));
-	GrapaFloat m2 (m*m);
-	GrapaFloat result(m);
-	GrapaFloat zpow(m);
-	GrapaFloat temp(true, maxbits, mExtra, 0);
-	GrapaFloat lasttemp(true, maxbits, mExtra, 0);
-	s64 i = 0;
-	s64 oldExp = z.mExp;
-	temp.mExp = z.mExp;
-	bool checklasttemp = true;
-	do
+	// |z| = m 2^e with m in [1, 2), so ln |z| = ln m + e ln 2.
+	GrapaFloat m(*this);
+	m.mSigned = false;
+	s64 e = m.mExp;
+	m.mExp = 0;
+	s64 w = mMax + mExtra + 32;
+	for (s64 a = e < 0 ? -e : e; a; a >>= 1)
+		w++;
+	GrapaInt d = _floattofixed(m, w) - (GrapaInt(1) << (u64)w);
+	if (e == 0)
 	{
-		i++;
-		oldExp = temp.mExp;
-		zpow = zpow * m2;
-		zpow.mFix = false;
-		zpow.mMax = zpow.mData.bitCount();
-		if (zpow.mMax<maxbits)
-			zpow.mMax = maxbits;
-		temp = zpow / GrapaFloat(true, maxbits, mExtra, 2 * i + 1);
-		zpow.mFix = true;
-		zpow.mMax = maxbits;
-		result = result + temp;
-
-		if (temp.mExp >= oldExp)
-		{
-			if (temp == lasttemp)
-				break;
-			lasttemp = temp;
-		}
-
-		if (checklasttemp && (temp.mExp > lasttemp.mExp || temp > lasttemp))
-		{
-			lasttemp = temp;
-			continue;
-		}
-		checklasttemp = false;
-
-	} while (temp.mExp > 0 || temp.mExp > -z.mMax);
-
-	result.mExp++;
+		if (d.IsZero())
+			return GrapaFloat(mFix, mMax, mExtra, 0);
+		if (!mFix)
+			w += w - (s64)d.bitCount();
+	}
+	GrapaInt y = _floatfixln(_floattofixed(m, w), w);
+	if (e)
+		y = y + _floattofixed(_floatconstant(gFloatLn2, true, w, 0, _floatln2), w) * e;
+	GrapaFloat result = _floatfromfixed(y, w, mMax, mExtra);
 	result.mFix = mFix;
-	result.mMax = mMax;
 	result.Truncate();
 	return(result);
 }
@@ -998,7 +1371,7 @@ GrapaFloat GrapaFloat::Log(const GrapaFloat& bx) const
 	s64 maxbits = z.mMax;
 	b.mMax = z.mMax;
 	z.mSigned = false;
-	GrapaFloat twoln = GrapaFloat(true, maxbits, ext, 2).LnBase();
+	GrapaFloat twoln = _floatconstant(gFloatLn2, true, maxbits, ext, _floatln2);
 	GrapaFloat ze(true, maxbits, ext, z.mExp);
 	GrapaFloat be(true, maxbits, ext, b.mExp);
 	z.mExp = 0;
@@ -1028,10 +1401,9 @@ GrapaFloat GrapaFloat::Ln() const
 	z.mMax += mExtra;
 	s64 maxbits = z.mMax;
 	z.mSigned = false;
-	GrapaFloat two(false, maxbits, mExtra, 2);
 	GrapaFloat p(false, maxbits, mExtra, z.mExp);
 	z.mExp = 0;
-	GrapaFloat result = z.LnBase() + (two.LnBase()*p);
+	GrapaFloat result = z.LnBase() + (_floatconstant(gFloatLn2, false, maxbits, mExtra, _floatln2) * p);
 	result.mFix = mFix;
 	result.mMax = mMax;
 	result.Truncate();
@@ -1040,311 +1412,39 @@ GrapaFloat GrapaFloat::Ln() const
 
 GrapaFloat GrapaFloat::Sin() const
 {
-	GrapaFloat sin(*this);
-	sin.mMax += 4;
-	GrapaFloat one(mFix, mMax, mExtra, 1);
-	if (sin.mTrunc)
-	{
-		sin = sin * one;
-		sin.mTrunc = false;
-	}
-	bool oldfix = sin.mFix;
-	sin.mFix = true;
-	bool sign_sin = sin.mSigned;
-	sin.mSigned = false;
-
-	GrapaFloat pi = Pi(one);
-
-	pi.mExp++;
-	if (sin > pi)
-	{
-		sin = sin % pi;
-	}
-	pi.mExp--;
-
-	if (sin > pi)
-	{
-		sign_sin = !sign_sin;
-		sin = sin % pi;
-	}
-
-	pi.mExp--;
-	if (sin > pi)
-	{
-		pi.mExp++;
-		sin = sin - pi;
-		sin.mSigned = !sin.mSigned;
-	}
-	else
-		pi.mExp++;
-
-	GrapaFloat fact(true, mMax, mExtra, 1);
-	GrapaFloat temp(true, mMax, mExtra, 0);
-	GrapaFloat lasttemp(true, mMax, mExtra, 0);
-	GrapaFloat radpow(sin);
-	GrapaFloat rad2(sin*sin);
-	u64 i = 0;
-	s64 oldExp = sin.mExp;
-	temp.mExp = sin.mExp;
-	bool checklasttemp = true;
-	do
-	{
-		i++;
-		oldExp = temp.mExp;
-		radpow = radpow * rad2;
-		radpow.mSigned = ((i % 2) == 1) ? true : false;
-		fact = fact * GrapaFloat(true, mMax, mExtra, (2 * i) * (2 * i + 1));
-
-		radpow.mFix = false;
-		radpow.mMax = radpow.mData.bitCount();
-		if (radpow.mMax< mMax)
-			radpow.mMax = mMax;
-		temp = radpow / fact;
-		radpow.mFix = true;
-		radpow.mMax = mMax;
-
-		sin = sin + temp;
-
-		if (checklasttemp && (temp.mExp > lasttemp.mExp || temp > lasttemp))
-		{
-			lasttemp = temp;
-			continue;
-		}
-		checklasttemp = false;
-
-	} while (temp.mExp > 0 || temp.mExp > -sin.mMax);
-
-	if (sign_sin)
-		sin.mSigned = true;
-
-	sin.mFix = true;
-	sin.mMax = mMax-4;
-	sin.Truncate();
-
-	return(sin);
+	if (mNaN)
+		return *this;
+	s64 w = mMax + mExtra + 32;
+	GrapaInt s, c;
+	_floatsincos(*this, w, s, c);
+	return _floatfromfixed(s, w, mMax - 4, mExtra);
 }
 
 GrapaFloat GrapaFloat::Cos() const
 {
-	GrapaFloat rad(*this);
-	GrapaFloat one(mFix, mMax, mExtra, 1);
-	if (rad.mTrunc)
-	{
-		rad = rad * one;
-		rad.mTrunc = false;
-	}
-	bool oldfix = rad.mFix;
-	rad.mFix = true;
-	rad.mSigned = false;
-
-	GrapaFloat pi = Pi(one);
-
-	pi.mExp++;
-	if (rad > pi)
-	{
-		rad = rad % pi;
-	}
-	pi.mExp--;
-
-	bool sign_cos = false;
-	bool maybesign_cos = false;
-
-	pi.mExp--;
-	if (rad > pi)
-		maybesign_cos = true;
-	pi.mExp++;
-
-	if (rad > pi)
-	{
-		rad = rad % pi;
-		pi.mExp--;
-		if (rad < pi && maybesign_cos)
-			sign_cos = true;
-		pi.mExp++;
-	}
-	else if (maybesign_cos)
-	{
-		sign_cos = true;
-	}
-
-	pi.mExp--;
-	if (rad > pi)
-	{
-		pi.mExp++;
-		rad = rad - pi;
-		rad.mSigned = !rad.mSigned;
-	}
-	else
-		pi.mExp++;
-
-	GrapaFloat cos(true, mMax, mExtra,1);
-	GrapaFloat fact(true, mMax, mExtra, 1);
-	GrapaFloat temp(true, mMax, mExtra, 0);
-	GrapaFloat lasttemp(true, mMax, mExtra, 0);
-	GrapaFloat radpow(true, mMax, mExtra, 1);
-	GrapaFloat rad2(rad*rad);
-	u64 i = 0;
-	s64 oldExp = rad.mExp;
-	temp.mExp = rad.mExp;
-	bool checklasttemp = true;
-	do
-	{
-		i++;
-		oldExp = temp.mExp;
-		radpow = radpow * rad2;
-		radpow.mSigned = ((i % 2) == 1) ? true : false;
-		fact = fact * (s64)((2 * i - 1) * (2 * i));
-
-		radpow.mFix = false;
-		radpow.mMax = radpow.mData.bitCount();
-		if (radpow.mMax< mMax)
-			radpow.mMax = mMax;
-		temp = radpow / fact;
-		radpow.mFix = true;
-		radpow.mMax = mMax;
-
-		cos = cos + temp;
-
-		if (checklasttemp && (temp.mExp > lasttemp.mExp || temp > lasttemp))
-		{
-			lasttemp = temp;
-			continue;
-		}
-		checklasttemp = false;
-
-	} while (temp.mExp > 0 || temp.mExp > -rad.mMax);
-
-
-	cos.mSigned = sign_cos;
-
-	cos.mFix = true;
-	cos.mMax = mMax;
-	cos.Truncate();
-
-	return(cos);
+	if (mNaN)
+		return *this;
+	s64 w = mMax + mExtra + 32;
+	GrapaInt s, c;
+	_floatsincos(*this, w, s, c);
+	return _floatfromfixed(c, w, mMax, mExtra);
 }
 
 GrapaFloat GrapaFloat::Tan() const
 {
-	GrapaFloat rad(*this);
-	if (rad.mTrunc)
-	{
-		rad = rad * GrapaFloat(mFix, mMax, mExtra, 1);
-		rad.mTrunc = false;
-	}
-	bool oldfix = rad.mFix;
-	rad.mFix = true;
-	rad.mSigned = false;
-
-	GrapaFloat one(mFix, mMax, mExtra, 1);
-	GrapaFloat pi = Pi(one);
-
-	bool sign_sin = rad.mSigned;
-	bool sign_cos = false;
-	bool maybesign_cos = false;
-	rad.mSigned = false;
-
-	pi.mExp++;
-	if (rad > pi)
-	{
-		rad = rad % pi;
-
-	}
-	pi.mExp--;
-
-	pi.mExp--;
-	if (rad > pi)
-		maybesign_cos = true;
-	pi.mExp++;
-
-	if (rad > pi)
-	{
-		sign_sin = !sign_sin;
-		rad = rad % pi;
-		pi.mExp--;
-		if (rad < pi && maybesign_cos)
-			sign_cos = true;
-		pi.mExp++;
-	}
-	else if (maybesign_cos)
-	{
-		sign_cos = true;
-	}
-
-	pi.mExp--;
-	if (rad > pi)
+	if (mNaN)
+		return *this;
+	s64 w = mMax + mExtra + 32;
+	GrapaInt s, c;
+	_floatsincos(*this, w, s, c);
+	// Near a pole cos has few significant bits left; recompute with enough to cover the quotient.
+	s64 lost = w - (s64)(c.dataSigned ? -c : c).bitCount();
+	if (lost > 16)
 	{
-		pi.mExp++;
-		rad = rad - pi;
-		rad.mSigned = !rad.mSigned;
+		w += 2 * lost;
+		_floatsincos(*this, w, s, c);
 	}
-	else
-		pi.mExp++;
-
-	GrapaFloat sin(rad);
-	GrapaFloat cos(true, mMax, mExtra, 1);
-	GrapaFloat fact(true, mMax, mExtra, 1);
-	GrapaFloat temp(true, mMax, mExtra, 0);
-	GrapaFloat lasttemp(true, mMax, mExtra, 0);
-	GrapaFloat radpow(rad);
-
-	u64 i = 0;
-	s64 oldExp = rad.mExp;
-	temp.mExp = rad.mExp;
-	bool checklasttemp = true;
-	do
-	{
-		i++;
-		oldExp = temp.mExp;
-		radpow = radpow * rad;
-		radpow.mSigned = ((i % 2) == 1) ? true : false;
-		fact = fact * (s64)(2 * i);
-
-		radpow.mFix = false;
-		radpow.mMax = radpow.mData.bitCount();
-		if (radpow.mMax< mMax)
-			radpow.mMax = mMax;
-		temp = radpow / fact;
-		radpow.mFix = true;
-		radpow.mMax = mMax;
-
-		cos = cos + temp;
-
-		radpow = radpow * rad;
-		radpow.mSigned = ((i % 2) == 1) ? true : false;
-		fact = fact * (s64)(2 * i + 1);
-
-		radpow.mFix = false;
-		radpow.mMax = radpow.mData.bitCount();
-		if (radpow.mMax< mMax)
-			radpow.mMax = mMax;
-		temp = radpow / fact;
-		radpow.mFix = true;
-		radpow.mMax = mMax;
-
-		sin = sin + temp;
-
-		if (checklasttemp && (temp.mExp > lasttemp.mExp || temp > lasttemp))
-		{
-			lasttemp = temp;
-			continue;
-		}
-		checklasttemp = false;
-
-	} while (temp.mExp > 0 || temp.mExp > -rad.mMax);
-
-	if (sign_sin)
-		sin.mSigned = true;
-
-	cos.mSigned = sign_cos;
-
-	GrapaFloat tan = sin / cos;
-
-	tan.mFix = true;
-	tan.mMax = mMax;
-	tan.Truncate();
-
-	return(tan);
+	return _floatfromfixed(_floatfixdiv(s, c, w), w, mMax, mExtra);
 }
 
 GrapaFloat GrapaFloat::Cot() const
@@ -1426,66 +1526,10 @@ GrapaFloat GrapaFloat::ACos() const
 GrapaFloat GrapaFloat::ATan() const
 {
 	if (mExp > 0 || (mExp == 0 && mBits > 1)) return(GrapaFloat(mFix,mMax, mExtra,0));
-	GrapaFloat rad(*this);
-	if (rad.mTrunc)
-	{
-		rad = rad * GrapaFloat(mFix, mMax, mExtra, 1);
-		rad.mTrunc = false;
-	}
-	if (rad.mFix)
-	{
-		rad.mFix = false;
-		if ((rad.mExp + 1) >= 0)
-			rad.mMax += (rad.mExp + 1);
-	}
-	rad.mMax += mExtra;
-	s64 maxbits = rad.mMax;
-	GrapaFloat pow(rad);
-	GrapaFloat pow2(rad*rad);
-	GrapaFloat pow2plusone(pow2+GrapaFloat(false,maxbits, mExtra,1));
-	GrapaFloat two(false, maxbits, mExtra, 2);
-	GrapaFloat twopow(false, maxbits, mExtra, 0);
-	GrapaFloat nfact(false, maxbits, mExtra, 1);
-	GrapaFloat nfactsq(false, maxbits, mExtra, 1);
-	GrapaFloat twonfact(false, maxbits, mExtra, 1);
-	GrapaFloat zpow(false, maxbits, mExtra, 1);
-	GrapaFloat temp(false, maxbits, mExtra, 0);
-	GrapaFloat lasttemp(false, maxbits, mExtra, 0);
-	GrapaFloat result(rad/(pow2+GrapaFloat(false,maxbits, mExtra,1)));
-	s64 i = 0;
-	s64 oldExp = rad.mExp;
-	temp.mExp = rad.mExp;
-	bool checklasttemp = true;
-	do
-	{
-		i++;
-		oldExp = temp.mExp;
-
-		twopow = two.Pow(2 * i);
-		nfact = nfact * GrapaFloat(false, maxbits, mExtra, i);
-		nfactsq = nfact * nfact;
-		twonfact = twonfact * GrapaFloat(false, maxbits, mExtra, (i*2) * (i * 2 + 1));
-		
-		pow = pow * pow2;
-		zpow = pow2plusone.Pow(i + 1);
-		temp = (twopow*nfactsq*pow) / (twonfact*zpow);
-
-		result = result + temp;
-
-		if (checklasttemp && (temp.mExp > lasttemp.mExp || temp > lasttemp))
-		{
-			lasttemp = temp;
-			continue;
-		}
-		checklasttemp = false;
-
-	} while (temp.mExp > 0 || temp.mExp > -rad.mMax);
-
-	result.mFix = true;
-	result.mMax = mMax;
-	result.Truncate();
-
-	return(result);
+	if (mNaN)
+		return *this;
+	s64 w = mMax + mExtra + 32;
+	return _floatfromfixed(_floatfixatan(_floattofixed(*this, w), w), w, mMax, mExtra);
 }
 
 GrapaFloat GrapaFloat::ACot() const
@@ -1517,112 +1561,38 @@ GrapaFloat GrapaFloat::ACsc() const
 
 GrapaFloat GrapaFloat::SinH() const
 {
-	GrapaFloat sin(*this);
-	if (sin.mTrunc)
+	GrapaFloat ax(*this);
+	ax.mSigned = false;
+	GrapaInt v;
+	s64 w, k;
+	if (!_floatexpfixed(ax, mMax + mExtra, v, w, k))
 	{
-		sin = sin * GrapaFloat(mFix, mMax, mExtra, 1);
-		sin.mTrunc = false;
+		GrapaFloat result(true, mMax, mExtra, 0);
+		result.mNaN = true;
+		return result;
 	}
-	sin.mFix = true;
-	bool sign_sin = sin.mSigned;
-	sin.mSigned = false;
-
-	GrapaFloat fact(true, mMax, mExtra, 1);
-	GrapaFloat temp(true, mMax, mExtra, 0);
-	GrapaFloat lasttemp(true, mMax, mExtra, 0);
-	GrapaFloat radpow(sin);
-	GrapaFloat rad2(sin*sin);
-	u64 i = 0;
-	s64 oldExp = sin.mExp;
-	temp.mExp = sin.mExp;
-	bool checklasttemp = true;
-	do
-	{
-		i++;
-		oldExp = temp.mExp;
-		radpow = radpow * rad2;
-		fact = fact * GrapaFloat(true, mMax, mExtra, (2 * i) * (2 * i + 1));
-
-		radpow.mFix = false;
-		radpow.mMax = radpow.mData.bitCount();
-		if (radpow.mMax< mMax)
-			radpow.mMax = mMax;
-		temp = radpow / fact;
-		radpow.mFix = true;
-		radpow.mMax = mMax;
-
-		sin = sin + temp;
-
-		if (checklasttemp && (temp.mExp > lasttemp.mExp || temp > lasttemp))
-		{
-			lasttemp = temp;
-			continue;
-		}
-		checklasttemp = false;
-
-	} while (temp.mExp > 0 || temp.mExp > -sin.mMax);
-
-	if (sign_sin)
-		sin.mSigned = true;
-
-	sin.mFix = true;
-	sin.mMax = mMax;
-	sin.Truncate();
-
-	return(sin);
+	// (e^x - e^-x) / 2 with e^x = v 2^k and e^-x = 2^-k / v.
+	GrapaInt d = _floatshl(v, k) - _floatshl(_floatfixdiv(GrapaInt(1) << (u64)w, v, w), -k);
+	GrapaFloat result = _floatfromfixed(d, w + 1, mMax, mExtra);
+	if (mSigned && !result.mData.IsZero())
+		result.mSigned = true;
+	return(result);
 }
 
 GrapaFloat GrapaFloat::CosH() const
 {
-	GrapaFloat rad(*this);
-	if (rad.mTrunc)
+	GrapaFloat ax(*this);
+	ax.mSigned = false;
+	GrapaInt v;
+	s64 w, k;
+	if (!_floatexpfixed(ax, mMax + mExtra, v, w, k))
 	{
-		rad = rad * GrapaFloat(mFix, mMax, mExtra, 1);
-		rad.mTrunc = false;
+		GrapaFloat result(true, mMax, mExtra, 0);
+		result.mNaN = true;
+		return result;
 	}
-	rad.mFix = true;
-
-	GrapaFloat cos(true, mMax, mExtra, 1);
-	GrapaFloat fact(true, mMax, mExtra, 1);
-	GrapaFloat temp(true, mMax, mExtra, 0);
-	GrapaFloat lasttemp(true, mMax, mExtra, 0);
-	GrapaFloat radpow(true, mMax, mExtra, 1);
-	GrapaFloat rad2(rad*rad);
-	u64 i = 0;
-	s64 oldExp = rad.mExp;
-	temp.mExp = rad.mExp;
-	bool checklasttemp = true;
-	do
-	{
-		i++;
-		oldExp = temp.mExp;
-		radpow = radpow * rad2;
-		fact = fact * (s64)((2 * i - 1) * (2 * i));
-
-		radpow.mFix = false;
-		radpow.mMax = radpow.mData.bitCount();
-		if (radpow.mMax< mMax)
-			radpow.mMax = mMax;
-		temp = radpow / fact;
-		radpow.mFix = true;
-		radpow.mMax = mMax;
-
-		cos = cos + temp;
-
-		if (checklasttemp && (temp.mExp > lasttemp.mExp || temp > lasttemp))
-		{
-			lasttemp = temp;
-			continue;
-		}
-		checklasttemp = false;
-
-	} while (temp.mExp > 0 || temp.mExp > -cos.mMax);
-
-	cos.mFix = true;
-	cos.mMax = mMax;
-	cos.Truncate();
-
-	return(cos);
+	GrapaInt d = _floatshl(v, k) + _floatshl(_floatfixdiv(GrapaInt(1) << (u64)w, v, w), -k);
+	return _floatfromfixed(d, w + 1, mMax, mExtra);
 }
 
 GrapaFloat GrapaFloat::TanH() const
@@ -1957,11 +1927,6 @@ void GrapaFloat::FromString(const GrapaBYTE& pIn, u8 radix, s64 max)
 			bits = ((radix == 2) ? 1 : (radix == 4) ? 2 : (radix == 8) ? 3 : 4) * s2.mLength;
 			break;
 		case 10:
-			for (lead = 0; lead < s2.mLength; lead++)
-			{
-				s2.mBytes[lead] -= '0';
-				if (s2.mBytes[lead]) break;
-			}
 			if (max == 0)
 			{
 				max = mMax+mExtra;
@@ -1973,6 +1938,31 @@ void GrapaFloat::FromString(const GrapaBYTE& pIn, u8 radix, s64 max)
 					max = (s64)s2.mLength * 8;
 			}
 			max = max / 6;
+			for (lead = 0; lead < s2.mLength && s2.mBytes[lead] >= '0' && s2.mBytes[lead] <= '9'; lead++);
+			if (s2.mLength > 64 && lead == s2.mLength)
+			{
+				// Long fractions take floor(f * 2^(8*max)) from one division instead of doubling digit by digit.
+				GrapaInt f, q, r;
+				f.FromString(s2, 10);
+				q = (f << (u64)(max * 8)).Div(GrapaInt(10).Pow(GrapaInt((s64)s2.mLength)), r);
+				if (q.IsZero())
+				{
+					mTrunc = true;
+					bits = 0;
+					break;
+				}
+				lead = q.bitStart();
+				n2 = q >> lead;
+				bits = max * 8 - lead;
+				if (!r.IsZero() || (bits + 7) / 8 >= max)
+					mTrunc = true;
+				break;
+			}
+			for (lead = 0; lead < s2.mLength; lead++)
+			{
+				s2.mBytes[lead] -= '0';
+				if (s2.mBytes[lead]) break;
+			}
 			for (lead = lead + 1; lead < s2.mLength; lead++)
 				s2.mBytes[lead] -= '0';
 			bucket.SetSize(max + 1);
@@ -2289,6 +2279,41 @@ GrapaInt GrapaFloat::ToInt()
 	return mSigned ? -a : a;
 }
 
+d64 GrapaFloat::ToDouble() const
+{
+	if (mNaN)
+		return NAN;
+	if (mData.IsZero())
+		return mSigned ? -0.0 : 0.0;
+	GrapaInt a(mData);
+	s64 bits = (s64)a.bitCount();
+	s64 shift = 0;
+	if (bits > 63)
+	{
+		shift = bits - 63;
+		a = a >> (u64)shift;
+	}
+	d64 v = ldexp((d64)(u64)a.LongValue(), (int)(mExp - mBits + 1 + shift));
+	return mSigned ? -v : v;
+}
+
+// Sets pValue and returns true when the value is exactly a double; see _floatnative.
+bool GrapaFloat::IsDouble(d64& pValue) const
+{
+	return _floatnative(*this, pValue);
+}
+
+// Takes the exact value of a finite double. mMax should hold 53 bits, or the value is truncated.
+void GrapaFloat::FromDouble(d64 pValue)
+{
+	mNaN = mTrunc = false;
+	mSigned = false;
+	if (pValue == 0.0)
+		FromInt(GrapaInt(0));
+	else
+		_floatfromnative(*this, pValue);
+}
+
 void GrapaFloat::FromInt(const GrapaInt& bi)
 {
 	if (bi.dataSigned)
@@ -73,6 +73,7 @@ public:
 	GrapaFloat Root2(const GrapaFloat& pexp) const;
 	static GrapaFloat Pi(const GrapaFloat& pexp);
 	static GrapaFloat E(const GrapaFloat& pexp);
+	static void PrecomputeConstants(s64 pMax, s64 pExtra);
 	GrapaFloat Abs() const;
 	GrapaFloat LnBase() const;
 	GrapaFloat Log(const GrapaFloat& b) const;
@@ -107,8 +108,11 @@ public:
 	GrapaCHAR ToString(u8 radix);
 	bool IsInt();
 	bool IsZero();
+	bool IsDouble(d64& pValue) const;
 	GrapaInt ToInt();
+	d64 ToDouble() const;
 	void FromInt(const GrapaInt& bi);
+	void FromDouble(d64 pValue);
 	void FromString(const GrapaBYTE& result, u8 radix, s64 max = 0);
 	void FromBytes(const GrapaBYTE& result);
 	GrapaBYTE getBytes() const;
@@ -23,6 +23,11 @@ limitations under the License.
 #include "GrapaState.h"
 #include "GrapaSystem.h"
 
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
 extern GrapaSystem* gSystem;
 
 #define NAME_INDEX_ID (1)
@@ -38,20 +43,64 @@ extern GrapaSystem* gSystem;
 #define VALUE_FIELD_SIZE 32
 #define VALUE_FIELD_GROW 8
 
+void GrapaGroupCritical::LeaveCritical()
+{
+	u64 end;
+	if (mTree)
+		mTree->Commit(false, end);
+	GrapaCritical::LeaveCritical();
+}
+
+// Takes the lock for a write, or returns false without it while another handle's transaction is
+// open. Waiting could never end when that handle is on the same thread.
+bool GrapaGroupCritical::WaitWrite()
+{
+	WaitCritical();
+	if (vOwner && vOwner != GrapaGroupHandle::Current())
+	{
+		GrapaCritical::LeaveCritical();
+		return(false);
+	}
+	return(true);
+}
+
+static thread_local const void* gGroupHandle = NULL;
+
+GrapaGroupHandle::GrapaGroupHandle(const void* pHandle)
+{
+	vPrev = gGroupHandle;
+	gGroupHandle = pHandle;
+}
+
+GrapaGroupHandle::~GrapaGroupHandle()
+{
+	gGroupHandle = vPrev;
+}
+
+const void* GrapaGroupHandle::Current()
+{
+	return(gGroupHandle);
+}
+
 GrapaGroup::GrapaGroup() 
 { 
+	mCritical.mTree = &mTree;
 	mRootTable = 0; 
 	mRootType = 0; 
 }
 
 GrapaGroup::GrapaGroup(GrapaFile*pFile) 
 { 
+	mCritical.mTree = &mTree;
 	INIT(pFile); 
 }
 
 GrapaGroup::~GrapaGroup() 
 { 
 	if (mFile) mFile->Flush(); 
+	// mTree is destroyed before the GrapaBtree base, so close the file through it here.
+	mTree.Close();
+	mFile = NULL;
 	mRootTable = 0; 
 	mRootType = 0; 
 }
@@ -284,7 +333,7 @@ GrapaError GrapaGroup::DeleteGroup(u64 parentTree, u8 parentType, const GrapaCHA
 	u64 tableId;
 	err = OpenGroup(parentTree, parentType, pTableName, newDirId, newDirType,tableId);
 	if (err) return(err);
-	mCritical.WaitCritical();
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
 	err = DeleteTable(parentTree, tableId);
 	mCritical.LeaveCritical();
 	return(err);
@@ -302,7 +351,7 @@ GrapaError GrapaGroup::CreateGroup(u64 parentTree, u8 parentType, GrapaCHAR pTab
 
 GrapaError GrapaGroup::CreateGroup(u64 parentTree, u8 parentType, GrapaCHAR pTableName, u8 listType, u64 & pNewTree)
 {
-	mCritical.WaitCritical();
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
 
 	GrapaError err;
 	GrapaDBCursor cursor;
@@ -620,7 +669,7 @@ GrapaError GrapaGroup::OpenGroup(u64 parentTree, u8 parentType, u64 pId, u64& pN
 GrapaError GrapaGroup::CreateEntry(u64 parentTree, u8 parentType, const GrapaCHAR& pDataName, u64& pId)
 {
 	pId = 0;
-	mCritical.WaitCritical();
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
 
 	GrapaError err;
 	GrapaDBCursor cursor;
@@ -710,67 +759,631 @@ GrapaError GrapaGroup::CreateEntry(u64 parentTree, u8 parentType, const GrapaCHA
 
 	if (pDataName.mLength && pDataName.mBytes)
 	{
-		if (nameId == 0 || OpenTableField(parentDict, nameId, dbFieldName) != 0)
+		err = CreateNameField(parentTree, parentType, parentDict, nameId);
+		if (err)
 		{
-			err = NextNameId(parentTree, parentType, nameId);
+			mCritical.LeaveCritical();
+			return(err);
+		}
+
+		cursor.Set(parentDict.mRecRef, RREC_ITEM, dataId);
+		err = Search(cursor);
+		if (err)
+		{
+			mCritical.LeaveCritical();
+			return(err);
+		}
+		{
+			GrapaDBFieldValueArray data;
+			data.Append(this, parentDict, nameId, pDataName, EQ_CMP);
+			err = SetRecordField(cursor, data);
 			if (err)
 			{
 				mCritical.LeaveCritical();
 				return(err);
 			}
-			if (nameId == 0)
+		}
+	}
+
+	mCritical.LeaveCritical();
+	return(0);
+}
+
+// Makes sure the table has its $KEY field and the name index over it. pNameId is the field id,
+// or 0 if the table has none yet.
+GrapaError GrapaGroup::CreateNameField(u64 parentTree, u8 parentType, GrapaDBTable& parentDict, u64& pNameId)
+{
+	GrapaError err;
+	GrapaDBField dbFieldName;
+
+	if (pNameId && OpenTableField(parentDict, pNameId, dbFieldName) == 0)
+		return(0);
+
+	err = NextNameId(parentTree, parentType, pNameId);
+	if (err) return(err);
+	if (pNameId == 0) return(-1);
+
+	GrapaCHAR fieldNameLabel("$KEY");
+	dbFieldName.Init(pNameId, NAME_FIELD_TYPE, NAME_FIELD_STORE, NAME_FIELD_SIZE, NAME_FIELD_GROW);
+	err = CreateTableField(parentDict, dbFieldName, fieldNameLabel);
+	if (err) return(err);
+	err = SetNameId(parentTree, parentType, pNameId);
+	if (err) return(err);
+
+	GrapaDBIndex dbIndexName;
+	GrapaDU64Array catIndexList(1);
+	catIndexList.Append(NAME_INDEX_FIELD_NAME_ID, pNameId);
+	return CreateIndex(parentDict, NAME_INDEX_ID, catIndexList, dbIndexName);
+}
+
+// Adds a batch of entries to a table. An empty row table is loaded bottom-up: the entries are
+// sorted by name, their records written one after another, and the record tree and each index
+// built in one pass. Anything else gets one SetField per value. A name given twice keeps its
+// last values. pCount is the number of entries loaded.
+GrapaError GrapaGroup::LoadEntries(u64 parentTree, u8 parentType, GrapaGroupBatch& pBatch, u64& pCount)
+{
+	GrapaError err;
+	GrapaDBCursor cursor;
+	GrapaDBTable parentDict;
+	u64 indexRef, nameId = 0, itemCount = 0, firstId = 0, i, j, row;
+	u64 fieldCount = pBatch.mFields.size();
+	u8 treeType = 0;
+
+	pCount = 0;
+	if (pBatch.mValues.size() != pBatch.mNames.size() * fieldCount) return(-1);
+	for (i = 0; i < pBatch.mNames.size(); i++)
+	{
+		if (pBatch.mNames[i].mLength == 0 || pBatch.mNames[i].mBytes == NULL)
+			return(-1);
+	}
+
+	// In the order the name index keeps them, so the records are written in that order too.
+	std::vector<u64> order(pBatch.mNames.size()), rows;
+	for (i = 0; i < order.size(); i++)
+		order[i] = i;
+	auto name = [&](u64 r) { return (const char*)pBatch.mNames[r].mBytes; };
+	std::stable_sort(order.begin(), order.end(), [&](u64 a, u64 b) { return strcmp(name(a), name(b)) < 0; });
+	rows.reserve(order.size());
+	for (i = 0; i < order.size(); i++)
+	{
+		if (i + 1 < order.size() && strcmp(name(order[i]), name(order[i + 1])) == 0)
+			continue;
+		rows.push_back(order[i]);
+	}
+
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
+
+	parentDict.mRef = parentTree;
+	parentDict.mRecRef = parentTree;
+
+	if (parentType == GROUP_TREE)
+	{
+		err = OpenTable(parentTree, 0, parentDict);
+		if (err)
+		{
+			mCritical.LeaveCritical();
+			return(err);
+		}
+	}
+
+	err = GetDataTypeRecord(parentDict.mRef, indexRef);
+	if (!err)
+	{
+		cursor.Set(indexRef);
+		err = Search(cursor); // go to 0 item
+	}
+	if (!err)
+		err = parentDict.mDictField.Read(this, cursor.mValue);
+	if (!err)
+	{
+		cursor.Set(parentDict.mRecRef);
+		err = GetTreeType(cursor, treeType);
+	}
+	if (!err)
+		err = GetTreeSize(cursor, itemCount);
+	if (err)
+	{
+		mCritical.LeaveCritical();
+		return(err);
+	}
+
+	if (treeType != RTABLE_TREE || itemCount)
+	{
+		mCritical.LeaveCritical();
+		for (i = 0; i < rows.size(); i++)
+		{
+			row = rows[i];
+			bool set = false;
+			for (j = 0; j < fieldCount; j++)
 			{
-				mCritical.LeaveCritical();
-				return(-1);
+				GrapaCHAR& value = pBatch.mValues[row * fieldCount + j];
+				if (value.mBytes == NULL) continue;
+				err = SetField(parentTree, parentType, pBatch.mNames[row], pBatch.mFields[j], value);
+				if (err) return(err);
+				set = true;
 			}
-			GrapaCHAR fieldNameLabel("$KEY");
-			dbFieldName.Init(nameId, NAME_FIELD_TYPE, NAME_FIELD_STORE, NAME_FIELD_SIZE, NAME_FIELD_GROW);
-			err = CreateTableField(parentDict, dbFieldName, fieldNameLabel);
-			if (err)
+			if (!set)
 			{
-				mCritical.LeaveCritical();
-				return(err);
+				u64 id = 0;
+				if (FindEntry(parentTree, parentType, pBatch.mNames[row], id))
+				{
+					err = CreateEntry(parentTree, parentType, pBatch.mNames[row], id);
+					if (err) return(err);
+				}
 			}
-			err = SetNameId(parentTree, parentType, nameId);
-			if (err)
+			pCount++;
+		}
+		return(0);
+	}
+
+	GrapaDBField keyField;
+	std::vector<GrapaDBField> fields(fieldCount);
+
+	GetNameId(parentTree, parentType, nameId);
+	err = CreateNameField(parentTree, parentType, parentDict, nameId);
+	if (!err)
+		err = OpenTableField(parentDict, nameId, keyField);
+	for (j = 0; j < fieldCount && !err; j++)
+	{
+		GrapaDBField field;
+		u64 maxId;
+		GrapaCHAR& fldName = pBatch.mFields[j];
+		if (fldName.StrCmp((const char*)"$KEY") == 0)
+			err = -1;
+		else
+			err = FindField(parentTree, parentType, fldName, field, maxId);
+		if (err && fldName.StrCmp((const char*)"$VALUE") == 0)
+		{
+			field.Init(maxId + 1, VALUE_FIELD_TYPE, VALUE_FIELD_STORE, VALUE_FIELD_SIZE, VALUE_FIELD_GROW);
+			err = CreateTableField(parentDict, field, fldName);
+		}
+		if (!err)
+			err = OpenTableField(parentDict, field.mId, fields[j]);
+	}
+	if (!err)
+		err = FirstFreeId(parentDict.mRef, 1, firstId);
+	if (err)
+	{
+		mCritical.LeaveCritical();
+		return(err);
+	}
+
+	std::vector<u64> refs(rows.size());
+	err = LoadRecords(parentDict, firstId, rows.size(), refs.data());
+	for (i = 0; i < rows.size() && !err; i++)
+	{
+		row = rows[i];
+		GrapaDBFieldValueArray data;
+		data.Append(keyField, pBatch.mNames[row]);
+		for (j = 0; j < fieldCount; j++)
+		{
+			GrapaCHAR& value = pBatch.mValues[row * fieldCount + j];
+			if (value.mBytes) data.Append(fields[j], value);
+		}
+		cursor.Set(parentDict.mRecRef, RREC_ITEM, firstId + i, refs[i]);
+		err = SetRecordField(cursor, data, false);
+	}
+	if (!err)
+		err = LoadIndexes(parentDict);
+	if (!err)
+		pCount = rows.size();
+
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+// Opens the row or column table that holds the entries, for the index calls.
+GrapaError GrapaGroup::OpenIndexTable(u64 parentTree, u8 parentType, GrapaDBTable& parentDict)
+{
+	GrapaError err;
+	GrapaCursor cursor;
+	u8 treeType = 0;
+
+	parentDict.mRef = parentTree;
+	parentDict.mRecRef = parentTree;
+	if (parentType == GROUP_TREE)
+	{
+		err = OpenTable(parentTree, 0, parentDict);
+		if (err) return(err);
+	}
+	cursor.Set(parentDict.mRecRef);
+	err = GetTreeType(cursor, treeType);
+	if (err) return(err);
+	if (treeType != RTABLE_TREE && treeType != CTABLE_TREE) return(-1);
+	return(0);
+}
+
+// Resolves pFields to field ids in pIndexList, in index order, and finds the secondary index over
+// exactly those fields. With pPrefix it finds a maintained index, the name index included, whose
+// fields start with them. pIndexId is 0 when there is none.
+GrapaError GrapaGroup::FindFieldIndex(u64 parentTree, u8 parentType, GrapaDBTable& parentDict, const std::vector<GrapaCHAR>& pFields, GrapaDU64Array& pIndexList, u64& pIndexId, bool pPrefix)
+{
+	GrapaError err;
+	GrapaCursor cursor;
+	GrapaCHAR keyName("$KEY");
+	u64 indexRef = 0, i;
+
+	pIndexId = 0;
+	pIndexList.SetLength(0);
+	if (pFields.empty()) return(-1);
+	for (i = 0; i < pFields.size(); i++)
+	{
+		GrapaDBField field;
+		u64 fieldId = 0, maxId;
+		if (keyName.StrCmp(pFields[i]) == 0)
+			err = GetNameId(parentTree, parentType, fieldId);
+		else
+		{
+			err = FindField(parentTree, parentType, pFields[i], field, maxId);
+			fieldId = field.mId;
+		}
+		if (!err && fieldId == 0) err = -1;
+		if (err) return(err);
+		pIndexList.Append(i + 1, fieldId);
+	}
+
+	cursor.Set(parentDict.mRecRef);
+	err = GetTreeIndex(cursor, indexRef);
+	if (err) return(err);
+	cursor.Set(indexRef);
+	err = First(cursor);
+	while (!err)
+	{
+		if (cursor.mKey > NAME_INDEX_ID || (pPrefix && cursor.mKey == NAME_INDEX_ID))
+		{
+			GrapaDBIndex dbIndex;
+			GrapaDU64Array indexList;
+			bool same = OpenIndex(parentDict, cursor.mKey, indexList, dbIndex) == 0;
+			if (pPrefix)
+				same = same && indexList.Count() >= pIndexList.Count() && !IndexDeferred(dbIndex.mRef);
+			else
+				same = same && indexList.Count() == pIndexList.Count();
+			for (u32 j = 0; same && j < pIndexList.Count(); j++)
+				same = ((GrapaDU64*)indexList.GetAt(j))->mNum.value == ((GrapaDU64*)pIndexList.GetAt(j))->mNum.value;
+			if (same)
 			{
-				mCritical.LeaveCritical();
-				return(err);
+				pIndexId = cursor.mKey;
+				return(0);
 			}
+		}
+		err = Next(cursor);
+	}
+	return(0);
+}
+
+// Adds a secondary index over pFields, in that order, and builds it from the rows already there.
+// A unique index fails, and is not kept, when two rows already share its values.
+GrapaError GrapaGroup::CreateFieldIndex(u64 parentTree, u8 parentType, const std::vector<GrapaCHAR>& pFields, bool pUnique)
+{
+	GrapaError err;
+	GrapaDBTable parentDict;
+	GrapaDBIndex dbIndex;
+	GrapaDU64Array indexList;
+	u64 indexId = 0;
+
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
+
+	err = OpenIndexTable(parentTree, parentType, parentDict);
+	if (!err)
+		err = FindFieldIndex(parentTree, parentType, parentDict, pFields, indexList, indexId);
+	if (!err && indexId)
+		err = -1;
+	if (!err)
+	{
+		GrapaCursor cursor;
+		cursor.Set(parentDict.mRecRef);
+		err = GetTreeIndex(cursor, dbIndex.mRef);
+	}
+	if (!err)
+		err = FindFreeIndexId(dbIndex, NAME_INDEX_ID + 1, indexId);
+	if (!err)
+		err = CreateIndex(parentDict, indexId, indexList, dbIndex, pUnique);
+	if (!err)
+	{
+		err = LoadIndexes(parentDict);
+		if (err)
+			DeleteIndex(parentDict, indexId);
+	}
+
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+GrapaError GrapaGroup::DeleteFieldIndex(u64 parentTree, u8 parentType, const std::vector<GrapaCHAR>& pFields)
+{
+	GrapaError err;
+	GrapaDBTable parentDict;
+	GrapaDU64Array indexList;
+	u64 indexId = 0;
+
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
+
+	err = OpenIndexTable(parentTree, parentType, parentDict);
+	if (!err)
+		err = FindFieldIndex(parentTree, parentType, parentDict, pFields, indexList, indexId);
+	if (!err && indexId == 0)
+		err = -1;
+	if (!err)
+		err = DeleteIndex(parentDict, indexId);
+
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+// Stops maintaining the table's secondary indexes until Reindex. The name index is kept up, since
+// every lookup by name goes through it. pCount is the number of indexes suspended.
+GrapaError GrapaGroup::SuspendIndexes(u64 parentTree, u8 parentType, u64& pCount)
+{
+	GrapaError err;
+	GrapaDBTable parentDict;
+	GrapaCursor cursor;
+	u64 indexRef = 0;
+
+	pCount = 0;
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
+
+	err = OpenIndexTable(parentTree, parentType, parentDict);
+	if (!err)
+	{
+		cursor.Set(parentDict.mRecRef);
+		err = GetTreeIndex(cursor, indexRef);
+	}
+	if (!err)
+	{
+		cursor.Set(indexRef);
+		GrapaError next = First(cursor);
+		while (!next && !err)
+		{
+			if (cursor.mKey > NAME_INDEX_ID)
 			{
-				GrapaDBIndex dbIndexName;
-				GrapaDU64Array catIndexList(1);
-				catIndexList.Append(NAME_INDEX_FIELD_NAME_ID, nameId);
-				err = CreateIndex(parentDict, NAME_INDEX_ID, catIndexList, dbIndexName);
-				if (err)
-				{
-					mCritical.LeaveCritical();
-					return(err);
-				}
+				err = DeferIndex(parentDict, cursor.mKey);
+				if (!err) pCount++;
 			}
+			next = Next(cursor);
 		}
+	}
 
-		cursor.Set(parentDict.mRecRef, RREC_ITEM, dataId);
-		err = Search(cursor);
-		if (err)
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+// Rebuilds the suspended indexes, each by one sort of the rows and a bottom-up build, and checks
+// the unique ones as it goes. pCount is the number rebuilt.
+GrapaError GrapaGroup::Reindex(u64 parentTree, u8 parentType, u64& pCount)
+{
+	GrapaError err;
+	GrapaDBTable parentDict;
+
+	pCount = 0;
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
+
+	err = OpenIndexTable(parentTree, parentType, parentDict);
+	if (!err)
+		err = RebuildIndexes(parentDict, pCount);
+
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+// Lists the rows whose pFields values lie between pLower and pUpper, in the order of an index that
+// starts with pFields; "$KEY" alone uses the name index. Each bound holds values for a leading run
+// of pFields, and an empty bound leaves that end open. pAfter carries on after that row, and a
+// pLimit other than 0 stops after that many rows. Rows come back in pRows, with the values of
+// pFields for each, and rows with no value in the first field are left out.
+GrapaError GrapaGroup::RangeEntries(u64 parentTree, u8 parentType, const std::vector<GrapaCHAR>& pFields, const std::vector<GrapaCHAR>& pLower, const std::vector<GrapaCHAR>& pUpper, bool pLowerIn, bool pUpperIn, bool pReverse, const GrapaCHAR& pAfter, u64 pLimit, GrapaGroupBatch& pRows)
+{
+	GrapaError err;
+	GrapaDBTable parentDict;
+	GrapaDBIndex dbIndex;
+	GrapaDBRange range;
+	GrapaDU64Array fieldList, indexList;
+	u64 indexId = 0, nameId = 0, afterId = 0, count = 0, at, i;
+
+	pRows.mFields = pFields;
+	pRows.mNames.clear();
+	pRows.mValues.clear();
+	if (pLower.size() > pFields.size() || pUpper.size() > pFields.size()) return(-1);
+
+	mCritical.WaitCritical();
+
+	err = OpenIndexTable(parentTree, parentType, parentDict);
+	if (!err)
+		err = GetNameId(parentTree, parentType, nameId);
+	if (!err)
+		err = FindFieldIndex(parentTree, parentType, parentDict, pFields, fieldList, indexId, true);
+	if (!err && indexId == 0)
+		err = -1;
+	if (!err)
+		err = OpenIndex(parentDict, indexId, indexList, dbIndex);
+	for (i = 0; !err && i < pLower.size(); i++)
+		err = range.mLower.Append(this, parentDict, ((GrapaDU64*)fieldList.GetAt((u32)i))->mNum.value, pLower[i]);
+	for (i = 0; !err && i < pUpper.size(); i++)
+		err = range.mUpper.Append(this, parentDict, ((GrapaDU64*)fieldList.GetAt((u32)i))->mNum.value, pUpper[i]);
+	if (!err && pAfter.mLength)
+	{
+		GrapaDBCursor cursor;
+		GrapaDBFieldValueArray data;
+		data.Append(this, parentDict, nameId, pAfter, EQ_CMP);
+		err = SearchDb(cursor, parentDict, data);
+		afterId = cursor.mKey;
+	}
+
+	if (!err)
+	{
+		range.mLowerIn = pLowerIn;
+		range.mUpperIn = pUpperIn;
+		range.mReverse = pReverse;
+		GrapaError next = FirstRange(range, dbIndex.mRef, afterId);
+		while (!next && (pLimit == 0 || count < pLimit))
 		{
-			mCritical.LeaveCritical();
-			return(err);
+			at = pRows.mValues.size();
+			pRows.mValues.resize(at + pFields.size());
+			for (i = 0; i < pFields.size(); i++)
+			{
+				if (GetRecordField(range.mCursor, ((GrapaDU64*)fieldList.GetAt((u32)i))->mNum.value, pRows.mValues[at + i]))
+					pRows.mValues[at + i].SetLength(0);
+			}
+			if (pRows.mValues[at].mLength)
+			{
+				pRows.mNames.emplace_back();
+				if (GetRecordField(range.mCursor, nameId, pRows.mNames.back()))
+					pRows.mNames.back().SetLength(0);
+				count++;
+			}
+			else
+				pRows.mValues.resize(at);
+			next = NextRange(range);
 		}
+	}
+
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+// Counts, sums and bounds the values of pField over the rows of the table, reading the column a
+// batch at a time. With pBy the rows are grouped by their value of pBy: pGroups has the group
+// values in order, rows with no value forming the first group, and pResults one aggregate for
+// each. Without pBy pResults has the one aggregate. An empty pField counts rows.
+GrapaError GrapaGroup::AggregateEntries(u64 parentTree, u8 parentType, const GrapaCHAR& pField, const GrapaCHAR& pBy, std::vector<GrapaCHAR>& pGroups, std::vector<GrapaDBAggregate>& pResults)
+{
+	GrapaError err;
+	GrapaDBScan scan;
+	GrapaCHAR keyName("$KEY");
+	std::unordered_map<std::string, u64> groups;
+	u64 i;
+
+	pGroups.clear();
+	pResults.clear();
+
+	mCritical.WaitCritical();
+
+	err = OpenIndexTable(parentTree, parentType, scan.mTable);
+	auto addColumn = [&](const GrapaCHAR& pName) {
+		GrapaDBColumn column;
+		u64 fieldId = 0;
+		GrapaError e;
+		if (keyName.StrCmp(pName) == 0)
 		{
-			GrapaDBFieldValueArray data;
-			data.Append(this, parentDict, nameId, pDataName, EQ_CMP);
-			err = SetRecordField(cursor, data);
-			if (err)
+			e = GetNameId(parentTree, parentType, fieldId);
+			if (!e) e = OpenTableField(scan.mTable, fieldId, column.mField);
+		}
+		else
+			e = FindField(parentTree, parentType, pName, column.mField, fieldId);
+		if (!e) scan.mColumns.push_back(column);
+		return(e);
+	};
+	if (!err && pField.mLength)
+		err = addColumn(pField);
+	if (!err && pBy.mLength)
+		err = addColumn(pBy);
+
+	if (!err)
+	{
+		u8 type = pField.mLength ? scan.mColumns.front().mField.mType : 0;
+		GrapaDBColumn* values = pField.mLength ? &scan.mColumns.front() : NULL;
+		GrapaDBColumn* by = pBy.mLength ? &scan.mColumns.back() : NULL;
+		if (by == NULL)
+			pResults.emplace_back(type);
+		scan.mRuns = by == NULL;
+		GrapaError next = FirstScan(scan);
+		while (!next)
+		{
+			if (by == NULL)
 			{
-				mCritical.LeaveCritical();
-				return(err);
+				if (values) pResults.front().Add(*values);
+				else pResults.front().mCount += scan.mCount;
+			}
+			else
+			{
+				if (values) values->Decode();
+				for (i = 0; i < scan.mCount; i++)
+				{
+					std::string key;
+					if (by->mSet[i]) key.assign((const char*)&by->mData[by->mStart[i]], (size_t)by->mLength[i]);
+					auto found = groups.find(key);
+					u64 g;
+					if (found == groups.end())
+					{
+						g = pResults.size();
+						groups.emplace(key, g);
+						pResults.emplace_back(type);
+						pGroups.emplace_back();
+						by->Value(i, pGroups.back());
+					}
+					else
+						g = found->second;
+					if (values) pResults[g].Add(*values, i);
+					else pResults[g].Count();
+				}
+			}
+			next = NextScan(scan);
+		}
+
+		if (by)
+		{
+			u8 byType = by->mField.mType;
+			std::vector<u64> order(pGroups.size());
+			for (i = 0; i < order.size(); i++) order[i] = i;
+			std::sort(order.begin(), order.end(), [&](u64 a, u64 b) { return(CompareValue(byType, pGroups[a], pGroups[b]) < 0); });
+			std::vector<GrapaCHAR> sortedGroups(order.size());
+			std::vector<GrapaDBAggregate> sortedResults;
+			sortedResults.reserve(order.size());
+			for (i = 0; i < order.size(); i++)
+			{
+				sortedGroups[i] = pGroups[order[i]];
+				sortedResults.push_back(pResults[order[i]]);
 			}
+			pGroups.swap(sortedGroups);
+			pResults.swap(sortedResults);
 		}
 	}
 
 	mCritical.LeaveCritical();
-	return(0);
+	return(err);
+}
+
+// Encodes the fixed fields of a column table, or only pField; see GrapaDB::CompactField. The name
+// field is left plain, as every new row writes to it. pNames and pInfo get an entry for each field
+// compacted.
+GrapaError GrapaGroup::CompactFields(u64 parentTree, u8 parentType, const GrapaCHAR& pField, std::vector<GrapaCHAR>& pNames, std::vector<GrapaDBCompact>& pInfo)
+{
+	GrapaError err;
+	GrapaDBTable parentDict;
+	GrapaDBFieldArray* fieldList = NULL;
+	u64 nameId = 0;
+
+	pNames.clear();
+	pInfo.clear();
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
+
+	err = OpenIndexTable(parentTree, parentType, parentDict);
+	if (!err)
+		err = GetNameId(parentTree, parentType, nameId);
+	if (!err)
+	{
+		fieldList = ListFields(parentTree, parentType);
+		if (fieldList == NULL)
+			err = -1;
+	}
+	for (u32 i = 0; !err && i < fieldList->Count(); i++)
+	{
+		GrapaDBField* field = fieldList->GetFieldAt(i);
+		GrapaCHAR name;
+		if (field == NULL || field->mId == nameId || GetData(field->mNameRef, name))
+			continue;
+		if (pField.mLength ? name.StrCmp(pField) != 0 : field->mStore != GrapaDBField::STORE_FIX)
+			continue;
+		pNames.push_back(name);
+		pInfo.emplace_back();
+		err = CompactField(parentDict, *field, pInfo.back());
+	}
+	if (fieldList)
+		delete fieldList;
+	if (!err && pField.mLength && pInfo.empty())
+		err = -1;
+
+	mCritical.LeaveCritical();
+	return(err);
 }
 
 GrapaError GrapaGroup::FindEntry(u64 parentTree, u8 parentType, const GrapaCHAR& pDataName, u64& pId)
@@ -846,7 +1459,7 @@ GrapaError GrapaGroup::FindEntry(u64 parentTree, u8 parentType, const GrapaCHAR&
 
 GrapaError GrapaGroup::DeleteEntry(u64 parentTree, u8 parentType, const GrapaCHAR& pDataName)
 {
-	mCritical.WaitCritical();
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
 
 	GrapaError err;
 	GrapaDBCursor cursor, tableCursor;
@@ -926,7 +1539,7 @@ GrapaError GrapaGroup::DeleteEntry(u64 parentTree, u8 parentType, const GrapaCHA
 
 GrapaError GrapaGroup::DeleteEntry(u64 parentTree, u8 parentType, u64 pId)
 {
-	mCritical.WaitCritical();
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
 
 	GrapaError err;
 	GrapaDBCursor cursor, tableCursor;
@@ -998,7 +1611,7 @@ GrapaError GrapaGroup::CreateField(u64 parentTree, u8 parentType, const char* pF
 
 GrapaError GrapaGroup::CreateField(u64 parentTree, u8 parentType, GrapaCHAR& pFieldName, u8 pType, u8 pStore, u64 pSize, u64 pGrow)
 {
-	mCritical.WaitCritical();
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
 
 	GrapaError err;
 	GrapaDBCursor cursor;
@@ -1122,7 +1735,7 @@ GrapaError GrapaGroup::CreateField(u64 parentTree, u8 parentType, GrapaCHAR& pFi
 
 GrapaError GrapaGroup::DeleteField(u64 parentTree, u8 parentType, GrapaCHAR& pFieldName)
 {
-	mCritical.WaitCritical();
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
 
 	GrapaError err;
 	GrapaDBCursor cursor;
@@ -1224,7 +1837,7 @@ GrapaError GrapaGroup::SetField(u64 parentTree, u8 parentType, const GrapaCHAR&
 
 GrapaError GrapaGroup::SetField(u64 parentTree, u8 parentType, const GrapaCHAR& pDataName, const GrapaCHAR& pFieldNameX, const GrapaBYTE& pDataValue)
 {
-	mCritical.WaitCritical();
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
 
 	GrapaError err;
 	GrapaDBCursor cursor;
@@ -1239,7 +1852,7 @@ GrapaError GrapaGroup::SetField(u64 parentTree, u8 parentType, const GrapaCHAR&
 	mCritical.LeaveCritical();
 	u64 id2 = 0, nameId2=0;
 	err = CreateEntry(parentTree, parentType, pDataName, nameId2);
-	mCritical.WaitCritical();
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
 	////////////
 
 	if (pDataName.mLength == 0 || pDataName.mBytes == NULL)
@@ -1522,7 +2135,7 @@ GrapaError GrapaGroup::SetField(u64 parentTree, u8 parentType, u64 pId, const ch
 
 GrapaError GrapaGroup::SetField(u64 parentTree, u8 parentType, u64 pId, const GrapaCHAR& pFieldNameX, const GrapaBYTE& pDataValue)
 {
-	mCritical.WaitCritical();
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
 
 	GrapaError err;
 	GrapaDBCursor cursor;
@@ -1815,17 +2428,126 @@ GrapaError GrapaGroup::DumpGroup(u64 parentTree, u8 parentType, u64 pId, GrapaFi
 	return(err);
 }
 
+// With a log, the conversion is one transaction, so a crash or an error part way leaves the file
+// as it was. Inside a transaction the handle already has open, it joins that one.
+GrapaError GrapaGroup::ConvertGroup(u64& pCount)
+{
+	u64 end = 0;
+	if (!mCritical.WaitWrite()) return((GrapaError)-1);
+	bool txn = mCritical.vOwner == NULL && mTree.Begin() == 0;
+	GrapaError err = ConvertFile(pCount);
+	if (txn && err)
+		mTree.Rollback();
+	else if (txn)
+		err = mTree.Commit(true, end);
+	if (mFile) mFile->Flush();
+	mCritical.LeaveCritical();
+	if (!err && end)
+		err = mTree.SyncLog(end);
+	return(err);
+}
+
+GrapaError GrapaGroup::SetCache(u64 pSize)
+{
+	mCritical.WaitCritical();
+	GrapaError err = mTree.SetCache(pSize);
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+void GrapaGroup::CacheStats(GrapaFileCacheStats& pStats)
+{
+	mTree.GetStats(pStats);
+}
+
+void GrapaGroup::SetLog(bool pLog)
+{
+	mTree.SetLog(pLog);
+}
+
+GrapaError GrapaGroup::SetFlush(u64 pRate)
+{
+	return mTree.SetFlush(pRate);
+}
+
+GrapaError GrapaGroup::Checkpoint()
+{
+	mCritical.WaitCritical();
+	GrapaError err = mTree.SyncFile();
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+// The transaction belongs to pHandle until it commits or rolls back; only pHandle can write,
+// commit or roll back meanwhile.
+GrapaError GrapaGroup::Begin(const void* pHandle)
+{
+	mCritical.WaitCritical();
+	GrapaError err = mTree.Begin();
+	if (!err)
+		mCritical.vOwner = pHandle;
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+// The sync runs after the lock is released, so concurrent committers share one.
+GrapaError GrapaGroup::Commit(const void* pHandle)
+{
+	u64 end = 0;
+	GrapaError err = -1;
+	mCritical.WaitCritical();
+	if (mCritical.vOwner == NULL || mCritical.vOwner == pHandle)
+		err = mTree.Commit(true, end);
+	if (!err)
+		mCritical.vOwner = NULL;
+	mCritical.LeaveCritical();
+	if (!err)
+		err = mTree.SyncLog(end);
+	return(err);
+}
+
+GrapaError GrapaGroup::Rollback(const void* pHandle)
+{
+	GrapaError err = -1;
+	mCritical.WaitCritical();
+	if (mCritical.vOwner == pHandle)
+	{
+		err = mTree.Rollback();
+		mCritical.vOwner = NULL;
+	}
+	mCritical.LeaveCritical();
+	return(err);
+}
+
+// Called when pHandle stops using the group; a transaction it left open is rolled back.
+void GrapaGroup::Release(const void* pHandle)
+{
+	if (pHandle && mCritical.vOwner == pHandle)
+		Rollback(pHandle);
+}
+
+// Taken under the group's lock, so pFile sees whole operations. Readers of it never take the lock.
+GrapaError GrapaGroup::Snapshot(GrapaFileSnapshot& pFile)
+{
+	mCritical.WaitCritical();
+	GrapaError err = pFile.Attach(&mTree);
+	mCritical.LeaveCritical();
+	return(err);
+}
+
 
 // Verify digital rights on file. So...open with identity. 
 // Make note of the opentype for each connection. For now, use R/W.
 
-GrapaGroupEvent* GrapaGroupQueue::OpenFile(const GrapaCHAR& fileName, GrapaFile* pFile, char mode)
+GrapaGroupEvent* GrapaGroupQueue::OpenFile(const GrapaCHAR& fileName, GrapaFile* pFile, char mode, u64 pCache, bool pLog)
 {
 	mCritical.WaitCritical();
 	GrapaGroupEvent*e = Search(fileName);
 	if (e == NULL)
 	{
 		e = new GrapaGroupEvent(fileName, pFile);
+		e->mValue.SetCache(pCache);
+		e->mValue.SetLog(pLog);
 		PushTail(e);
 	}
 	if (e)
@@ -1851,13 +2573,15 @@ GrapaGroupEvent* GrapaGroupQueue::OpenFile(const GrapaCHAR& fileName, GrapaFile*
 	return(e);
 }
 
-GrapaGroupEvent* GrapaGroupQueue::Create(const GrapaCHAR& fileName, GrapaFile* pFile, u8 pType)
+GrapaGroupEvent* GrapaGroupQueue::Create(const GrapaCHAR& fileName, GrapaFile* pFile, u8 pType, u64 pCache, bool pLog)
 {
 	mCritical.WaitCritical();
 	GrapaGroupEvent*e = Search(fileName);
 	if (e == NULL)
 	{
 		e = new GrapaGroupEvent(fileName, pFile);
+		e->mValue.SetCache(pCache);
+		e->mValue.SetLog(pLog);
 		PushTail(e);
 	}
 	if (e)
@@ -1884,13 +2608,15 @@ GrapaGroupEvent* GrapaGroupQueue::Create(const GrapaCHAR& fileName, GrapaFile* p
 	return(e);
 }
 
-GrapaGroupEvent* GrapaGroupQueue::Create(const GrapaCHAR& fileName, GrapaFile* pFile, GrapaCHAR& pType)
+GrapaGroupEvent* GrapaGroupQueue::Create(const GrapaCHAR& fileName, GrapaFile* pFile, GrapaCHAR& pType, u64 pCache, bool pLog)
 {
 	mCritical.WaitCritical();
 	GrapaGroupEvent*e = Search(fileName);
 	if (e == NULL)
 	{
 		e = new GrapaGroupEvent(fileName, pFile);
+		e->mValue.SetCache(pCache);
+		e->mValue.SetLog(pLog);
 		PushTail(e);
 	}
 	if (e)
@@ -1917,9 +2643,10 @@ GrapaGroupEvent* GrapaGroupQueue::Create(const GrapaCHAR& fileName, GrapaFile* p
 	return(e);
 }
 
-void GrapaGroupQueue::CloseFile(GrapaGroupEvent* pEvent)
+void GrapaGroupQueue::CloseFile(GrapaGroupEvent* pEvent, const void* pHandle)
 {
 	if (pEvent == NULL) return;
+	pEvent->mValue.Release(pHandle);
 	mCritical.WaitCritical();
 	pEvent->mInstanceCount--;
 	if (pEvent->mInstanceCount == 0)
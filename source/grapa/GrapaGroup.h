@@ -11,8 +11,44 @@
 #include "GrapaFileTree.h"
 #include "GrapaFileCache.h"
 
+#include <vector>
+
 class GrapaRuleEvent;
 
+// Entries for GrapaGroup::LoadEntries. Each entry has a name in mNames and a value for each of
+// mFields in mValues, one row of values per entry. A value with no bytes leaves that field unset.
+class GrapaGroupBatch
+{
+public:
+	std::vector<GrapaCHAR> mFields;
+	std::vector<GrapaCHAR> mNames;
+	std::vector<GrapaCHAR> mValues;
+};
+
+// Every group operation runs under this lock, and leaving it commits the operation to the
+// file's log, so a crash loses whole operations and never leaves half of one. While a transaction
+// is open, vOwner is the handle that began it, and writes for any other handle are refused.
+class GrapaGroupCritical : public GrapaCritical
+{
+public:
+	GrapaFileCache* mTree;
+	const void* vOwner;
+	GrapaGroupCritical() : mTree(NULL), vOwner(NULL) {}
+	virtual void LeaveCritical();
+	bool WaitWrite();
+};
+
+// Names the database handle the current thread makes group calls for, for as long as it is in
+// scope. Writes compare it with the handle whose transaction is open.
+class GrapaGroupHandle
+{
+public:
+	const void* vPrev;
+	GrapaGroupHandle(const void* pHandle);
+	~GrapaGroupHandle();
+	static const void* Current();
+};
+
 class GrapaGroup : public GrapaDB
 {
 public:
@@ -44,6 +80,7 @@ public:
 	//GrapaError ListGroup(u64 parentTree, u8 parentType, GrapaRuleEvent* pTable);
 
 	GrapaError CreateEntry(u64 parentTree, u8 parentType, const GrapaCHAR& pDataName, u64& pId);
+	GrapaError LoadEntries(u64 parentTree, u8 parentType, GrapaGroupBatch& pBatch, u64& pCount);
 	GrapaError FindEntry(u64 parentTree, u8 parentType, const GrapaCHAR& pDataName, u64& pId);
 	GrapaError DeleteEntry(u64 parentTree, u8 parentType, const GrapaCHAR& pDataName);
 	GrapaError DeleteEntry(u64 parentTree, u8 parentType, u64 pId);
@@ -52,6 +89,14 @@ public:
 	GrapaError CreateField(u64 parentTree, u8 parentType, GrapaCHAR& pFieldName, u8 pType = GrapaTokenType::RAW, u8 pStore = GrapaDBField::STORE_VAR, u64 pSize = 32, u64 pGrow = 8);
 	GrapaError DeleteField(u64 parentTree, u8 parentType, GrapaCHAR& pField);
 
+	GrapaError CreateFieldIndex(u64 parentTree, u8 parentType, const std::vector<GrapaCHAR>& pFields, bool pUnique);
+	GrapaError DeleteFieldIndex(u64 parentTree, u8 parentType, const std::vector<GrapaCHAR>& pFields);
+	GrapaError SuspendIndexes(u64 parentTree, u8 parentType, u64& pCount);
+	GrapaError Reindex(u64 parentTree, u8 parentType, u64& pCount);
+	GrapaError AggregateEntries(u64 parentTree, u8 parentType, const GrapaCHAR& pField, const GrapaCHAR& pBy, std::vector<GrapaCHAR>& pGroups, std::vector<GrapaDBAggregate>& pResults);
+	GrapaError CompactFields(u64 parentTree, u8 parentType, const GrapaCHAR& pField, std::vector<GrapaCHAR>& pNames, std::vector<GrapaDBCompact>& pInfo);
+	GrapaError RangeEntries(u64 parentTree, u8 parentType, const std::vector<GrapaCHAR>& pFields, const std::vector<GrapaCHAR>& pLower, const std::vector<GrapaCHAR>& pUpper, bool pLowerIn, bool pUpperIn, bool pReverse, const GrapaCHAR& pAfter, u64 pLimit, GrapaGroupBatch& pRows);
+
 	GrapaError SetField(u64 parentTree, u8 parentType, const GrapaCHAR& pName, const char* pField, const GrapaBYTE& pValue);
 	GrapaError SetField(u64 parentTree, u8 parentType, const GrapaCHAR& pName, const GrapaCHAR& pField, const GrapaBYTE& pValue);
 	GrapaError SetField(u64 parentTree, u8 parentType, u64 pId, const char* pField, const GrapaBYTE& pValue);
@@ -61,6 +106,17 @@ public:
 	GrapaError GetField(u64 parentTree, u8 parentType, u64 pId, const GrapaCHAR& pField, GrapaBYTE& pValue);
 
 	GrapaError DumpGroup(u64 parentTree, u8 parentType, u64 pId=0, GrapaFile *pDumpFile=NULL);
+	GrapaError ConvertGroup(u64& pCount);
+	GrapaError SetCache(u64 pSize = GrapaFileCache::DEFAULT_SIZE);
+	void CacheStats(GrapaFileCacheStats& pStats);
+	void SetLog(bool pLog);
+	GrapaError SetFlush(u64 pRate);
+	GrapaError Checkpoint();
+	GrapaError Begin(const void* pHandle);
+	GrapaError Commit(const void* pHandle);
+	GrapaError Rollback(const void* pHandle);
+	void Release(const void* pHandle);
+	GrapaError Snapshot(GrapaFileSnapshot& pFile);
 
 	GrapaDBFieldArray* ListFields(u64 parentTree, u8 parentType);
 	GrapaError FindField(u64 parentTree, u8 parentType, const GrapaCHAR& pFieldName, GrapaDBField& field, u64& pMaxId);
@@ -68,10 +124,15 @@ public:
 	GrapaError SetNameId(u64 parentTree, u8 parentType, u64 pNameId);
 	GrapaError NextNameId(u64 parentTree, u8 parentType, u64& pNameId);
 
+protected:
+	GrapaError CreateNameField(u64 parentTree, u8 parentType, GrapaDBTable& parentDict, u64& pNameId);
+	GrapaError OpenIndexTable(u64 parentTree, u8 parentType, GrapaDBTable& parentDict);
+	GrapaError FindFieldIndex(u64 parentTree, u8 parentType, GrapaDBTable& parentDict, const std::vector<GrapaCHAR>& pFields, GrapaDU64Array& pIndexList, u64& pIndexId, bool pPrefix = false);
+
 protected:
 	//GrapaFileCache mCache;
 	GrapaFileCache mTree;
-	GrapaCritical mCritical;
+	GrapaGroupCritical mCritical;
 };
 
 class GrapaGroupEvent : public GrapaEvent
@@ -93,10 +154,10 @@ class GrapaGroupQueue : public GrapaQueue
 public:
 	//virtual void CLEAR() { GrapaQueue::CLEAR(); }
 public:
-	GrapaGroupEvent* OpenFile(const GrapaCHAR& fileName, GrapaFile* pFile, char mode);
-	GrapaGroupEvent* Create(const GrapaCHAR& fileName, GrapaFile* pFile, u8 pType);
-	GrapaGroupEvent* Create(const GrapaCHAR& fileName, GrapaFile* pFile, GrapaCHAR& pType);
-	void CloseFile(GrapaGroupEvent* pEvent);
+	GrapaGroupEvent* OpenFile(const GrapaCHAR& fileName, GrapaFile* pFile, char mode, u64 pCache = GrapaFileCache::DEFAULT_SIZE, bool pLog = false);
+	GrapaGroupEvent* Create(const GrapaCHAR& fileName, GrapaFile* pFile, u8 pType, u64 pCache = GrapaFileCache::DEFAULT_SIZE, bool pLog = false);
+	GrapaGroupEvent* Create(const GrapaCHAR& fileName, GrapaFile* pFile, GrapaCHAR& pType, u64 pCache = GrapaFileCache::DEFAULT_SIZE, bool pLog = false);
+	void CloseFile(GrapaGroupEvent* pEvent, const void* pHandle = NULL);
 protected:
 	virtual GrapaGroupEvent* Search(const GrapaCHAR& pName) { GrapaGroupEvent* item = Head(); while (item) { if (item->mName.StrCmp(pName) == 0) break; item = item->Next(); } return(item); }
 	virtual GrapaGroupEvent* Head(u64 mSkip = 0) { GrapaGroupEvent*e = (GrapaGroupEvent*)GrapaQueue::Head(mSkip); return(e); }
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "GrapaInt.h"
 #include <math.h>
+#include <vector>
 
 #include <openssl/rand.h>
 #include <openssl/rsa.h>
@@ -41,9 +42,10 @@ extern GrapaSystem* gSystem;
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 GrapaArray32::GrapaArray32() { INIT(); };
-GrapaArray32::~GrapaArray32() { if (mBytes) GrapaMem::Delete(mBytes); mBytes = NULL; mSize = mLength = 0; };
-GrapaArray32& GrapaArray32::operator=(const GrapaArray32& that) { if (this != &that) { INIT(); SetLength(that.mLength, false); memcpy(mBytes, that.mBytes, (size_t)mLength*sizeof(u32)); } return *this; }
-void GrapaArray32::INIT() { mBytes = NULL; mSize = 0; mLength = 0; mGrow = 16; dataSigned = false; NaN = false; }
+GrapaArray32::GrapaArray32(const GrapaArray32& that) { INIT(); FROM(that); };
+GrapaArray32::~GrapaArray32() { if (mBytes && mBytes != (u8*)mInline) GrapaMem::Delete(mBytes); mBytes = NULL; mSize = mLength = 0; };
+GrapaArray32& GrapaArray32::operator=(const GrapaArray32& that) { if (this != &that) { SetLength(that.mLength, false); memcpy(mBytes, that.mBytes, (size_t)mLength); } return *this; }
+void GrapaArray32::INIT() { mBytes = (u8*)mInline; mSize = sizeof(mInline); mLength = 0; mGrow = 16; dataSigned = false; NaN = false; }
 void GrapaArray32::SetLength(u64 pLen, bool pCopy) {
 	if (pLen > mSize)
 		SetSize(pLen, pCopy);
@@ -52,17 +54,27 @@ void GrapaArray32::SetLength(u64 pLen, bool pCopy) {
 void GrapaArray32::SetSize(u64 pLen, bool pCopy) {
 	if (mLength > pLen)
 		mLength = pLen;
-	if (pLen != mSize) {
-		u8* b = NULL;
-		if (pLen) b = (u8*)GrapaMem::Create(pLen);
+	u8* inl = (u8*)mInline;
+	if (pLen <= sizeof(mInline)) {
+		if (mBytes != inl) {
+			if (pCopy && mBytes && mLength)
+				memcpy(inl, mBytes, (size_t)mLength);
+			GrapaMem::Delete(mBytes);
+			mBytes = inl;
+		}
+		mSize = sizeof(mInline);
+	}
+	else if (pLen != mSize) {
+		u8* b = (u8*)GrapaMem::Create(pLen);
 		if (pCopy&&mBytes&&b)
 			memcpy(b, mBytes, (size_t)mLength);
-		GrapaMem::Delete(mBytes);
+		if (mBytes != inl)
+			GrapaMem::Delete(mBytes);
 		mBytes = b;
 		mSize = pLen;
 	}
 }
-void GrapaArray32::FROM(const GrapaArray32& pData) { dataSigned = pData.dataSigned; NaN = pData.NaN; SetLength(pData.mLength, false); if (pData.mBytes) memcpy(mBytes, pData.mBytes, (size_t)mLength); }
+void GrapaArray32::FROM(const GrapaArray32& pData) { dataSigned = pData.dataSigned; NaN = pData.NaN; SetLength(pData.mLength, false); if (pData.mBytes && mLength) memcpy(mBytes, pData.mBytes, (size_t)mLength); }
 u64 GrapaArray32::GetCount() const { return(mLength / sizeof(u32)); }
 u64 GrapaArray32::GetByteCount() const {
 	u64 count = GetCount();
@@ -74,12 +86,12 @@ u64 GrapaArray32::GetByteCount() const {
 }
 void GrapaArray32::SetCount(u64 pCount) {
 	u64 oldCount = GetCount(), newCount = pCount;
-	SetLength(((pCount / mGrow) + 1) * mGrow * sizeof(u32), true);
+	u64 capacity = (pCount * sizeof(u32) <= sizeof(mInline)) ? sizeof(mInline) : ((pCount / mGrow) + 1) * mGrow * sizeof(u32);
+	if (capacity > mSize || (newCount + mGrow) < (mSize / sizeof(u32)))
+		SetSize(capacity, true);
 	mLength = pCount*sizeof(u32);
 	if (newCount > oldCount)
 		memset(&((u32*)mBytes)[oldCount], 0, (size_t) (newCount - oldCount) * sizeof(u32));
-	else if ((newCount + mGrow) < (mSize / sizeof(u32)))
-		SetSize(((newCount / mGrow) + 1) * mGrow * sizeof(u32), true);
 }
 void GrapaArray32::GrowCount(u64 pCount) { if (pCount > GetCount()) SetCount(pCount); }
 void GrapaArray32::SetItem(u64 pItem, u32 pValue) { GrowCount(pItem + 1); ((u32*)mBytes)[pItem] = pValue; }
@@ -99,6 +111,10 @@ bool GrapaArray32::IsNeg() const { return (GetCount() ? (GetItem(GetCount() - 1)
 bool GrapaArray32::IsSignNeg() const { return (dataSigned && IsNeg()); }
 bool GrapaArray32::IsZero() const { return (GetCount()==0 || (GetCount() == 1 && GetItem(0) == 0) ? true : false); }
 bool GrapaArray32::IsItem(u32 pItem) const { return (GetCount() == 1 && GetItem(0) == pItem ? true : false); }
+// Limb i is items 2i and 2i+1, sign extended past the end like GetItem.
+u64 GrapaArray32::GetLimb(u64 pLimb) const { return ((u64)GetItem(pLimb * 2 + 1) << 32) | GetItem(pLimb * 2); }
+// True when the value fits one signed 64-bit limb, which the small value fast paths use.
+bool GrapaArray32::IsSmall() const { u64 c = GetCount(); return !NaN && c && (c < 2 || (c == 2 && (((GetItem(1) & 0x80000000) != 0) == dataSigned))); }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -247,9 +263,500 @@ void GrapaInt::operator =(s64 bi)
 	*this = bi2; 
 }
 
+// Small value and 64-bit limb kernels. Where the compiler has a 128-bit integer, add, subtract
+// and compare of values of up to two items, and multiply of values that fit one signed limb,
+// are done directly. Larger products run over 64-bit limbs with 128-bit products: schoolbook below
+// _intmullimbs_ limbs, then Karatsuba, then Toom-3 from _inttoom3limbs_ limbs. The item loops and
+// OpenSSL remain for compilers without a 128-bit integer.
+#if defined(__SIZEOF_INT128__)
+#define _intwide_
+typedef __int128 _ints128;
+typedef unsigned __int128 _intu128;
+#define _intmullimbs_ 48
+#define _inttoom3limbs_ 400
+
+// Value of a with at most two items, extended as GetItem does.
+static _ints128 _intwidevalue(const GrapaArray32& a)
+{
+	u64 c = a.GetCount();
+	_ints128 v = (_ints128)(c > 1 ? ((u64)a.GetItem(1) << 32) | a.GetItem(0) : (c ? (u64)a.GetItem(0) : 0));
+	if (a.dataSigned)
+		v -= ((_ints128)1) << (32 * c);
+	return v;
+}
+
+// Stores v in the fewest items whose top bit gives the sign, as RTrim leaves them.
+static void _intsetwide(GrapaArray32& r, _ints128 v)
+{
+	u64 n = 1;
+	for (; n < 4; n++)
+	{
+		_ints128 lim = ((_ints128)1) << (32 * n - 1);
+		if (v >= -lim && v < lim)
+			break;
+	}
+	r.NaN = false;
+	r.dataSigned = v < 0;
+	r.SetCount(n);
+	for (u64 i = 0; i < n; i++)
+		((u32*)r.mBytes)[i] = (u32)(v >> (32 * i));
+}
+
+// |a| as limbs into m, which has room for GetCount() / 2 + 2 limbs. Returns the limb count.
+static u64 _intmagnitude(const GrapaArray32& a, u64* m)
+{
+	u64 n = (a.GetCount() + 1) / 2;
+	u64 carry = 1;
+	for (u64 i = 0; i < n; i++)
+	{
+		u64 x = a.GetLimb(i);
+		if (a.dataSigned)
+		{
+			x = ~x + carry;
+			carry = (carry && x == 0) ? 1 : 0;
+		}
+		m[i] = x;
+	}
+	if (a.dataSigned && carry)
+		m[n++] = 1;
+	while (n && m[n - 1] == 0)
+		n--;
+	return n;
+}
+
+// r[0, na + nb) = a * b, summing each result limb by column into a three limb accumulator.
+static void _intmulmagnitude(const u64* a, u64 na, const u64* b, u64 nb, u64* r)
+{
+	if (na == 0 || nb == 0)
+	{
+		memset(r, 0, (size_t)(na + nb) * sizeof(u64));
+		return;
+	}
+	_intu128 acc = 0;
+	for (u64 k = 0; k + 1 < na + nb; k++)
+	{
+		u64 i0 = k < nb ? 0 : k - nb + 1;
+		u64 i1 = k < na ? k : na - 1;
+		u64 c2 = 0;
+		for (u64 i = i0; i <= i1; i++)
+		{
+			_intu128 p = (_intu128)a[i] * b[k - i];
+			acc += p;
+			c2 += acc < p;
+		}
+		r[k] = (u64)acc;
+		acc = (acc >> 64) | ((_intu128)c2 << 64);
+	}
+	r[na + nb - 1] = (u64)acc;
+}
+
+// r[0, 2n) = a[0, n)^2. Each cross product is summed once and doubled.
+static void _intsqrmagnitude(const u64* a, u64 n, u64* r)
+{
+	_intu128 acc = 0;
+	u64 c2 = 0;
+	for (u64 k = 0; k + 1 < 2 * n; k++)
+	{
+		u64 i0 = k < n ? 0 : k - n + 1;
+		_intu128 cross = 0;
+		u64 cc = 0;
+		for (u64 i = i0; i < k - i; i++)
+		{
+			_intu128 p = (_intu128)a[i] * a[k - i];
+			cross += p;
+			cc += cross < p;
+		}
+		cc = (cc << 1) | (u64)(cross >> 127);
+		cross <<= 1;
+		if ((k & 1) == 0)
+		{
+			_intu128 p = (_intu128)a[k / 2] * a[k / 2];
+			cross += p;
+			cc += cross < p;
+		}
+		acc += cross;
+		c2 += cc + (acc < cross);
+		r[k] = (u64)acc;
+		acc = (acc >> 64) | ((_intu128)c2 << 64);
+		c2 = 0;
+	}
+	r[2 * n - 1] = (u64)acc;
+}
+
+static void _intsetmagnitude(GrapaArray32& r, const u64* m, u64 n, bool neg)
+{
+	r.NaN = false;
+	r.dataSigned = false;
+	r.SetCount(2 * n + 1);
+	u32* d = (u32*)r.mBytes;
+	for (u64 i = 0; i < n; i++)
+	{
+		d[2 * i] = (u32)m[i];
+		d[2 * i + 1] = (u32)(m[i] >> 32);
+	}
+	d[2 * n] = 0;
+	if (neg)
+	{
+		u64 carry = 1;
+		for (u64 i = 0; i <= 2 * n; i++)
+		{
+			u64 x = (u64)(u32)~d[i] + carry;
+			d[i] = (u32)x;
+			carry = x >> 32;
+		}
+		r.dataSigned = true;
+	}
+	r.RTrim();
+}
+
+// Limb vectors for the recursive multiplications, least significant limb first, no top zero limbs.
+typedef std::vector<u64> _intlimbs;
+
+struct _intslimbs
+{
+	_intlimbs m;
+	bool neg;
+};
+
+static void _intlimbtrim(_intlimbs& a)
+{
+	while (a.size() && a.back() == 0)
+		a.pop_back();
+}
+
+static int _intlimbcmp(const _intlimbs& a, const _intlimbs& b)
+{
+	if (a.size() != b.size())
+		return a.size() < b.size() ? -1 : 1;
+	for (size_t i = a.size(); i-- > 0;)
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	return 0;
+}
+
+// r += a << (64 * pShift). a must not alias r.
+static void _intlimbaddto(_intlimbs& r, const u64* a, size_t na, size_t pShift)
+{
+	if (r.size() < na + pShift)
+		r.resize(na + pShift, 0);
+	u64 carry = 0;
+	size_t i = 0;
+	for (; i < na; i++)
+	{
+		_intu128 t = (_intu128)r[i + pShift] + a[i] + carry;
+		r[i + pShift] = (u64)t;
+		carry = (u64)(t >> 64);
+	}
+	for (i += pShift; carry; i++)
+	{
+		if (i == r.size())
+			r.push_back(0);
+		r[i] += carry;
+		carry = r[i] == 0 ? 1 : 0;
+	}
+}
+
+// r -= a, where r >= a. a must not alias r.
+static void _intlimbsubfrom(_intlimbs& r, const u64* a, size_t na)
+{
+	u64 borrow = 0;
+	size_t i = 0;
+	for (; i < na; i++)
+	{
+		u64 x = r[i];
+		r[i] = x - a[i] - borrow;
+		borrow = (x < a[i] || (x == a[i] && borrow)) ? 1 : 0;
+	}
+	for (; borrow && i < r.size(); i++)
+	{
+		borrow = r[i] == 0 ? 1 : 0;
+		r[i]--;
+	}
+	_intlimbtrim(r);
+}
+
+static void _intlimbmulsmall(_intlimbs& a, u64 k)
+{
+	u64 carry = 0;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		_intu128 t = (_intu128)a[i] * k + carry;
+		a[i] = (u64)t;
+		carry = (u64)(t >> 64);
+	}
+	if (carry)
+		a.push_back(carry);
+}
+
+// a /= d where the division is known to be exact.
+static void _intlimbdivexact(_intlimbs& a, u64 d)
+{
+	_intu128 rem = 0;
+	for (size_t i = a.size(); i-- > 0;)
+	{
+		_intu128 cur = (rem << 64) | a[i];
+		a[i] = (u64)(cur / d);
+		rem = cur % d;
+	}
+	_intlimbtrim(a);
+}
+
+// r += (aneg ? -a : a), signed.
+static void _intslimbaddto(_intslimbs& r, const _intlimbs& a, bool aneg)
+{
+	if (r.neg == aneg)
+		_intlimbaddto(r.m, a.data(), a.size(), 0);
+	else if (_intlimbcmp(r.m, a) >= 0)
+		_intlimbsubfrom(r.m, a.data(), a.size());
+	else
+	{
+		_intlimbs t(a);
+		_intlimbsubfrom(t, r.m.data(), r.m.size());
+		r.m.swap(t);
+		r.neg = aneg;
+	}
+	if (r.m.empty())
+		r.neg = false;
+}
+
+static _intlimbs _intlimbslice(const u64* a, size_t n, size_t pFrom, size_t pTo)
+{
+	if (pFrom > n) pFrom = n;
+	if (pTo > n) pTo = n;
+	_intlimbs s(a + pFrom, a + pTo);
+	_intlimbtrim(s);
+	return s;
+}
+
+static void _intlimbmul(const u64* a, size_t na, const u64* b, size_t nb, _intlimbs& r);
+
+static void _intslimbmul(const _intslimbs& x, const _intslimbs& y, _intslimbs& r)
+{
+	_intlimbmul(x.m.data(), x.m.size(), y.m.data(), y.m.size(), r.m);
+	r.neg = !r.m.empty() && x.neg != y.neg;
+}
+
+// r[0, n) = |x - y| where x has n limbs and y has ny <= n limbs. Returns true when x < y.
+static bool _intlimbabsdiff(const u64* x, const u64* y, size_t ny, size_t n, u64* r)
+{
+	bool neg = false;
+	for (size_t i = n; i-- > 0;)
+	{
+		u64 yi = i < ny ? y[i] : 0;
+		if (x[i] != yi)
+		{
+			neg = x[i] < yi;
+			break;
+		}
+	}
+	u64 borrow = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		u64 xi = x[i], yi = i < ny ? y[i] : 0;
+		u64 p = neg ? yi : xi, q = neg ? xi : yi;
+		r[i] = p - q - borrow;
+		borrow = (p < q || (p == q && borrow)) ? 1 : 0;
+	}
+	return neg;
+}
+
+static size_t _intlimbkaratsubascratch(size_t n)
+{
+	return 8 * n + 512;
+}
+
+// r[0, 2n) = a[0, n) * b[0, n), squaring when a == b. Uses the subtractive form z1 = z0 + z2 - (a0 - a1)(b0 - b1) so the
+// half products never carry past h limbs. t is scratch of _intlimbkaratsubascratch(n) limbs.
+static void _intlimbkaratsuba(const u64* a, const u64* b, size_t n, u64* r, u64* t)
+{
+	if (n < _intmullimbs_)
+	{
+		if (a == b)
+			_intsqrmagnitude(a, n, r);
+		else
+			_intmulmagnitude(a, n, b, n, r);
+		return;
+	}
+	size_t h = (n + 1) / 2, l = n - h;
+	bool nega = _intlimbabsdiff(a, a + h, l, h, t);
+	bool negb = nega;
+	u64* db = t;
+	if (a != b)
+	{
+		db = t + h;
+		negb = _intlimbabsdiff(b, b + h, l, h, db);
+	}
+	u64* dm = t + 2 * h;
+	u64* w = t + 4 * h;
+	u64* next = t + 6 * h + 1;
+	_intlimbkaratsuba(a, b, h, r, next);
+	_intlimbkaratsuba(a + h, b + h, l, r + 2 * h, next);
+	_intlimbkaratsuba(t, db, h, dm, next);
+
+	u64 carry = 0;
+	for (size_t k = 0; k < 2 * h; k++)
+	{
+		_intu128 v = (_intu128)r[k] + (k < 2 * l ? r[2 * h + k] : 0) + carry;
+		w[k] = (u64)v;
+		carry = (u64)(v >> 64);
+	}
+	w[2 * h] = carry;
+	if (nega == negb)
+	{
+		u64 borrow = 0;
+		for (size_t k = 0; k <= 2 * h; k++)
+		{
+			u64 x = w[k], y = k < 2 * h ? dm[k] : 0;
+			w[k] = x - y - borrow;
+			borrow = (x < y || (x == y && borrow)) ? 1 : 0;
+		}
+	}
+	else
+	{
+		carry = 0;
+		for (size_t k = 0; k <= 2 * h; k++)
+		{
+			_intu128 v = (_intu128)w[k] + (k < 2 * h ? dm[k] : 0) + carry;
+			w[k] = (u64)v;
+			carry = (u64)(v >> 64);
+		}
+	}
+
+	carry = 0;
+	for (size_t k = 0; h + k < 2 * n && (k <= 2 * h || carry); k++)
+	{
+		_intu128 v = (_intu128)r[h + k] + (k <= 2 * h ? w[k] : 0) + carry;
+		r[h + k] = (u64)v;
+		carry = (u64)(v >> 64);
+	}
+}
+
+// Splits in thirds and evaluates at 0, 1, -1, -2 and infinity: 5 third size products instead of 9.
+// Interpolation follows Bodrato's sequence.
+static void _intlimbtoom3(const u64* a, size_t na, const u64* b, size_t nb, _intlimbs& r)
+{
+	size_t k = (na + 2) / 3;
+	_intlimbs a0 = _intlimbslice(a, na, 0, k), a1 = _intlimbslice(a, na, k, 2 * k), a2 = _intlimbslice(a, na, 2 * k, na);
+	_intlimbs b0 = _intlimbslice(b, nb, 0, k), b1 = _intlimbslice(b, nb, k, 2 * k), b2 = _intlimbslice(b, nb, 2 * k, nb);
+	_intslimbs pa1, pam1, pam2, pb1, pbm1, pbm2;
+
+	pa1.m = a0; pa1.neg = false;
+	_intlimbaddto(pa1.m, a2.data(), a2.size(), 0);
+	pam1 = pa1;
+	_intslimbaddto(pa1, a1, false);
+	_intslimbaddto(pam1, a1, true);
+	pam2 = pam1;
+	_intslimbaddto(pam2, a2, false);
+	_intlimbmulsmall(pam2.m, 2);
+	_intslimbaddto(pam2, a0, true);
+
+	pb1.m = b0; pb1.neg = false;
+	_intlimbaddto(pb1.m, b2.data(), b2.size(), 0);
+	pbm1 = pb1;
+	_intslimbaddto(pb1, b1, false);
+	_intslimbaddto(pbm1, b1, true);
+	pbm2 = pbm1;
+	_intslimbaddto(pbm2, b2, false);
+	_intlimbmulsmall(pbm2.m, 2);
+	_intslimbaddto(pbm2, b0, true);
+
+	_intlimbs r0, rinf;
+	_intslimbs r1, rm1, rm2;
+	_intlimbmul(a0.data(), a0.size(), b0.data(), b0.size(), r0);
+	_intlimbmul(a2.data(), a2.size(), b2.data(), b2.size(), rinf);
+	_intslimbmul(pa1, pb1, r1);
+	_intslimbmul(pam1, pbm1, rm1);
+	_intslimbmul(pam2, pbm2, rm2);
+
+	_intslimbs s3 = rm2;
+	_intslimbaddto(s3, r1.m, !r1.neg);
+	_intlimbdivexact(s3.m, 3);
+	_intslimbs s1 = r1;
+	_intslimbaddto(s1, rm1.m, !rm1.neg);
+	_intlimbdivexact(s1.m, 2);
+	_intslimbs s2 = rm1;
+	_intslimbaddto(s2, r0, true);
+	_intslimbs t = s2;
+	_intslimbaddto(t, s3.m, !s3.neg);
+	_intlimbdivexact(t.m, 2);
+	_intlimbs rinf2(rinf);
+	_intlimbmulsmall(rinf2, 2);
+	_intslimbaddto(t, rinf2, false);
+	s3 = t;
+	_intslimbaddto(s2, s1.m, s1.neg);
+	_intslimbaddto(s2, rinf, true);
+	_intslimbaddto(s1, s3.m, !s3.neg);
+
+	r.swap(r0);
+	r.reserve(na + nb);
+	_intlimbaddto(r, s1.m.data(), s1.m.size(), k);
+	_intlimbaddto(r, s2.m.data(), s2.m.size(), 2 * k);
+	_intlimbaddto(r, s3.m.data(), s3.m.size(), 3 * k);
+	_intlimbaddto(r, rinf.data(), rinf.size(), 4 * k);
+	_intlimbtrim(r);
+}
+
+// r = a * b on magnitudes. Unequal lengths are cut into slices of the shorter length, then
+// schoolbook, Karatsuba or Toom-3 is chosen by that length.
+static void _intlimbmul(const u64* a, size_t na, const u64* b, size_t nb, _intlimbs& r)
+{
+	while (na && a[na - 1] == 0) na--;
+	while (nb && b[nb - 1] == 0) nb--;
+	if (na < nb)
+	{
+		const u64* t = a; a = b; b = t;
+		size_t n = na; na = nb; nb = n;
+	}
+	r.clear();
+	if (nb == 0)
+		return;
+	if (na == nb && a != b && memcmp(a, b, (size_t)na * sizeof(u64)) == 0)
+		b = a;
+	if (nb < _intmullimbs_)
+	{
+		r.resize(na + nb);
+		if (a == b)
+			_intsqrmagnitude(a, na, r.data());
+		else
+			_intmulmagnitude(a, na, b, nb, r.data());
+		_intlimbtrim(r);
+		return;
+	}
+	if (nb < na)
+	{
+		// Unbalanced: multiply b by slices of a of its own length.
+		_intlimbs p;
+		r.reserve(na + nb);
+		for (size_t i = 0; i < na; i += nb)
+		{
+			_intlimbmul(a + i, (na - i < nb) ? na - i : nb, b, nb, p);
+			_intlimbaddto(r, p.data(), p.size(), i);
+		}
+		_intlimbtrim(r);
+		return;
+	}
+	if (nb < _inttoom3limbs_)
+	{
+		_intlimbs t(_intlimbkaratsubascratch(nb));
+		r.resize(2 * nb);
+		_intlimbkaratsuba(a, b, nb, r.data(), t.data());
+		_intlimbtrim(r);
+	}
+	else
+		_intlimbtoom3(a, na, b, nb, r);
+}
+#endif
+
 GrapaInt GrapaInt::operator +(const GrapaInt& bi2) const
 {
 	GrapaInt result;
+#ifdef _intwide_
+	if (GetCount() && bi2.GetCount() && GetCount() <= 2 && bi2.GetCount() <= 2 && !NaN && !bi2.NaN)
+	{
+		_intsetwide(result, _intwidevalue(*this) + _intwidevalue(bi2));
+		return result;
+	}
+#endif
 	//GrapaInt bi2(bi);
 	result.SetCount(((GetCount() > bi2.GetCount()) ? GetCount() : bi2.GetCount()) + ((dataSigned || bi2.dataSigned) ? 1 : 0));
 	result.dataSigned = (dataSigned || bi2.dataSigned);
@@ -322,6 +829,13 @@ GrapaInt GrapaInt::operator -(const GrapaInt& bi2) const
 {
 	//GrapaInt bi2(bi);
 	GrapaInt result;
+#ifdef _intwide_
+	if (GetCount() && bi2.GetCount() && GetCount() <= 2 && bi2.GetCount() <= 2 && !NaN && !bi2.NaN)
+	{
+		_intsetwide(result, _intwidevalue(*this) - _intwidevalue(bi2));
+		return result;
+	}
+#endif
 	result.SetCount(((GetCount() > bi2.GetCount()) ? GetCount() : bi2.GetCount()) + ((dataSigned || bi2.dataSigned)?1:0));
 	result.dataSigned = dataSigned;
 	s64 carryIn = 0;
@@ -518,69 +1032,15 @@ static GrapaInt FftMultiply(const GrapaInt& bi1, const GrapaInt& bi2)
 	return result;
 }
 
-static GrapaInt GrapaMultiply(const GrapaInt& bi1, const GrapaInt& bi2)
-{
-	GrapaInt result;
-	result.SetCount(bi1.GetCount() + bi2.GetCount());
-	for (s32 i = 0; i < bi1.GetCount(); i++)
-	{
-		if (bi1.GetItem(i) == 0)
-			continue;
-		u32 mcarry = 0;
-		for (s32 j = 0, k = i; j < bi2.GetCount(); j++, k++)
-		{
-			u64 val = ((u64)bi1.GetItem(i) * (u64)bi2.GetItem(j)) +
-				(u64)result.GetItem(k) + mcarry;
-			result.SetItem(k, (u32)(val & 0xFFFFFFFF));
-			mcarry = (val >> 32);
-		}
-		if (mcarry)
-			result.SetItem(i + bi2.GetCount(), mcarry);
-	}
-	result.RTrim();
-	return result;
-}
-
-static GrapaInt KaratsubaMultiply(const GrapaInt& x, const GrapaInt& y)
-{
-	s64 xLength = x.GetCount();
-	s64 yLength = y.GetCount();
-	s64 N = (xLength > yLength) ? xLength : yLength;
-	if (N <= 3)
-		return GrapaMultiply(x,y);
-	N = (N / 2) + (N % 2);
-	GrapaInt Xl,Xr;
-	Xl.SetCount((xLength-N)>0? (xLength - N): 0);
-	Xr.SetCount(N);
-	for (s32 j = 0; j < N; j++) Xr.SetItem(j, x.GetItem(j));
-	for (s32 j = N; j < xLength; j++) Xl.SetItem(j-N, x.GetItem(j));
-	GrapaInt Yl,Yr;
-	Yl.SetCount((yLength - N) > 0 ? (yLength - N) : 0);
-	Yr.SetCount(N);
-	for (s32 j = 0; j < N; j++) Yr.SetItem(j, y.GetItem(j));
-	for (s32 j = N; j < yLength; j++) Yl.SetItem(j - N, y.GetItem(j));
-	Xl.RTrim();
-	Xr.RTrim();
-	Yl.RTrim();
-	Yr.RTrim();
-	GrapaInt P1 = KaratsubaMultiply(Xl, Yl);
-	GrapaInt P2 = KaratsubaMultiply(Xr, Yr);
-	GrapaInt Xa = Xl + Xr;
-	GrapaInt Ya = Yl + Yr;
-	GrapaInt P3 = KaratsubaMultiply(Xa, Ya);
-	return (P1 << (2 * N * 32)) + ((P3 - P1 - P2) << (N * 32)) + P2;
-}
-
 static GrapaInt OpenSSLMultiply(const GrapaInt& bi1, const GrapaInt& bi2)
 {
 	BIGNUM* n1 = bi1.getBytesOpenSSL();
 	BIGNUM* n2 = bi2.getBytesOpenSSL();
 	BIGNUM* r = BN_new();
-	BN_CTX* ctx = BN_CTX_new();
+	BN_CTX* ctx = GrapaInt::OpenSSLContext();
 	int err = BN_mul(r, n1, n2, ctx);
 	BN_free(n1);
 	BN_free(n2);
-	BN_CTX_free(ctx);
 	GrapaInt result;
 	if (err == 1)
 		result.setBytesOpenSSL(r);
@@ -602,6 +1062,34 @@ static GrapaInt OpenSSLMultiply(const GrapaInt& bi1, const GrapaInt& bi2)
 
 GrapaInt GrapaInt::operator *(const GrapaInt& bi) const
 {
+#ifdef _intwide_
+	if (IsSmall() && bi.IsSmall())
+	{
+		GrapaInt result;
+		_intsetwide(result, (_ints128)(s64)GetLimb(0) * (s64)bi.GetLimb(0));
+		return result;
+	}
+	if (GetCount() && bi.GetCount() && GetCount() <= 2 * _intmullimbs_ && bi.GetCount() <= 2 * _intmullimbs_ && !NaN && !bi.NaN)
+	{
+		u64 ma[_intmullimbs_ + 2], mb[_intmullimbs_ + 2], mr[2 * _intmullimbs_ + 4];
+		u64 na = _intmagnitude(*this, ma);
+		u64 nb = _intmagnitude(bi, mb);
+		_intmulmagnitude(ma, na, mb, nb, mr);
+		GrapaInt result;
+		_intsetmagnitude(result, mr, na + nb, na && nb && dataSigned != bi.dataSigned);
+		return result;
+	}
+	if (GetCount() && bi.GetCount() && !NaN && !bi.NaN)
+	{
+		_intlimbs ma((size_t)GetCount() / 2 + 2), mb((size_t)bi.GetCount() / 2 + 2), mr;
+		u64 na = _intmagnitude(*this, ma.data());
+		u64 nb = _intmagnitude(bi, mb.data());
+		_intlimbmul(ma.data(), (size_t)na, mb.data(), (size_t)nb, mr);
+		GrapaInt result;
+		_intsetmagnitude(result, mr.data(), mr.size(), !mr.empty() && dataSigned != bi.dataSigned);
+		return result;
+	}
+#endif
 	return OpenSSLMultiply(*this, bi);
 }
 
@@ -621,44 +1109,44 @@ GrapaInt GrapaInt::operator <<(u64 shiftVal)
 {
 	GrapaInt result(*this);
 	u32 oldCount = (u32)result.GetCount();
-	result.GrowCount(oldCount + shiftVal/sizeof(32) + 1);
+	result.GrowCount(oldCount + shiftVal / 32 + 1);
 	int newCount = GrapaInt::shiftLeft((u32*)result.mBytes, oldCount, shiftVal);
 	result.SetCount(newCount);
 	return result;
 }
 
+// Whole words move with memmove; only the remaining 0..31 bits need a pass over the items.
 int GrapaInt::shiftLeft(u32* inData, u32 inCount, u64 shiftVal)
 {
-	u64 shiftAmount = 32;
 	u32 bufLen = inCount;
 
 	while (bufLen > 1 && inData[bufLen - 1] == 0)
 		bufLen--;
 
-	for (u64 count = shiftVal; count > 0;)
-	{
-		if (count < shiftAmount)
-			shiftAmount = count;
+	if (bufLen == 0 || (bufLen == 1 && inData[0] == 0))
+		return bufLen;
 
-		u64 carry = 0;
-		for (u32 i = 0; i < bufLen; i++)
-		{
-			u64 val = ((u64)inData[i]) << shiftAmount;
-			val |= carry;
+	u32 words = (u32)(shiftVal / 32);
+	u32 bits = (u32)(shiftVal % 32);
 
-			inData[i] = (u32)(val & 0xFFFFFFFF);
-			carry = val >> 32;
-		}
+	if (words)
+	{
+		memmove(&inData[words], inData, (size_t)bufLen * sizeof(u32));
+		memset(inData, 0, (size_t)words * sizeof(u32));
+		bufLen += words;
+	}
 
-		if (carry != 0)
+	if (bits)
+	{
+		u32 carry = 0;
+		for (u32 i = words; i < bufLen; i++)
 		{
-			if (bufLen + 1 >= inCount)
-			{
-				inData[bufLen] = (u32)carry;
-				bufLen++;
-			}
+			u64 val = (((u64)inData[i]) << bits) | carry;
+			inData[i] = (u32)val;
+			carry = (u32)(val >> 32);
 		}
-		count -= shiftAmount;
+		if (carry != 0)
+			inData[bufLen++] = carry;
 	}
 	return bufLen;
 }
@@ -690,37 +1178,41 @@ GrapaInt GrapaInt::operator >>(u64 shiftVal)
 
 int GrapaInt::shiftRight(u32* inData, u32 inCount, u64 shiftVal)
 {
-	u64 shiftAmount = 32;
-	u64 invShift = 0;
 	s32 bufLen = inCount;
 
 	while (bufLen > 1 && inData[bufLen - 1] == 0)
 		bufLen--;
 
-	for (u64 count = shiftVal; count > 0;)
-	{
-		if (count < shiftAmount)
-		{
-			shiftAmount = count;
-			invShift = 32 - shiftAmount;
-		}
+	if (bufLen == 0)
+		return bufLen;
 
-		u64 carry = 0;
-		for (s32 i = bufLen - 1; i >= 0; i--)
-		{
-			u64 val = ((u64)inData[i]) >> shiftAmount;
-			val |= carry;
+	u64 words = shiftVal / 32;
+	u32 bits = (u32)(shiftVal % 32);
 
-			carry = (((u64)inData[i]) << invShift) & 0xFFFFFFFF;
-			inData[i] = (u32)(val);
-		}
+	if (words >= (u64)bufLen)
+	{
+		inData[0] = 0;
+		return 1;
+	}
 
-		count -= shiftAmount;
+	if (words)
+	{
+		memmove(inData, &inData[words], (size_t)(bufLen - words) * sizeof(u32));
+		bufLen -= (s32)words;
+	}
 
-		while (bufLen > 1 && inData[bufLen - 1] == 0)
-			bufLen--;
+	if (bits)
+	{
+		for (s32 i = 0; i < bufLen; i++)
+		{
+			u32 next = (i + 1 < bufLen) ? inData[i + 1] : 0;
+			inData[i] = (u32)((inData[i] >> bits) | (((u64)next << (32 - bits)) & 0xFFFFFFFF));
+		}
 	}
 
+	while (bufLen > 1 && inData[bufLen - 1] == 0)
+		bufLen--;
+
 	return bufLen;
 }
 
@@ -771,6 +1263,10 @@ bool GrapaInt::Equals(const GrapaInt& bi2) const
 
 bool GrapaInt::operator >(const GrapaInt& bi2) const
 {
+#ifdef _intwide_
+	if (GetCount() <= 2 && bi2.GetCount() <= 2)
+		return _intwidevalue(*this) > _intwidevalue(bi2);
+#endif
 	bool aNeg = IsSignNeg();
 	bool bNeg = bi2.IsSignNeg();
 
@@ -802,6 +1298,10 @@ bool GrapaInt::operator >(u64 i1) const
 
 bool GrapaInt::operator <(const GrapaInt& bi2) const
 {
+#ifdef _intwide_
+	if (GetCount() <= 2 && bi2.GetCount() <= 2)
+		return _intwidevalue(*this) < _intwidevalue(bi2);
+#endif
 	bool aNeg = IsSignNeg();
 	bool bNeg = bi2.IsSignNeg();
 
@@ -848,6 +1348,71 @@ GrapaInt GrapaInt::Abs() const
 	return *this;
 }
 
+// Division by multiplication with a Newton reciprocal, once divisor and quotient both pass
+// _intnewtonbits_ bits; below that OpenSSL's BN_div wins. The products run through the Karatsuba and
+// Toom-3 kernels above, so a division costs a few multiplications instead of a quadratic loop.
+#define _intnewtonbits_ 8192
+
+// x ~ 2^(2n) / d, within a few units, for d of exactly n bits. Each level computes the top half of d
+// first, then one Newton step doubles the precision: x = 2 x0 - d x0^2 / 2^(2n).
+static GrapaInt _intrecip(const GrapaInt& d, s64 n)
+{
+	GrapaInt q, r;
+	if (n <= _intnewtonbits_)
+	{
+		(GrapaInt(1) << (u64)(2 * n)).multiByteDivide(d, q, r);
+		return q;
+	}
+	s64 h = n / 2 + 16;
+	GrapaInt dh(d);
+	dh = dh >> (u64)(n - h);
+	GrapaInt x = _intrecip(dh, h) << (u64)(n - h);
+	GrapaInt t = (x * x) >> (u64)(n - 32);
+	t = (d * t) >> (u64)(n + 32);
+	return (x << 1) - t;
+}
+
+// q = a / b, r = a % b for a, b >= 0, given x = _intrecip of the top n bits of b (b shifted up when it
+// has fewer than n bits). n must be at least 32 bits more than the quotient.
+static void _intdivrecip(const GrapaInt& a, const GrapaInt& b, const GrapaInt& x, s64 n, GrapaInt& q, GrapaInt& r)
+{
+	s64 m = (s64)a.bitCount();
+	s64 sb = (s64)b.bitCount();
+	s64 e = m - n - 2 > 0 ? m - n - 2 : 0;
+	GrapaInt at(a);
+	if (e)
+		at = at >> (u64)e;
+	q = (at * x) >> (u64)(n + sb - e);
+	r = a - q * b;
+	while (r.IsSignNeg())
+	{
+		q = q - (s64)1;
+		r = r + b;
+	}
+	while (r >= b)
+	{
+		q = q + (s64)1;
+		r = r - b;
+	}
+}
+
+static bool _intnewton(const GrapaInt& a, const GrapaInt& b)
+{
+	if (a.IsSignNeg() || b.IsSignNeg())
+		return false;
+	s64 sb = (s64)b.bitCount();
+	return sb >= _intnewtonbits_ && (s64)a.bitCount() - sb >= _intnewtonbits_;
+}
+
+static void _intdivnewton(const GrapaInt& a, const GrapaInt& b, GrapaInt& q, GrapaInt& r)
+{
+	s64 sb = (s64)b.bitCount();
+	s64 n = (s64)a.bitCount() - sb + 33;
+	GrapaInt d(b);
+	d = n <= sb ? d >> (u64)(sb - n) : d << (u64)(n - sb);
+	_intdivrecip(a, b, _intrecip(d, n), n, q, r);
+}
+
 void GrapaInt::multiByteDivide(const GrapaInt& bi2, GrapaInt& outQuotient, GrapaInt& outRemainder)
 {
 	//GrapaInt bi2(bi);
@@ -857,6 +1422,12 @@ void GrapaInt::multiByteDivide(const GrapaInt& bi2, GrapaInt& outQuotient, Grapa
 	if (IsZero()) return;
 	if (bi2.IsZero()) return;  // it's actually infinity...or undefined.
 
+	if (_intnewton(*this, bi2))
+	{
+		_intdivnewton(*this, bi2, outQuotient, outRemainder);
+		return;
+	}
+
 	GrapaInt result;
 	int err;
 	BIGNUM* n1, * n2;
@@ -866,11 +1437,10 @@ void GrapaInt::multiByteDivide(const GrapaInt& bi2, GrapaInt& outQuotient, Grapa
 
 	BIGNUM* dv = BN_new();
 	BIGNUM* rem = BN_new();
-	BN_CTX* ctx = BN_CTX_new();
+	BN_CTX* ctx = OpenSSLContext();
 	err = BN_div(dv,rem, n1, n2, ctx);
 	BN_free(n1);
 	BN_free(n2);
-	BN_CTX_free(ctx);
 	if (err == 1)
 	{
 		outQuotient.setBytesOpenSSL(dv);
@@ -1198,11 +1768,10 @@ GrapaInt GrapaInt::Pow(const GrapaInt& pexp) const
 	n1 = getBytesOpenSSL();
 	n2 = pexp.getBytesOpenSSL();
 	BIGNUM* r = BN_new();
-	BN_CTX* ctx = BN_CTX_new();
+	BN_CTX* ctx = OpenSSLContext();
 	err = BN_exp(r, n1, n2, ctx);
 	BN_free(n1);
 	BN_free(n2);
-	BN_CTX_free(ctx);
 	if (err == 1)
 		result.setBytesOpenSSL(r);
 	else
@@ -1440,6 +2009,174 @@ u64 GrapaInt::LargestPrimeFactor64(u64 n)
 	return p;
 }
 
+// Divide-and-conquer radix conversion. Values of more than _intradixbits_ bits are split by powers
+// radix^(c 2^i), c being the most digits whose power fits in 32 bits, and each half converted on its
+// own; the powers and their reciprocals are cached per radix. Hex stays with BN_bn2hex, which is
+// already linear.
+#define _intradixbits_ 4096
+
+struct GrapaIntRadixPower
+{
+	GrapaInt mPow, mRecip;
+	s64 mBits, mRecipBits, mDigits;
+};
+
+struct GrapaIntRadixCache
+{
+	GrapaCritical mLock;
+	std::vector<GrapaIntRadixPower*> mPowers;
+};
+
+static GrapaIntRadixCache gIntRadix[65];
+
+static u64 _intradixchunk(u64 radix, u64& pPow)
+{
+	u64 c = 0;
+	pPow = 1;
+	while (pPow * radix <= 0xFFFFFFFFull)
+	{
+		pPow *= radix;
+		c++;
+	}
+	return c;
+}
+
+// Entry for radix^(c 2^pLevel), with its reciprocal when it is large enough for _intdivrecip to win.
+// Entries are never freed, so the pointer stays good after the lock is released.
+static const GrapaIntRadixPower* _intradixpower(u64 radix, u64 pLevel)
+{
+	GrapaIntRadixCache& cache = gIntRadix[radix];
+	cache.mLock.WaitCritical();
+	while (cache.mPowers.size() <= pLevel)
+	{
+		GrapaIntRadixPower* p = new GrapaIntRadixPower();
+		if (cache.mPowers.empty())
+		{
+			u64 pw;
+			p->mDigits = (s64)_intradixchunk(radix, pw);
+			p->mPow = GrapaInt((s64)pw);
+		}
+		else
+		{
+			const GrapaIntRadixPower* b = cache.mPowers.back();
+			p->mDigits = b->mDigits * 2;
+			p->mPow = b->mPow * b->mPow;
+		}
+		p->mBits = (s64)p->mPow.bitCount();
+		p->mRecipBits = 0;
+		if (p->mBits >= _intnewtonbits_)
+		{
+			p->mRecipBits = p->mBits + 34;
+			p->mRecip = _intrecip(p->mPow << (u64)34, p->mRecipBits);
+		}
+		cache.mPowers.push_back(p);
+	}
+	const GrapaIntRadixPower* result = cache.mPowers[pLevel];
+	cache.mLock.LeaveCritical();
+	return result;
+}
+
+static const char* _intradixchars = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz+/";
+
+// Digits of a >= 0 by repeated division, or by BN_bn2dec for radix 10.
+static void _intradixdigits(const GrapaInt& a, u64 radix, GrapaCHAR& result)
+{
+	if (radix == 10)
+	{
+		BIGNUM* bn = a.getBytesOpenSSL();
+		char* str = BN_bn2dec(bn);
+		result.Append(str);
+		OPENSSL_free(str);
+		BN_free(bn);
+		return;
+	}
+	if (a.IsZero())
+	{
+		result.Append('0');
+		return;
+	}
+	GrapaInt n(a), quotient, remainder, biRadix((s64)radix);
+	u64 start = result.mLength;
+	while (n.GetCount() > 1 || (n.GetCount() == 1 && n.GetItem(0) != 0))
+	{
+		n.singleByteDivide(biRadix, quotient, remainder);
+		result.Append(_intradixchars[(u32)remainder.GetItem(0)]);
+		n = quotient;
+	}
+	for (u64 i = start, j = result.mLength - 1; i < j; i++, j--)
+	{
+		u8 c = result.mBytes[i];
+		result.mBytes[i] = result.mBytes[j];
+		result.mBytes[j] = c;
+	}
+}
+
+// Appends a >= 0, a < radix^(c 2^(pLevel + 1)), padded with zeros to pWidth digits when pWidth is set.
+static void _intradixout(const GrapaInt& a, u64 radix, s64 pLevel, s64 pWidth, GrapaCHAR& result)
+{
+	if (pLevel < 0 || (s64)a.bitCount() <= _intradixbits_)
+	{
+		GrapaCHAR digits;
+		_intradixdigits(a, radix, digits);
+		if (pWidth > (s64)digits.mLength)
+		{
+			GrapaCHAR pad;
+			pad.Pad(pWidth - digits.mLength, '0');
+			result.Append(pad);
+		}
+		result.Append(digits);
+		return;
+	}
+	const GrapaIntRadixPower* p = _intradixpower(radix, pLevel);
+	if (a < p->mPow)
+	{
+		if (pWidth > p->mDigits)
+		{
+			GrapaCHAR pad;
+			pad.Pad(pWidth - p->mDigits, '0');
+			result.Append(pad);
+			pWidth = p->mDigits;
+		}
+		_intradixout(a, radix, pLevel - 1, pWidth, result);
+		return;
+	}
+	GrapaInt q, r;
+	if (p->mRecipBits)
+		_intdivrecip(a, p->mPow, p->mRecip, p->mRecipBits, q, r);
+	else
+		GrapaInt(a).multiByteDivide(p->mPow, q, r);
+	_intradixout(q, radix, pLevel - 1, pWidth ? pWidth - p->mDigits : 0, result);
+	_intradixout(r, radix, pLevel - 1, p->mDigits, result);
+}
+
+// Value of digit values d[0, n) in radix, most significant first. Chunks of c digits are summed in a
+// u64, then neighbours are joined level by level from the right: left * radix^(c 2^i) + right.
+static GrapaInt _intradixin(const u8* d, u64 n, u64 radix)
+{
+	u64 pw;
+	u64 c = _intradixchunk(radix, pw);
+	std::vector<GrapaInt> nodes;
+	nodes.reserve((size_t)(n / c + 1));
+	for (u64 end = n; end > 0; end = end > c ? end - c : 0)
+	{
+		u64 v = 0;
+		for (u64 i = end > c ? end - c : 0; i < end; i++)
+			v = v * radix + d[i];
+		nodes.push_back(GrapaInt((s64)v));
+	}
+	for (u64 level = 0; nodes.size() > 1; level++)
+	{
+		const GrapaIntRadixPower* p = _intradixpower(radix, level);
+		size_t k = 0;
+		for (size_t i = 0; i + 1 < nodes.size(); i += 2)
+			nodes[k++] = nodes[i + 1] * p->mPow + nodes[i];
+		if (nodes.size() & 1)
+			nodes[k++] = nodes.back();
+		nodes.resize(k);
+	}
+	return nodes.empty() ? GrapaInt(0) : nodes[0];
+}
+
 GrapaCHAR GrapaInt::ToString() const
 {
 	return ToString(10);
@@ -1462,6 +2199,21 @@ GrapaCHAR GrapaInt::ToString(u64 radix) const
 	if (radix < 2 || radix > 64)
 		return result;// (new ArgumentException("Radix must be >= 2 and <= 36"));
 
+	if (radix != 16 && bitCount() > _intradixbits_)
+	{
+		GrapaInt a(*this);
+		if (a.IsSignNeg())
+		{
+			a = -a;
+			result.Append('-');
+		}
+		s64 level = 0;
+		while (_intradixpower(radix, level + 1)->mBits <= (s64)a.bitCount())
+			level++;
+		_intradixout(a, radix, level, 0, result);
+		return result;
+	}
+
 	if (radix == 10)
 	{
 		BIGNUM* bn = getBytesOpenSSL();
@@ -1533,6 +2285,37 @@ void GrapaInt::FromString(const GrapaBYTE& result, u32 radix)
 {
 	*this = 0;
 	if (radix < 2 || radix > 64 || result.mLength == 0) return;
+	if (radix != 16)
+	{
+		// Same digits BN_dec2bn or the loop below would take: an optional leading '-', then the
+		// leading decimal digits for radix 10, or the whole string when every character is a digit
+		// of radix.
+		const u8* p = result.mBytes;
+		u64 len = result.mLength;
+		bool isNeg = len && p[0] == '-';
+		if (isNeg)
+		{
+			p++;
+			len--;
+		}
+		std::vector<u8> digits((size_t)len);
+		u64 n = 0;
+		for (; n < len; n++)
+		{
+			u8 c = p[n];
+			u32 v = (c >= '0' && c <= '9') ? c - '0' : (c >= 'A' && c <= 'Z') ? 10 + c - 'A' : (c >= 'a' && c <= 'z') ? 36 + c - 'a' : c == '+' ? 62 : c == '/' ? 63 : 64;
+			if (v >= radix)
+				break;
+			digits[(size_t)n] = (u8)v;
+		}
+		if ((radix == 10 && n > (_intradixbits_ / 3)) || (radix != 10 && n && n == len))
+		{
+			*this = _intradixin(digits.data(), n, radix);
+			if (isNeg && !IsZero())
+				*this = -*this;
+			return;
+		}
+	}
 	if (radix == 10)
 	{
 		BIGNUM* bn = nullptr;
@@ -1688,6 +2471,19 @@ void GrapaInt::FromBytes(const GrapaBYTE& result, bool isUnsigned)
 //	}
 //}
 
+// One BN_CTX per thread, kept for the life of the thread rather than allocated per operation.
+BN_CTX* GrapaInt::OpenSSLContext()
+{
+	struct Holder
+	{
+		BN_CTX* ctx;
+		Holder() { ctx = BN_CTX_new(); }
+		~Holder() { BN_CTX_free(ctx); }
+	};
+	static thread_local Holder holder;
+	return holder.ctx;
+}
+
 BIGNUM* GrapaInt::getBytesOpenSSL() const
 {
 	GrapaBYTE gb;
@@ -1718,27 +2514,230 @@ void GrapaInt::setBytesOpenSSL(BIGNUM* b)
 		*this = -*this;
 }
 
+// Modular contexts. Get keeps the most recently used _intmodcache_ contexts; callers hold a
+// shared_ptr, so an evicted context lives until its last user is done with it.
+#define _intmodcache_ 16
+// modPow goes through a cached context from this modulus size up.
+#define _intmodbits_ 256
+// Below this much work (exponentiations times modulus bits squared) PowBatch stays on one thread.
+#define _intmodparallelwork_ 1048576
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <thread>
+
+static void _intparallel(u64 pCount, u64 pWork, const std::function<void(u64)>& pTask)
+{
+	u64 threads = std::thread::hardware_concurrency();
+	if (threads > pCount)
+		threads = pCount;
+	if (pWork < _intmodparallelwork_ || threads < 2)
+	{
+		for (u64 t = 0; t < pCount; t++)
+			pTask(t);
+		return;
+	}
+	std::atomic<u64> next(0);
+	std::vector<std::future<void>> futures;
+	for (u64 w = 1; w < threads; w++)
+		futures.push_back(std::async(std::launch::async, [&]() {
+			for (u64 t = next++; t < pCount; t = next++)
+				pTask(t);
+			}));
+	for (u64 t = next++; t < pCount; t = next++)
+		pTask(t);
+	for (auto& f : futures) f.get();
+}
+
+static GrapaCritical gIntModLock;
+static std::vector<std::shared_ptr<GrapaIntModContext>> gIntMod;
+
+// For an odd modulus and a nonzero base, the table holds base^(d 2^(w i)) in Montgomery form for
+// every window i of an exponent up to the modulus size and digit d in 1..2^w-1, so PowBase needs
+// one multiply per window and no squarings.
+GrapaIntModContext::GrapaIntModContext(const GrapaInt& modulus, const GrapaInt& base)
+{
+	mModulus = modulus;
+	mBase = base;
+	mN = modulus.getBytesOpenSSL();
+	BN_set_negative(mN, 0);
+	mMont = NULL;
+	mOne = NULL;
+	mWindow = 4;
+	mTableBits = 0;
+	BN_CTX* ctx = GrapaInt::OpenSSLContext();
+	if (!BN_is_odd(mN))
+		return;
+	mMont = BN_MONT_CTX_new();
+	if (!BN_MONT_CTX_set(mMont, mN, ctx))
+	{
+		BN_MONT_CTX_free(mMont);
+		mMont = NULL;
+		return;
+	}
+	mOne = BN_new();
+	BN_one(mOne);
+	BN_to_montgomery(mOne, mOne, mMont, ctx);
+	if (base.IsZero())
+		return;
+	mTableBits = BN_num_bits(mN);
+	u64 windows = (mTableBits + mWindow - 1) / mWindow;
+	u64 digits = ((u64)1 << mWindow) - 1;
+	BIGNUM* cur = base.getBytesOpenSSL();
+	BN_nnmod(cur, cur, mN, ctx);
+	BN_to_montgomery(cur, cur, mMont, ctx);
+	mTable.reserve(windows * digits);
+	for (u64 i = 0; i < windows; i++)
+	{
+		mTable.push_back(BN_dup(cur));
+		for (u64 d = 2; d <= digits; d++)
+		{
+			BIGNUM* t = BN_new();
+			BN_mod_mul_montgomery(t, mTable.back(), cur, mMont, ctx);
+			mTable.push_back(t);
+		}
+		BN_mod_mul_montgomery(cur, mTable.back(), cur, mMont, ctx);
+	}
+	BN_free(cur);
+}
+
+GrapaIntModContext::~GrapaIntModContext()
+{
+	for (BIGNUM* t : mTable)
+		BN_free(t);
+	if (mOne)
+		BN_free(mOne);
+	if (mMont)
+		BN_MONT_CTX_free(mMont);
+	BN_free(mN);
+}
+
+std::shared_ptr<GrapaIntModContext> GrapaIntModContext::Get(const GrapaInt& modulus, const GrapaInt& base)
+{
+	gIntModLock.WaitCritical();
+	for (u64 i = gIntMod.size(); i-- > 0;)
+	{
+		if (gIntMod[i]->mModulus == modulus && gIntMod[i]->mBase == base)
+		{
+			std::shared_ptr<GrapaIntModContext> found = gIntMod[i];
+			gIntMod.erase(gIntMod.begin() + i);
+			gIntMod.push_back(found);
+			gIntModLock.LeaveCritical();
+			return found;
+		}
+	}
+	gIntModLock.LeaveCritical();
+	std::shared_ptr<GrapaIntModContext> made = std::make_shared<GrapaIntModContext>(modulus, base);
+	gIntModLock.WaitCritical();
+	gIntMod.push_back(made);
+	if (gIntMod.size() > _intmodcache_)
+		gIntMod.erase(gIntMod.begin());
+	gIntModLock.LeaveCritical();
+	return made;
+}
+
+// base^exp mod |modulus|. A negative exponent raises the inverse of base.
+GrapaInt GrapaIntModContext::Pow(const GrapaInt& base, const GrapaInt& exp) const
+{
+	GrapaInt result;
+	BN_CTX* ctx = GrapaInt::OpenSSLContext();
+	BIGNUM* b = base.getBytesOpenSSL();
+	BIGNUM* e = exp.getBytesOpenSSL();
+	BIGNUM* r = BN_new();
+	int err = 0;
+	if (!BN_is_zero(mN))
+	{
+		err = 1;
+		if (BN_is_negative(e))
+		{
+			BN_set_negative(e, 0);
+			BN_nnmod(b, b, mN, ctx);
+			BIGNUM* inv = BN_mod_inverse(NULL, b, mN, ctx);
+			if (inv == NULL)
+				err = 0;
+			else
+			{
+				BN_free(b);
+				b = inv;
+			}
+		}
+		if (err)
+			err = mMont ? BN_mod_exp_mont(r, b, e, mN, ctx, mMont) : BN_mod_exp(r, b, e, mN, ctx);
+	}
+	if (err == 1)
+		result.setBytesOpenSSL(r);
+	else
+		result.NaN = true;
+	BN_free(b);
+	BN_free(e);
+	BN_free(r);
+	return result;
+}
+
+// mBase^exp, from the table when the exponent fits it.
+GrapaInt GrapaIntModContext::PowBase(const GrapaInt& exp) const
+{
+	if (mTable.empty() || exp.IsSignNeg() || exp.bitCount() > mTableBits)
+		return Pow(mBase, exp);
+	GrapaInt result;
+	BN_CTX* ctx = GrapaInt::OpenSSLContext();
+	BIGNUM* e = exp.getBytesOpenSSL();
+	BIGNUM* acc = BN_dup(mOne);
+	u64 digits = ((u64)1 << mWindow) - 1;
+	u64 bits = BN_num_bits(e);
+	for (u64 i = 0; i * mWindow < bits; i++)
+	{
+		u64 d = 0;
+		for (u32 j = mWindow; j-- > 0;)
+			d = (d << 1) | (BN_is_bit_set(e, (int)(i * mWindow + j)) ? 1 : 0);
+		if (d)
+			BN_mod_mul_montgomery(acc, acc, mTable[i * digits + d - 1], mMont, ctx);
+	}
+	BN_from_montgomery(acc, acc, mMont, ctx);
+	result.setBytesOpenSSL(acc);
+	BN_free(acc);
+	BN_free(e);
+	return result;
+}
+
+// results[i] = bases[i]^exps[i]; a list of one entry is used for every i, and an empty bases list
+// means the fixed base. Entries run across worker threads.
+void GrapaIntModContext::PowBatch(const std::vector<GrapaInt>& bases, const std::vector<GrapaInt>& exps, std::vector<GrapaInt>& results) const
+{
+	u64 count = bases.size() > exps.size() ? bases.size() : exps.size();
+	results.assign(count, GrapaInt());
+	if (exps.empty())
+		return;
+	u64 bits = BN_num_bits(mN);
+	_intparallel(count, count * bits * bits, [&](u64 i) {
+		const GrapaInt& e = exps[exps.size() == 1 ? 0 : i];
+		if (bases.empty())
+			results[i] = PowBase(e);
+		else
+			results[i] = Pow(bases[bases.size() == 1 ? 0 : i], e);
+		});
+}
+
 GrapaInt GrapaInt::modPow(const GrapaInt& pexp, const GrapaInt& pn) const
 {
 	GrapaInt result;
-	GrapaBYTE gb;
 	int err;
-	u32 sz;
 
 	GrapaInt m1(-1);
 	if (pexp == m1)
 		return modInverse(pn);
+	if (!pexp.IsSignNeg() && !pn.IsSignNeg() && pn.testBit(0) && pn.bitCount() >= _intmodbits_)
+		return GrapaIntModContext::Get(pn, GrapaInt(0))->Pow(*this, pexp);
 	BIGNUM* b_base = getBytesOpenSSL();
 	BIGNUM* b_exp = pexp.getBytesOpenSSL();
 	BIGNUM* b_mod = pn.getBytesOpenSSL();
 	BIGNUM* b_result = BN_new();
-	BN_CTX* b_ctx = BN_CTX_new();
+	BN_CTX* b_ctx = OpenSSLContext();
 	err = BN_mod_exp(b_result, b_base, b_exp, b_mod, b_ctx);
-	char* res_str = BN_bn2dec(b_result);
 	BN_free(b_base);
 	BN_free(b_exp);
 	BN_free(b_mod);
-	BN_CTX_free(b_ctx);
 	if (err == 1)
 		result.setBytesOpenSSL(b_result);
 	else
@@ -1922,11 +2921,10 @@ GrapaInt GrapaInt::gcd(const GrapaInt& bi) const
 	n1 = getBytesOpenSSL();
 	n2 = bi.getBytesOpenSSL();
 	BIGNUM* r = BN_new();
-	BN_CTX* ctx = BN_CTX_new();
+	BN_CTX* ctx = OpenSSLContext();
 	err = BN_gcd(r, n1, n2, ctx);
 	BN_free(n1);
 	BN_free(n2);
-	BN_CTX_free(ctx);
 	if (err == 1)
 		result.setBytesOpenSSL(r);
 	else
@@ -2162,13 +3160,15 @@ GrapaInt GrapaInt::modInverse(const GrapaInt& modulus) const
 	BIGNUM* n1, * n2;
 	n1 = getBytesOpenSSL();
 	n2 = modulus.getBytesOpenSSL();
-	BN_CTX* ctx = BN_CTX_new();
+	BN_CTX* ctx = OpenSSLContext();
 	BIGNUM* inv_bn = BN_mod_inverse(0L, n1, n2, ctx);
 	BN_free(n1);
 	BN_free(n2);
-	BN_CTX_free(ctx);
 	if (inv_bn)
+	{
 		result.setBytesOpenSSL(inv_bn);
+		BN_free(inv_bn);
+	}
 	else
 		result.NaN = true;
 	return result;
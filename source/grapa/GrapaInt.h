@@ -9,14 +9,21 @@
 #include "GrapaThread.h"
 #include <openssl/rand.h>
 
+#include <memory>
+#include <vector>
+
+// Two's complement items, least significant first, read as 32-bit items or as 64-bit limbs.
+// Values of up to two limbs live in mInline and need no heap block.
 class GrapaArray32
 {
 public:
 	bool dataSigned,NaN;
 	u8* mBytes;
 	u64 mSize, mLength, mGrow;
+	u64 mInline[2];
 public:
 	GrapaArray32();
+	GrapaArray32(const GrapaArray32& that);
 	~GrapaArray32();
 	GrapaArray32& operator=(const GrapaArray32& that);
 private:
@@ -37,9 +44,11 @@ public:
 	bool IsSignNeg() const;
     bool IsZero() const;
 	bool IsItem(u32 pItem) const;
+	u64 GetLimb(u64 pLimb) const;
+	bool IsSmall() const;
 };
 
-class GrapaInt : public GrapaArray32, public GrapaCritical
+class GrapaInt : public GrapaArray32
 {
 public:
 	GrapaInt();
@@ -107,6 +116,7 @@ public:
 	void FromBytes(const GrapaBYTE& result, bool isUnsigned=false);
 	//GrapaInt Factorial();
 	GrapaInt Pow(const GrapaInt& exp) const;
+	static BN_CTX* OpenSSLContext();
 	BIGNUM* getBytesOpenSSL() const;
 	void setBytesOpenSSL(BIGNUM* b);
 	GrapaInt modPow(const GrapaInt& exp, const GrapaInt& n) const;
@@ -138,6 +148,28 @@ public:
 	static u64 sqrt64(u64 ull);
 };
 
+// Montgomery parameters for one modulus, and optionally a fixed-base table, built once and shared
+// by every exponentiation with that modulus. Contexts are read-only after Get returns them, so the
+// same context serves several threads at once.
+class GrapaIntModContext
+{
+public:
+	GrapaInt mModulus, mBase;
+	BIGNUM* mN;
+	BN_MONT_CTX* mMont;
+	BIGNUM* mOne;
+	std::vector<BIGNUM*> mTable;
+	u32 mWindow;
+	u64 mTableBits;
+public:
+	GrapaIntModContext(const GrapaInt& modulus, const GrapaInt& base);
+	virtual ~GrapaIntModContext();
+	static std::shared_ptr<GrapaIntModContext> Get(const GrapaInt& modulus, const GrapaInt& base);
+	GrapaInt Pow(const GrapaInt& base, const GrapaInt& exp) const;
+	GrapaInt PowBase(const GrapaInt& exp) const;
+	void PowBatch(const std::vector<GrapaInt>& bases, const std::vector<GrapaInt>& exps, std::vector<GrapaInt>& results) const;
+};
+
 class GrapaPolyMod
 {
 protected:
@@ -752,6 +752,70 @@ public:
 };
 GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleDebug(GrapaCHAR& pName) { return new GrapaLibraryRuleDebugEvent(pName); }
 
+class GrapaLibraryRuleUpgradeEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleUpgradeEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleUpgrade(GrapaCHAR& pName) { return new GrapaLibraryRuleUpgradeEvent(pName); }
+
+class GrapaLibraryRuleCacheEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleCacheEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleCache(GrapaCHAR& pName) { return new GrapaLibraryRuleCacheEvent(pName); }
+
+class GrapaLibraryRuleTransactionEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleTransactionEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleTransaction(GrapaCHAR& pName) { return new GrapaLibraryRuleTransactionEvent(pName); }
+
+class GrapaLibraryRuleLoadEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleLoadEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleLoad(GrapaCHAR& pName) { return new GrapaLibraryRuleLoadEvent(pName); }
+
+class GrapaLibraryRuleIndexEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleIndexEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleIndex(GrapaCHAR& pName) { return new GrapaLibraryRuleIndexEvent(pName); }
+
+class GrapaLibraryRuleFileRangeEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleFileRangeEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleFileRange(GrapaCHAR& pName) { return new GrapaLibraryRuleFileRangeEvent(pName); }
+
+class GrapaLibraryRuleFileAggregateEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleFileAggregateEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleFileAggregate(GrapaCHAR& pName) { return new GrapaLibraryRuleFileAggregateEvent(pName); }
+
+class GrapaLibraryRuleFileCompactEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleFileCompactEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleFileCompact(GrapaCHAR& pName) { return new GrapaLibraryRuleFileCompactEvent(pName); }
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 class GrapaLibraryRuleMacEvent : public GrapaLibraryEvent
@@ -956,6 +1020,14 @@ public:
 };
 GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleIsAks(GrapaCHAR& pName) { return new GrapaLibraryRuleIsAksEvent(pName); }
 
+class GrapaLibraryRulePrimesEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRulePrimesEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandlePrimes(GrapaCHAR& pName) { return new GrapaLibraryRulePrimesEvent(pName); }
+
 class GrapaLibraryRuleRandomEvent : public GrapaLibraryEvent
 {
 public:
@@ -1440,6 +1512,14 @@ public:
 };
 GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleModInv(GrapaCHAR& pName) { return new GrapaLibraryRuleModInvEvent(pName); }
 
+class GrapaLibraryRuleModCtxEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleModCtxEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleModCtx(GrapaCHAR& pName) { return new GrapaLibraryRuleModCtxEvent(pName); }
+
 class GrapaLibraryRuleAbsEvent : public GrapaLibraryEvent
 {
 public:
@@ -1856,6 +1936,14 @@ public:
 };
 GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleReShape(GrapaCHAR& pName) { return new GrapaLibraryRuleReShapeEvent(pName); }
 
+class GrapaLibraryRuleDTypeEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleDTypeEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleDType(GrapaCHAR& pName) { return new GrapaLibraryRuleDTypeEvent(pName); }
+
 class GrapaLibraryRuleDotEvent : public GrapaLibraryEvent
 {
 public:
@@ -1904,6 +1992,14 @@ public:
 };
 GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleEigH(GrapaCHAR& pName) { return new GrapaLibraryRuleEigHEvent(pName); }
 
+class GrapaLibraryRuleSvdEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleSvdEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleSvd(GrapaCHAR& pName) { return new GrapaLibraryRuleSvdEvent(pName); }
+
 class GrapaLibraryRuleSumEvent : public GrapaLibraryEvent
 {
 public:
@@ -1920,6 +2016,38 @@ public:
 };
 GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleMean(GrapaCHAR& pName) { return new GrapaLibraryRuleMeanEvent(pName); }
 
+class GrapaLibraryRuleNormEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleNormEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleNorm(GrapaCHAR& pName) { return new GrapaLibraryRuleNormEvent(pName); }
+
+class GrapaLibraryRuleLuEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleLuEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleLu(GrapaCHAR& pName) { return new GrapaLibraryRuleLuEvent(pName); }
+
+class GrapaLibraryRuleQrEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleQrEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleQr(GrapaCHAR& pName) { return new GrapaLibraryRuleQrEvent(pName); }
+
+class GrapaLibraryRuleCholeskyEvent : public GrapaLibraryEvent
+{
+public:
+	GrapaLibraryRuleCholeskyEvent(GrapaCHAR& pName) { mName.FROM(pName); };
+	virtual GrapaRuleEvent* Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput);
+};
+GrapaLibraryEvent* GrapaLibraryRuleEvent::HandleCholesky(GrapaCHAR& pName) { return new GrapaLibraryRuleCholeskyEvent(pName); }
+
 class GrapaLibraryRuleLowerEvent : public GrapaLibraryEvent
 {
 public:
@@ -2359,6 +2487,7 @@ GrapaLibraryEvent* GrapaLibraryRuleEvent::LoadLib(GrapaScriptExec *vScriptExec,
 		{ "staticprime", &GrapaLibraryRuleEvent::HandleStaticPrime },
 		{ "isprime", &GrapaLibraryRuleEvent::HandleIsPrime },
 		{ "isaks", &GrapaLibraryRuleEvent::HandleIsAks },
+		{ "primes", &GrapaLibraryRuleEvent::HandlePrimes },
 		{ "random", &GrapaLibraryRuleEvent::HandleRandom },
 		{ "setbit", &GrapaLibraryRuleEvent::HandleSetBit },
 		{ "clearbit", &GrapaLibraryRuleEvent::HandleClearBit },
@@ -2379,6 +2508,7 @@ GrapaLibraryEvent* GrapaLibraryRuleEvent::LoadLib(GrapaScriptExec *vScriptExec,
 		{ "mod", &GrapaLibraryRuleEvent::HandleMod },
 		{ "modpow", &GrapaLibraryRuleEvent::HandleModPow },
 		{ "modinv", &GrapaLibraryRuleEvent::HandleModInv },
+		{ "modctx", &GrapaLibraryRuleEvent::HandleModCtx },
 		{ "abs", &GrapaLibraryRuleEvent::HandleAbs },
 		{ "gcd", &GrapaLibraryRuleEvent::HandleGcd },
 		{ "e", &GrapaLibraryRuleEvent::HandleE },
@@ -2466,14 +2596,20 @@ GrapaLibraryEvent* GrapaLibraryRuleEvent::LoadLib(GrapaScriptExec *vScriptExec,
 		{ "join", &GrapaLibraryRuleEvent::HandleJoin },
 		{ "shape", &GrapaLibraryRuleEvent::HandleShape },
 		{ "reshape", &GrapaLibraryRuleEvent::HandleReShape },
+		{ "dtype", &GrapaLibraryRuleEvent::HandleDType },
 		{ "dot", &GrapaLibraryRuleEvent::HandleDot },
 		{ "identity", &GrapaLibraryRuleEvent::HandleIdentity },
 		{ "diagonal", &GrapaLibraryRuleEvent::HandleDiagonal },
 		{ "triu", &GrapaLibraryRuleEvent::HandleTriU },
 		{ "tril", &GrapaLibraryRuleEvent::HandleTriL },
 		{ "eigh", &GrapaLibraryRuleEvent::HandleEigH },
+		{ "svd", &GrapaLibraryRuleEvent::HandleSvd },
 		{ "sum", &GrapaLibraryRuleEvent::HandleSum },
 		{ "mean", &GrapaLibraryRuleEvent::HandleMean },
+		{ "norm", &GrapaLibraryRuleEvent::HandleNorm },
+		{ "lu", &GrapaLibraryRuleEvent::HandleLu },
+		{ "qr", &GrapaLibraryRuleEvent::HandleQr },
+		{ "cholesky", &GrapaLibraryRuleEvent::HandleCholesky },
 		{ "lower", &GrapaLibraryRuleEvent::HandleLower },
 		{ "upper", &GrapaLibraryRuleEvent::HandleUpper },
 		{ "eq", &GrapaLibraryRuleEvent::HandleEq },
@@ -2500,6 +2636,27 @@ GrapaLibraryEvent* GrapaLibraryRuleEvent::LoadLib(GrapaScriptExec *vScriptExec,
 		{ "file_get", &GrapaLibraryRuleEvent::HandleGet },
 		{ "file_split", &GrapaLibraryRuleEvent::HandleFileSplit },
 		{ "file_debug", &GrapaLibraryRuleEvent::HandleDebug },
+		{ "file_upgrade", &GrapaLibraryRuleEvent::HandleUpgrade },
+		{ "file_cache", &GrapaLibraryRuleEvent::HandleCache },
+		{ "file_begin", &GrapaLibraryRuleEvent::HandleTransaction },
+		{ "file_commit", &GrapaLibraryRuleEvent::HandleTransaction },
+		{ "file_rollback", &GrapaLibraryRuleEvent::HandleTransaction },
+		{ "file_snapshot", &GrapaLibraryRuleEvent::HandleTransaction },
+		{ "file_release", &GrapaLibraryRuleEvent::HandleTransaction },
+		{ "file_checkpoint", &GrapaLibraryRuleEvent::HandleTransaction },
+		{ "file_load", &GrapaLibraryRuleEvent::HandleLoad },
+		{ "file_mkindex", &GrapaLibraryRuleEvent::HandleIndex },
+		{ "file_rmindex", &GrapaLibraryRuleEvent::HandleIndex },
+		{ "file_suspend", &GrapaLibraryRuleEvent::HandleIndex },
+		{ "file_reindex", &GrapaLibraryRuleEvent::HandleIndex },
+		{ "file_range", &GrapaLibraryRuleEvent::HandleFileRange },
+		{ "file_aggregate", &GrapaLibraryRuleEvent::HandleFileAggregate },
+		{ "file_count", &GrapaLibraryRuleEvent::HandleFileAggregate },
+		{ "file_sum", &GrapaLibraryRuleEvent::HandleFileAggregate },
+		{ "file_min", &GrapaLibraryRuleEvent::HandleFileAggregate },
+		{ "file_max", &GrapaLibraryRuleEvent::HandleFileAggregate },
+		{ "file_avg", &GrapaLibraryRuleEvent::HandleFileAggregate },
+		{ "file_compact", &GrapaLibraryRuleEvent::HandleFileCompact },
 		{ "net_mac", &GrapaLibraryRuleEvent::HandleMac },
 		{ "net_interfaces", &GrapaLibraryRuleEvent::HandleInterfaces },
 		{ "net_connect", &GrapaLibraryRuleEvent::HandleConnect },
@@ -2647,6 +2804,7 @@ GrapaLibraryEvent* GrapaLibraryRuleEvent::LoadLib(GrapaScriptExec *vScriptExec,
             else if (pName.Cmp("staticprime") == 0) lib = new GrapaLibraryRuleStaticPrimeEvent(pName);
             else if (pName.Cmp("isprime") == 0) lib = new GrapaLibraryRuleIsPrimeEvent(pName);
             else if (pName.Cmp("isaks") == 0) lib = new GrapaLibraryRuleIsAksEvent(pName);
+            else if (pName.Cmp("primes") == 0) lib = new GrapaLibraryRulePrimesEvent(pName);
             else if (pName.Cmp("random") == 0) lib = new GrapaLibraryRuleRandomEvent(pName);
             else if (pName.Cmp("setbit") == 0) lib = new GrapaLibraryRuleSetBitEvent(pName);
             else if (pName.Cmp("clearbit") == 0) lib = new GrapaLibraryRuleClearBitEvent(pName);
@@ -2669,6 +2827,7 @@ GrapaLibraryEvent* GrapaLibraryRuleEvent::LoadLib(GrapaScriptExec *vScriptExec,
 			else if (pName.Cmp("mod") == 0) lib = new GrapaLibraryRuleModEvent(pName);
 			else if (pName.Cmp("modpow") == 0) lib = new GrapaLibraryRuleModPowEvent(pName);
 			else if (pName.Cmp("modinv") == 0) lib = new GrapaLibraryRuleModInvEvent(pName);
+			else if (pName.Cmp("modctx") == 0) lib = new GrapaLibraryRuleModCtxEvent(pName);
 			else if (pName.Cmp("abs") == 0) lib = new GrapaLibraryRuleAbsEvent(pName);
 			else if (pName.Cmp("gcd") == 0) lib = new GrapaLibraryRuleGcdEvent(pName);
 
@@ -2767,14 +2926,20 @@ GrapaLibraryEvent* GrapaLibraryRuleEvent::LoadLib(GrapaScriptExec *vScriptExec,
 			else if (pName.Cmp("join") == 0) lib = new GrapaLibraryRuleJoinEvent(pName);
 			else if (pName.Cmp("shape") == 0) lib = new GrapaLibraryRuleShapeEvent(pName);
 			else if (pName.Cmp("reshape") == 0) lib = new GrapaLibraryRuleReShapeEvent(pName);
+			else if (pName.Cmp("dtype") == 0) lib = new GrapaLibraryRuleDTypeEvent(pName);
 			else if (pName.Cmp("dot") == 0) lib = new GrapaLibraryRuleDotEvent(pName);
 			else if (pName.Cmp("identity") == 0) lib = new GrapaLibraryRuleIdentityEvent(pName);
 			else if (pName.Cmp("diagonal") == 0) lib = new GrapaLibraryRuleDiagonalEvent(pName);
 			else if (pName.Cmp("triu") == 0) lib = new GrapaLibraryRuleTriUEvent(pName);
 			else if (pName.Cmp("tril") == 0) lib = new GrapaLibraryRuleTriLEvent(pName);
 			else if (pName.Cmp("eigh") == 0) lib = new GrapaLibraryRuleEigHEvent(pName);
+			else if (pName.Cmp("svd") == 0) lib = new GrapaLibraryRuleSvdEvent(pName);
 			else if (pName.Cmp("sum") == 0) lib = new GrapaLibraryRuleSumEvent(pName);
 			else if (pName.Cmp("mean") == 0) lib = new GrapaLibraryRuleMeanEvent(pName);
+			else if (pName.Cmp("norm") == 0) lib = new GrapaLibraryRuleNormEvent(pName);
+			else if (pName.Cmp("lu") == 0) lib = new GrapaLibraryRuleLuEvent(pName);
+			else if (pName.Cmp("qr") == 0) lib = new GrapaLibraryRuleQrEvent(pName);
+			else if (pName.Cmp("cholesky") == 0) lib = new GrapaLibraryRuleCholeskyEvent(pName);
 			else if (pName.Cmp("lower") == 0) lib = new GrapaLibraryRuleLowerEvent(pName);
             else if (pName.Cmp("upper") == 0) lib = new GrapaLibraryRuleUpperEvent(pName);
 
@@ -2810,6 +2975,14 @@ GrapaLibraryEvent* GrapaLibraryRuleEvent::LoadLib(GrapaScriptExec *vScriptExec,
 			//else if (pName.Cmp("getop") == 0) lib = new GrapaLibraryRuleGetOpEvent(pName);
 			//else if (pName.Cmp("runop") == 0) lib = new GrapaLibraryRuleRunOpEvent(pName);
 			else if (pName.Cmp("file_debug") == 0) lib = new GrapaLibraryRuleDebugEvent(pName);
+			else if (pName.Cmp("file_upgrade") == 0) lib = new GrapaLibraryRuleUpgradeEvent(pName);
+			else if (pName.Cmp("file_cache") == 0) lib = new GrapaLibraryRuleCacheEvent(pName);
+			else if (pName.Cmp("file_begin") == 0 || pName.Cmp("file_commit") == 0 || pName.Cmp("file_rollback") == 0 || pName.Cmp("file_snapshot") == 0 || pName.Cmp("file_release") == 0 || pName.Cmp("file_checkpoint") == 0) lib = new GrapaLibraryRuleTransactionEvent(pName);
+			else if (pName.Cmp("file_load") == 0) lib = new GrapaLibraryRuleLoadEvent(pName);
+			else if (pName.Cmp("file_mkindex") == 0 || pName.Cmp("file_rmindex") == 0 || pName.Cmp("file_suspend") == 0 || pName.Cmp("file_reindex") == 0) lib = new GrapaLibraryRuleIndexEvent(pName);
+			else if (pName.Cmp("file_range") == 0) lib = new GrapaLibraryRuleFileRangeEvent(pName);
+			else if (pName.Cmp("file_aggregate") == 0 || pName.Cmp("file_count") == 0 || pName.Cmp("file_sum") == 0 || pName.Cmp("file_min") == 0 || pName.Cmp("file_max") == 0 || pName.Cmp("file_avg") == 0) lib = new GrapaLibraryRuleFileAggregateEvent(pName);
+			else if (pName.Cmp("file_compact") == 0) lib = new GrapaLibraryRuleFileCompactEvent(pName);
 		}
 		if (lib == NULL)
 		{
@@ -2949,6 +3122,23 @@ GrapaRuleEvent* GrapaLibraryRuleGetEnvEvent::Run(GrapaScriptExec* vScriptExec, G
 			err = 0;
 			result = new GrapaRuleEvent(0, GrapaCHAR(), gSystem->mLibDir);
 		}
+		else if (r1.vVal->mValue.Cmp("$FILEMAP") == 0 || (r1.vVal->mValue.mToken == GrapaTokenType::SYSID && r1.vVal->mValue.Cmp("FILEMAP") == 0))
+		{
+			err = 0;
+			result = new GrapaRuleEvent(GrapaTokenType::BOOL, 0, "", gSystem->mFileMap ? "\1" : "");
+		}
+		else if (r1.vVal->mValue.Cmp("$WAL") == 0 || (r1.vVal->mValue.mToken == GrapaTokenType::SYSID && r1.vVal->mValue.Cmp("WAL") == 0))
+		{
+			err = 0;
+			result = new GrapaRuleEvent(GrapaTokenType::BOOL, 0, "", gSystem->mFileLog ? "\1" : "");
+		}
+#ifdef GRAPA_WALFAULT
+		else if (r1.vVal->mValue.Cmp("$WALFAULT") == 0 || (r1.vVal->mValue.mToken == GrapaTokenType::SYSID && r1.vVal->mValue.Cmp("WALFAULT") == 0))
+		{
+			err = 0;
+			result = new GrapaRuleEvent(0, GrapaCHAR(), GrapaInt(GrapaFileLog::GetFault()).getBytes());
+		}
+#endif
 		else if (r1.vVal->mValue.Cmp("$BIN") == 0 || (r1.vVal->mValue.mToken==GrapaTokenType::SYSID && r1.vVal->mValue.Cmp("BIN") == 0))
 		{
 			err = 0;
@@ -3100,6 +3290,30 @@ GrapaRuleEvent* GrapaLibraryRulePutEnvEvent::Run(GrapaScriptExec* vScriptExec, G
 			err = 0;
 			gSystem->mLibDir.FROM(r2.vVal? r2.vVal->mValue:GrapaCHAR());
 		}
+		else if (r1.vVal->mValue.Cmp("$FILEMAP") == 0 || (r1.vVal->mValue.mToken == GrapaTokenType::SYSID && r1.vVal->mValue.Cmp("FILEMAP") == 0))
+		{
+			err = 0;
+			gSystem->mFileMap = r2.vVal && !r2.vVal->IsZero();
+		}
+		else if (r1.vVal->mValue.Cmp("$WAL") == 0 || (r1.vVal->mValue.mToken == GrapaTokenType::SYSID && r1.vVal->mValue.Cmp("WAL") == 0))
+		{
+			err = 0;
+			gSystem->mFileLog = r2.vVal && !r2.vVal->IsZero();
+		}
+#ifdef GRAPA_WALFAULT
+		else if (r1.vVal->mValue.Cmp("$WALFAULT") == 0 || (r1.vVal->mValue.mToken == GrapaTokenType::SYSID && r1.vVal->mValue.Cmp("WALFAULT") == 0))
+		{
+			err = 0;
+			s64 writes = 0;
+			if (r2.vVal && r2.vVal->mValue.mBytes && (r2.vVal->mValue.mToken == GrapaTokenType::INT || r2.vVal->mValue.mToken == GrapaTokenType::SYSINT))
+			{
+				GrapaInt a;
+				a.FromBytes(r2.vVal->mValue);
+				writes = a.LongValue();
+			}
+			GrapaFileLog::SetFault(writes);
+		}
+#endif
 		else if (r1.vVal->mValue.Cmp("$BIN") == 0 || (r1.vVal->mValue.mToken == GrapaTokenType::SYSID && r1.vVal->mValue.Cmp("BIN") == 0))
 		{
 			err = 0;
@@ -10049,42 +10263,30 @@ GrapaRuleEvent* GrapaLibraryRuleDebugEvent::Run(GrapaScriptExec *vScriptExec, Gr
 	return(result);
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-
-GrapaRuleEvent* GrapaLibraryRuleMacEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+GrapaRuleEvent* GrapaLibraryRuleUpgradeEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
 {
+	GrapaError err = -1;
 	GrapaRuleEvent* result = NULL;
 
-	GrapaRuleEvent* r = NULL;
-	u64 mac;
-	char ipx[256];
-	char namex[256];
-	GrapaNet::GetMac(namex, ipx, mac);
-	result = new GrapaRuleEvent();
-	result->mValue.mToken = GrapaTokenType::LIST;
-	result->vQueue = new GrapaRuleQueue();
-
-	r = new GrapaRuleEvent(GrapaTokenType::STR, 0, "name", namex);
-	result->vQueue->PushTail(r);
-	r = new GrapaRuleEvent(GrapaTokenType::STR, 0, "ip", ipx);
-	result->vQueue->PushTail(r);
-	r = new GrapaRuleEvent(0, GrapaCHAR("mac"), GrapaInt(mac).getBytes());
-	r->mValue.mToken = GrapaTokenType::RAW;
-	result->vQueue->PushTail(r);
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
 
-	return(result);
-}
+	GrapaRuleEvent* objEvent = vScriptExec->vScriptState->SearchTarget(pNameSpace, r1.vVal);
+	if (objEvent && objEvent->vDatabase == NULL)
+		objEvent->vDatabase = new GrapaLocalDatabase(vScriptExec->vScriptState);
 
-GrapaRuleEvent* GrapaLibraryRuleInterfacesEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
-{
-	GrapaRuleEvent* result = NULL;
-	result = new GrapaRuleEvent();
-	result->mValue.mToken = GrapaTokenType::TABLE;
-	result = GrapaNet::GetInterfaces();
+	if (objEvent)
+	{
+		u64 count = 0;
+		err = objEvent->vDatabase->DatabaseConvert(count);
+		if (!err)
+			result = new GrapaRuleEvent(0, GrapaCHAR(), GrapaInt(count).getBytes());
+	}
+	if (err && result == NULL)
+		result = Error(vScriptExec, pNameSpace, err);
 	return(result);
 }
 
-GrapaRuleEvent* GrapaLibraryRuleConnectEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+GrapaRuleEvent* GrapaLibraryRuleCacheEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
 {
 	GrapaError err = -1;
 	GrapaRuleEvent* result = NULL;
@@ -10092,103 +10294,174 @@ GrapaRuleEvent* GrapaLibraryRuleConnectEvent::Run(GrapaScriptExec *vScriptExec,
 	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
 	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
 	GrapaLibraryParam r3(vScriptExec, pNameSpace, pInput ? pInput->Head(2) : NULL);
-	GrapaLibraryParam r4(vScriptExec, pNameSpace, pInput ? pInput->Head(3) : NULL);
 
 	GrapaRuleEvent* objEvent = vScriptExec->vScriptState->SearchTarget(pNameSpace, r1.vVal);
-	if (objEvent && objEvent->vNetConnect == NULL)
-		objEvent->vNetConnect = new GrapaNetConnect();
+	if (objEvent && objEvent->vDatabase == NULL)
+		objEvent->vDatabase = new GrapaLocalDatabase(vScriptExec->vScriptState);
 
 	if (objEvent)
 	{
-		err = 0;
-
-		if (r2.vVal && r2.vVal->mValue.mBytes)
-			objEvent->vNetConnect->Set(r2.vVal->mValue);
-		if (r3.vVal && r3.vVal->mValue.mBytes)
+		s64 size = -1, rate = -1;
+		if (r2.vVal && r2.vVal->mValue.mBytes && (r2.vVal->mValue.mToken == GrapaTokenType::INT || r2.vVal->mValue.mToken == GrapaTokenType::SYSINT))
 		{
-			err = objEvent->vNetConnect->Certificate(r3.vVal);
+			GrapaInt a;
+			a.FromBytes(r2.vVal->mValue);
+			size = a.LongValue();
+			if (size < 0) size = 0;
 		}
-		if (!err && r4.vVal && r4.vVal->vQueue)
+		if (r3.vVal && r3.vVal->mValue.mBytes && (r3.vVal->mValue.mToken == GrapaTokenType::INT || r3.vVal->mValue.mToken == GrapaTokenType::SYSINT))
 		{
-			s64 index;
-			err = objEvent->vNetConnect->Proxy(r4.vVal->vQueue->Search("type", index), r4.vVal->vQueue->Search("id", index), r4.vVal->vQueue->Search("ip", index));
+			GrapaInt a;
+			a.FromBytes(r3.vVal->mValue);
+			rate = a.LongValue();
+			if (rate < 0) rate = 0;
 		}
+		GrapaFileCacheStats stats;
+		err = objEvent->vDatabase->DatabaseCache(size, rate, stats);
 		if (!err)
 		{
-			err = objEvent->vNetConnect->Connect(objEvent);
-		}
-		if (err == 0)
-		{
-			if (!objEvent->vNetConnect->mNet.mConnected)
-			{
-				objEvent->vNetConnect->Disconnect();
-				err = -1;
-			}
+			result = new GrapaRuleEvent();
+			result->mValue.mToken = GrapaTokenType::LIST;
+			result->vQueue = new GrapaRuleQueue();
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("size"), GrapaInt(stats.size).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("pages"), GrapaInt(stats.pages).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("used"), GrapaInt(stats.used).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("dirty"), GrapaInt(stats.dirty).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("pinned"), GrapaInt(stats.pinned).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("hits"), GrapaInt(stats.hits).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("misses"), GrapaInt(stats.misses).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("evictions"), GrapaInt(stats.evictions).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("writebacks"), GrapaInt(stats.writebacks).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("writes"), GrapaInt(stats.writes).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("commits"), GrapaInt(stats.commits).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("syncs"), GrapaInt(stats.syncs).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("checkpoints"), GrapaInt(stats.checkpoints).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("recovered"), GrapaInt(stats.recovered).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("snapshots"), GrapaInt(stats.snapshots).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("versions"), GrapaInt(stats.versions).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("rate"), GrapaInt(stats.rate).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("flushed"), GrapaInt(stats.flushed).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("throughput"), GrapaInt(stats.throughput).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("backlog"), GrapaInt(stats.backlog).getBytes()));
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("stalls"), GrapaInt(stats.stalls).getBytes()));
 		}
 	}
 	if (err && result == NULL)
-	{
 		result = Error(vScriptExec, pNameSpace, err);
-	}
-
 	return(result);
 }
 
-GrapaRuleEvent* GrapaLibraryRuleBindEvent::Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput)
+GrapaRuleEvent* GrapaLibraryRuleTransactionEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
 {
 	GrapaError err = -1;
 	GrapaRuleEvent* result = NULL;
 
 	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
-	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
 
 	GrapaRuleEvent* objEvent = vScriptExec->vScriptState->SearchTarget(pNameSpace, r1.vVal);
-	if (objEvent && objEvent->vNetConnect == NULL)
-		objEvent->vNetConnect = new GrapaNetConnect();
+	if (objEvent && objEvent->vDatabase == NULL)
+		objEvent->vDatabase = new GrapaLocalDatabase(vScriptExec->vScriptState);
 
 	if (objEvent)
 	{
-		if (r2.vVal && r2.vVal->mValue.mBytes)
-			objEvent->vNetConnect->Set(r2.vVal->mValue);
-		err = objEvent->vNetConnect->Bind(objEvent);
+		if (mName.Cmp("file_begin") == 0)
+			err = objEvent->vDatabase->DatabaseBegin();
+		else if (mName.Cmp("file_commit") == 0)
+			err = objEvent->vDatabase->DatabaseCommit();
+		else if (mName.Cmp("file_snapshot") == 0)
+			err = objEvent->vDatabase->DatabaseSnapshot();
+		else if (mName.Cmp("file_release") == 0)
+			err = objEvent->vDatabase->DatabaseRelease();
+		else if (mName.Cmp("file_checkpoint") == 0)
+			err = objEvent->vDatabase->DatabaseCheckpoint();
+		else
+			err = objEvent->vDatabase->DatabaseRollback();
+		if (!err)
+			result = new GrapaRuleEvent(GrapaTokenType::BOOL, 0, "", "\1");
 	}
 	if (err && result == NULL)
 		result = Error(vScriptExec, pNameSpace, err);
-
 	return(result);
 }
 
-GrapaRuleEvent* GrapaLibraryRuleListenEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+// mkindex and rmindex take a field name or an $ARRAY of them; suspend and reindex return how many
+// indexes they touched.
+GrapaRuleEvent* GrapaLibraryRuleIndexEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
 {
 	GrapaError err = -1;
 	GrapaRuleEvent* result = NULL;
 
 	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
 	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+	GrapaLibraryParam r3(vScriptExec, pNameSpace, pInput ? pInput->Head(2) : NULL);
 
 	GrapaRuleEvent* objEvent = vScriptExec->vScriptState->SearchTarget(pNameSpace, r1.vVal);
-	if (objEvent && objEvent->vNetConnect == NULL)
-		objEvent->vNetConnect = new GrapaNetConnect();
-
-	GrapaRuleEvent* objBind = vScriptExec->vScriptState->SearchTarget(pNameSpace, r2.vVal);
-	if (objBind && objBind->vNetConnect == NULL)
-		objBind->vNetConnect = new GrapaNetConnect();
+	if (objEvent && objEvent->vDatabase == NULL)
+		objEvent->vDatabase = new GrapaLocalDatabase(vScriptExec->vScriptState);
 
-	if (objEvent && objBind)
+	if (objEvent && (mName.Cmp("file_suspend") == 0 || mName.Cmp("file_reindex") == 0))
 	{
-		err = objEvent->vNetConnect->Listen(objBind->vNetConnect);
-		if (err == 0 && !objEvent->vNetConnect->mNet.mConnected)
+		u64 count = 0;
+		if (mName.Cmp("file_suspend") == 0)
+			err = objEvent->vDatabase->IndexSuspend(count);
+		else
+			err = objEvent->vDatabase->IndexRebuild(count);
+		if (!err)
+			result = new GrapaRuleEvent(0, GrapaCHAR(), GrapaInt(count).getBytes());
+	}
+	else if (objEvent && r2.vVal)
+	{
+		std::vector<GrapaCHAR> fields;
+		if (r2.vVal->mValue.mToken == GrapaTokenType::ARRAY)
 		{
-			objEvent->vNetConnect->Disconnect();
+			GrapaRuleEvent* f = r2.vVal->vQueue ? ((GrapaRuleQueue*)r2.vVal->vQueue)->Head() : NULL;
+			for (; f; f = f->Next())
+			{
+				GrapaRuleEvent* v = f;
+				while (v && v->mValue.mToken == GrapaTokenType::PTR) v = v->vRulePointer;
+				if (v) fields.emplace_back(v->mValue);
+			}
+		}
+		else if (r2.vVal->mValue.mLength)
+			fields.emplace_back(r2.vVal->mValue);
+		if (mName.Cmp("file_mkindex") == 0)
+		{
+			bool isNeg, isNull;
+			bool unique = r3.vVal && !r3.vVal->IsNullIsNegIsZero(isNeg, isNull);
+			err = objEvent->vDatabase->IndexCreate(fields, unique);
 		}
+		else
+			err = objEvent->vDatabase->IndexDelete(fields);
+		if (!err)
+			result = new GrapaRuleEvent(GrapaTokenType::BOOL, 0, "", "\1");
 	}
 	if (err && result == NULL)
 		result = Error(vScriptExec, pNameSpace, err);
-
 	return(result);
 }
 
-GrapaRuleEvent* GrapaLibraryRuleOnListenEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+// A value read from a field, as an event. Lists, arrays and the other structured types are stored
+// serialized, so they are unpacked.
+static GrapaRuleEvent* GrapaLibraryFileValue(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, const GrapaCHAR& pName, GrapaCHAR& pValue)
+{
+	GrapaRuleEvent* e = new GrapaRuleEvent(0, pName, pValue);
+	switch (pValue.mToken)
+	{
+	case GrapaTokenType::ARRAY: case GrapaTokenType::TUPLE: case GrapaTokenType::LIST: case GrapaTokenType::XML: case GrapaTokenType::EL:
+	case GrapaTokenType::TAG: case GrapaTokenType::OP: case GrapaTokenType::CODE: case GrapaTokenType::ERR:
+		e->vQueue = new GrapaRuleQueue();
+		e->vClass = ((GrapaRuleQueue*)e->vQueue)->FROM(vScriptExec->vScriptState, pNameSpace, pValue);
+		e->mValue.SetLength(0);
+		break;
+	}
+	return e;
+}
+
+// Fields are a name or an $ARRAY of names, and each bound a value, or an $ARRAY of values when
+// there are several fields; null leaves that end open. The options $LIST takes lo_excl and hi_excl
+// to leave out rows equal to a bound, desc to walk down from the upper bound, limit, and after to
+// carry on after a row an earlier call returned.
+GrapaRuleEvent* GrapaLibraryRuleFileRangeEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
 {
 	GrapaError err = -1;
 	GrapaRuleEvent* result = NULL;
@@ -10197,37 +10470,542 @@ GrapaRuleEvent* GrapaLibraryRuleOnListenEvent::Run(GrapaScriptExec *vScriptExec,
 	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
 	GrapaLibraryParam r3(vScriptExec, pNameSpace, pInput ? pInput->Head(2) : NULL);
 	GrapaLibraryParam r4(vScriptExec, pNameSpace, pInput ? pInput->Head(3) : NULL);
+	GrapaLibraryParam r5(vScriptExec, pNameSpace, pInput ? pInput->Head(4) : NULL);
 
 	GrapaRuleEvent* objEvent = vScriptExec->vScriptState->SearchTarget(pNameSpace, r1.vVal);
-	if (objEvent && objEvent->vNetConnect == NULL)
-		objEvent->vNetConnect = new GrapaNetConnect();
+	if (objEvent && objEvent->vDatabase == NULL)
+		objEvent->vDatabase = new GrapaLocalDatabase(vScriptExec->vScriptState);
 
-	if (objEvent)
+	if (objEvent && r2.vVal)
 	{
-		GrapaNames* vNames = pNameSpace;
-		while (vNames->GetParrent()) vNames = vNames->GetParrent();
-		objEvent->vNetConnect->mNames.SetParrent(vNames);
-		if (r2.vVal && r2.vVal->mValue.mBytes)
-			objEvent->vNetConnect->Set(r2.vVal->mValue);
-		err = objEvent->vNetConnect->OnListen(vScriptExec, objEvent, r3.vVal, r4.vVal);
-		if (err == 0 && !objEvent->vNetConnect->mNet.mBound)
+		auto deref = [](GrapaRuleEvent* e) { while (e && e->mValue.mToken == GrapaTokenType::PTR) e = e->vRulePointer; return e; };
+		bool several = r2.vVal->mValue.mToken == GrapaTokenType::ARRAY;
+		auto valuesOf = [&](GrapaRuleEvent* v, std::vector<GrapaCHAR>& pValues) {
+			v = deref(v);
+			if (v == NULL || v->mNull) return;
+			if (several && v->mValue.mToken == GrapaTokenType::ARRAY)
+			{
+				GrapaRuleEvent* e = v->vQueue ? ((GrapaRuleQueue*)v->vQueue)->Head() : NULL;
+				for (; e; e = e->Next())
+				{
+					GrapaRuleEvent* d = deref(e);
+					if (d) pValues.emplace_back(d->mValue);
+				}
+			}
+			else if (v->mValue.mLength)
+				pValues.emplace_back(v->mValue);
+		};
+
+		std::vector<GrapaCHAR> fields, lower, upper;
+		if (several)
+			valuesOf(r2.vVal, fields);
+		else if (r2.vVal->mValue.mLength)
+			fields.emplace_back(r2.vVal->mValue);
+		valuesOf(r3.vVal, lower);
+		valuesOf(r4.vVal, upper);
+
+		bool lowerIn = true, upperIn = true, reverse = false;
+		GrapaCHAR after;
+		u64 limit = 0;
+		GrapaRuleEvent* o = deref(r5.vVal);
+		if (o && o->mValue.mToken == GrapaTokenType::LIST && o->vQueue)
+		{
+			bool isNeg, isNull;
+			s64 index = 0;
+			GrapaRuleEvent* e = deref(o->vQueue->Search(GrapaCHAR("lo_excl"), index));
+			if (e) lowerIn = e->IsNullIsNegIsZero(isNeg, isNull);
+			e = deref(o->vQueue->Search(GrapaCHAR("hi_excl"), index));
+			if (e) upperIn = e->IsNullIsNegIsZero(isNeg, isNull);
+			e = deref(o->vQueue->Search(GrapaCHAR("desc"), index));
+			if (e) reverse = !e->IsNullIsNegIsZero(isNeg, isNull);
+			e = deref(o->vQueue->Search(GrapaCHAR("limit"), index));
+			if (e && e->mValue.mToken == GrapaTokenType::INT)
+			{
+				GrapaInt a;
+				a.FromBytes(e->mValue);
+				if (a.LongValue() > 0) limit = (u64)a.LongValue();
+			}
+			e = deref(o->vQueue->Search(GrapaCHAR("after"), index));
+			if (e && !e->mNull) after.FROM(e->mValue);
+		}
+
+		GrapaGroupBatch rows;
+		err = objEvent->vDatabase->IndexRange(fields, lower, upper, lowerIn, upperIn, reverse, after, limit, rows);
+		if (!err)
 		{
-			objEvent->vNetConnect->Disconnect();
+			GrapaCHAR keyName("$KEY");
+			result = new GrapaRuleEvent(GrapaTokenType::ARRAY, 0, "", "");
+			result->vQueue = new GrapaRuleQueue();
+			for (u64 i = 0; i < rows.mNames.size(); i++)
+			{
+				GrapaRuleEvent* item = new GrapaRuleEvent(0, rows.mNames[i], GrapaCHAR());
+				item->mValue.mToken = GrapaTokenType::LIST;
+				item->vQueue = new GrapaRuleQueue();
+				result->vQueue->PushTail(item);
+				rows.mNames[i].mToken = GrapaTokenType::STR;
+				item->vQueue->PushTail(new GrapaRuleEvent(0, keyName, rows.mNames[i]));
+				for (u64 j = 0; j < rows.mFields.size(); j++)
+				{
+					if (rows.mFields[j].StrCmp(keyName) != 0)
+						item->vQueue->PushTail(GrapaLibraryFileValue(vScriptExec, pNameSpace, rows.mFields[j], rows.mValues[i * rows.mFields.size() + j]));
+				}
+			}
 		}
 	}
 	if (err && result == NULL)
 		result = Error(vScriptExec, pNameSpace, err);
-
 	return(result);
 }
 
-GrapaRuleEvent* GrapaLibraryRuleDisconnectEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+// Aggregates a field of the current table, reading it a column batch at a time. file_aggregate
+// gives a $LIST of count, sum, min, max and avg, and file_count, file_sum, file_min, file_max and
+// file_avg give the one value. With a second field the rows are grouped by its value: aggregate
+// gives an $ARRAY of those $LISTs, each also holding the group value under that field's name, and
+// the others a $LIST of group value:result. count with no field counts rows. sum and avg are null
+// for fields that are not numbers, and min, max and avg are null when there are no values.
+GrapaRuleEvent* GrapaLibraryRuleFileAggregateEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
 {
 	GrapaError err = -1;
 	GrapaRuleEvent* result = NULL;
 
 	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
-
+	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+	GrapaLibraryParam r3(vScriptExec, pNameSpace, pInput ? pInput->Head(2) : NULL);
+
+	GrapaRuleEvent* objEvent = vScriptExec->vScriptState->SearchTarget(pNameSpace, r1.vVal);
+	if (objEvent && objEvent->vDatabase == NULL)
+		objEvent->vDatabase = new GrapaLocalDatabase(vScriptExec->vScriptState);
+
+	if (objEvent)
+	{
+		auto deref = [](GrapaRuleEvent* e) { while (e && e->mValue.mToken == GrapaTokenType::PTR) e = e->vRulePointer; return e; };
+		GrapaCHAR field, by;
+		GrapaRuleEvent* e = deref(r2.vVal);
+		if (e && !e->mNull) field.FROM(e->mValue);
+		e = deref(r3.vVal);
+		if (e && !e->mNull) by.FROM(e->mValue);
+
+		std::vector<GrapaCHAR> groups;
+		std::vector<GrapaDBAggregate> results;
+		if (field.mLength || mName.Cmp("file_count") == 0)
+			err = objEvent->vDatabase->FieldAggregate(field, by, groups, results);
+		if (!err)
+		{
+			GrapaItemState& state = vScriptExec->vScriptState->mItemState;
+			auto statEvent = [&](const GrapaCHAR& pName, const char* pStat, const GrapaDBAggregate& a) {
+				GrapaCHAR value;
+				bool none = false;
+				if (strcmp(pStat, "count") == 0)
+					value.FROM(GrapaInt((s64)a.mCount).getBytes());
+				else if (strcmp(pStat, "min") == 0 || strcmp(pStat, "max") == 0)
+				{
+					none = a.mCount == 0;
+					if (pStat[1] == 'i') a.Min(value);
+					else a.Max(value);
+				}
+				else if (!a.Numeric() || (a.mCount == 0 && strcmp(pStat, "avg") == 0))
+					none = true;
+				else if (strcmp(pStat, "sum") == 0)
+				{
+					if (a.mType == GrapaTokenType::INT)
+						value.FROM(a.Sum().getBytes());
+					else
+						value.FROM(GrapaFloat(state.mFloatFix, state.mFloatMax, state.mFloatExtra, a.SumFloat()).getBytes());
+				}
+				else if (a.mType == GrapaTokenType::INT)
+					value.FROM((GrapaFloat(state.mFloatFix, state.mFloatMax, state.mFloatExtra, a.Sum()) / (s64)a.mCount).getBytes());
+				else
+					value.FROM((GrapaFloat(state.mFloatFix, state.mFloatMax, state.mFloatExtra, a.SumFloat()) / (s64)a.mCount).getBytes());
+				if (none)
+				{
+					GrapaRuleEvent* n = new GrapaRuleEvent(0, pName, GrapaCHAR());
+					n->mValue.SetNull();
+					n->mNull = true;
+					return n;
+				}
+				return GrapaLibraryFileValue(vScriptExec, pNameSpace, pName, value);
+			};
+			const char* stats[] = { "count", "sum", "min", "max", "avg" };
+			auto statList = [&](const GrapaCHAR& pName, const GrapaDBAggregate& a) {
+				GrapaRuleEvent* list = new GrapaRuleEvent(0, pName, GrapaCHAR());
+				list->mValue.mToken = GrapaTokenType::LIST;
+				list->vQueue = new GrapaRuleQueue();
+				for (const char* s : stats)
+					list->vQueue->PushTail(statEvent(GrapaCHAR(s), s, a));
+				return list;
+			};
+			bool all = mName.Cmp("file_aggregate") == 0;
+			const char* stat = all ? "" : (const char*)mName.mBytes + 5;
+			if (by.mLength == 0)
+				result = all ? statList(GrapaCHAR(), results.front()) : statEvent(GrapaCHAR(), stat, results.front());
+			else
+			{
+				result = new GrapaRuleEvent(all ? GrapaTokenType::ARRAY : GrapaTokenType::LIST, 0, "", "");
+				result->vQueue = new GrapaRuleQueue();
+				for (u64 i = 0; i < groups.size(); i++)
+				{
+					if (all)
+					{
+						GrapaRuleEvent* item = statList(GrapaCHAR(), results[i]);
+						if (groups[i].mLength)
+							item->vQueue->PushHead(GrapaLibraryFileValue(vScriptExec, pNameSpace, by, groups[i]));
+						else
+							item->vQueue->PushHead(statEvent(by, "min", GrapaDBAggregate()));
+						result->vQueue->PushTail(item);
+					}
+					else
+					{
+						GrapaCHAR name(groups[i]);
+						switch (groups[i].mToken)
+						{
+						case GrapaTokenType::INT: { GrapaInt a; a.FromBytes(groups[i]); name = a.ToString(); } break;
+						case GrapaTokenType::FLOAT: { GrapaFloat a; a.FromBytes(groups[i]); name = a.ToString(); } break;
+						case GrapaTokenType::TIME: { GrapaTime a; a.FromBytes(groups[i]); a.ToString(name); } break;
+						}
+						name.mToken = GrapaTokenType::STR;
+						result->vQueue->PushTail(statEvent(name, stat, results[i]));
+					}
+				}
+			}
+		}
+	}
+	if (err && result == NULL)
+		result = Error(vScriptExec, pNameSpace, err);
+	return(result);
+}
+
+// Returns a $LIST with an entry for each field compacted: its records, the bytes its slots took
+// (raw) and take now (size), and how many blocks went to each encoding.
+GrapaRuleEvent* GrapaLibraryRuleFileCompactEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaError err = -1;
+	GrapaRuleEvent* result = NULL;
+
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+
+	GrapaRuleEvent* objEvent = vScriptExec->vScriptState->SearchTarget(pNameSpace, r1.vVal);
+	if (objEvent && objEvent->vDatabase == NULL)
+		objEvent->vDatabase = new GrapaLocalDatabase(vScriptExec->vScriptState);
+
+	if (objEvent)
+	{
+		GrapaCHAR field;
+		GrapaRuleEvent* e = r2.vVal;
+		while (e && e->mValue.mToken == GrapaTokenType::PTR) e = e->vRulePointer;
+		if (e && !e->mNull) field.FROM(e->mValue);
+
+		std::vector<GrapaCHAR> names;
+		std::vector<GrapaDBCompact> info;
+		err = objEvent->vDatabase->FieldCompact(field, names, info);
+		if (!err)
+		{
+			auto number = [](const char* pName, u64 pValue) { return new GrapaRuleEvent(0, GrapaCHAR(pName), GrapaInt((s64)pValue).getBytes()); };
+			result = new GrapaRuleEvent(0, GrapaCHAR(), GrapaCHAR());
+			result->mValue.mToken = GrapaTokenType::LIST;
+			result->vQueue = new GrapaRuleQueue();
+			for (u64 i = 0; i < info.size(); i++)
+			{
+				GrapaRuleEvent* item = new GrapaRuleEvent(0, names[i], GrapaCHAR());
+				item->mValue.mToken = GrapaTokenType::LIST;
+				item->vQueue = new GrapaRuleQueue();
+				item->vQueue->PushTail(number("records", info[i].mRecords));
+				item->vQueue->PushTail(number("raw", info[i].mRaw));
+				item->vQueue->PushTail(number("size", info[i].mSize));
+				for (u8 code = 0; code < GrapaDBColumnCode::LAST_CODE; code++)
+					item->vQueue->PushTail(number(GrapaDBColumnCode::Name(code), info[i].mBlocks[code]));
+				result->vQueue->PushTail(item);
+			}
+		}
+	}
+	if (err && result == NULL)
+		result = Error(vScriptExec, pNameSpace, err);
+	return(result);
+}
+
+// Rows are a $LIST of name:fields, or an $ARRAY of $LISTs that each carry their name in $KEY. The
+// fields of a row are a $LIST of field:value; any other value goes to $VALUE.
+GrapaRuleEvent* GrapaLibraryRuleLoadEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaError err = -1;
+	GrapaRuleEvent* result = NULL;
+
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+
+	GrapaRuleEvent* objEvent = vScriptExec->vScriptState->SearchTarget(pNameSpace, r1.vVal);
+	if (objEvent && objEvent->vDatabase == NULL)
+		objEvent->vDatabase = new GrapaLocalDatabase(vScriptExec->vScriptState);
+
+	bool isList = r2.vVal && r2.vVal->mValue.mToken == GrapaTokenType::LIST;
+	bool isArray = r2.vVal && r2.vVal->mValue.mToken == GrapaTokenType::ARRAY;
+
+	if (objEvent && (isList || isArray))
+	{
+		GrapaGroupBatch batch;
+		GrapaCHAR keyName("$KEY"), valueName("$VALUE");
+		auto deref = [](GrapaRuleEvent* e) { while (e && e->mValue.mToken == GrapaTokenType::PTR) e = e->vRulePointer; return e; };
+		auto fieldIndex = [&](const GrapaCHAR& pField) {
+			u64 i;
+			for (i = 0; i < batch.mFields.size(); i++)
+				if (batch.mFields[i].StrCmp(pField) == 0) return i;
+			batch.mFields.emplace_back(pField);
+			return i;
+		};
+		auto fieldsOf = [&](GrapaRuleEvent* row) { row = deref(row); return (row && row->mValue.mToken == GrapaTokenType::LIST && row->vQueue) ? (GrapaRuleQueue*)row->vQueue : NULL; };
+
+		err = 0;
+		GrapaRuleEvent* row = r2.vVal->vQueue ? ((GrapaRuleQueue*)r2.vVal->vQueue)->Head() : NULL;
+		for (; row && !err; row = row->Next())
+		{
+			GrapaRuleQueue* fields = fieldsOf(row);
+			if (isArray && fields == NULL) err = -1;
+			if (fields == NULL)
+			{
+				fieldIndex(valueName);
+				continue;
+			}
+			for (GrapaRuleEvent* f = fields->Head(); f; f = f->Next())
+			{
+				if (isArray && f->mName.StrCmp(keyName) == 0) continue;
+				fieldIndex(f->mName);
+			}
+		}
+
+		u64 fieldCount = batch.mFields.size();
+		row = r2.vVal->vQueue ? ((GrapaRuleQueue*)r2.vVal->vQueue)->Head() : NULL;
+		for (; row && !err; row = row->Next())
+		{
+			GrapaRuleQueue* fields = fieldsOf(row);
+			u64 at = batch.mValues.size();
+			batch.mValues.resize(at + fieldCount);
+			batch.mNames.emplace_back();
+			if (isList)
+				batch.mNames.back().FROM(row->mName);
+			auto setValue = [&](u64 pField, GrapaRuleEvent* v) {
+				GrapaCHAR& to = batch.mValues[at + pField];
+				v = deref(v);
+				if (v == NULL) return;
+				switch (v->mValue.mToken)
+				{
+				case GrapaTokenType::ARRAY: case GrapaTokenType::TUPLE: case GrapaTokenType::LIST: case GrapaTokenType::XML: case GrapaTokenType::EL:
+				case GrapaTokenType::TAG: case GrapaTokenType::OP: case GrapaTokenType::CODE: case GrapaTokenType::ERR:
+					if (v->vQueue)
+						((GrapaRuleQueue*)v->vQueue)->TO(to, v->vClass, v->mValue.mToken);
+					to.mToken = v->mValue.mToken;
+					break;
+				default:
+					to.FROM(v->mValue);
+					break;
+				}
+			};
+			if (fields == NULL)
+			{
+				setValue(fieldIndex(valueName), row);
+				continue;
+			}
+			for (GrapaRuleEvent* f = fields->Head(); f; f = f->Next())
+			{
+				if (isArray && f->mName.StrCmp(keyName) == 0)
+				{
+					GrapaRuleEvent* k = deref(f);
+					if (k) batch.mNames.back().FROM(k->mValue);
+				}
+				else
+					setValue(fieldIndex(f->mName), f);
+			}
+		}
+
+		u64 count = 0;
+		if (!err)
+			err = objEvent->vDatabase->DatabaseLoad(batch, count);
+		if (!err)
+			result = new GrapaRuleEvent(0, GrapaCHAR(), GrapaInt(count).getBytes());
+	}
+	if (err && result == NULL)
+		result = Error(vScriptExec, pNameSpace, err);
+	return(result);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GrapaRuleEvent* GrapaLibraryRuleMacEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaRuleEvent* result = NULL;
+
+	GrapaRuleEvent* r = NULL;
+	u64 mac;
+	char ipx[256];
+	char namex[256];
+	GrapaNet::GetMac(namex, ipx, mac);
+	result = new GrapaRuleEvent();
+	result->mValue.mToken = GrapaTokenType::LIST;
+	result->vQueue = new GrapaRuleQueue();
+
+	r = new GrapaRuleEvent(GrapaTokenType::STR, 0, "name", namex);
+	result->vQueue->PushTail(r);
+	r = new GrapaRuleEvent(GrapaTokenType::STR, 0, "ip", ipx);
+	result->vQueue->PushTail(r);
+	r = new GrapaRuleEvent(0, GrapaCHAR("mac"), GrapaInt(mac).getBytes());
+	r->mValue.mToken = GrapaTokenType::RAW;
+	result->vQueue->PushTail(r);
+
+	return(result);
+}
+
+GrapaRuleEvent* GrapaLibraryRuleInterfacesEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaRuleEvent* result = NULL;
+	result = new GrapaRuleEvent();
+	result->mValue.mToken = GrapaTokenType::TABLE;
+	result = GrapaNet::GetInterfaces();
+	return(result);
+}
+
+GrapaRuleEvent* GrapaLibraryRuleConnectEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaError err = -1;
+	GrapaRuleEvent* result = NULL;
+
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+	GrapaLibraryParam r3(vScriptExec, pNameSpace, pInput ? pInput->Head(2) : NULL);
+	GrapaLibraryParam r4(vScriptExec, pNameSpace, pInput ? pInput->Head(3) : NULL);
+
+	GrapaRuleEvent* objEvent = vScriptExec->vScriptState->SearchTarget(pNameSpace, r1.vVal);
+	if (objEvent && objEvent->vNetConnect == NULL)
+		objEvent->vNetConnect = new GrapaNetConnect();
+
+	if (objEvent)
+	{
+		err = 0;
+
+		if (r2.vVal && r2.vVal->mValue.mBytes)
+			objEvent->vNetConnect->Set(r2.vVal->mValue);
+		if (r3.vVal && r3.vVal->mValue.mBytes)
+		{
+			err = objEvent->vNetConnect->Certificate(r3.vVal);
+		}
+		if (!err && r4.vVal && r4.vVal->vQueue)
+		{
+			s64 index;
+			err = objEvent->vNetConnect->Proxy(r4.vVal->vQueue->Search("type", index), r4.vVal->vQueue->Search("id", index), r4.vVal->vQueue->Search("ip", index));
+		}
+		if (!err)
+		{
+			err = objEvent->vNetConnect->Connect(objEvent);
+		}
+		if (err == 0)
+		{
+			if (!objEvent->vNetConnect->mNet.mConnected)
+			{
+				objEvent->vNetConnect->Disconnect();
+				err = -1;
+			}
+		}
+	}
+	if (err && result == NULL)
+	{
+		result = Error(vScriptExec, pNameSpace, err);
+	}
+
+	return(result);
+}
+
+GrapaRuleEvent* GrapaLibraryRuleBindEvent::Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaError err = -1;
+	GrapaRuleEvent* result = NULL;
+
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+
+	GrapaRuleEvent* objEvent = vScriptExec->vScriptState->SearchTarget(pNameSpace, r1.vVal);
+	if (objEvent && objEvent->vNetConnect == NULL)
+		objEvent->vNetConnect = new GrapaNetConnect();
+
+	if (objEvent)
+	{
+		if (r2.vVal && r2.vVal->mValue.mBytes)
+			objEvent->vNetConnect->Set(r2.vVal->mValue);
+		err = objEvent->vNetConnect->Bind(objEvent);
+	}
+	if (err && result == NULL)
+		result = Error(vScriptExec, pNameSpace, err);
+
+	return(result);
+}
+
+GrapaRuleEvent* GrapaLibraryRuleListenEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaError err = -1;
+	GrapaRuleEvent* result = NULL;
+
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+
+	GrapaRuleEvent* objEvent = vScriptExec->vScriptState->SearchTarget(pNameSpace, r1.vVal);
+	if (objEvent && objEvent->vNetConnect == NULL)
+		objEvent->vNetConnect = new GrapaNetConnect();
+
+	GrapaRuleEvent* objBind = vScriptExec->vScriptState->SearchTarget(pNameSpace, r2.vVal);
+	if (objBind && objBind->vNetConnect == NULL)
+		objBind->vNetConnect = new GrapaNetConnect();
+
+	if (objEvent && objBind)
+	{
+		err = objEvent->vNetConnect->Listen(objBind->vNetConnect);
+		if (err == 0 && !objEvent->vNetConnect->mNet.mConnected)
+		{
+			objEvent->vNetConnect->Disconnect();
+		}
+	}
+	if (err && result == NULL)
+		result = Error(vScriptExec, pNameSpace, err);
+
+	return(result);
+}
+
+GrapaRuleEvent* GrapaLibraryRuleOnListenEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaError err = -1;
+	GrapaRuleEvent* result = NULL;
+
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+	GrapaLibraryParam r3(vScriptExec, pNameSpace, pInput ? pInput->Head(2) : NULL);
+	GrapaLibraryParam r4(vScriptExec, pNameSpace, pInput ? pInput->Head(3) : NULL);
+
+	GrapaRuleEvent* objEvent = vScriptExec->vScriptState->SearchTarget(pNameSpace, r1.vVal);
+	if (objEvent && objEvent->vNetConnect == NULL)
+		objEvent->vNetConnect = new GrapaNetConnect();
+
+	if (objEvent)
+	{
+		GrapaNames* vNames = pNameSpace;
+		while (vNames->GetParrent()) vNames = vNames->GetParrent();
+		objEvent->vNetConnect->mNames.SetParrent(vNames);
+		if (r2.vVal && r2.vVal->mValue.mBytes)
+			objEvent->vNetConnect->Set(r2.vVal->mValue);
+		err = objEvent->vNetConnect->OnListen(vScriptExec, objEvent, r3.vVal, r4.vVal);
+		if (err == 0 && !objEvent->vNetConnect->mNet.mBound)
+		{
+			objEvent->vNetConnect->Disconnect();
+		}
+	}
+	if (err && result == NULL)
+		result = Error(vScriptExec, pNameSpace, err);
+
+	return(result);
+}
+
+GrapaRuleEvent* GrapaLibraryRuleDisconnectEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaError err = -1;
+	GrapaRuleEvent* result = NULL;
+
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+
 	GrapaRuleEvent* objEvent = vScriptExec->vScriptState->SearchTarget(pNameSpace, r1.vVal);
 	if (objEvent && objEvent->vNetConnect == NULL)
 		objEvent->vNetConnect = new GrapaNetConnect();
@@ -10731,6 +11509,7 @@ GrapaRuleEvent* GrapaLibraryRuleGenPrimeEvent::Run(GrapaScriptExec *vScriptExec,
 	GrapaCHAR name;
 	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
 	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+	GrapaLibraryParam r3(vScriptExec, pNameSpace, pInput ? pInput->Head(2) : NULL);
 	GrapaInt num1 = 512;
 	GrapaInt num2 = 0;
 	if (r1.vVal && r1.vVal->mValue.mLength)
@@ -10740,7 +11519,14 @@ GrapaRuleEvent* GrapaLibraryRuleGenPrimeEvent::Run(GrapaScriptExec *vScriptExec,
 	if (num1.GetCount() == 1 && num1.GetItem(0) >= 2)
 	{
 		GrapaPrime p;
-		p.GenPrime(num1.GetItem(0), num2.LongValue(), GrapaInt(0), GrapaInt(1));
+		if (r3.vVal && r3.vVal->mValue.mLength)
+		{
+			GrapaInt seed;
+			seed.FromBytes(r3.vVal->mValue);
+			p.GenPrime(num1.GetItem(0), num2.LongValue(), (u64)seed.LongValue());
+		}
+		else
+			p.GenPrime(num1.GetItem(0), num2.LongValue(), GrapaInt(0), GrapaInt(1));
 		result = new GrapaRuleEvent(0, name, p.getBytes());
 		err = 0;
 	}
@@ -10776,7 +11562,37 @@ GrapaRuleEvent* GrapaLibraryRuleIsPrimeEvent::Run(GrapaScriptExec *vScriptExec,
 	GrapaError err = -1;
 	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
 	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
-	if (r1.vVal && r1.vVal->mValue.mLength)
+	GrapaLibraryParam r3(vScriptExec, pNameSpace, pInput ? pInput->Head(2) : NULL);
+	if (r1.vVal && (r1.vVal->mValue.mToken == GrapaTokenType::ARRAY || r1.vVal->mValue.mToken == GrapaTokenType::TUPLE))
+	{
+		// Batch form: one 1/0 per entry, tested in parallel. A seed makes the bases reproducible.
+		GrapaInt safe = 0, seed;
+		if (r2.vVal && r2.vVal->mValue.mLength)
+			safe.FromBytes(r2.vVal->mValue);
+		if (r3.vVal && r3.vVal->mValue.mLength)
+			seed.FromBytes(r3.vVal->mValue);
+		else
+			seed = GrapaInt((u64)gSystem->Random32() << 32 | gSystem->Random32());
+		std::vector<GrapaInt> list;
+		GrapaRuleEvent* ev = r1.vVal->vQueue ? r1.vVal->vQueue->Head() : NULL;
+		for (; ev; ev = ev->Next())
+		{
+			GrapaRuleEvent* v = ev;
+			while (v->mValue.mToken == GrapaTokenType::PTR && v->vRulePointer) v = v->vRulePointer;
+			GrapaInt a;
+			if (v->mValue.mToken == GrapaTokenType::INT)
+				a.FromBytes(v->mValue);
+			list.push_back(a);
+		}
+		std::vector<u8> flags;
+		GrapaPrime::TestPrimes(list, flags, (u32)safe.LongValue(), 64, (u64)seed.LongValue());
+		result = new GrapaRuleEvent(GrapaTokenType::ARRAY, 0, "", "");
+		result->vQueue = new GrapaRuleQueue();
+		for (u8 f : flags)
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR(""), GrapaInt(f ? 1 : 0).getBytes()));
+		err = 0;
+	}
+	else if (r1.vVal && r1.vVal->mValue.mLength)
 	{
 		GrapaPrime num1, num2;
 		num1.FromBytes(r1.vVal->mValue);
@@ -10792,6 +11608,35 @@ GrapaRuleEvent* GrapaLibraryRuleIsPrimeEvent::Run(GrapaScriptExec *vScriptExec,
 	return(result);
 }
 
+GrapaRuleEvent* GrapaLibraryRulePrimesEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaRuleEvent* result = NULL;
+	GrapaError err = -1;
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+	GrapaInt low = 2, high;
+	if (r1.vVal && r1.vVal->mValue.mLength)
+		high.FromBytes(r1.vVal->mValue);
+	if (r2.vVal && r2.vVal->mValue.mLength)
+	{
+		low = high;
+		high.FromBytes(r2.vVal->mValue);
+	}
+	if (!low.IsSignNeg() && !high.IsSignNeg() && high.bitCount() < 63)
+	{
+		std::vector<u64> primes;
+		GrapaPrime::Sieve(low.LongValue(), high.LongValue(), primes);
+		result = new GrapaRuleEvent(GrapaTokenType::ARRAY, 0, "", "");
+		result->vQueue = new GrapaRuleQueue();
+		for (u64 p : primes)
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR(""), GrapaInt(p).getBytes()));
+		err = 0;
+	}
+	if (err && result == NULL)
+		result = Error(vScriptExec, pNameSpace, err);
+	return(result);
+}
+
 GrapaRuleEvent* GrapaLibraryRuleIsAksEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
 {
 	GrapaRuleEvent* result = NULL;
@@ -14160,21 +15005,123 @@ GrapaRuleEvent* GrapaLibraryRuleEEvent::Run(GrapaScriptExec *vScriptExec, GrapaN
 	return(result);
 }
 
+// Reads an INT (or RAW) value, or the INT entries of an ARRAY or TUPLE, setting pArray for the
+// list forms. Returns false for anything else.
+static bool ModPowInts(GrapaRuleEvent* pVal, std::vector<GrapaInt>& pList, bool& pArray)
+{
+	pList.clear();
+	if (pVal == NULL)
+		return false;
+	if (pVal->mValue.mToken == GrapaTokenType::INT || pVal->mValue.mToken == GrapaTokenType::RAW)
+	{
+		GrapaInt a;
+		a.FromBytes(pVal->mValue);
+		pList.push_back(a);
+		return true;
+	}
+	if (pVal->mValue.mToken != GrapaTokenType::ARRAY && pVal->mValue.mToken != GrapaTokenType::TUPLE)
+		return false;
+	pArray = true;
+	for (GrapaRuleEvent* ev = pVal->vQueue ? pVal->vQueue->Head() : NULL; ev; ev = ev->Next())
+	{
+		GrapaRuleEvent* v = ev;
+		while (v->mValue.mToken == GrapaTokenType::PTR && v->vRulePointer) v = v->vRulePointer;
+		if (v->mValue.mToken != GrapaTokenType::INT)
+			return false;
+		GrapaInt a;
+		a.FromBytes(v->mValue);
+		pList.push_back(a);
+	}
+	return true;
+}
+
+// (a).modpow(p,m) as before. An array of bases or exponents runs the whole batch against one
+// cached context for m, across worker threads. A list from (m).modctx(g) supplies the modulus and
+// fixed base: ctx.modpow(p) raises g, ctx.modpow(p,b) raises b.
 GrapaRuleEvent* GrapaLibraryRuleModPowEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
 {
 	GrapaRuleEvent *result = NULL;
 	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
 	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
 	GrapaLibraryParam r3(vScriptExec, pNameSpace, pInput ? pInput->Head(2) : NULL);
-	if (r1.vVal && r2.vVal && r3.vVal)
+	std::vector<GrapaInt> bases, exps, mods;
+	std::shared_ptr<GrapaIntModContext> ctx;
+	bool isArray = false;
+	if (r1.vVal && r1.vVal->mValue.mToken == GrapaTokenType::LIST)
 	{
-		if ((r1.vVal->mValue.mToken == GrapaTokenType::INT || r1.vVal->mValue.mToken == GrapaTokenType::RAW) && r2.vVal->mValue.mToken == GrapaTokenType::INT && r3.vVal->mValue.mToken == GrapaTokenType::INT)
+		GrapaInt m, g;
+		bool hasMod = false;
+		for (GrapaRuleEvent* ev = r1.vVal->vQueue ? r1.vVal->vQueue->Head() : NULL; ev; ev = ev->Next())
 		{
-			GrapaInt a, b, c;
-			a.FromBytes(r1.vVal->mValue);
-			b.FromBytes(r2.vVal->mValue);
-			c.FromBytes(r3.vVal->mValue);
-			result = new GrapaRuleEvent(0, GrapaCHAR(), (a.modPow(b, c)).getBytes());
+			if (ev->mValue.mToken != GrapaTokenType::INT)
+				continue;
+			if (ev->mName.Cmp("mod") == 0)
+			{
+				m.FromBytes(ev->mValue);
+				hasMod = true;
+			}
+			else if (ev->mName.Cmp("base") == 0)
+				g.FromBytes(ev->mValue);
+		}
+		if (hasMod && ModPowInts(r2.vVal, exps, isArray))
+		{
+			if ((r3.vVal && !r3.vVal->IsNull()) ? ModPowInts(r3.vVal, bases, isArray) : !g.IsZero())
+				ctx = GrapaIntModContext::Get(m, g);
+		}
+	}
+	else if (r1.vVal && ModPowInts(r1.vVal, bases, isArray) && ModPowInts(r2.vVal, exps, isArray) && r3.vVal && r3.vVal->mValue.mToken == GrapaTokenType::INT)
+	{
+		GrapaInt c;
+		c.FromBytes(r3.vVal->mValue);
+		if (!isArray)
+			result = new GrapaRuleEvent(0, GrapaCHAR(), (bases[0].modPow(exps[0], c)).getBytes());
+		else
+			ctx = GrapaIntModContext::Get(c, GrapaInt(0));
+	}
+	if (ctx)
+	{
+		u64 n = bases.size() > exps.size() ? bases.size() : exps.size();
+		if ((bases.size() == 1 || bases.size() == n || bases.empty()) && (exps.size() == 1 || exps.size() == n))
+		{
+			if (!isArray)
+				result = new GrapaRuleEvent(0, GrapaCHAR(), (bases.empty() ? ctx->PowBase(exps[0]) : ctx->Pow(bases[0], exps[0])).getBytes());
+			else
+			{
+				std::vector<GrapaInt> values;
+				ctx->PowBatch(bases, exps, values);
+				result = new GrapaRuleEvent(GrapaTokenType::ARRAY, 0, "", "");
+				result->vQueue = new GrapaRuleQueue();
+				for (GrapaInt& v : values)
+					result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR(""), v.getBytes()));
+			}
+		}
+	}
+	if (result == NULL)
+		result = Error(vScriptExec, pNameSpace, -1);
+	return(result);
+}
+
+// (m).modctx(g) builds (or finds) the cached context for modulus m and fixed base g and returns
+// {mod:m, base:g} for use with modpow.
+GrapaRuleEvent* GrapaLibraryRuleModCtxEvent::Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaRuleEvent* result = NULL;
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+	if (r1.vVal && r1.vVal->mValue.mToken == GrapaTokenType::INT)
+	{
+		GrapaInt m, g;
+		m.FromBytes(r1.vVal->mValue);
+		if (r2.vVal && r2.vVal->mValue.mToken == GrapaTokenType::INT)
+			g.FromBytes(r2.vVal->mValue);
+		if (!m.IsZero())
+		{
+			GrapaIntModContext::Get(m, g);
+			result = new GrapaRuleEvent(GrapaTokenType::LIST, 0, "", "");
+			result->vQueue = new GrapaRuleQueue();
+			result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("mod"), m.getBytes()));
+			if (!g.IsZero())
+				result->vQueue->PushTail(new GrapaRuleEvent(0, GrapaCHAR("base"), g.getBytes()));
 		}
 	}
 	if (result == NULL)
@@ -14424,6 +15371,16 @@ GrapaRuleEvent* GrapaLibraryRuleInvEvent::Run(GrapaScriptExec* vScriptExec, Grap
 		q.Inv(vScriptExec, pNameSpace);
 		result = q.ToArray();
 	}
+	else if (r1.vVal && r1.vVal->mValue.mToken == GrapaTokenType::LIST)
+	{
+		GrapaVectorFactor f;
+		GrapaVector q;
+		if (f.FROM(vScriptExec, r1.vVal) && f.Inv(vScriptExec, q))
+		{
+			result = new GrapaRuleEvent(GrapaTokenType::VECTOR, 0, "", "");
+			result->vVector = new GrapaVector(q);
+		}
+	}
 	if (result == NULL)
 		result = Error(vScriptExec, pNameSpace, -1);
 	return(result);
@@ -14485,6 +15442,13 @@ GrapaRuleEvent* GrapaLibraryRuleDetEvent::Run(GrapaScriptExec* vScriptExec, Grap
 		q.FROM(vScriptExec->vScriptState->mItemState.mFloatFix, vScriptExec->vScriptState->mItemState.mFloatMax, vScriptExec->vScriptState->mItemState.mFloatExtra, r1.vVal, 0);
 		result = new GrapaRuleEvent(0, GrapaCHAR(""), q.Determinant(vScriptExec, pNameSpace).getBytes());
 	}
+	else if (r1.vVal && r1.vVal->mValue.mToken == GrapaTokenType::LIST)
+	{
+		GrapaVectorFactor f;
+		GrapaFloat d(vScriptExec->vScriptState->mItemState.mFloatFix, vScriptExec->vScriptState->mItemState.mFloatMax, vScriptExec->vScriptState->mItemState.mFloatExtra, 0);
+		if (f.FROM(vScriptExec, r1.vVal) && f.Determinant(vScriptExec, d))
+			result = new GrapaRuleEvent(0, GrapaCHAR(""), d.getBytes());
+	}
 	if (result == NULL)
 		result = Error(vScriptExec, pNameSpace, -1);
 	return(result);
@@ -14513,7 +15477,42 @@ GrapaRuleEvent* GrapaLibraryRuleSolveEvent::Run(GrapaScriptExec* vScriptExec, Gr
 {
 	GrapaRuleEvent* result = NULL;
 	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
-	if (r1.vVal && (r1.vVal->mValue.mToken == GrapaTokenType::VECTOR))
+	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+	if (r2.vVal && (r2.vVal->mValue.mToken == GrapaTokenType::VECTOR || r2.vVal->mValue.mToken == GrapaTokenType::ARRAY || r2.vVal->mValue.mToken == GrapaTokenType::TUPLE))
+	{
+		GrapaVector a, b, x;
+		GrapaVectorFactor f;
+		if (r2.vVal->mValue.mToken == GrapaTokenType::VECTOR)
+			b.FROM(*r2.vVal->vVector);
+		else
+			b.FROM(vScriptExec, r2.vVal, 0);
+		if (r1.vVal && r1.vVal->mValue.mToken == GrapaTokenType::LIST)
+		{
+			if (f.FROM(vScriptExec, r1.vVal) && !f.Solve(vScriptExec, b, x))
+			{
+				result = new GrapaRuleEvent(GrapaTokenType::VECTOR, 0, "", "");
+				result->vVector = new GrapaVector(x);
+			}
+		}
+		else if (r1.vVal && (r1.vVal->mValue.mToken == GrapaTokenType::VECTOR || r1.vVal->mValue.mToken == GrapaTokenType::ARRAY || r1.vVal->mValue.mToken == GrapaTokenType::TUPLE))
+		{
+			if (r1.vVal->mValue.mToken == GrapaTokenType::VECTOR)
+				a.FROM(*r1.vVal->vVector);
+			else
+				a.FROM(vScriptExec, r1.vVal, 0);
+			if (!a.Solve(vScriptExec, pNameSpace, b, x))
+			{
+				if (r1.vVal->mValue.mToken == GrapaTokenType::VECTOR)
+				{
+					result = new GrapaRuleEvent(GrapaTokenType::VECTOR, 0, "", "");
+					result->vVector = new GrapaVector(x);
+				}
+				else
+					result = x.ToArray();
+			}
+		}
+	}
+	else if (r1.vVal && (r1.vVal->mValue.mToken == GrapaTokenType::VECTOR))
 	{
 		result = new GrapaRuleEvent(GrapaTokenType::VECTOR, 0, "", "");
 		result->vVector = new GrapaVector();
@@ -17011,6 +18010,33 @@ GrapaRuleEvent* GrapaLibraryRuleReShapeEvent::Run(GrapaScriptExec* vScriptExec,
 	return(result);
 }
 
+GrapaRuleEvent* GrapaLibraryRuleDTypeEvent::Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaRuleEvent* result = NULL;
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+	if (r1.vVal && (r1.vVal->mValue.mToken == GrapaTokenType::VECTOR || r1.vVal->mValue.mToken == GrapaTokenType::ARRAY || r1.vVal->mValue.mToken == GrapaTokenType::TUPLE))
+	{
+		if (r2.vVal == NULL || r2.vVal->IsNull())
+			return new GrapaRuleEvent(0, GrapaCHAR(), GrapaVector::DTypeName(r1.vVal->mValue.mToken == GrapaTokenType::VECTOR ? r1.vVal->vVector->mDType : GrapaVectorDType::DEFAULT));
+		result = new GrapaRuleEvent(GrapaTokenType::VECTOR, 0, "", "");
+		result->vVector = new GrapaVector();
+		if (r1.vVal->mValue.mToken == GrapaTokenType::VECTOR)
+			result->vVector->FROM(*r1.vVal->vVector);
+		else
+			result->vVector->FROM(vScriptExec, r1.vVal, 0);
+		if (!result->vVector->SetDType(GrapaVector::ToDType(r2.vVal->mValue)))
+		{
+			result->CLEAR();
+			delete result;
+			result = NULL;
+		}
+	}
+	if (result == NULL)
+		result = Error(vScriptExec, pNameSpace, -1);
+	return(result);
+}
+
 GrapaRuleEvent* GrapaLibraryRuleDotEvent::Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput)
 {
 	GrapaRuleEvent* result = NULL;
@@ -17202,12 +18228,15 @@ GrapaRuleEvent* GrapaLibraryRuleEigHEvent::Run(GrapaScriptExec* vScriptExec, Gra
 {
 	GrapaRuleEvent* result = NULL;
 	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+	bool isNeg = false, isNull = false;
+	bool refine = r2.vVal && !r2.vVal->IsNullIsNegIsZero(isNeg, isNull);
 	if (r1.vVal && (r1.vVal->mValue.mToken == GrapaTokenType::ARRAY || r1.vVal->mValue.mToken == GrapaTokenType::TUPLE))
 	{
 		GrapaVector aa;
 		aa.FROM(vScriptExec->vScriptState->mItemState.mFloatFix, vScriptExec->vScriptState->mItemState.mFloatMax, vScriptExec->vScriptState->mItemState.mFloatExtra, r1.vVal, 0);
 		GrapaVector cc,dd;
-		if (!aa.EigH(vScriptExec, pNameSpace, cc, dd) || cc.mData==NULL || dd.mData==NULL)
+		if (!aa.EigH(vScriptExec, pNameSpace, cc, dd, refine) || cc.mData==NULL || dd.mData==NULL)
 		{
 			result = Error(vScriptExec, pNameSpace, -1);
 		}
@@ -17233,7 +18262,7 @@ GrapaRuleEvent* GrapaLibraryRuleEigHEvent::Run(GrapaScriptExec* vScriptExec, Gra
 		GrapaRuleEvent* v = new GrapaRuleEvent(GrapaTokenType::VECTOR, 0, "v", "");
 		v->vVector = new GrapaVector();
 		result->vQueue->PushTail(v);
-		if (!r1.vVal->vVector->EigH(vScriptExec, pNameSpace, *w->vVector, *v->vVector))
+		if (!r1.vVal->vVector->EigH(vScriptExec, pNameSpace, *w->vVector, *v->vVector, refine))
 		{
 			result->CLEAR();
 			delete result;
@@ -17245,6 +18274,48 @@ GrapaRuleEvent* GrapaLibraryRuleEigHEvent::Run(GrapaScriptExec* vScriptExec, Gra
 	return(result);
 }
 
+GrapaRuleEvent* GrapaLibraryRuleSvdEvent::Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaRuleEvent* result = NULL;
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
+	bool isNeg = false, isNull = false;
+	bool refine = r2.vVal && !r2.vVal->IsNullIsNegIsZero(isNeg, isNull);
+	GrapaVector aa;
+	bool isArray = false;
+	if (r1.vVal && (r1.vVal->mValue.mToken == GrapaTokenType::ARRAY || r1.vVal->mValue.mToken == GrapaTokenType::TUPLE))
+	{
+		aa.FROM(vScriptExec->vScriptState->mItemState.mFloatFix, vScriptExec->vScriptState->mItemState.mFloatMax, vScriptExec->vScriptState->mItemState.mFloatExtra, r1.vVal, 0);
+		isArray = true;
+	}
+	else if (r1.vVal && r1.vVal->mValue.mToken == GrapaTokenType::VECTOR && r1.vVal->vVector)
+		aa.FROM(*r1.vVal->vVector);
+	GrapaVector u, s, v;
+	if (aa.Svd(vScriptExec, pNameSpace, u, s, v, refine))
+	{
+		const char* names[3] = { "u", "s", "v" };
+		GrapaVector* parts[3] = { &u, &s, &v };
+		result = new GrapaRuleEvent(GrapaTokenType::LIST, 0, "", "");
+		result->vQueue = new GrapaRuleQueue();
+		for (u64 i = 0; i < 3; i++)
+		{
+			GrapaRuleEvent* e = NULL;
+			if (isArray)
+				e = parts[i]->ToArray();
+			else
+			{
+				e = new GrapaRuleEvent(GrapaTokenType::VECTOR, 0, "", "");
+				e->vVector = new GrapaVector(*parts[i]);
+			}
+			e->mName.FROM(names[i]);
+			result->vQueue->PushTail(e);
+		}
+	}
+	if (result == NULL)
+		result = Error(vScriptExec, pNameSpace, -1);
+	return(result);
+}
+
 GrapaRuleEvent* GrapaLibraryRuleSumEvent::Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput)
 {
 	GrapaRuleEvent* result = NULL;
@@ -17304,7 +18375,7 @@ GrapaRuleEvent* GrapaLibraryRuleMeanEvent::Run(GrapaScriptExec* vScriptExec, Gra
 		GrapaVector aa;
 		aa.FROM(vScriptExec->vScriptState->mItemState.mFloatFix, vScriptExec->vScriptState->mItemState.mFloatMax, vScriptExec->vScriptState->mItemState.mFloatExtra, r1.vVal, 0);
 		GrapaVector cc;
-		if (aa.Mean(vScriptExec, cc, axis == 0) || cc.mData == NULL)
+		if (aa.Mean(vScriptExec, cc, axis == 0) || (cc.mData == NULL && cc.mNative == NULL))
 		{
 			result = Error(vScriptExec, pNameSpace, -1);
 		}
@@ -17329,6 +18400,86 @@ GrapaRuleEvent* GrapaLibraryRuleMeanEvent::Run(GrapaScriptExec* vScriptExec, Gra
 	return(result);
 }
 
+GrapaRuleEvent* GrapaLibraryRuleNormEvent::Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaRuleEvent* result = NULL;
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+	GrapaFloat d(vScriptExec->vScriptState->mItemState.mFloatFix, vScriptExec->vScriptState->mItemState.mFloatMax, vScriptExec->vScriptState->mItemState.mFloatExtra, 0);
+	if (r1.vVal && (r1.vVal->mValue.mToken == GrapaTokenType::ARRAY || r1.vVal->mValue.mToken == GrapaTokenType::TUPLE))
+	{
+		GrapaVector aa;
+		aa.FROM(vScriptExec->vScriptState->mItemState.mFloatFix, vScriptExec->vScriptState->mItemState.mFloatMax, vScriptExec->vScriptState->mItemState.mFloatExtra, r1.vVal, 0);
+		if (aa.Norm(vScriptExec, d) == 0)
+			result = new GrapaRuleEvent(0, GrapaCHAR(), d.getBytes());
+	}
+	else if (r1.vVal && r1.vVal->mValue.mToken == GrapaTokenType::VECTOR)
+	{
+		if (r1.vVal->vVector->Norm(vScriptExec, d) == 0)
+			result = new GrapaRuleEvent(0, GrapaCHAR(), d.getBytes());
+	}
+	if (result == NULL)
+		result = Error(vScriptExec, pNameSpace, -1);
+	return(result);
+}
+
+// Factorises a VECTOR, ARRAY or TUPLE matrix into a list of its factors (see GrapaVectorFactor),
+// or returns NULL.
+static GrapaRuleEvent* VectorFactorRun(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleQueue* pInput, u8 pKind)
+{
+	GrapaRuleEvent* result = NULL;
+	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
+	GrapaVectorFactor f;
+	if (r1.vVal && r1.vVal->mValue.mToken == GrapaTokenType::VECTOR)
+	{
+		if (f.FROM(vScriptExec, *r1.vVal->vVector, pKind))
+			result = f.ToList();
+	}
+	else if (r1.vVal && (r1.vVal->mValue.mToken == GrapaTokenType::ARRAY || r1.vVal->mValue.mToken == GrapaTokenType::TUPLE))
+	{
+		GrapaVector aa;
+		aa.FROM(vScriptExec->vScriptState->mItemState.mFloatFix, vScriptExec->vScriptState->mItemState.mFloatMax, vScriptExec->vScriptState->mItemState.mFloatExtra, r1.vVal, 0);
+		if (f.FROM(vScriptExec, aa, pKind))
+		{
+			GrapaRuleEvent* list = f.ToList();
+			result = new GrapaRuleEvent(GrapaTokenType::LIST, 0, "", "");
+			result->vQueue = new GrapaRuleQueue();
+			for (GrapaRuleEvent* ev = list->vQueue->Head(); ev; ev = ev->Next())
+			{
+				GrapaRuleEvent* a = ev->vVector->ToArray();
+				a->mName.FROM(ev->mName);
+				result->vQueue->PushTail(a);
+			}
+			list->CLEAR();
+			delete list;
+		}
+	}
+	return(result);
+}
+
+GrapaRuleEvent* GrapaLibraryRuleLuEvent::Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaRuleEvent* result = VectorFactorRun(vScriptExec, pNameSpace, pInput, GrapaVectorFactorKind::LU);
+	if (result == NULL)
+		result = Error(vScriptExec, pNameSpace, -1);
+	return(result);
+}
+
+GrapaRuleEvent* GrapaLibraryRuleQrEvent::Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaRuleEvent* result = VectorFactorRun(vScriptExec, pNameSpace, pInput, GrapaVectorFactorKind::QR);
+	if (result == NULL)
+		result = Error(vScriptExec, pNameSpace, -1);
+	return(result);
+}
+
+GrapaRuleEvent* GrapaLibraryRuleCholeskyEvent::Run(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* pOperation, GrapaRuleQueue* pInput)
+{
+	GrapaRuleEvent* result = VectorFactorRun(vScriptExec, pNameSpace, pInput, GrapaVectorFactorKind::CHOLESKY);
+	if (result == NULL)
+		result = Error(vScriptExec, pNameSpace, -1);
+	return(result);
+}
+
 GrapaRuleEvent* GrapaLibraryRuleLowerEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
 {
 	GrapaRuleEvent *result = NULL;
@@ -17624,12 +18775,45 @@ GrapaRuleEvent* GrapaLibraryRuleNEqEvent::Run(GrapaScriptExec *vScriptExec, Grap
 	return(result);
 }
 
+static GrapaRuleEvent* VectorCmpRun(GrapaScriptExec* vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent* r1, GrapaRuleEvent* r2, u8 pOp)
+{
+	GrapaVector bb;
+	GrapaVector* b = &bb;
+	switch (r2->mValue.mToken)
+	{
+	case GrapaTokenType::VECTOR:
+		b = r2->vVector;
+		break;
+	case GrapaTokenType::ARRAY:
+	case GrapaTokenType::TUPLE:
+		bb.FROM(vScriptExec->vScriptState->mItemState.mFloatFix, vScriptExec->vScriptState->mItemState.mFloatMax, vScriptExec->vScriptState->mItemState.mFloatExtra, r2, 0);
+		break;
+	case GrapaTokenType::INT:
+	case GrapaTokenType::FLOAT:
+		bb.FromValue(vScriptExec, r2->mValue);
+		break;
+	default:
+		return NULL;
+	}
+	GrapaRuleEvent* result = new GrapaRuleEvent(GrapaTokenType::VECTOR, 0, "", "");
+	result->vVector = new GrapaVector();
+	if (r1->vVector->Cmp(vScriptExec, pNameSpace, *b, pOp, *result->vVector))
+	{
+		result->CLEAR();
+		delete result;
+		result = NULL;
+	}
+	return result;
+}
+
 GrapaRuleEvent* GrapaLibraryRuleGtEqEvent::Run(GrapaScriptExec *vScriptExec, GrapaNames* pNameSpace, GrapaRuleEvent *pOperation, GrapaRuleQueue* pInput)
 {
 	GrapaRuleEvent *result = NULL;
 	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
 	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
-	if (r1.vVal && r2.vVal)
+	if (r1.vVal && r2.vVal && r1.vVal->mValue.mToken == GrapaTokenType::VECTOR && r1.vVal->vVector)
+		result = VectorCmpRun(vScriptExec, pNameSpace, r1.vVal, r2.vVal, GrapaVectorOp::GTEQ);
+	else if (r1.vVal && r2.vVal)
 	{
 		//bool isEqual = false;
 		GrapaCHAR name;
@@ -17694,7 +18878,9 @@ GrapaRuleEvent* GrapaLibraryRuleGtEvent::Run(GrapaScriptExec *vScriptExec, Grapa
 	GrapaRuleEvent *result = NULL;
 	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
 	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
-	if (r1.vVal && r2.vVal)
+	if (r1.vVal && r2.vVal && r1.vVal->mValue.mToken == GrapaTokenType::VECTOR && r1.vVal->vVector)
+		result = VectorCmpRun(vScriptExec, pNameSpace, r1.vVal, r2.vVal, GrapaVectorOp::GT);
+	else if (r1.vVal && r2.vVal)
 	{
 		//bool isEqual = false;
 		GrapaCHAR name;
@@ -17759,7 +18945,9 @@ GrapaRuleEvent* GrapaLibraryRuleLtEqEvent::Run(GrapaScriptExec *vScriptExec, Gra
 	GrapaRuleEvent *result = NULL;
 	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
 	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
-	if (r1.vVal && r2.vVal)
+	if (r1.vVal && r2.vVal && r1.vVal->mValue.mToken == GrapaTokenType::VECTOR && r1.vVal->vVector)
+		result = VectorCmpRun(vScriptExec, pNameSpace, r1.vVal, r2.vVal, GrapaVectorOp::LTEQ);
+	else if (r1.vVal && r2.vVal)
 	{
 		//bool isEqual = false;
 		GrapaCHAR name;
@@ -17824,7 +19012,9 @@ GrapaRuleEvent* GrapaLibraryRuleLtEvent::Run(GrapaScriptExec *vScriptExec, Grapa
 	GrapaRuleEvent *result = NULL;
 	GrapaLibraryParam r1(vScriptExec, pNameSpace, pInput ? pInput->Head(0) : NULL);
 	GrapaLibraryParam r2(vScriptExec, pNameSpace, pInput ? pInput->Head(1) : NULL);
-	if (r1.vVal && r2.vVal)
+	if (r1.vVal && r2.vVal && r1.vVal->mValue.mToken == GrapaTokenType::VECTOR && r1.vVal->vVector)
+		result = VectorCmpRun(vScriptExec, pNameSpace, r1.vVal, r2.vVal, GrapaVectorOp::LT);
+	else if (r1.vVal && r2.vVal)
 	{
 		//bool isEqual = false;
 		GrapaCHAR name;
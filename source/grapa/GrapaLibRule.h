@@ -103,6 +103,14 @@ public:
 	GrapaLibraryEvent* HandleFileSplit(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleInclude(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleDebug(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleUpgrade(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleCache(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleTransaction(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleLoad(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleIndex(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleFileRange(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleFileAggregate(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleFileCompact(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleMac(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleInterfaces(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleConnect(GrapaCHAR& pName);
@@ -128,6 +136,7 @@ public:
 	GrapaLibraryEvent* HandleStaticPrime(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleIsPrime(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleIsAks(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandlePrimes(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleRandom(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleSetBit(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleClearBit(GrapaCHAR& pName);
@@ -185,6 +194,7 @@ public:
 	GrapaLibraryEvent* HandleLog(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleE(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleModPow(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleModCtx(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleModInv(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleAbs(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleGcd(GrapaCHAR& pName);
@@ -238,14 +248,20 @@ public:
 	GrapaLibraryEvent* HandleJoin(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleShape(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleReShape(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleDType(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleDot(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleIdentity(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleDiagonal(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleTriU(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleTriL(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleEigH(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleSvd(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleSum(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleMean(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleNorm(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleLu(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleQr(GrapaCHAR& pName);
+	GrapaLibraryEvent* HandleCholesky(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleLower(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleUpper(GrapaCHAR& pName);
 	GrapaLibraryEvent* HandleUtc(GrapaCHAR& pName);
@@ -20,6 +20,12 @@ limitations under the License.
 #include <math.h>
 #include <limits.h>
 #include <time.h>
+#include <string.h>
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <thread>
 
 #include <openssl/rand.h>
 
@@ -1000,6 +1006,377 @@ void GrapaPrime::GenPrime(u32 bits, u32 safe, const GrapaInt& randP, const Grapa
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Segmented sieve and batch primality testing. Work is cut into fixed segments and candidate
+// slots, and every Miller-Rabin base is drawn from the caller's seed and the candidate's
+// position, so results do not depend on how many threads ran them.
+
+// Numbers covered by one sieve segment; only the odd ones are stored, a byte each.
+#define _primesegment_ 262144
+// Odd candidates sieved per NextPrime window.
+#define _primewindow_ 16384
+// Below this much work (numbers sieved, or candidates times bits squared) no threads start.
+#define _primeparallelwork_ 1048576
+
+static void _primeparallel(u64 pCount, u64 pWork, const std::function<void(u64)>& pTask)
+{
+	u64 threads = std::thread::hardware_concurrency();
+	if (threads > pCount)
+		threads = pCount;
+	if (pWork < _primeparallelwork_ || threads < 2)
+	{
+		for (u64 t = 0; t < pCount; t++)
+			pTask(t);
+		return;
+	}
+	std::atomic<u64> next(0);
+	std::vector<std::future<void>> futures;
+	for (u64 w = 1; w < threads; w++)
+		futures.push_back(std::async(std::launch::async, [&]() {
+			for (u64 t = next++; t < pCount; t = next++)
+				pTask(t);
+			}));
+	for (u64 t = next++; t < pCount; t = next++)
+		pTask(t);
+	for (auto& f : futures) f.get();
+}
+
+// splitmix64 step, used as a stateless generator for seeded bases and start points.
+static u64 _primemix(u64 x)
+{
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+// Primes below 2^16, with the odd ones grouped into products that fit a BN_ULONG so one
+// BN_mod_word covers several trial divisors.
+class GrapaPrimeTable
+{
+public:
+	std::vector<u32> mPrimes;
+	std::vector<BN_ULONG> mProducts;
+	std::vector<u32> mEnds;
+	GrapaPrimeTable()
+	{
+		std::vector<u8> composite(65536, 0);
+		for (u32 i = 2; i < 65536; i++)
+		{
+			if (composite[i])
+				continue;
+			mPrimes.push_back(i);
+			for (u32 j = i * i; j < 65536; j += i)
+				composite[j] = 1;
+		}
+		BN_ULONG product = 1;
+		for (u32 i = 1; i < mPrimes.size(); i++)
+		{
+			if (product > ((BN_ULONG)-1) / mPrimes[i])
+			{
+				mProducts.push_back(product);
+				mEnds.push_back(i);
+				product = 1;
+			}
+			product *= mPrimes[i];
+		}
+		mProducts.push_back(product);
+		mEnds.push_back((u32)mPrimes.size());
+	}
+};
+
+static const GrapaPrimeTable& _primetable()
+{
+	static GrapaPrimeTable table;
+	return table;
+}
+
+// Exact test for n < 2^32 by trial division.
+static bool _primesmall(u64 n)
+{
+	if (n < 2)
+		return false;
+	const std::vector<u32>& primes = _primetable().mPrimes;
+	for (u32 i = 0; i < primes.size() && (u64)primes[i] * primes[i] <= n; i++)
+		if (n % primes[i] == 0)
+			return false;
+	return true;
+}
+
+// False when an odd prime below 2^16 divides n (n above 2^32), or for pSafe divides (n-1)/2.
+static bool _primetrial(const BIGNUM* n, u32 pSafe)
+{
+	const GrapaPrimeTable& table = _primetable();
+	u32 i = 1;
+	for (u64 b = 0; b < table.mProducts.size(); b++)
+	{
+		BN_ULONG r = BN_mod_word(n, table.mProducts[b]);
+		for (; i < table.mEnds[b]; i++)
+		{
+			BN_ULONG m = r % table.mPrimes[i];
+			if (m == 0 || (pSafe && m == 1))
+				return false;
+		}
+	}
+	return true;
+}
+
+// Miller-Rabin with base 2 followed by pRounds-1 bases drawn from pKey. n is odd and above 2^32.
+static bool _primemiller(const BIGNUM* n, u32 pRounds, u64 pKey, BN_CTX* ctx)
+{
+	BN_CTX_start(ctx);
+	BIGNUM* n1 = BN_CTX_get(ctx);
+	BIGNUM* t = BN_CTX_get(ctx);
+	BIGNUM* range = BN_CTX_get(ctx);
+	BIGNUM* a = BN_CTX_get(ctx);
+	BIGNUM* b = BN_CTX_get(ctx);
+	BN_MONT_CTX* mont = BN_MONT_CTX_new();
+	bool prime = b && mont && BN_MONT_CTX_set(mont, n, ctx);
+	if (prime)
+	{
+		BN_copy(n1, n);
+		BN_sub_word(n1, 1);
+		int s = 1;
+		while (!BN_is_bit_set(n1, s))
+			s++;
+		BN_rshift(t, n1, s);
+		BN_copy(range, n);
+		BN_sub_word(range, 3);
+		std::vector<u8> raw(((BN_num_bits(n) + 64 + 63) / 64) * 8);
+		u64 key = pKey;
+		for (u32 round = 0; prime && round < (pRounds ? pRounds : 1); round++)
+		{
+			if (round == 0)
+				BN_set_word(a, 2);
+			else
+			{
+				for (u64 i = 0; i < raw.size(); i += 8)
+				{
+					key = _primemix(key);
+					memcpy(&raw[i], &key, 8);
+				}
+				BN_bin2bn(raw.data(), (int)raw.size(), a);
+				BN_mod(a, a, range, ctx);
+				BN_add_word(a, 2);
+			}
+			BN_mod_exp_mont(b, a, t, n, ctx, mont);
+			if (BN_is_one(b) || BN_cmp(b, n1) == 0)
+				continue;
+			prime = false;
+			for (int j = 1; j < s; j++)
+			{
+				BN_mod_sqr(b, b, n, ctx);
+				if (BN_cmp(b, n1) == 0)
+				{
+					prime = true;
+					break;
+				}
+				if (BN_is_one(b))
+					break;
+			}
+		}
+	}
+	BN_MONT_CTX_free(mont);
+	BN_CTX_end(ctx);
+	return prime;
+}
+
+// pTrial is false when the caller has already sieved the candidate.
+static bool _primecandidate(const BIGNUM* n, u32 pSafe, u32 pRounds, u64 pKey, bool pTrial)
+{
+	if (BN_num_bits(n) <= 32)
+	{
+		u64 w = BN_get_word(n);
+		return _primesmall(w) && (!pSafe || _primesmall((w - 1) / 2));
+	}
+	if (!BN_is_odd(n) || (pSafe && !BN_is_bit_set(n, 1)))
+		return false;
+	if (pTrial && !_primetrial(n, pSafe))
+		return false;
+	BN_CTX* ctx = GrapaInt::OpenSSLContext();
+	if (!pSafe)
+		return _primemiller(n, pRounds, pKey, ctx);
+	// Safe candidates: a base 2 round on both halves rejects most pairs before the full rounds.
+	BIGNUM* q = BN_new();
+	BN_rshift1(q, n);
+	bool prime = _primemiller(n, 1, pKey, ctx) && _primecandidate(q, 0, 1, pKey, false)
+		&& _primemiller(n, pRounds, pKey, ctx) && _primecandidate(q, 0, pRounds, _primemix(~pKey), false);
+	BN_free(q);
+	return prime;
+}
+
+// Primes in [low, high), in order. Segments are sieved in parallel against the primes up to
+// sqrt(high), which come from a recursive call.
+void GrapaPrime::Sieve(u64 low, u64 high, std::vector<u64>& primes)
+{
+	primes.clear();
+	if (low < 2)
+		low = 2;
+	if (high > 0x8000000000000000ULL)
+		high = 0x8000000000000000ULL;
+	if (high <= low)
+		return;
+	if (low == 2)
+		primes.push_back(2);
+	u64 root = (u64)sqrt((double)(high - 1));
+	while (root * root > high - 1)
+		root--;
+	while ((root + 1) * (root + 1) <= high - 1)
+		root++;
+	std::vector<u64> base;
+	if (root >= 3)
+		Sieve(3, root + 1, base);
+	u64 first = low | 1;
+	u64 odds = high > first ? (high - first + 1) / 2 : 0;
+	u64 span = _primesegment_ / 2;
+	u64 segments = (odds + span - 1) / span;
+	std::vector<std::vector<u64>> parts(segments);
+	_primeparallel(segments, high - low, [&](u64 seg) {
+		u64 count = odds - seg * span;
+		if (count > span)
+			count = span;
+		u64 v0 = first + 2 * seg * span;
+		u64 last = v0 + 2 * (count - 1);
+		std::vector<u8> composite(count, 0);
+		for (u64 p : base)
+		{
+			if (p * p > last)
+				break;
+			u64 m = ((v0 + p - 1) / p) * p;
+			if (m < p * p)
+				m = p * p;
+			if ((m & 1) == 0)
+				m += p;
+			for (u64 i = (m - v0) / 2; i < count; i += p)
+				composite[i] = 1;
+		}
+		for (u64 i = 0; i < count; i++)
+			if (!composite[i])
+				parts[seg].push_back(v0 + 2 * i);
+		});
+	for (auto& part : parts)
+		primes.insert(primes.end(), part.begin(), part.end());
+}
+
+// Tests every entry of list (by absolute value). Candidates run in parallel after trial
+// division; entry i draws its bases from seed and i, so the flags are reproducible.
+void GrapaPrime::TestPrimes(const std::vector<GrapaInt>& list, std::vector<u8>& result, u32 safe, u32 rounds, u64 seed)
+{
+	result.assign(list.size(), 0);
+	u64 work = 0;
+	for (const GrapaInt& v : list)
+		work += v.bitCount() * v.bitCount();
+	_primeparallel(list.size(), work, [&](u64 i) {
+		BIGNUM* n = list[i].getBytesOpenSSL();
+		BN_set_negative(n, 0);
+		result[i] = _primecandidate(n, safe, rounds, _primemix(seed + i), true) ? 1 : 0;
+		BN_free(n);
+		});
+}
+
+// Smallest (safe) prime >= start. Windows of odd candidates are sieved by the primes below 2^16
+// and the survivors tested in parallel batches; bases come from seed and the candidate's offset.
+GrapaInt GrapaPrime::NextPrime(const GrapaInt& start, u32 safe, u32 rounds, u64 seed)
+{
+	BIGNUM* n = start.getBytesOpenSSL();
+	if (BN_is_negative(n) || BN_num_bits(n) < 2)
+		BN_set_word(n, 2);
+	while (BN_num_bits(n) <= 32 && !_primecandidate(n, safe, rounds, seed, true))
+		BN_add_word(n, 1);
+	GrapaInt result;
+	if (BN_num_bits(n) <= 32)
+	{
+		result.setBytesOpenSSL(n);
+		BN_free(n);
+		return result;
+	}
+	if (!BN_is_odd(n))
+		BN_add_word(n, 1);
+	const GrapaPrimeTable& table = _primetable();
+	u64 batch = std::thread::hardware_concurrency() * 2;
+	if (batch < 2)
+		batch = 2;
+	std::vector<u8> composite(_primewindow_);
+	std::vector<u32> survivors;
+	std::vector<u8> pass;
+	for (u64 offset = 0; ; offset += 2 * _primewindow_)
+	{
+		memset(composite.data(), 0, composite.size());
+		// Candidate k is n + 2k; drop k when p divides it, or for safe primes when p divides (n+2k-1)/2.
+		for (u32 i = 1; i < table.mPrimes.size(); i++)
+		{
+			u64 p = table.mPrimes[i];
+			u64 r = BN_mod_word(n, (BN_ULONG)p);
+			u64 half = (p + 1) / 2;
+			for (u64 k = ((p - r) % p) * half % p; k < _primewindow_; k += p)
+				composite[k] = 1;
+			if (safe)
+				for (u64 k = ((p + 1 - r) % p) * half % p; k < _primewindow_; k += p)
+					composite[k] = 1;
+		}
+		survivors.clear();
+		bool mod4 = BN_is_bit_set(n, 1);
+		for (u32 k = 0; k < _primewindow_; k++)
+			if (!composite[k] && (!safe || (mod4 != ((k & 1) != 0))))
+				survivors.push_back(k);
+		for (u64 b = 0; b < survivors.size(); b += batch)
+		{
+			u64 count = survivors.size() - b;
+			if (count > batch)
+				count = batch;
+			pass.assign(count, 0);
+			_primeparallel(count, count * BN_num_bits(n) * BN_num_bits(n), [&](u64 j) {
+				BIGNUM* c = BN_dup(n);
+				BN_add_word(c, 2 * survivors[b + j]);
+				pass[j] = _primecandidate(c, safe, rounds, _primemix(seed + offset + 2 * survivors[b + j]), false) ? 1 : 0;
+				BN_free(c);
+				});
+			for (u64 j = 0; j < count; j++)
+			{
+				if (pass[j])
+				{
+					BN_add_word(n, 2 * survivors[b + j]);
+					result.setBytesOpenSSL(n);
+					BN_free(n);
+					return result;
+				}
+			}
+		}
+		BN_add_word(n, 2 * _primewindow_);
+	}
+}
+
+// Reproducible key generation: the start point is drawn from seed with the top two bits set,
+// then NextPrime finds the first prime above it.
+void GrapaPrime::GenPrime(u32 bits, u32 safe, u64 seed)
+{
+	if (bits < 2)
+		bits = 2;
+	std::vector<u8> raw(((bits + 63) / 64) * 8);
+	u64 key = _primemix(seed);
+	while (true)
+	{
+		for (u64 i = 0; i < raw.size(); i += 8)
+		{
+			key = _primemix(key);
+			memcpy(&raw[i], &key, 8);
+		}
+		BIGNUM* b = BN_bin2bn(raw.data(), (int)raw.size(), NULL);
+		BN_mask_bits(b, bits);
+		BN_set_bit(b, bits - 1);
+		BN_set_bit(b, bits - 2);
+		GrapaInt start;
+		start.setBytesOpenSSL(b);
+		BN_free(b);
+		GrapaInt p = NextPrime(start, safe, 64, key);
+		if (p.bitCount() == bits)
+		{
+			*this = p;
+			return;
+		}
+	}
+}
+
 //***********************************************************************
 // Generates a random number with the specified number of bits such
 // that gcd(number, this) = 1
@@ -7,7 +7,9 @@
 
 #include "GrapaInt.h"
 
-class GrapaPrime : public GrapaInt
+#include <vector>
+
+class GrapaPrime : public GrapaInt, public GrapaCritical
 {
 public:
 	u32 mBits;
@@ -28,6 +30,10 @@ public:
 
 public:
 	void GenPrime(u32 bits, u32 safe, const GrapaInt& randP, const GrapaInt& eP);
+	void GenPrime(u32 bits, u32 safe, u64 seed);
+	static void Sieve(u64 low, u64 high, std::vector<u64>& primes);
+	static void TestPrimes(const std::vector<GrapaInt>& list, std::vector<u8>& result, u32 safe, u32 rounds, u64 seed);
+	static GrapaInt NextPrime(const GrapaInt& start, u32 safe, u32 rounds, u64 seed);
 	bool TestPrime(u32 safe, u32 confidence) const;
 	bool AKS() const;
 public:
@@ -19,6 +19,7 @@ limitations under the License.
 #include "GrapaSystem.h"
 #include "GrapaLink.h"
 #include "GrapaTime.h"
+#include "GrapaFloat.h"
 #include <string>
 #include <algorithm>  // for std::max and std::min
 
@@ -50,6 +51,7 @@ extern GrapaSystem* gSystem;
 GrapaSystem::GrapaSystem()
 {
 	RandSeed();
+	GrapaFloat::PrecomputeConstants(16 * 8, 10);
 #ifdef WIN32
 	mStdinRef = GetStdHandle(STD_INPUT_HANDLE);
 	GetConsoleMode(mStdinRef, &mStdinMode);
@@ -106,6 +108,8 @@ GrapaSystem::GrapaSystem()
 	mStaticLib = NULL;
 	mArgv = new GrapaRuleQueue();
 	mLinkInitialized = false;
+	mFileMap = false;
+	mFileLog = false;
 }
 
 GrapaSystem::~GrapaSystem()
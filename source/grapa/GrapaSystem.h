@@ -158,6 +158,8 @@ class GrapaSystem
 {
 public:
 	bool mStop, mLinkInitialized;
+	bool mFileMap;
+	bool mFileLog;
 	GrapaCHAR mBinName, mBinDir, mWorkDir, mLibDir, mHomeDir, mTempDir, mGrammar;
 	GrapaRuleQueue *mPath;
 	GrapaCHAR mVersion;
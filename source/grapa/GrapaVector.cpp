@@ -38,639 +38,2082 @@ extern GrapaSystem* gSystem;
 #define _maxvectorblock_ 62
 #define _datavectorpos(bd,bs,bp) ((GrapaVectorItem*)&((u8*)bd)[bs*bp])
 
-///////////////////////////////////////////////////////////////////////////////////////////////////
+// FLOAT64 and INT64 vectors hold mSize 8 byte values row-major in mNative instead of
+// GrapaVectorItem cells. The kernels below run over those buffers. AVX2 is selected at
+// runtime where the compiler can target it per function, SSE2 otherwise, then plain loops.
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define _vectorsse2_
+#include <emmintrin.h>
+#if defined(__AVX2__) || defined(__GNUC__) || defined(__clang__)
+#define _vectoravx2_
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(_vectoravx2_) && !defined(__AVX2__)
+#define _vectoravx2target_ __attribute__((target("avx2")))
+#else
+#define _vectoravx2target_
+#endif
+
+static bool _vectorhasavx2()
+{
+#if defined(__AVX2__)
+	return true;
+#elif defined(_vectoravx2_)
+	static int has = -1;
+	if (has < 0)
+		has = __builtin_cpu_supports("avx2") ? 1 : 0;
+	return has == 1;
+#else
+	return false;
+#endif
+}
 
-GrapaVectorBYTE::GrapaVectorBYTE(const GrapaBYTE& b)
+#ifdef _vectoravx2_
+_vectoravx2target_ static u64 _vectorf64avx2(u8 pOp, const d64* a, const d64* b, bool bs, d64* r, u64 n)
 {
-	mBytes = NULL;
-	mLength = 0;
-	mToken = 0;
-	if (b.mBytes && b.mLength)
+	u64 i = 0;
+	__m256d vb = _mm256_set1_pd(b[0]);
+#define _vectorloop(f) for (; i + 4 <= n; i += 4) _mm256_storeu_pd(r + i, f(_mm256_loadu_pd(a + i), bs ? vb : _mm256_loadu_pd(b + i)))
+	switch (pOp)
 	{
-		mBytes = (u8*)GrapaMem::Create(b.mLength + 1);
-		memcpy(mBytes, b.mBytes, b.mLength);
-		mBytes[b.mLength] = 0;
-		mLength = b.mLength;
-		mToken = b.mToken;
-	};
-};
+	case GrapaVectorOp::ADD: _vectorloop(_mm256_add_pd); break;
+	case GrapaVectorOp::SUB: _vectorloop(_mm256_sub_pd); break;
+	case GrapaVectorOp::MUL: _vectorloop(_mm256_mul_pd); break;
+	case GrapaVectorOp::DIV: _vectorloop(_mm256_div_pd); break;
+	}
+#undef _vectorloop
+	return i;
+}
 
-GrapaVectorBYTE::GrapaVectorBYTE(const GrapaVectorBYTE& b)
+// Integer lanes wrap, so each kernel also keeps the sign bits of (x^s)&(y^s) for ADD and
+// (x^y)&(x^s) for SUB, which are set where the exact result did not fit.
+_vectoravx2target_ static u64 _vectors64avx2(u8 pOp, const s64* a, const s64* b, bool bs, s64* r, u64 n, bool& pOverflow)
 {
-	mBytes = NULL;
-	mLength = 0;
-	mToken = 0;
-	if (b.mBytes && b.mLength)
+	u64 i = 0;
+	__m256i vb = _mm256_set1_epi64x(b[0]);
+	__m256i of = _mm256_setzero_si256();
+	bool add = pOp == GrapaVectorOp::ADD;
+	for (; i + 4 <= n; i += 4)
 	{
-		mBytes = (u8*)GrapaMem::Create(b.mLength + 1);
-		memcpy(mBytes, b.mBytes, b.mLength);
-		mBytes[b.mLength] = 0;
-		mLength = b.mLength;
-		mToken = b.mToken;
-	};
-};
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i y = bs ? vb : _mm256_loadu_si256((const __m256i*)(b + i));
+		__m256i s = add ? _mm256_add_epi64(x, y) : _mm256_sub_epi64(x, y);
+		_mm256_storeu_si256((__m256i*)(r + i), s);
+		of = _mm256_or_si256(of, _mm256_and_si256(_mm256_xor_si256(x, s), _mm256_xor_si256(add ? y : x, add ? s : y)));
+	}
+	pOverflow = _mm256_movemask_pd(_mm256_castsi256_pd(of)) != 0;
+	return i;
+}
 
-GrapaVectorBYTE::~GrapaVectorBYTE()
+_vectoravx2target_ static u64 _vectorf64cmpavx2(u8 pOp, const d64* a, const d64* b, bool bs, s64* r, u64 n)
 {
-	CLEAR();
-};
+	u64 i = 0;
+	__m256d vb = _mm256_set1_pd(b[0]);
+	__m256i one = _mm256_set1_epi64x(1);
+#define _vectorloop(c) for (; i + 4 <= n; i += 4) _mm256_storeu_si256((__m256i*)(r + i), _mm256_and_si256(_mm256_castpd_si256(_mm256_cmp_pd(_mm256_loadu_pd(a + i), bs ? vb : _mm256_loadu_pd(b + i), c)), one))
+	switch (pOp)
+	{
+	case GrapaVectorOp::GT: _vectorloop(_CMP_GT_OQ); break;
+	case GrapaVectorOp::GTEQ: _vectorloop(_CMP_GE_OQ); break;
+	case GrapaVectorOp::LT: _vectorloop(_CMP_LT_OQ); break;
+	case GrapaVectorOp::LTEQ: _vectorloop(_CMP_LE_OQ); break;
+	}
+#undef _vectorloop
+	return i;
+}
 
-void GrapaVectorBYTE::CLEAR()
+_vectoravx2target_ static u64 _vectors64cmpavx2(u8 pOp, const s64* a, const s64* b, bool bs, s64* r, u64 n)
 {
-	if (mBytes) GrapaMem::Delete(mBytes);
-	mBytes = NULL;
-	mLength = 0;
-	mToken = 0;
-};
+	u64 i = 0;
+	__m256i vb = _mm256_set1_epi64x(b[0]);
+	__m256i one = _mm256_set1_epi64x(1);
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i y = bs ? vb : _mm256_loadu_si256((const __m256i*)(b + i));
+		__m256i m;
+		switch (pOp)
+		{
+		case GrapaVectorOp::GT: m = _mm256_and_si256(_mm256_cmpgt_epi64(x, y), one); break;
+		case GrapaVectorOp::GTEQ: m = _mm256_andnot_si256(_mm256_cmpgt_epi64(y, x), one); break;
+		case GrapaVectorOp::LT: m = _mm256_and_si256(_mm256_cmpgt_epi64(y, x), one); break;
+		default: m = _mm256_andnot_si256(_mm256_cmpgt_epi64(x, y), one); break;
+		}
+		_mm256_storeu_si256((__m256i*)(r + i), m);
+	}
+	return i;
+}
 
-GrapaBYTE GrapaVectorBYTE::Get()
+_vectoravx2target_ static u64 _vectorf64sumavx2(const d64* a, u64 n, d64& sum)
 {
-	if (mBytes && mLength)
+	u64 i = 0;
+	__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+	for (; i + 8 <= n; i += 8)
 	{
-		GrapaBYTE v(mBytes, mLength);
-		v.mToken = mToken;
-		return(v);
+		s0 = _mm256_add_pd(s0, _mm256_loadu_pd(a + i));
+		s1 = _mm256_add_pd(s1, _mm256_loadu_pd(a + i + 4));
 	}
-	return GrapaBYTE();
-};
+	d64 t[4];
+	_mm256_storeu_pd(t, _mm256_add_pd(s0, s1));
+	sum = (t[0] + t[1]) + (t[2] + t[3]);
+	return i;
+}
 
-GrapaVectorValue::~GrapaVectorValue()
+// Leaves the four lane sums in t; pOverflow is set when a lane did not fit.
+_vectoravx2target_ static u64 _vectors64sumavx2(const s64* a, u64 n, s64* t, bool& pOverflow)
 {
-	CLEAR();
-};
+	u64 i = 0;
+	__m256i s0 = _mm256_setzero_si256();
+	__m256i of = _mm256_setzero_si256();
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i s = _mm256_add_epi64(s0, x);
+		of = _mm256_or_si256(of, _mm256_and_si256(_mm256_xor_si256(s0, s), _mm256_xor_si256(x, s)));
+		s0 = s;
+	}
+	_mm256_storeu_si256((__m256i*)t, s0);
+	pOverflow = _mm256_movemask_pd(_mm256_castsi256_pd(of)) != 0;
+	return i;
+}
 
-void GrapaVectorValue::CLEAR()
+_vectoravx2target_ static u64 _vectortransposeavx2(const d64* a, d64* r, u64 rows, u64 cols, u64 i, u64 j, u64 je)
 {
-	if (isRaw)
+	for (; j + 4 <= je; j += 4)
 	{
-		if (b)
-		{
-			b->CLEAR();
-			delete b;
-		}
-		b = NULL;
+		__m256d r0 = _mm256_loadu_pd(a + (i + 0) * cols + j);
+		__m256d r1 = _mm256_loadu_pd(a + (i + 1) * cols + j);
+		__m256d r2 = _mm256_loadu_pd(a + (i + 2) * cols + j);
+		__m256d r3 = _mm256_loadu_pd(a + (i + 3) * cols + j);
+		__m256d t0 = _mm256_unpacklo_pd(r0, r1);
+		__m256d t1 = _mm256_unpackhi_pd(r0, r1);
+		__m256d t2 = _mm256_unpacklo_pd(r2, r3);
+		__m256d t3 = _mm256_unpackhi_pd(r2, r3);
+		_mm256_storeu_pd(r + (j + 0) * rows + i, _mm256_permute2f128_pd(t0, t2, 0x20));
+		_mm256_storeu_pd(r + (j + 1) * rows + i, _mm256_permute2f128_pd(t1, t3, 0x20));
+		_mm256_storeu_pd(r + (j + 2) * rows + i, _mm256_permute2f128_pd(t0, t2, 0x31));
+		_mm256_storeu_pd(r + (j + 3) * rows + i, _mm256_permute2f128_pd(t1, t3, 0x31));
 	}
-	else if (e)
+	return j;
+}
+
+_vectoravx2target_ static u64 _vectorf64axpyavx2(d64 s, const d64* b, d64* c, u64 n)
+{
+	u64 j = 0;
+	__m256d vs = _mm256_set1_pd(s);
+	for (; j + 8 <= n; j += 8)
 	{
-		e->CLEAR();
-		delete e;
-	};
-	isRaw = 0;
-	e = NULL;
-};
+		_mm256_storeu_pd(c + j, _mm256_add_pd(_mm256_loadu_pd(c + j), _mm256_mul_pd(vs, _mm256_loadu_pd(b + j))));
+		_mm256_storeu_pd(c + j + 4, _mm256_add_pd(_mm256_loadu_pd(c + j + 4), _mm256_mul_pd(vs, _mm256_loadu_pd(b + j + 4))));
+	}
+	for (; j + 4 <= n; j += 4)
+		_mm256_storeu_pd(c + j, _mm256_add_pd(_mm256_loadu_pd(c + j), _mm256_mul_pd(vs, _mm256_loadu_pd(b + j))));
+	return j;
+}
 
-void GrapaVectorValue::Set(GrapaRuleEvent* v)
+_vectoravx2target_ static u64 _vectorf64dotavx2(const d64* a, const d64* b, u64 n, d64& sum)
 {
-	CLEAR();
-	if (v)
+	u64 i = 0;
+	__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+	for (; i + 8 <= n; i += 8)
 	{
-		switch (v->mValue.mToken) {
-		case GrapaTokenType::STR:
-		case GrapaTokenType::INT:
-		case GrapaTokenType::FLOAT: 
-			b = new GrapaVectorBYTE(v->mValue);
-			isRaw = 1;
-			break;
-		default: 
-			e = GrapaScriptExec::CopyItem(v);
-			isRaw = 0;
-			break;
-		};
-	};
-};
+		s0 = _mm256_add_pd(s0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+		s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+	}
+	d64 t[4];
+	_mm256_storeu_pd(t, _mm256_add_pd(s0, s1));
+	sum = (t[0] + t[1]) + (t[2] + t[3]);
+	return i;
+}
 
-void GrapaVectorValue::Set(GrapaVectorValue* v)
+_vectoravx2target_ static u64 _vectorf64boundsavx2(const d64* a, u64 n, d64& pMin, d64& pMax)
 {
-	CLEAR();
-	if (v)
+	u64 i = 0;
+	__m256d lo = _mm256_set1_pd(pMin), hi = _mm256_set1_pd(pMax);
+	for (; i + 4 <= n; i += 4)
 	{
-		if (v->isRaw)
-			b = new GrapaVectorBYTE(*v->b);
-		else
-			e = GrapaScriptExec::CopyItem(v->e);
-		isRaw = v->isRaw;
-	};
-};
+		__m256d x = _mm256_loadu_pd(a + i);
+		lo = _mm256_min_pd(lo, x);
+		hi = _mm256_max_pd(hi, x);
+	}
+	d64 t[4], u[4];
+	_mm256_storeu_pd(t, lo);
+	_mm256_storeu_pd(u, hi);
+	for (int k = 0; k < 4; k++)
+	{
+		if (t[k] < pMin) pMin = t[k];
+		if (u[k] > pMax) pMax = u[k];
+	}
+	return i;
+}
 
-void GrapaVectorValue::Set(GrapaFloat* v)
+_vectoravx2target_ static u64 _vectors64boundsavx2(const s64* a, u64 n, s64& pMin, s64& pMax)
 {
-	CLEAR();
-	if (v)
+	u64 i = 0;
+	__m256i lo = _mm256_set1_epi64x(pMin), hi = _mm256_set1_epi64x(pMax);
+	for (; i + 4 <= n; i += 4)
 	{
-		b = new GrapaVectorBYTE(v->getBytes());
-		isRaw = 1;
-	};
-};
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		lo = _mm256_blendv_epi8(lo, x, _mm256_cmpgt_epi64(lo, x));
+		hi = _mm256_blendv_epi8(hi, x, _mm256_cmpgt_epi64(x, hi));
+	}
+	s64 t[4], u[4];
+	_mm256_storeu_si256((__m256i*)t, lo);
+	_mm256_storeu_si256((__m256i*)u, hi);
+	for (int k = 0; k < 4; k++)
+	{
+		if (t[k] < pMin) pMin = t[k];
+		if (u[k] > pMax) pMax = u[k];
+	}
+	return i;
+}
+#endif
 
-void GrapaVectorValue::Set(GrapaInt* v)
+#ifdef _vectorsse2_
+static u64 _vectorf64sse2(u8 pOp, const d64* a, const d64* b, bool bs, d64* r, u64 n)
 {
-	CLEAR();
-	if (v)
+	u64 i = 0;
+	__m128d vb = _mm_set1_pd(b[0]);
+#define _vectorloop(f) for (; i + 2 <= n; i += 2) _mm_storeu_pd(r + i, f(_mm_loadu_pd(a + i), bs ? vb : _mm_loadu_pd(b + i)))
+	switch (pOp)
 	{
-		b = new GrapaVectorBYTE(v->getBytes());
-		isRaw = 1;
-	};
-};
+	case GrapaVectorOp::ADD: _vectorloop(_mm_add_pd); break;
+	case GrapaVectorOp::SUB: _vectorloop(_mm_sub_pd); break;
+	case GrapaVectorOp::MUL: _vectorloop(_mm_mul_pd); break;
+	case GrapaVectorOp::DIV: _vectorloop(_mm_div_pd); break;
+	}
+#undef _vectorloop
+	return i;
+}
 
-void GrapaVectorValue::Set(GrapaBYTE* v)
+static u64 _vectors64sse2(u8 pOp, const s64* a, const s64* b, bool bs, s64* r, u64 n, bool& pOverflow)
 {
-	CLEAR();
-	if (v)
+	u64 i = 0;
+	__m128i vb = _mm_set1_epi64x(b[0]);
+	__m128i of = _mm_setzero_si128();
+	bool add = pOp == GrapaVectorOp::ADD;
+	for (; i + 2 <= n; i += 2)
 	{
-		b = new GrapaVectorBYTE(*v);
-		isRaw = 1;
-	};
-};
+		__m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i y = bs ? vb : _mm_loadu_si128((const __m128i*)(b + i));
+		__m128i s = add ? _mm_add_epi64(x, y) : _mm_sub_epi64(x, y);
+		_mm_storeu_si128((__m128i*)(r + i), s);
+		of = _mm_or_si128(of, _mm_and_si128(_mm_xor_si128(x, s), _mm_xor_si128(add ? y : x, add ? s : y)));
+	}
+	pOverflow = _mm_movemask_pd(_mm_castsi128_pd(of)) != 0;
+	return i;
+}
 
-GrapaRuleEvent* GrapaVectorValue::Get()
+static u64 _vectorf64cmpsse2(u8 pOp, const d64* a, const d64* b, bool bs, s64* r, u64 n)
 {
-	GrapaRuleEvent* result = NULL;
-	if (e)
+	u64 i = 0;
+	__m128d vb = _mm_set1_pd(b[0]);
+	__m128i one = _mm_set1_epi64x(1);
+#define _vectorloop(f) for (; i + 2 <= n; i += 2) _mm_storeu_si128((__m128i*)(r + i), _mm_and_si128(_mm_castpd_si128(f(_mm_loadu_pd(a + i), bs ? vb : _mm_loadu_pd(b + i))), one))
+	switch (pOp)
 	{
-		if (isRaw)
-			result = new GrapaRuleEvent(0, GrapaCHAR(""), b->Get());
-		else
-			result = GrapaScriptExec::CopyItem(e);
-	};
-	return(result);
-};
+	case GrapaVectorOp::GT: _vectorloop(_mm_cmpgt_pd); break;
+	case GrapaVectorOp::GTEQ: _vectorloop(_mm_cmpge_pd); break;
+	case GrapaVectorOp::LT: _vectorloop(_mm_cmplt_pd); break;
+	case GrapaVectorOp::LTEQ: _vectorloop(_mm_cmple_pd); break;
+	}
+#undef _vectorloop
+	return i;
+}
 
-///////////////////////////////////////////////////////////////////////////////////////////////////
+static u64 _vectorf64sumsse2(const d64* a, u64 n, d64& sum)
+{
+	u64 i = 0;
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+	for (; i + 4 <= n; i += 4)
+	{
+		s0 = _mm_add_pd(s0, _mm_loadu_pd(a + i));
+		s1 = _mm_add_pd(s1, _mm_loadu_pd(a + i + 2));
+	}
+	d64 t[2];
+	_mm_storeu_pd(t, _mm_add_pd(s0, s1));
+	sum = t[0] + t[1];
+	return i;
+}
 
-GrapaVector::GrapaVector()
+static u64 _vectors64sumsse2(const s64* a, u64 n, s64* t, bool& pOverflow)
 {
-	mData = NULL;
-	mCounts = NULL;
-	mSize = 0;
-	mDim = 0;
-	mBlock = _minvectorblock_;
-	mMaxBlock = _minvectordatablock_;
-	mSetBlock = 0;
+	u64 i = 0;
+	__m128i s0 = _mm_setzero_si128();
+	__m128i of = _mm_setzero_si128();
+	for (; i + 2 <= n; i += 2)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i s = _mm_add_epi64(s0, x);
+		of = _mm_or_si128(of, _mm_and_si128(_mm_xor_si128(s0, s), _mm_xor_si128(x, s)));
+		s0 = s;
+	}
+	_mm_storeu_si128((__m128i*)t, s0);
+	t[2] = t[3] = 0;
+	pOverflow = _mm_movemask_pd(_mm_castsi128_pd(of)) != 0;
+	return i;
 }
 
-static u64* _scanvectordepth(GrapaRuleEvent* value, u8 pos, u8& dim, u8 maxDim, u64 size, u64& tot)
+static u64 _vectortransposesse2(const d64* a, d64* r, u64 rows, u64 cols, u64 i, u64 j, u64 je)
 {
-	if (maxDim && pos == maxDim) return(NULL);
-	if (value == NULL || value->vQueue == NULL) return(NULL);
-	if ((value->mValue.mToken != GrapaTokenType::ARRAY && value->mValue.mToken != GrapaTokenType::TUPLE) && (pos!=1 || value->mValue.mToken != GrapaTokenType::LIST)) return(NULL);
-	u64* counts = _scanvectordepth(value->vQueue->Head(), pos+1, dim, maxDim, size* value->vQueue->mCount, tot);
-	if (counts == NULL)
+	for (; j + 2 <= je; j += 2)
 	{
-		dim = pos+1;
-		tot = size* value->vQueue->mCount;
-		counts = (u64*)GrapaMem::Create(dim * sizeof(u64));
-		memset(counts,0, dim * sizeof(u64));
+		__m128d r0 = _mm_loadu_pd(a + (i + 0) * cols + j);
+		__m128d r1 = _mm_loadu_pd(a + (i + 1) * cols + j);
+		_mm_storeu_pd(r + (j + 0) * rows + i, _mm_unpacklo_pd(r0, r1));
+		_mm_storeu_pd(r + (j + 1) * rows + i, _mm_unpackhi_pd(r0, r1));
 	}
-	counts[pos] = value->vQueue->mCount;
-	return(counts);
+	return j;
 }
 
-bool GrapaVector::_scanvectorcreate(GrapaRuleEvent* value, u8 pos, u8 dim, u64* counts, GrapaVectorItem* data, u8 block, u64& p, u8& maxblock)
+static u64 _vectorf64axpysse2(d64 s, const d64* b, d64* c, u64 n)
+{
+	u64 j = 0;
+	__m128d vs = _mm_set1_pd(s);
+	for (; j + 2 <= n; j += 2)
+		_mm_storeu_pd(c + j, _mm_add_pd(_mm_loadu_pd(c + j), _mm_mul_pd(vs, _mm_loadu_pd(b + j))));
+	return j;
+}
+
+static u64 _vectorf64dotsse2(const d64* a, const d64* b, u64 n, d64& sum)
 {
-	if (value == NULL || value->vQueue == NULL) return(false);
-	if ((value->mValue.mToken != GrapaTokenType::ARRAY && value->mValue.mToken != GrapaTokenType::TUPLE) && (pos != 1 || value->mValue.mToken != GrapaTokenType::LIST)) return(false);
-	bool hasLabels = (mLabels.mCount == 0 && pos == 1 && value->mValue.mToken == GrapaTokenType::LIST);
-	GrapaInt b;
 	u64 i = 0;
-	GrapaCHAR nullval;
-	nullval.SetNull();
-	value = value->vQueue->Head();
-	bool hasBlankHeader = true;
-	while (value)
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+	for (; i + 4 <= n; i += 4)
 	{
-		if ((pos + 1) < dim)
-		{
-			if (counts[pos+1] != value->vQueue->mCount) return(false);
-			if (!_scanvectorcreate(value, pos + 1, dim, counts, data, block, p, maxblock)) return(false);
-		}
+		s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+		s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+	}
+	d64 t[2];
+	_mm_storeu_pd(t, _mm_add_pd(s0, s1));
+	sum = t[0] + t[1];
+	return i;
+}
+
+static u64 _vectorf64boundssse2(const d64* a, u64 n, d64& pMin, d64& pMax)
+{
+	u64 i = 0;
+	__m128d lo = _mm_set1_pd(pMin), hi = _mm_set1_pd(pMax);
+	for (; i + 2 <= n; i += 2)
+	{
+		__m128d x = _mm_loadu_pd(a + i);
+		lo = _mm_min_pd(lo, x);
+		hi = _mm_max_pd(hi, x);
+	}
+	d64 t[2], u[2];
+	_mm_storeu_pd(t, lo);
+	_mm_storeu_pd(u, hi);
+	for (int k = 0; k < 2; k++)
+	{
+		if (t[k] < pMin) pMin = t[k];
+		if (u[k] > pMax) pMax = u[k];
+	}
+	return i;
+}
+#endif
+
+static void _vectorf64op(u8 pOp, const d64* a, const d64* b, bool bs, d64* r, u64 n)
+{
+	u64 i = 0;
+	if (pOp <= GrapaVectorOp::DIV)
+	{
+#ifdef _vectoravx2_
+		if (_vectorhasavx2())
+			i = _vectorf64avx2(pOp, a, b, bs, r, n);
 		else
+#endif
+#ifdef _vectorsse2_
+			i = _vectorf64sse2(pOp, a, b, bs, r, n);
+#endif
+	}
+	for (; i < n; i++)
+	{
+		d64 x = a[i], y = bs ? b[0] : b[i];
+		switch (pOp)
 		{
-			if (hasBlankHeader && hasLabels)
-			{
-				bool isInt = true;
-				bool isFloat = false;
-				for (u64 j = 0; j < value->mName.mLength; j++)
-				{
-					if (!isdigit(value->mName.mBytes[j]))
-					{
-						if (value->mName.mBytes[j] == '.' && !isFloat)
-						{
-							isFloat = true;
-							isInt = false;
-						}
-						else
-						{
-							isInt = isFloat = false;
-							break;
-						}
-					}
-				}
-				if (isInt)
-				{
-					GrapaInt y;
-					y.FromString(value->mName, 10);
-					s64 lv = y.LongValue();
-					if (lv != i)
-						hasBlankHeader = false;
-				}
-				else
-					hasBlankHeader = false;
-			}
-			if (hasLabels)
-				mLabels.PushTail(new GrapaRuleEvent(0, value->mName, nullval));
-			GrapaVectorItem *d1 = _datavectorpos(data, block, p);
-			if (value->IsNull())
-			{
-				d1->isValue = 0;
-				d1->isNull = 1;
-				d1->mLen = 0;
-				d1->mToken = 0;
-			}
-			else
-			{
-				bool handled = false;
-				switch (value->mValue.mToken)
-				{
-				case GrapaTokenType::INT:
-				case GrapaTokenType::FLOAT:
-				case GrapaTokenType::STR:
-					if ((value->mValue.mLength + _minvectorheadblock_) <= block)
-					{
-						d1->isValue = 0;
-						d1->isNull = 0;
-						d1->mLen = value->mValue.mLength;
-						d1->mToken = value->mValue.mToken;
-						memcpy(d1->d, value->mValue.mBytes, value->mValue.mLength);
-						handled = true;
-					}
-					else if (value->mValue.mToken == GrapaTokenType::INT || value->mValue.mToken == GrapaTokenType::FLOAT)
-					{
-						if (value->mValue.mLength > maxblock)
-							maxblock = (u8)value->mValue.mLength;
-					}
-					break;
-				}
-				if (!handled)
-				{
-					d1->isValue = 1;
-					d1->isNull = 0;
-					d1->mLen = 0;
-					d1->mToken = 0;
-					GrapaVectorValue* d = new GrapaVectorValue(value);
-					memcpy(d1->d, &d, sizeof(GrapaVectorValue*));
-				}
-			}
-			p++;
+		case GrapaVectorOp::ADD: r[i] = x + y; break;
+		case GrapaVectorOp::SUB: r[i] = x - y; break;
+		case GrapaVectorOp::MUL: r[i] = x * y; break;
+		case GrapaVectorOp::DIV: r[i] = x / y; break;
+		case GrapaVectorOp::POW: r[i] = pow(x, y); break;
+		case GrapaVectorOp::ROOT: r[i] = pow(x, 1.0 / y); break;
 		}
-		value = value->Next();
-		i++;
 	}
-	if (hasBlankHeader && hasLabels)
-		mLabels.CLEAR();
-	return(true);
 }
 
-GrapaVector::GrapaVector(const GrapaVector& bi, u8 pBlock)
+// Checked int64 arithmetic. Each returns false when the exact result does not fit in r.
+static bool _vectors64add(s64 x, s64 y, s64& r)
 {
-	mData = NULL;
-	mCounts = NULL;
-	mSize = 0;
-	mDim = 0;
-	mBlock = _minvectorblock_;
-	mMaxBlock = _minvectordatablock_;
-	mSetBlock = 0;
-	FROM(bi, pBlock);
+#if defined(__GNUC__) || defined(__clang__)
+	return !__builtin_add_overflow(x, y, &r);
+#else
+	r = (s64)((u64)x + (u64)y);
+	return ((x ^ r) & (y ^ r)) >= 0;
+#endif
 }
 
-GrapaVector::~GrapaVector()
+static bool _vectors64sub(s64 x, s64 y, s64& r)
 {
-	CLEAR();
+#if defined(__GNUC__) || defined(__clang__)
+	return !__builtin_sub_overflow(x, y, &r);
+#else
+	r = (s64)((u64)x - (u64)y);
+	return ((x ^ y) & (x ^ r)) >= 0;
+#endif
 }
 
-void GrapaVector::CLEAR()
+static bool _vectors64mul(s64 x, s64 y, s64& r)
 {
-	if (mData && mSize)
-		for (u64 i = 0; i < mSize; i++)
-		{
-			GrapaVectorItem* d1 = _datavectorpos(mData, mBlock, i);
-			if (d1->isValue)
-			{
-				GrapaVectorValue* d = 0L;
-				memcpy(&d, d1->d, sizeof(GrapaVectorValue*));
-				d1->isValue = 0;
-				d1->isNull = 0;
-				d1->mLen = 0;
-				d1->mToken = 0;
-				if (d)
-				{
-					d->CLEAR();
-					delete d;
-				}
-			}
-		}
-	if (mData)
-		GrapaMem::Delete(mData);
-	mData = NULL;
-	if (mCounts)
-		GrapaMem::Delete(mCounts);
-	mCounts = NULL;
-	mSize = 0;
-	mDim = 0;
-	mBlock = _minvectorblock_;
-	mMaxBlock = _minvectordatablock_;
-	mLabels.CLEAR();
-	// mSetBlock = 0;
+#if defined(__GNUC__) || defined(__clang__)
+	return !__builtin_mul_overflow(x, y, &r);
+#else
+	d64 t = (d64)x * (d64)y;
+	if (t >= 9.2e18 || t <= -9.2e18)
+		return false;
+	r = x * y;
+	return true;
+#endif
 }
 
-bool GrapaVector::FROM(const GrapaVector& pData, u8 pBlock)
+// y is not negative; negative powers run in float64. The base is only squared while bits of y
+// remain, so 2^62 does not overflow on a square it never uses.
+static bool _vectors64pow(s64 x, s64 y, s64& r)
 {
-	CLEAR();
-	if (pBlock)
+	r = 1;
+	while (y > 0)
 	{
-		mSetBlock = pBlock;
-		if (mSetBlock % 2) mSetBlock++;
-		mSetBlock += _minvectorblock_ - _minvectordatablock_;
+		if ((y & 1) && !_vectors64mul(r, x, r))
+			return false;
+		y >>= 1;
+		if (y && !_vectors64mul(x, x, x))
+			return false;
 	}
-	mDim = pData.mDim;
-	mBlock = pData.mBlock;
-	mMaxBlock = _minvectordatablock_;
-	if (mSetBlock >= _minvectorblock_ && mSetBlock <= _maxvectorblock_) 
-		mBlock = mSetBlock;
-	if (mSetBlock == 0 && (pData.mMaxBlock + _minvectorheadblock_) > mBlock)
-		mBlock = (pData.mMaxBlock + _minvectorheadblock_) < _maxvectorblock_ ? (pData.mMaxBlock + _minvectorheadblock_) : _maxvectorblock_;
-	if (mBlock % 2) mBlock++;
-	mSize = pData.mSize;
-	if (pData.mCounts)
+	return true;
+}
+
+// Returns false when any result overflows int64, leaving the caller to redo the op in float64.
+static bool _vectors64op(u8 pOp, const s64* a, const s64* b, bool bs, s64* r, u64 n)
+{
+	u64 i = 0;
+	bool overflow = false;
+	if (pOp <= GrapaVectorOp::SUB)
 	{
-		mCounts = (u64*)GrapaMem::Create(sizeof(u64) * mDim);
-		memcpy(mCounts, pData.mCounts, mDim * sizeof(u64));
+#ifdef _vectoravx2_
+		if (_vectorhasavx2())
+			i = _vectors64avx2(pOp, a, b, bs, r, n, overflow);
+		else
+#endif
+#ifdef _vectorsse2_
+			i = _vectors64sse2(pOp, a, b, bs, r, n, overflow);
+#endif
 	}
-	if (pData.mData)
+	for (; i < n && !overflow; i++)
 	{
-		mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
-		memset(mData, 0, mBlock * mSize);
-		GrapaVectorItem* d1, * d2;
-		for (u64 i = 0; i < mSize; i++)
+		s64 x = a[i], y = bs ? b[0] : b[i];
+		switch (pOp)
 		{
-			d1 = _datavectorpos(mData, mBlock, i);
-			d2 = _datavectorpos(pData.mData, pData.mBlock, i);
-			d1->isNull = d2->isNull;
-			if (!d1->isNull)
-			{
-				d1->isValue = d2->isValue;
-				d1->mLen = d2->mLen;
-				d1->mToken = d2->mToken;
-				if (d2->isValue)
-				{
-					GrapaVectorValue* d = 0L;
-					memcpy(&d, d2->d, sizeof(GrapaVectorValue*));
-					if (d)
-					{
-						d = new GrapaVectorValue(d);
-						memcpy(d1->d, &d, sizeof(GrapaVectorValue*));
-					}
-				}
-				else
-				{
-					if (mBlock >= d2->mLen)
-						memcpy(d1->d, d2->d, d2->mLen);
-					else
-					{
-						d1->isValue = 1;
-						GrapaBYTE v(d2->d, d2->mLen);
-						v.mToken = d2->mToken;
-						GrapaVectorValue* d = new GrapaVectorValue(&v);
-						memcpy(d1->d, &d, sizeof(GrapaVectorValue*));
-					}
-				}
-			}
+		case GrapaVectorOp::ADD: overflow = !_vectors64add(x, y, r[i]); break;
+		case GrapaVectorOp::SUB: overflow = !_vectors64sub(x, y, r[i]); break;
+		case GrapaVectorOp::MUL: overflow = !_vectors64mul(x, y, r[i]); break;
+		case GrapaVectorOp::POW: overflow = !_vectors64pow(x, y, r[i]); break;
 		}
 	}
-	GrapaRuleEvent* ev = ((GrapaVector*)&pData)->mLabels.Head();
-	while (ev)
-	{
-		mLabels.PushTail(new GrapaRuleEvent(0,ev->mName,ev->mValue));
-		ev = ev->Next();
-	}
-	return(true);
+	return !overflow;
 }
 
-bool GrapaVector::FROM(bool pFix, s64 pMax, s64 pExtra, GrapaRuleEvent* value, u8 pDim, u8 pBlock)
+static void _vectorf64cmp(u8 pOp, const d64* a, const d64* b, bool bs, s64* r, u64 n)
 {
-	CLEAR();
-	if (pBlock)
-	{
-		mSetBlock = pBlock;
-		if (mSetBlock % 2) mSetBlock++;
-		mSetBlock += _minvectorblock_ - _minvectordatablock_;
-	}
-	if (mSetBlock >= _minvectorblock_ && mSetBlock <= _maxvectorblock_) mBlock = mSetBlock;
-	if (value == NULL || value->vQueue == NULL || value->vQueue->mCount == 0)
+	u64 i = 0;
+#ifdef _vectoravx2_
+	if (_vectorhasavx2())
+		i = _vectorf64cmpavx2(pOp, a, b, bs, r, n);
+	else
+#endif
+#ifdef _vectorsse2_
+		i = _vectorf64cmpsse2(pOp, a, b, bs, r, n);
+#endif
+	for (; i < n; i++)
 	{
-		mDim = 1;
-		mSize = 0;
-		mCounts = (u64*)GrapaMem::Create(mDim * sizeof(u64));
-		mCounts[0] = 0;
-		mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
+		d64 x = a[i], y = bs ? b[0] : b[i];
+		switch (pOp)
+		{
+		case GrapaVectorOp::GT: r[i] = x > y; break;
+		case GrapaVectorOp::GTEQ: r[i] = x >= y; break;
+		case GrapaVectorOp::LT: r[i] = x < y; break;
+		case GrapaVectorOp::LTEQ: r[i] = x <= y; break;
+		}
 	}
-	else
+}
+
+static void _vectors64cmp(u8 pOp, const s64* a, const s64* b, bool bs, s64* r, u64 n)
+{
+	u64 i = 0;
+#ifdef _vectoravx2_
+	if (_vectorhasavx2())
+		i = _vectors64cmpavx2(pOp, a, b, bs, r, n);
+#endif
+	for (; i < n; i++)
 	{
-		mCounts = _scanvectordepth(value, 0, mDim, pDim, 1, mSize);
-		mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
-		memset(mData, 0, mBlock * mSize);
-		u64 p = 0;
-		if (!_scanvectorcreate(value, 0, mDim, mCounts, mData, mBlock, p, mMaxBlock))
+		s64 x = a[i], y = bs ? b[0] : b[i];
+		switch (pOp)
 		{
-			CLEAR();
-			return(false);
+		case GrapaVectorOp::GT: r[i] = x > y; break;
+		case GrapaVectorOp::GTEQ: r[i] = x >= y; break;
+		case GrapaVectorOp::LT: r[i] = x < y; break;
+		case GrapaVectorOp::LTEQ: r[i] = x <= y; break;
 		}
 	}
-	return(true);
 }
 
-bool GrapaVector::FROM(GrapaScriptExec* pScriptExec, GrapaRuleEvent* value, u8 pDim, u8 pBlock)
+static d64 _vectorf64sum(const d64* a, u64 n)
 {
-	return FROM(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, value, pDim, pBlock);
+	d64 sum = 0.0;
+	u64 i = 0;
+#ifdef _vectoravx2_
+	if (_vectorhasavx2())
+		i = _vectorf64sumavx2(a, n, sum);
+	else
+#endif
+#ifdef _vectorsse2_
+		i = _vectorf64sumsse2(a, n, sum);
+#endif
+	for (; i < n; i++)
+		sum += a[i];
+	return sum;
 }
 
-char* _next_vector_token(GrapaCHAR& sep, char*& sC, u64& lenC, char*& vS, u64& vL, bool& isQuoted, bool& isSYS)
+// Returns false when a partial sum overflows int64, even if the total would have fit.
+static bool _vectors64sum(const s64* a, u64 n, s64& sum)
 {
-	vS = NULL;
-	vL = 0;
-	isQuoted = false;
-	isSYS = false;
-	char* ret = NULL;
-	if (lenC == 0)
-	{
-		sC = NULL;
-		return ret;
-	}
-	if (*sC == '"' || (lenC>=7 && sC[0] == '"' && sC[1] == '=' && sC[2] == '"' && sC[3] == '"'))
+	s64 t[4] = { 0, 0, 0, 0 };
+	u64 i = 0;
+	bool overflow = false;
+#ifdef _vectoravx2_
+	if (_vectorhasavx2())
+		i = _vectors64sumavx2(a, n, t, overflow);
+	else
+#endif
+#ifdef _vectorsse2_
+		i = _vectors64sumsse2(a, n, t, overflow);
+#endif
+	sum = 0;
+	for (u64 j = 0; j < 4 && !overflow; j++)
+		overflow = !_vectors64add(sum, t[j], sum);
+	for (; i < n && !overflow; i++)
+		overflow = !_vectors64add(sum, a[i], sum);
+	return !overflow;
+}
+
+// c[0..n) += s * b[0..n). Every lane does the same multiply then add, so AVX2, SSE2 and
+// the scalar tail give identical results.
+static void _vectorf64axpy(d64 s, const d64* b, d64* c, u64 n)
+{
+	u64 j = 0;
+#ifdef _vectoravx2_
+	if (_vectorhasavx2())
+		j = _vectorf64axpyavx2(s, b, c, n);
+	else
+#endif
+#ifdef _vectorsse2_
+		j = _vectorf64axpysse2(s, b, c, n);
+#endif
+	for (; j < n; j++)
+		c[j] += s * b[j];
+}
+
+static d64 _vectorf64dot(const d64* a, const d64* b, u64 n)
+{
+	d64 sum = 0.0;
+	u64 i = 0;
+#ifdef _vectoravx2_
+	if (_vectorhasavx2())
+		i = _vectorf64dotavx2(a, b, n, sum);
+	else
+#endif
+#ifdef _vectorsse2_
+		i = _vectorf64dotsse2(a, b, n, sum);
+#endif
+	for (; i < n; i++)
+		sum += a[i] * b[i];
+	return sum;
+}
+
+// Tiled so both the source rows and the destination columns of a tile stay in cache.
+static void _vectortranspose64(const u64* a, u64* r, u64 rows, u64 cols)
+{
+	const u64 tile = 32;
+	bool avx2 = _vectorhasavx2();
+	for (u64 ii = 0; ii < rows; ii += tile)
 	{
-		isQuoted = true;
-		if (lenC >= 7 && sC[0] == '"' && sC[1] == '=' && sC[2] == '"' && sC[3] == '"')
-			isSYS = true;
-		char* sC2 = sC + 1 + (isSYS ? 3 : 0);
-		char* v = sC2;
-		u64 lenC2 = lenC - 1 - (isSYS ? 3 : 0);
-		while (lenC2)
+		u64 ie = (ii + tile) < rows ? (ii + tile) : rows;
+		for (u64 jj = 0; jj < cols; jj += tile)
 		{
-			if (*v == '"')
+			u64 je = (jj + tile) < cols ? (jj + tile) : cols;
+			u64 i = ii;
+#ifdef _vectoravx2_
+			if (avx2)
 			{
-				if (lenC2 > 1 && v[1] == '"')
+				for (; i + 4 <= ie; i += 4)
 				{
-					v = v + 1;
-					lenC2--;
+					u64 j = _vectortransposeavx2((const d64*)a, (d64*)r, rows, cols, i, jj, je);
+					for (; j < je; j++)
+						for (u64 k = 0; k < 4; k++)
+							r[j * rows + i + k] = a[(i + k) * cols + j];
 				}
-				else
-					break;
 			}
-			*sC2 = *v;
-			sC2 = sC2 + 1;
-			v = v + 1;
-			lenC2--;
+#endif
+#ifdef _vectorsse2_
+			for (; i + 2 <= ie; i += 2)
+			{
+				u64 j = _vectortransposesse2((const d64*)a, (d64*)r, rows, cols, i, jj, je);
+				for (; j < je; j++)
+				{
+					r[j * rows + i] = a[i * cols + j];
+					r[j * rows + i + 1] = a[(i + 1) * cols + j];
+				}
+			}
+#endif
+			for (; i < ie; i++)
+				for (u64 j = jj; j < je; j++)
+					r[j * rows + i] = a[i * cols + j];
 		}
-		vS = &sC[1 +(isSYS ? 3 : 0)];
-		vL = sC2 - sC - 1 - (isSYS ? 4 : 0);
-		lenC = lenC - (v - sC) - 1;
-		sC = v + 1;
-		if (sep.mLength == 0)
+	}
+}
+
+class GrapaVectorBCast {
+public: enum {
+	SCALAR = 0,
+	FULL = 1,
+	ROW = 2,
+	COL = 3,
+}; };
+
+// Same broadcasting rules as Add/Mul/Pow: scalar, matching shape, a row across a 2D vector,
+// or a column (r x 1) across a 2D vector.
+static bool _vectorbcast(const GrapaVector& a, const GrapaVector& b, u64& rows, u64& cols, u8& mode)
+{
+	if (a.mCounts == NULL || b.mCounts == NULL)
+		return false;
+	switch (a.mDim)
+	{
+	case 1:
+		rows = 1;
+		cols = a.mCounts[0];
+		if (b.mDim != 1)
+			return false;
+		if (b.mCounts[0] == 1)
+			mode = GrapaVectorBCast::SCALAR;
+		else if (b.mCounts[0] == cols)
+			mode = GrapaVectorBCast::FULL;
+		else
+			return false;
+		return true;
+	case 2:
+		rows = a.mCounts[0];
+		cols = a.mCounts[1];
+		if (b.mDim == 1)
 		{
-			u64 lenC2 = lenC;
-			char* sC2 = sC;
-			while (lenC2 && *sC2 != ',' && *sC2 != '\t')
-			{
-				lenC2--;
-				sC2 = sC2 + 1;
-			}
-			if (lenC2 && *sC2 == '\t') sep.Append('\t');
-			else sep.Append(',');
+			if (b.mCounts[0] == 1)
+				mode = GrapaVectorBCast::SCALAR;
+			else if (b.mCounts[0] == cols)
+				mode = GrapaVectorBCast::ROW;
+			else
+				return false;
+			return true;
 		}
-		if (lenC>=sep.mLength && memcmp(sC, sep.mBytes, sep.mLength)==0)
+		if (b.mDim != 2 || b.mCounts[0] != rows)
+			return false;
+		if (b.mCounts[1] == cols)
+			mode = GrapaVectorBCast::FULL;
+		else if (b.mCounts[1] == 1)
+			mode = GrapaVectorBCast::COL;
+		else
+			return false;
+		return true;
+	}
+	return false;
+}
+
+static u64 _vectorbpos(u8 mode, u64 cols, u64 i, u64 j)
+{
+	switch (mode)
+	{
+	case GrapaVectorBCast::FULL: return i * cols + j;
+	case GrapaVectorBCast::ROW: return j;
+	case GrapaVectorBCast::COL: return i;
+	}
+	return 0;
+}
+
+static bool _vectoritem(GrapaVectorItem* d1, GrapaBYTE& v)
+{
+	if (d1->isNull)
+		return false;
+	if (d1->isValue)
+	{
+		GrapaVectorValue* d = 0L;
+		memcpy(&d, d1->d, sizeof(GrapaVectorValue*));
+		if (d == NULL || d->e == NULL)
+			return false;
+		if (d->isRaw)
+			v = d->b->Get();
+		else
+			v = d->e->mValue;
+	}
+	else
+	{
+		v.FROM(d1->mLen, d1->d);
+		v.mToken = d1->mToken;
+	}
+	return true;
+}
+
+// Shortest decimal that round trips, so 0.1 comes back as 0.1 rather than its binary expansion.
+static GrapaFloat _vectorfromf64(d64 v)
+{
+	GrapaFloat f(false, 16 * 8, 10, 0);
+	if (v == 0.0 || !std::isfinite(v))
+		return f;
+	char buf[40];
+	int prec = 15;
+	for (; prec < 17; prec++)
+	{
+		snprintf(buf, sizeof(buf), "%.*e", prec - 1, v);
+		if (strtod(buf, NULL) == v)
+			break;
+	}
+	snprintf(buf, sizeof(buf), "%.*e", prec - 1, v);
+	char* e = strchr(buf, 'e');
+	int exp10 = atoi(e + 1);
+	char digits[24];
+	int n = 0;
+	for (char* c = buf; c < e; c++)
+		if (*c >= '0' && *c <= '9')
+			digits[n++] = *c;
+	while (n > 1 && digits[n - 1] == '0')
+		n--;
+	GrapaCHAR s;
+	if (exp10 < 0)
+	{
+		s.FROM("0.");
+		for (int k = -1; k > exp10; k--)
+			s.Append('0');
+		s.Append(digits, n);
+	}
+	else
+	{
+		for (int k = 0; k <= exp10; k++)
+			s.Append(k < n ? digits[k] : '0');
+		if (n > exp10 + 1)
 		{
-			lenC -= sep.mLength;
-			sC = sC + sep.mLength;
-			ret = v + sep.mLength;
+			s.Append('.');
+			s.Append(&digits[exp10 + 1], n - exp10 - 1);
 		}
 	}
+	f.FromString(s, 10);
+	f.Truncate();
+	return v < 0 ? -f : f;
+}
+
+static bool _vectortof64(const GrapaBYTE& v, d64& r)
+{
+	switch (v.mToken)
+	{
+	case GrapaTokenType::INT:
+	{
+		GrapaInt a;
+		a.FromBytes(v);
+		if (a.bitCount() <= 63)
+			r = (d64)a.LongValue();
+		else
+			r = GrapaFloat(false, (s64)a.bitCount() + 1, 0, a).ToDouble();
+		return true;
+	}
+	case GrapaTokenType::FLOAT:
+	{
+		GrapaFloat a(false, 16 * 8, 10, 0);
+		a.FromBytes(v);
+		r = a.ToDouble();
+		return true;
+	}
+	}
+	return false;
+}
+
+static bool _vectortos64(const GrapaBYTE& v, s64& r)
+{
+	GrapaInt a;
+	switch (v.mToken)
+	{
+	case GrapaTokenType::INT:
+		a.FromBytes(v);
+		break;
+	case GrapaTokenType::FLOAT:
+	{
+		GrapaFloat f(false, 16 * 8, 10, 0);
+		f.FromBytes(v);
+		if (!f.IsInt())
+			return false;
+		a = f.ToInt();
+		break;
+	}
+	default:
+		return false;
+	}
+	if (a.bitCount() > 63)
+		return false;
+	r = a.LongValue();
+	return true;
+}
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <thread>
+#include <vector>
+
+// Below this many multiply-adds the thread start-up costs more than the work.
+#define _vectorparallelwork_ 262144
+
+// Runs pTask(0..pCount) across the hardware threads, handing out task numbers from a shared
+// counter so uneven tasks balance. Small jobs stay on the calling thread.
+static void _vectorparallel(u64 pCount, u64 pWork, const std::function<void(u64)>& pTask)
+{
+	u64 threads = std::thread::hardware_concurrency();
+	if (threads > pCount)
+		threads = pCount;
+	if (pWork < _vectorparallelwork_ || threads < 2)
+	{
+		for (u64 t = 0; t < pCount; t++)
+			pTask(t);
+		return;
+	}
+	std::atomic<u64> next(0);
+	std::vector<std::future<void>> futures;
+	for (u64 w = 1; w < threads; w++)
+		futures.push_back(std::async(std::launch::async, [&]() {
+			for (u64 t = next++; t < pCount; t = next++)
+				pTask(t);
+			}));
+	for (u64 t = next++; t < pCount; t = next++)
+		pTask(t);
+	for (auto& f : futures) f.get();
+}
+
+// Methods that rewrite a native vector in place and only have a GrapaFloat implementation box
+// it into GrapaVectorItem cells for their duration, then restore the dtype (float64 when values
+// no longer fit int64). Methods that only read the vector box a copy instead, leaving the vector
+// itself unconverted for other readers.
+class GrapaVectorBox
+{
+public:
+	GrapaVector* vVector;
+	u8 mDType;
+	GrapaVectorBox(GrapaVector* pVector) { vVector = pVector; mDType = pVector->mDType; if (mDType) pVector->SetDType(GrapaVectorDType::DEFAULT); }
+	~GrapaVectorBox() { if (mDType && !vVector->SetDType(mDType)) vVector->SetDType(GrapaVectorDType::FLOAT64); }
+};
+
+static u8 _vectorlistdtype(GrapaRuleEvent* event, bool pBox)
+{
+	u8 dtype = GrapaVectorDType::DEFAULT;
+	GrapaRuleEvent* ev = (event && event->vQueue) ? event->vQueue->Head() : NULL;
+	for (; ev; ev = ev->Next())
+	{
+		if (ev->mValue.mToken != GrapaTokenType::VECTOR || ev->vVector == NULL || ev->vVector->mDType == GrapaVectorDType::DEFAULT)
+			continue;
+		if (dtype == GrapaVectorDType::DEFAULT || ev->vVector->mDType == GrapaVectorDType::FLOAT64)
+			dtype = ev->vVector->mDType;
+		if (pBox)
+			ev->vVector->SetDType(GrapaVectorDType::DEFAULT);
+	}
+	return dtype;
+}
+
+// Reductions over native buffers. Values are summed in fixed blocks and the block sums are
+// combined pairwise, so the result depends only on the shape, never on how many threads ran
+// the blocks, and the rounding error grows with log(n) instead of n.
+#define _vectorsumblock_ 1024
+#define _vectorsumrows_ 256
+
+// Adds the n rows of p (each cols wide) pairwise, leaving the total in the first row.
+static void _vectorf64pairwise(d64* p, u64 n, u64 cols)
+{
+	if (n < 2)
+		return;
+	u64 h = (n + 1) / 2;
+	_vectorf64pairwise(p, h, cols);
+	_vectorf64pairwise(p + h * cols, n - h, cols);
+	_vectorf64op(GrapaVectorOp::ADD, p, p + h * cols, false, p, cols);
+}
+
+// Sum (pSquares: sum of squares) of a[0..n). pParallel is false when the caller already runs
+// one of these per thread.
+static d64 _vectorf64total(const d64* a, u64 n, bool pSquares, bool pParallel)
+{
+	if (n <= _vectorsumblock_)
+		return pSquares ? _vectorf64dot(a, a, n) : _vectorf64sum(a, n);
+	u64 blocks = (n + _vectorsumblock_ - 1) / _vectorsumblock_;
+	d64* part = (d64*)GrapaMem::Create(sizeof(d64) * blocks);
+	_vectorparallel(blocks, pParallel ? n : 0, [&](u64 b) {
+		u64 i = b * _vectorsumblock_, len = (n - i) < _vectorsumblock_ ? (n - i) : _vectorsumblock_;
+		part[b] = pSquares ? _vectorf64dot(a + i, a + i, len) : _vectorf64sum(a + i, len);
+		});
+	_vectorf64pairwise(part, blocks, 1);
+	d64 sum = part[0];
+	GrapaMem::Delete(part);
+	return sum;
+}
+
+// Column sums of the rows x cols matrix a into r.
+static void _vectorf64colsum(const d64* a, u64 rows, u64 cols, d64* r)
+{
+	u64 blocks = (rows + _vectorsumrows_ - 1) / _vectorsumrows_;
+	if (blocks == 0 || cols == 0)
+		return;
+	d64* part = (d64*)GrapaMem::Create(sizeof(d64) * blocks * cols);
+	memset(part, 0, sizeof(d64) * blocks * cols);
+	_vectorparallel(blocks, rows * cols, [&](u64 b) {
+		d64* p = part + b * cols;
+		u64 ie = (b + 1) * _vectorsumrows_ < rows ? (b + 1) * _vectorsumrows_ : rows;
+		for (u64 i = b * _vectorsumrows_; i < ie; i++)
+			_vectorf64op(GrapaVectorOp::ADD, p, a + i * cols, false, p, cols);
+		});
+	_vectorf64pairwise(part, blocks, cols);
+	memcpy(r, part, sizeof(d64) * cols);
+	GrapaMem::Delete(part);
+}
+
+// int64 sums are exact, so blocks are simply added in turn. Returns false when a partial sum
+// overflows, leaving the caller to sum in float64.
+static bool _vectors64colsum(const s64* a, u64 rows, u64 cols, s64* r)
+{
+	u64 blocks = (rows + _vectorsumrows_ - 1) / _vectorsumrows_;
+	if (blocks == 0 || cols == 0)
+		return true;
+	s64* part = (s64*)GrapaMem::Create(sizeof(s64) * blocks * cols);
+	memset(part, 0, sizeof(s64) * blocks * cols);
+	std::atomic<bool> overflow(false);
+	_vectorparallel(blocks, rows * cols, [&](u64 b) {
+		s64* p = part + b * cols;
+		u64 ie = (b + 1) * _vectorsumrows_ < rows ? (b + 1) * _vectorsumrows_ : rows;
+		for (u64 i = b * _vectorsumrows_; i < ie && !overflow.load(); i++)
+			if (!_vectors64op(GrapaVectorOp::ADD, p, a + i * cols, false, p, cols))
+				overflow.store(true);
+		});
+	bool ok = !overflow.load();
+	for (u64 b = 0; b < blocks && ok; b++)
+		ok = _vectors64op(GrapaVectorOp::ADD, r, part + b * cols, false, r, cols);
+	GrapaMem::Delete(part);
+	return ok;
+}
+
+static bool _vectorf64hasnan(const d64* a, u64 n)
+{
+	for (u64 i = 0; i < n; i++)
+		if (std::isnan(a[i]))
+			return true;
+	return false;
+}
+
+// An int64 sum that overflows is taken again in float64, as Dot does with an int64 product.
+static GrapaError _vectornativesum(const GrapaVector& a, GrapaVector& result, bool isRows, bool isMean)
+{
+	u64 rows = isRows ? a.mCounts[1] : a.mCounts[0];
+	u64 cols = isRows ? a.mCounts[0] : a.mCounts[1];
+	result.mDim = isRows ? 2 : 1;
+	result.mCounts = (u64*)GrapaMem::Create(sizeof(u64) * result.mDim);
+	result.mCounts[0] = cols;
+	if (isRows) result.mCounts[1] = 1;
+	result.mSize = cols;
+	result.mDType = (isMean || a.mDType == GrapaVectorDType::FLOAT64) ? GrapaVectorDType::FLOAT64 : GrapaVectorDType::INT64;
+	result.mNative = GrapaMem::Create(sizeof(u64) * (cols ? cols : 1));
+	memset(result.mNative, 0, sizeof(u64) * (cols ? cols : 1));
+	d64* rf = (d64*)result.mNative;
+	if (a.mDType == GrapaVectorDType::FLOAT64)
+	{
+		const d64* af = (const d64*)a.mNative;
+		if (isRows)
+			_vectorparallel(cols, a.mSize, [&](u64 j) { rf[j] = _vectorf64total(af + j * rows, rows, false, cols == 1); });
+		else
+			_vectorf64colsum(af, rows, cols, rf);
+	}
 	else
 	{
-		if (sep.mLength == 0)
+		const s64* ai = (const s64*)a.mNative;
+		s64* ri = isMean ? (s64*)GrapaMem::Create(sizeof(s64) * (cols ? cols : 1)) : (s64*)result.mNative;
+		if (isMean)
+			memset(ri, 0, sizeof(s64) * (cols ? cols : 1));
+		std::atomic<bool> overflow(false);
+		if (isRows)
+			_vectorparallel(cols, a.mSize, [&](u64 j) { if (!_vectors64sum(ai + j * rows, rows, ri[j])) overflow.store(true); });
+		else if (!_vectors64colsum(ai, rows, cols, ri))
+			overflow.store(true);
+		if (isMean)
 		{
-			u64 lenC2 = lenC;
-			char* sC2 = sC;
-			while (lenC2 && *sC2 != ',' && *sC2 != '\t')
-			{
-				lenC2--;
-				sC2 = sC2 + 1;
-			}
-			if (lenC2 && *sC2 == '\t') sep.Append('\t');
-			else sep.Append(',');
+			for (u64 j = 0; j < cols; j++)
+				rf[j] = (d64)ri[j];
+			GrapaMem::Delete(ri);
 		}
-		char* sC2 = (char*)GrapaMem::MemFind(sC, lenC, sep.mBytes, sep.mLength);
-		if (sC2)
+		if (overflow.load())
 		{
-			vS = sC;
-			vL = sC2 - sC;
-			lenC = lenC - (sC2 - sC) - sep.mLength;
-			sC = sC2 + sep.mLength;
-			ret = sC2;
+			GrapaVector f(a);
+			f.SetDType(GrapaVectorDType::FLOAT64);
+			result.CLEAR();
+			return _vectornativesum(f, result, isRows, isMean);
 		}
-		else
+	}
+	if (isMean)
+		for (u64 j = 0; j < cols; j++)
+			rf[j] /= (d64)rows;
+	return 0;
+}
+
+// Covariance of the variables (columns, or rows when isRows) as a float64 matrix. The
+// observations are centred, then each task adds one row of the upper triangle for one block
+// of observations, and the block results are combined pairwise. Returns false when a value
+// does not convert to float64 or is NaN, leaving the GrapaFloat path to skip nulls.
+static bool _vectornativecov(const GrapaVector& a, GrapaVector& result, bool isRows)
+{
+	GrapaVector x(a);
+	if (x.mDim != 2 || !x.SetDType(GrapaVectorDType::FLOAT64) || _vectorf64hasnan((const d64*)x.mNative, x.mSize))
+		return false;
+	u64 n = isRows ? a.mCounts[1] : a.mCounts[0];
+	u64 v = isRows ? a.mCounts[0] : a.mCounts[1];
+	d64* obs = (d64*)x.mNative;
+	d64* t = NULL;
+	if (isRows)
+	{
+		t = (d64*)GrapaMem::Create(sizeof(d64) * (x.mSize ? x.mSize : 1));
+		_vectortranspose64((const u64*)x.mNative, (u64*)t, a.mCounts[0], a.mCounts[1]);
+		obs = t;
+	}
+	d64* mean = (d64*)GrapaMem::Create(sizeof(d64) * (v ? v : 1));
+	memset(mean, 0, sizeof(d64) * (v ? v : 1));
+	_vectorf64colsum(obs, n, v, mean);
+	for (u64 j = 0; j < v; j++)
+		mean[j] /= (d64)(n ? n : 1);
+	_vectorparallel((n + _vectorsumrows_ - 1) / _vectorsumrows_, n * v, [&](u64 b) {
+		u64 ie = (b + 1) * _vectorsumrows_ < n ? (b + 1) * _vectorsumrows_ : n;
+		for (u64 i = b * _vectorsumrows_; i < ie; i++)
+			_vectorf64op(GrapaVectorOp::SUB, obs + i * v, mean, false, obs + i * v, v);
+		});
+	u64 cap = (v * v) > (1 << 22) ? (v * v) : (1 << 22);
+	u64 block = _vectorsumrows_;
+	if (((n + block - 1) / block) * v * v > cap)
+		block = (n + (cap / (v * v)) - 1) / (cap / (v * v));
+	u64 blocks = n ? (n + block - 1) / block : 1;
+	d64* part = (d64*)GrapaMem::Create(sizeof(d64) * blocks * v * v);
+	memset(part, 0, sizeof(d64) * blocks * v * v);
+	_vectorparallel(blocks * v, n * v * v / 2, [&](u64 task) {
+		u64 b = task / v, p = task % v;
+		d64* row = part + b * v * v + p * v;
+		u64 ie = (b + 1) * block < n ? (b + 1) * block : n;
+		for (u64 i = b * block; i < ie; i++)
+			_vectorf64axpy(obs[i * v + p], obs + i * v + p, row + p, v - p);
+		});
+	_vectorf64pairwise(part, blocks, v * v);
+	d64 div = n > 1 ? (d64)(n - 1) : 1.0;
+	for (u64 p = 0; p < v; p++)
+	{
+		for (u64 q = p; q < v; q++)
 		{
-			vS = sC;
-			vL = lenC;
-			lenC = 0;
-			sC = NULL;
+			part[p * v + q] /= div;
+			part[q * v + p] = part[p * v + q];
 		}
 	}
-	return ret;
+	result.CLEAR();
+	result.mDim = 2;
+	result.mCounts = (u64*)GrapaMem::Create(sizeof(u64) * 2);
+	result.mCounts[0] = v;
+	result.mCounts[1] = v;
+	result.mSize = v * v;
+	result.mBlock = _minvectorblock_;
+	result.mMaxBlock = _minvectordatablock_;
+	result.mNative = GrapaMem::Create(sizeof(d64) * (v ? v * v : 1));
+	memcpy(result.mNative, part, sizeof(d64) * v * v);
+	result.mDType = GrapaVectorDType::FLOAT64;
+	GrapaMem::Delete(part);
+	GrapaMem::Delete(mean);
+	if (t)
+		GrapaMem::Delete(t);
+	return true;
 }
 
-bool GrapaVector::FROM(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, bool pFix, s64 pMax, s64 pExtra, const GrapaBYTE& pData, u8 pBlock)
+// GEMM tiling: each task owns a _vectorgemmrows_ x _vectorgemmcols_ block of the result, and
+// walks k in _vectorgemmdepth_ slices so the slice of b it reuses stays in L2. Every result
+// cell still sums k in order, so the answer does not depend on the thread count.
+#define _vectorgemmrows_ 64
+#define _vectorgemmcols_ 256
+#define _vectorgemmdepth_ 128
+
+static void _vectorf64gemm(const d64* a, const d64* b, d64* c, u64 k, u64 n, u64 i0, u64 i1, u64 j0, u64 j1)
 {
-	CLEAR();
-	if (pBlock)
+	for (u64 kk = 0; kk < k; kk += _vectorgemmdepth_)
 	{
-		mSetBlock = pBlock;
-		if (mSetBlock % 2) mSetBlock++;
-		mSetBlock += _minvectorblock_ - _minvectordatablock_;
+		u64 ke = (kk + _vectorgemmdepth_) < k ? (kk + _vectorgemmdepth_) : k;
+		for (u64 i = i0; i < i1; i++)
+			for (u64 x = kk; x < ke; x++)
+				_vectorf64axpy(a[i * k + x], b + x * n + j0, c + i * n + j0, j1 - j0);
 	}
-	if (pData.mBytes == NULL || pData.mLength == 0)
-		return(false);
-	char* s = (char*)pData.mBytes;
-	u64 len = pData.mLength;
-
-	GrapaCHAR del;
-	char* pr = (char*)GrapaMem::MemFind(s, '\r', len);
-	char* pn = (char*)GrapaMem::MemFind(s, '\n', len);
-	if (pr && pn && pn > (pr + 1)) pn = NULL;
-	del.FROM("\n");
-	if (pr && (&pr[1]) == pn) del.FROM("\r\n");
+}
 
-	GrapaCHAR sep;
+static bool _vectors64muladd(s64 a, s64 b, s64& c)
+{
+	s64 t;
+	return _vectors64mul(a, b, t) && _vectors64add(c, t, c);
+}
 
-	char* s2 = (char*)GrapaMem::MemFind(s, len, (void*)del.mBytes, del.mLength);
-	if (s == s2)
-		return(false);
-	u64 linelen = s2 ? (s2 - s) : len;
-	u64 cols = 0;
-	s2 = s;
-	bool hasBlankHeader = true;
-	while (s2)
+// Returns false on overflow, leaving the caller to redo the product at full precision.
+static bool _vectors64gemm(const s64* a, const s64* b, s64* c, u64 k, u64 n, u64 i0, u64 i1, u64 j0, u64 j1, std::atomic<bool>& pOverflow)
+{
+	for (u64 kk = 0; kk < k; kk += _vectorgemmdepth_)
 	{
-		cols++;
-		char* sC = s2;
-		u64 lenC = linelen - (s2 - s);
-		char* vS = NULL;
-		u64 vL = 0;
-		bool isQuoted = false;
-		bool isSYS = false;
-		s2 = _next_vector_token(sep, sC, lenC, vS, vL, isQuoted, isSYS);
-		if (cols == 1 && !isQuoted && vL >= 3 && memcmp(vS, "ï»¿", 3) == 0)
-		{
-			vS += 3;
-			vL -= 3;
-		}
-		mLabels.PushTail(new GrapaRuleEvent(0, GrapaBYTE(vS, vL), GrapaCHAR("")));
-		if (hasBlankHeader)
+		u64 ke = (kk + _vectorgemmdepth_) < k ? (kk + _vectorgemmdepth_) : k;
+		for (u64 i = i0; i < i1; i++)
 		{
-			bool isInt = true;
-			bool isFloat = false;
-			for (u64 j = 0; j < vL; j++)
+			if (pOverflow.load())
+				return false;
+			for (u64 x = kk; x < ke; x++)
 			{
-				if (!isdigit(vS[j]))
+				s64 s = a[i * k + x];
+				if (s == 0)
+					continue;
+				const s64* br = b + x * n;
+				s64* cr = c + i * n;
+				for (u64 j = j0; j < j1; j++)
 				{
-					if (vS[j] == '.' && !isFloat)
-					{
-						isFloat = true;
-						isInt = false;
-					}
-					else
+					if (!_vectors64muladd(s, br[j], cr[j]))
 					{
-						isInt = isFloat = false;
-						break;
+						pOverflow.store(true);
+						return false;
 					}
 				}
 			}
-			if (isInt)
-			{
-				GrapaInt y;
-				y.FromString(GrapaBYTE(vS, vL), 10);
-				s64 lv = y.LongValue();
-				if (lv != (cols - 1))
-					hasBlankHeader = false;
-			}
-			else
-				hasBlankHeader = false;
 		}
-
-		if (s2 == NULL)
-			break;
-		s2 += sep.mLength;
 	}
-	if (hasBlankHeader)
-		mLabels.CLEAR();
+	return true;
+}
+
+// a is m x k and b is k x n, both native in pDType; result is m x n. Returns false when int64
+// overflows, when either operand does not convert to pDType, or when a float64 operand holds
+// NaN, since the GrapaFloat path skips null terms where NaN would spread through the sum.
+static bool _vectornativedot(GrapaVector& a, GrapaVector& b, u8 pDType, u64 m, u64 k, u64 n, GrapaVector& result)
+{
+	if (!a.SetDType(pDType) || !b.SetDType(pDType))
+		return false;
+	if (pDType == GrapaVectorDType::FLOAT64 && (_vectorf64hasnan((const d64*)a.mNative, a.mSize) || _vectorf64hasnan((const d64*)b.mNative, b.mSize)))
+		return false;
+	u64* native = (u64*)GrapaMem::Create(sizeof(u64) * ((m && n) ? m * n : 1));
+	memset(native, 0, sizeof(u64) * ((m && n) ? m * n : 1));
+	u64 rowTiles = (m + _vectorgemmrows_ - 1) / _vectorgemmrows_;
+	u64 colTiles = (n + _vectorgemmcols_ - 1) / _vectorgemmcols_;
+	std::atomic<bool> overflow(false);
+	_vectorparallel(rowTiles * colTiles, m * n * k, [&](u64 t) {
+		u64 i0 = (t / colTiles) * _vectorgemmrows_, j0 = (t % colTiles) * _vectorgemmcols_;
+		u64 i1 = (i0 + _vectorgemmrows_) < m ? (i0 + _vectorgemmrows_) : m;
+		u64 j1 = (j0 + _vectorgemmcols_) < n ? (j0 + _vectorgemmcols_) : n;
+		if (pDType == GrapaVectorDType::FLOAT64)
+			_vectorf64gemm((const d64*)a.mNative, (const d64*)b.mNative, (d64*)native, k, n, i0, i1, j0, j1);
+		else
+			_vectors64gemm((const s64*)a.mNative, (const s64*)b.mNative, (s64*)native, k, n, i0, i1, j0, j1, overflow);
+		});
+	if (overflow.load())
+	{
+		GrapaMem::Delete(native);
+		return false;
+	}
+	result.CLEAR();
+	result.mDim = 2;
+	result.mCounts = (u64*)GrapaMem::Create(sizeof(u64) * 2);
+	result.mCounts[0] = m;
+	result.mCounts[1] = n;
+	result.mSize = m * n;
+	result.mBlock = _minvectorblock_;
+	result.mMaxBlock = _minvectordatablock_;
+	result.mNative = native;
+	result.mDType = pDType;
+	return true;
+}
+
+static void _vectorfloatsfree(GrapaFloat** v, u64 n)
+{
+	for (u64 i = 0; i < n; i++)
+		if (v[i])
+			delete v[i];
+	GrapaMem::Delete(v);
+}
+
+// Decodes every cell once, NULL for null cells. Returns NULL when a cell holds an op, since
+// running script from worker threads is not safe.
+static GrapaFloat** _vectorfloats(GrapaScriptExec* pScriptExec, const GrapaVector& a)
+{
+	GrapaFloat** v = (GrapaFloat**)GrapaMem::Create(sizeof(GrapaFloat*) * (a.mSize ? a.mSize : 1));
+	memset(v, 0, sizeof(GrapaFloat*) * (a.mSize ? a.mSize : 1));
+	for (u64 i = 0; i < a.mSize; i++)
+	{
+		GrapaVectorParam p(pScriptExec, a.mData, a.mBlock, i);
+		if (p.Aop)
+		{
+			_vectorfloatsfree(v, i);
+			return NULL;
+		}
+		if (p.a)
+			v[i] = new GrapaFloat(*p.aa);
+	}
+	return v;
+}
+
+// A GrapaFloat multiply-add costs roughly this many double ones.
+#define _vectorfloatwork_ 64
+#define _vectordottile_ 16
+
+// Default storage product for a (m x k) and b (k x n) into the cells already allocated in
+// result. Operands are decoded once instead of per multiply, and result tiles are spread over
+// threads. Each cell sums k in order, as the serial loop does. Returns false if an operand
+// holds ops, leaving the serial loop to run them.
+static bool _vectordotfloats(GrapaScriptExec* pScriptExec, const GrapaVector& a, const GrapaVector& b, GrapaVector& result)
+{
+	u64 m = a.mCounts[0], k = a.mCounts[1], n = b.mCounts[1];
+	GrapaFloat** av = _vectorfloats(pScriptExec, a);
+	if (av == NULL)
+		return false;
+	GrapaFloat** bv = _vectorfloats(pScriptExec, b);
+	if (bv == NULL)
+	{
+		_vectorfloatsfree(av, a.mSize);
+		return false;
+	}
+	GrapaFloat** rv = (GrapaFloat**)GrapaMem::Create(sizeof(GrapaFloat*) * (result.mSize ? result.mSize : 1));
+	memset(rv, 0, sizeof(GrapaFloat*) * (result.mSize ? result.mSize : 1));
+	bool fix = pScriptExec->vScriptState->mItemState.mFloatFix;
+	s64 max = pScriptExec->vScriptState->mItemState.mFloatMax, extra = pScriptExec->vScriptState->mItemState.mFloatExtra;
+	u64 rowTiles = (m + _vectordottile_ - 1) / _vectordottile_;
+	u64 colTiles = (n + _vectordottile_ - 1) / _vectordottile_;
+	_vectorparallel(rowTiles * colTiles, m * n * k * _vectorfloatwork_, [&](u64 t) {
+		u64 i0 = (t / colTiles) * _vectordottile_, j0 = (t % colTiles) * _vectordottile_;
+		u64 i1 = (i0 + _vectordottile_) < m ? (i0 + _vectordottile_) : m;
+		u64 j1 = (j0 + _vectordottile_) < n ? (j0 + _vectordottile_) : n;
+		for (u64 i = i0; i < i1; i++)
+		{
+			for (u64 j = j0; j < j1; j++)
+			{
+				GrapaFloat val(fix, max, extra, 0);
+				bool isSet = false;
+				for (u64 x = 0; x < k; x++)
+				{
+					if (av[i * k + x] && bv[x * n + j])
+					{
+						val += *av[i * k + x] * *bv[x * n + j];
+						isSet = true;
+					}
+				}
+				if (isSet)
+					rv[i * n + j] = new GrapaFloat(val);
+			}
+		}
+		});
+	for (u64 i = 0; i < result.mSize; i++)
+	{
+		if (rv[i])
+			result.Set(i, *rv[i]);
+		else
+			result.Set(i);
+	}
+	_vectorfloatsfree(rv, result.mSize);
+	_vectorfloatsfree(bv, b.mSize);
+	_vectorfloatsfree(av, a.mSize);
+	return true;
+}
+
+// Default storage sums, one task per result cell. Each cell adds its values in the same order
+// as a serial loop, so the results match it exactly.
+static GrapaError _vectorfloatsum(GrapaScriptExec* pScriptExec, const GrapaVector& a, GrapaVector& result, bool isRows, bool isMean)
+{
+	u64 rows = isRows ? a.mCounts[1] : a.mCounts[0];
+	u64 cols = isRows ? a.mCounts[0] : a.mCounts[1];
+	result.mDim = isRows ? 2 : 1;
+	result.mSetBlock = a.mSetBlock;
+	result.mBlock = a.mBlock;
+	result.mMaxBlock = _minvectordatablock_;
+	result.mCounts = (u64*)GrapaMem::Create(sizeof(u64) * result.mDim);
+	result.mCounts[0] = cols;
+	if (isRows) result.mCounts[1] = 1;
+	result.mSize = cols;
+	result.mData = (GrapaVectorItem*)GrapaMem::Create(result.mBlock * result.mSize);
+	memset(result.mData, 0, result.mBlock * result.mSize);
+	GrapaFloat** rv = (GrapaFloat**)GrapaMem::Create(sizeof(GrapaFloat*) * (cols ? cols : 1));
+	memset(rv, 0, sizeof(GrapaFloat*) * (cols ? cols : 1));
+	bool fix = pScriptExec->vScriptState->mItemState.mFloatFix;
+	s64 max = pScriptExec->vScriptState->mItemState.mFloatMax, extra = pScriptExec->vScriptState->mItemState.mFloatExtra;
+	_vectorparallel(cols, rows * cols * _vectorfloatwork_, [&](u64 j) {
+		GrapaFloat sum(fix, max, extra, 0);
+		for (u64 i = 0; i < rows; i++)
+		{
+			u64 pos = isRows ? (j * a.mCounts[1] + i) : (i * a.mCounts[1] + j);
+			GrapaVectorParam p1(pScriptExec, a.mData, a.mBlock, (pos));
+			sum = sum + *p1.aa;
+		}
+		rv[j] = new GrapaFloat(isMean ? sum / rows : sum);
+		});
+	for (u64 j = 0; j < cols; j++)
+		result.Set(j, *rv[j]);
+	_vectorfloatsfree(rv, cols);
+	return 0;
+}
+
+// Default storage covariance. Cells are decoded once, each variable is centred by its own task,
+// then each task fills one row of the upper triangle. Returns false if a cell holds an op.
+static bool _vectorfloatcov(GrapaScriptExec* pScriptExec, const GrapaVector& a, GrapaVector& result, bool isRows)
+{
+	GrapaFloat** av = _vectorfloats(pScriptExec, a);
+	if (av == NULL)
+		return false;
+	u64 n = isRows ? a.mCounts[1] : a.mCounts[0];
+	u64 v = isRows ? a.mCounts[0] : a.mCounts[1];
+	bool fix = pScriptExec->vScriptState->mItemState.mFloatFix;
+	s64 max = pScriptExec->vScriptState->mItemState.mFloatMax, extra = pScriptExec->vScriptState->mItemState.mFloatExtra;
+	GrapaFloat** cv = (GrapaFloat**)GrapaMem::Create(sizeof(GrapaFloat*) * ((v && n) ? v * n : 1));
+	memset(cv, 0, sizeof(GrapaFloat*) * ((v && n) ? v * n : 1));
+	_vectorparallel(v, v * n * _vectorfloatwork_, [&](u64 j) {
+		GrapaFloat zero(fix, max, extra, 0);
+		GrapaFloat sum(fix, max, extra, 0);
+		for (u64 i = 0; i < n; i++)
+		{
+			GrapaFloat* f = av[isRows ? (j * a.mCounts[1] + i) : (i * a.mCounts[1] + j)];
+			sum = sum + (f ? *f : zero);
+		}
+		sum = sum / n;
+		for (u64 i = 0; i < n; i++)
+		{
+			GrapaFloat* f = av[isRows ? (j * a.mCounts[1] + i) : (i * a.mCounts[1] + j)];
+			cv[j * n + i] = new GrapaFloat((f ? *f : zero) - sum);
+		}
+		});
+	GrapaFloat** rv = (GrapaFloat**)GrapaMem::Create(sizeof(GrapaFloat*) * (v ? v * v : 1));
+	memset(rv, 0, sizeof(GrapaFloat*) * (v ? v * v : 1));
+	_vectorparallel(v, v * v * n * _vectorfloatwork_ / 2, [&](u64 i) {
+		for (u64 j = i; j < v && n; j++)
+		{
+			GrapaFloat val(fix, max, extra, 0);
+			for (u64 x = 0; x < n; x++)
+				val += *cv[i * n + x] * *cv[j * n + x];
+			if (n > 1) val = val / (n - 1);
+			rv[i * v + j] = new GrapaFloat(val);
+		}
+		});
+	result.CLEAR();
+	result.mDim = 2;
+	result.mSetBlock = a.mSetBlock;
+	result.mBlock = a.mBlock;
+	result.mMaxBlock = _minvectordatablock_;
+	result.mCounts = (u64*)GrapaMem::Create(sizeof(u64) * result.mDim);
+	result.mCounts[0] = v;
+	result.mCounts[1] = v;
+	result.mSize = v * v;
+	result.mData = (GrapaVectorItem*)GrapaMem::Create(result.mBlock * result.mSize);
+	memset(result.mData, 0, result.mBlock * result.mSize);
+	for (u64 i = 0; i < v; i++)
+	{
+		for (u64 j = i; j < v; j++)
+		{
+			if (rv[i * v + j])
+			{
+				result.Set((i * v + j), *rv[i * v + j]);
+				result.Set((j * v + i), *rv[i * v + j]);
+			}
+			else
+			{
+				result.Set((i * v + j));
+				result.Set((j * v + i));
+			}
+		}
+	}
+	_vectorfloatsfree(rv, v * v);
+	_vectorfloatsfree(cv, v * n);
+	_vectorfloatsfree(av, a.mSize);
+	return true;
+}
+
+// Square root of the sum of squares over every cell, null cells skipped. Blocks of cells are
+// summed in parallel and the block sums added in order, so threads do not change the result.
+static GrapaFloat _vectorfloatnorm(GrapaScriptExec* pScriptExec, const GrapaVector& a)
+{
+	bool fix = pScriptExec->vScriptState->mItemState.mFloatFix;
+	s64 max = pScriptExec->vScriptState->mItemState.mFloatMax, extra = pScriptExec->vScriptState->mItemState.mFloatExtra;
+	u64 blocks = (a.mSize + _vectorsumblock_ - 1) / _vectorsumblock_;
+	GrapaFloat** part = (GrapaFloat**)GrapaMem::Create(sizeof(GrapaFloat*) * (blocks ? blocks : 1));
+	memset(part, 0, sizeof(GrapaFloat*) * (blocks ? blocks : 1));
+	_vectorparallel(blocks, a.mSize * _vectorfloatwork_, [&](u64 b) {
+		GrapaFloat sum(fix, max, extra, 0);
+		u64 ie = (b + 1) * _vectorsumblock_ < a.mSize ? (b + 1) * _vectorsumblock_ : a.mSize;
+		for (u64 i = b * _vectorsumblock_; i < ie; i++)
+		{
+			GrapaVectorParam p1(pScriptExec, a.mData, a.mBlock, i);
+			if (p1.a)
+				sum += *p1.aa * *p1.aa;
+		}
+		part[b] = new GrapaFloat(sum);
+		});
+	GrapaFloat sum(fix, max, extra, 0);
+	for (u64 b = 0; b < blocks; b++)
+		sum += *part[b];
+	_vectorfloatsfree(part, blocks);
+	return sum.Root(GrapaInt(2));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+GrapaVectorBYTE::GrapaVectorBYTE(const GrapaBYTE& b)
+{
+	mBytes = NULL;
+	mLength = 0;
+	mToken = 0;
+	if (b.mBytes && b.mLength)
+	{
+		mBytes = (u8*)GrapaMem::Create(b.mLength + 1);
+		memcpy(mBytes, b.mBytes, b.mLength);
+		mBytes[b.mLength] = 0;
+		mLength = b.mLength;
+		mToken = b.mToken;
+	};
+};
+
+GrapaVectorBYTE::GrapaVectorBYTE(const GrapaVectorBYTE& b)
+{
+	mBytes = NULL;
+	mLength = 0;
+	mToken = 0;
+	if (b.mBytes && b.mLength)
+	{
+		mBytes = (u8*)GrapaMem::Create(b.mLength + 1);
+		memcpy(mBytes, b.mBytes, b.mLength);
+		mBytes[b.mLength] = 0;
+		mLength = b.mLength;
+		mToken = b.mToken;
+	};
+};
+
+GrapaVectorBYTE::~GrapaVectorBYTE()
+{
+	CLEAR();
+};
+
+void GrapaVectorBYTE::CLEAR()
+{
+	if (mBytes) GrapaMem::Delete(mBytes);
+	mBytes = NULL;
+	mLength = 0;
+	mToken = 0;
+};
+
+GrapaBYTE GrapaVectorBYTE::Get()
+{
+	if (mBytes && mLength)
+	{
+		GrapaBYTE v(mBytes, mLength);
+		v.mToken = mToken;
+		return(v);
+	}
+	return GrapaBYTE();
+};
+
+GrapaVectorValue::~GrapaVectorValue()
+{
+	CLEAR();
+};
+
+void GrapaVectorValue::CLEAR()
+{
+	if (isRaw)
+	{
+		if (b)
+		{
+			b->CLEAR();
+			delete b;
+		}
+		b = NULL;
+	}
+	else if (e)
+	{
+		e->CLEAR();
+		delete e;
+	};
+	isRaw = 0;
+	e = NULL;
+};
+
+void GrapaVectorValue::Set(GrapaRuleEvent* v)
+{
+	CLEAR();
+	if (v)
+	{
+		switch (v->mValue.mToken) {
+		case GrapaTokenType::STR:
+		case GrapaTokenType::INT:
+		case GrapaTokenType::FLOAT: 
+			b = new GrapaVectorBYTE(v->mValue);
+			isRaw = 1;
+			break;
+		default: 
+			e = GrapaScriptExec::CopyItem(v);
+			isRaw = 0;
+			break;
+		};
+	};
+};
+
+void GrapaVectorValue::Set(GrapaVectorValue* v)
+{
+	CLEAR();
+	if (v)
+	{
+		if (v->isRaw)
+			b = new GrapaVectorBYTE(*v->b);
+		else
+			e = GrapaScriptExec::CopyItem(v->e);
+		isRaw = v->isRaw;
+	};
+};
+
+void GrapaVectorValue::Set(GrapaFloat* v)
+{
+	CLEAR();
+	if (v)
+	{
+		b = new GrapaVectorBYTE(v->getBytes());
+		isRaw = 1;
+	};
+};
+
+void GrapaVectorValue::Set(GrapaInt* v)
+{
+	CLEAR();
+	if (v)
+	{
+		b = new GrapaVectorBYTE(v->getBytes());
+		isRaw = 1;
+	};
+};
+
+void GrapaVectorValue::Set(GrapaBYTE* v)
+{
+	CLEAR();
+	if (v)
+	{
+		b = new GrapaVectorBYTE(*v);
+		isRaw = 1;
+	};
+};
+
+GrapaRuleEvent* GrapaVectorValue::Get()
+{
+	GrapaRuleEvent* result = NULL;
+	if (e)
+	{
+		if (isRaw)
+			result = new GrapaRuleEvent(0, GrapaCHAR(""), b->Get());
+		else
+			result = GrapaScriptExec::CopyItem(e);
+	};
+	return(result);
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+GrapaVector::GrapaVector()
+{
+	mData = NULL;
+	mCounts = NULL;
+	mSize = 0;
+	mDim = 0;
+	mBlock = _minvectorblock_;
+	mMaxBlock = _minvectordatablock_;
+	mSetBlock = 0;
+	mDType = GrapaVectorDType::DEFAULT;
+	mNative = NULL;
+}
+
+static u64* _scanvectordepth(GrapaRuleEvent* value, u8 pos, u8& dim, u8 maxDim, u64 size, u64& tot)
+{
+	if (maxDim && pos == maxDim) return(NULL);
+	if (value == NULL || value->vQueue == NULL) return(NULL);
+	if ((value->mValue.mToken != GrapaTokenType::ARRAY && value->mValue.mToken != GrapaTokenType::TUPLE) && (pos!=1 || value->mValue.mToken != GrapaTokenType::LIST)) return(NULL);
+	u64* counts = _scanvectordepth(value->vQueue->Head(), pos+1, dim, maxDim, size* value->vQueue->mCount, tot);
+	if (counts == NULL)
+	{
+		dim = pos+1;
+		tot = size* value->vQueue->mCount;
+		counts = (u64*)GrapaMem::Create(dim * sizeof(u64));
+		memset(counts,0, dim * sizeof(u64));
+	}
+	counts[pos] = value->vQueue->mCount;
+	return(counts);
+}
+
+bool GrapaVector::_scanvectorcreate(GrapaRuleEvent* value, u8 pos, u8 dim, u64* counts, GrapaVectorItem* data, u8 block, u64& p, u8& maxblock)
+{
+	if (value == NULL || value->vQueue == NULL) return(false);
+	if ((value->mValue.mToken != GrapaTokenType::ARRAY && value->mValue.mToken != GrapaTokenType::TUPLE) && (pos != 1 || value->mValue.mToken != GrapaTokenType::LIST)) return(false);
+	bool hasLabels = (mLabels.mCount == 0 && pos == 1 && value->mValue.mToken == GrapaTokenType::LIST);
+	GrapaInt b;
+	u64 i = 0;
+	GrapaCHAR nullval;
+	nullval.SetNull();
+	value = value->vQueue->Head();
+	bool hasBlankHeader = true;
+	while (value)
+	{
+		if ((pos + 1) < dim)
+		{
+			if (counts[pos+1] != value->vQueue->mCount) return(false);
+			if (!_scanvectorcreate(value, pos + 1, dim, counts, data, block, p, maxblock)) return(false);
+		}
+		else
+		{
+			if (hasBlankHeader && hasLabels)
+			{
+				bool isInt = true;
+				bool isFloat = false;
+				for (u64 j = 0; j < value->mName.mLength; j++)
+				{
+					if (!isdigit(value->mName.mBytes[j]))
+					{
+						if (value->mName.mBytes[j] == '.' && !isFloat)
+						{
+							isFloat = true;
+							isInt = false;
+						}
+						else
+						{
+							isInt = isFloat = false;
+							break;
+						}
+					}
+				}
+				if (isInt)
+				{
+					GrapaInt y;
+					y.FromString(value->mName, 10);
+					s64 lv = y.LongValue();
+					if (lv != i)
+						hasBlankHeader = false;
+				}
+				else
+					hasBlankHeader = false;
+			}
+			if (hasLabels)
+				mLabels.PushTail(new GrapaRuleEvent(0, value->mName, nullval));
+			GrapaVectorItem *d1 = _datavectorpos(data, block, p);
+			if (value->IsNull())
+			{
+				d1->isValue = 0;
+				d1->isNull = 1;
+				d1->mLen = 0;
+				d1->mToken = 0;
+			}
+			else
+			{
+				bool handled = false;
+				switch (value->mValue.mToken)
+				{
+				case GrapaTokenType::INT:
+				case GrapaTokenType::FLOAT:
+				case GrapaTokenType::STR:
+					if ((value->mValue.mLength + _minvectorheadblock_) <= block)
+					{
+						d1->isValue = 0;
+						d1->isNull = 0;
+						d1->mLen = value->mValue.mLength;
+						d1->mToken = value->mValue.mToken;
+						memcpy(d1->d, value->mValue.mBytes, value->mValue.mLength);
+						handled = true;
+					}
+					else if (value->mValue.mToken == GrapaTokenType::INT || value->mValue.mToken == GrapaTokenType::FLOAT)
+					{
+						if (value->mValue.mLength > maxblock)
+							maxblock = (u8)value->mValue.mLength;
+					}
+					break;
+				}
+				if (!handled)
+				{
+					d1->isValue = 1;
+					d1->isNull = 0;
+					d1->mLen = 0;
+					d1->mToken = 0;
+					GrapaVectorValue* d = new GrapaVectorValue(value);
+					memcpy(d1->d, &d, sizeof(GrapaVectorValue*));
+				}
+			}
+			p++;
+		}
+		value = value->Next();
+		i++;
+	}
+	if (hasBlankHeader && hasLabels)
+		mLabels.CLEAR();
+	return(true);
+}
+
+GrapaVector::GrapaVector(const GrapaVector& bi, u8 pBlock)
+{
+	mData = NULL;
+	mCounts = NULL;
+	mSize = 0;
+	mDim = 0;
+	mBlock = _minvectorblock_;
+	mMaxBlock = _minvectordatablock_;
+	mSetBlock = 0;
+	mDType = GrapaVectorDType::DEFAULT;
+	mNative = NULL;
+	FROM(bi, pBlock);
+}
+
+GrapaVector::~GrapaVector()
+{
+	CLEAR();
+}
+
+void GrapaVector::CLEAR()
+{
+	if (mData && mSize)
+		for (u64 i = 0; i < mSize; i++)
+		{
+			GrapaVectorItem* d1 = _datavectorpos(mData, mBlock, i);
+			if (d1->isValue)
+			{
+				GrapaVectorValue* d = 0L;
+				memcpy(&d, d1->d, sizeof(GrapaVectorValue*));
+				d1->isValue = 0;
+				d1->isNull = 0;
+				d1->mLen = 0;
+				d1->mToken = 0;
+				if (d)
+				{
+					d->CLEAR();
+					delete d;
+				}
+			}
+		}
+	if (mData)
+		GrapaMem::Delete(mData);
+	mData = NULL;
+	if (mNative)
+		GrapaMem::Delete(mNative);
+	mNative = NULL;
+	mDType = GrapaVectorDType::DEFAULT;
+	if (mCounts)
+		GrapaMem::Delete(mCounts);
+	mCounts = NULL;
+	mSize = 0;
+	mDim = 0;
+	mBlock = _minvectorblock_;
+	mMaxBlock = _minvectordatablock_;
+	mLabels.CLEAR();
+	// mSetBlock = 0;
+}
+
+bool GrapaVector::FROM(const GrapaVector& pData, u8 pBlock)
+{
+	CLEAR();
+	if (pBlock)
+	{
+		mSetBlock = pBlock;
+		if (mSetBlock % 2) mSetBlock++;
+		mSetBlock += _minvectorblock_ - _minvectordatablock_;
+	}
+	mDim = pData.mDim;
+	mBlock = pData.mBlock;
+	mMaxBlock = _minvectordatablock_;
+	if (mSetBlock >= _minvectorblock_ && mSetBlock <= _maxvectorblock_) 
+		mBlock = mSetBlock;
+	if (mSetBlock == 0 && (pData.mMaxBlock + _minvectorheadblock_) > mBlock)
+		mBlock = (pData.mMaxBlock + _minvectorheadblock_) < _maxvectorblock_ ? (pData.mMaxBlock + _minvectorheadblock_) : _maxvectorblock_;
+	if (mBlock % 2) mBlock++;
+	mSize = pData.mSize;
+	if (pData.mCounts)
+	{
+		mCounts = (u64*)GrapaMem::Create(sizeof(u64) * mDim);
+		memcpy(mCounts, pData.mCounts, mDim * sizeof(u64));
+	}
+	if (pData.mNative)
+	{
+		mNative = GrapaMem::Create(sizeof(u64) * (mSize ? mSize : 1));
+		memcpy(mNative, pData.mNative, sizeof(u64) * mSize);
+		mDType = pData.mDType;
+	}
+	if (pData.mData)
+	{
+		mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
+		memset(mData, 0, mBlock * mSize);
+		GrapaVectorItem* d1, * d2;
+		for (u64 i = 0; i < mSize; i++)
+		{
+			d1 = _datavectorpos(mData, mBlock, i);
+			d2 = _datavectorpos(pData.mData, pData.mBlock, i);
+			d1->isNull = d2->isNull;
+			if (!d1->isNull)
+			{
+				d1->isValue = d2->isValue;
+				d1->mLen = d2->mLen;
+				d1->mToken = d2->mToken;
+				if (d2->isValue)
+				{
+					GrapaVectorValue* d = 0L;
+					memcpy(&d, d2->d, sizeof(GrapaVectorValue*));
+					if (d)
+					{
+						d = new GrapaVectorValue(d);
+						memcpy(d1->d, &d, sizeof(GrapaVectorValue*));
+					}
+				}
+				else
+				{
+					if (mBlock >= d2->mLen)
+						memcpy(d1->d, d2->d, d2->mLen);
+					else
+					{
+						d1->isValue = 1;
+						GrapaBYTE v(d2->d, d2->mLen);
+						v.mToken = d2->mToken;
+						GrapaVectorValue* d = new GrapaVectorValue(&v);
+						memcpy(d1->d, &d, sizeof(GrapaVectorValue*));
+					}
+				}
+			}
+		}
+	}
+	GrapaRuleEvent* ev = ((GrapaVector*)&pData)->mLabels.Head();
+	while (ev)
+	{
+		mLabels.PushTail(new GrapaRuleEvent(0,ev->mName,ev->mValue));
+		ev = ev->Next();
+	}
+	return(true);
+}
+
+bool GrapaVector::FROM(bool pFix, s64 pMax, s64 pExtra, GrapaRuleEvent* value, u8 pDim, u8 pBlock)
+{
+	CLEAR();
+	if (pBlock)
+	{
+		mSetBlock = pBlock;
+		if (mSetBlock % 2) mSetBlock++;
+		mSetBlock += _minvectorblock_ - _minvectordatablock_;
+	}
+	if (mSetBlock >= _minvectorblock_ && mSetBlock <= _maxvectorblock_) mBlock = mSetBlock;
+	if (value == NULL || value->vQueue == NULL || value->vQueue->mCount == 0)
+	{
+		mDim = 1;
+		mSize = 0;
+		mCounts = (u64*)GrapaMem::Create(mDim * sizeof(u64));
+		mCounts[0] = 0;
+		mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
+	}
+	else
+	{
+		mCounts = _scanvectordepth(value, 0, mDim, pDim, 1, mSize);
+		mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
+		memset(mData, 0, mBlock * mSize);
+		u64 p = 0;
+		if (!_scanvectorcreate(value, 0, mDim, mCounts, mData, mBlock, p, mMaxBlock))
+		{
+			CLEAR();
+			return(false);
+		}
+	}
+	return(true);
+}
+
+bool GrapaVector::FROM(GrapaScriptExec* pScriptExec, GrapaRuleEvent* value, u8 pDim, u8 pBlock)
+{
+	return FROM(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, value, pDim, pBlock);
+}
+
+char* _next_vector_token(GrapaCHAR& sep, char*& sC, u64& lenC, char*& vS, u64& vL, bool& isQuoted, bool& isSYS)
+{
+	vS = NULL;
+	vL = 0;
+	isQuoted = false;
+	isSYS = false;
+	char* ret = NULL;
+	if (lenC == 0)
+	{
+		sC = NULL;
+		return ret;
+	}
+	if (*sC == '"' || (lenC>=7 && sC[0] == '"' && sC[1] == '=' && sC[2] == '"' && sC[3] == '"'))
+	{
+		isQuoted = true;
+		if (lenC >= 7 && sC[0] == '"' && sC[1] == '=' && sC[2] == '"' && sC[3] == '"')
+			isSYS = true;
+		char* sC2 = sC + 1 + (isSYS ? 3 : 0);
+		char* v = sC2;
+		u64 lenC2 = lenC - 1 - (isSYS ? 3 : 0);
+		while (lenC2)
+		{
+			if (*v == '"')
+			{
+				if (lenC2 > 1 && v[1] == '"')
+				{
+					v = v + 1;
+					lenC2--;
+				}
+				else
+					break;
+			}
+			*sC2 = *v;
+			sC2 = sC2 + 1;
+			v = v + 1;
+			lenC2--;
+		}
+		vS = &sC[1 +(isSYS ? 3 : 0)];
+		vL = sC2 - sC - 1 - (isSYS ? 4 : 0);
+		lenC = lenC - (v - sC) - 1;
+		sC = v + 1;
+		if (sep.mLength == 0)
+		{
+			u64 lenC2 = lenC;
+			char* sC2 = sC;
+			while (lenC2 && *sC2 != ',' && *sC2 != '\t')
+			{
+				lenC2--;
+				sC2 = sC2 + 1;
+			}
+			if (lenC2 && *sC2 == '\t') sep.Append('\t');
+			else sep.Append(',');
+		}
+		if (lenC>=sep.mLength && memcmp(sC, sep.mBytes, sep.mLength)==0)
+		{
+			lenC -= sep.mLength;
+			sC = sC + sep.mLength;
+			ret = v + sep.mLength;
+		}
+	}
+	else
+	{
+		if (sep.mLength == 0)
+		{
+			u64 lenC2 = lenC;
+			char* sC2 = sC;
+			while (lenC2 && *sC2 != ',' && *sC2 != '\t')
+			{
+				lenC2--;
+				sC2 = sC2 + 1;
+			}
+			if (lenC2 && *sC2 == '\t') sep.Append('\t');
+			else sep.Append(',');
+		}
+		char* sC2 = (char*)GrapaMem::MemFind(sC, lenC, sep.mBytes, sep.mLength);
+		if (sC2)
+		{
+			vS = sC;
+			vL = sC2 - sC;
+			lenC = lenC - (sC2 - sC) - sep.mLength;
+			sC = sC2 + sep.mLength;
+			ret = sC2;
+		}
+		else
+		{
+			vS = sC;
+			vL = lenC;
+			lenC = 0;
+			sC = NULL;
+		}
+	}
+	return ret;
+}
+
+bool GrapaVector::FROM(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, bool pFix, s64 pMax, s64 pExtra, const GrapaBYTE& pData, u8 pBlock)
+{
+	CLEAR();
+	if (pBlock)
+	{
+		mSetBlock = pBlock;
+		if (mSetBlock % 2) mSetBlock++;
+		mSetBlock += _minvectorblock_ - _minvectordatablock_;
+	}
+	if (pData.mBytes == NULL || pData.mLength == 0)
+		return(false);
+	char* s = (char*)pData.mBytes;
+	u64 len = pData.mLength;
+
+	GrapaCHAR del;
+	char* pr = (char*)GrapaMem::MemFind(s, '\r', len);
+	char* pn = (char*)GrapaMem::MemFind(s, '\n', len);
+	if (pr && pn && pn > (pr + 1)) pn = NULL;
+	del.FROM("\n");
+	if (pr && (&pr[1]) == pn) del.FROM("\r\n");
+
+	GrapaCHAR sep;
+
+	char* s2 = (char*)GrapaMem::MemFind(s, len, (void*)del.mBytes, del.mLength);
+	if (s == s2)
+		return(false);
+	u64 linelen = s2 ? (s2 - s) : len;
+	u64 cols = 0;
+	s2 = s;
+	bool hasBlankHeader = true;
+	while (s2)
+	{
+		cols++;
+		char* sC = s2;
+		u64 lenC = linelen - (s2 - s);
+		char* vS = NULL;
+		u64 vL = 0;
+		bool isQuoted = false;
+		bool isSYS = false;
+		s2 = _next_vector_token(sep, sC, lenC, vS, vL, isQuoted, isSYS);
+		if (cols == 1 && !isQuoted && vL >= 3 && memcmp(vS, "ï»¿", 3) == 0)
+		{
+			vS += 3;
+			vL -= 3;
+		}
+		mLabels.PushTail(new GrapaRuleEvent(0, GrapaBYTE(vS, vL), GrapaCHAR("")));
+		if (hasBlankHeader)
+		{
+			bool isInt = true;
+			bool isFloat = false;
+			for (u64 j = 0; j < vL; j++)
+			{
+				if (!isdigit(vS[j]))
+				{
+					if (vS[j] == '.' && !isFloat)
+					{
+						isFloat = true;
+						isInt = false;
+					}
+					else
+					{
+						isInt = isFloat = false;
+						break;
+					}
+				}
+			}
+			if (isInt)
+			{
+				GrapaInt y;
+				y.FromString(GrapaBYTE(vS, vL), 10);
+				s64 lv = y.LongValue();
+				if (lv != (cols - 1))
+					hasBlankHeader = false;
+			}
+			else
+				hasBlankHeader = false;
+		}
+
+		if (s2 == NULL)
+			break;
+		s2 += sep.mLength;
+	}
+	if (hasBlankHeader)
+		mLabels.CLEAR();
 	u64 rows = 0;
 	s2 = s;
 	while (s2)
@@ -913,6 +2356,13 @@ void GrapaVector::TO(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, Grapa
 {
 	pValue.SetLength(0);
 	pValue.mToken = 0;
+	if (mDType)
+	{
+		GrapaVector boxed(*this);
+		boxed.SetDType(GrapaVectorDType::DEFAULT);
+		boxed.TO(pScriptExec, pNameSpace, delim, pValue);
+		return;
+	}
 	if (mData == NULL)
 		return;
 	u64 p = 0;
@@ -1372,6 +2822,41 @@ void GrapaVector::Set(u64 pPos, GrapaInt& fl)
 
 GrapaError GrapaVector::Dot(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, GrapaVector& bi, GrapaVector& result)
 {
+	if (mDType || bi.mDType)
+	{
+		u8 dtype = (mDType == GrapaVectorDType::FLOAT64 || bi.mDType == GrapaVectorDType::FLOAT64) ? GrapaVectorDType::FLOAT64 : GrapaVectorDType::INT64;
+		GrapaVector a(*this), b(bi);
+		if (dtype == GrapaVectorDType::INT64 && (!a.SetDType(GrapaVectorDType::INT64) || !b.SetDType(GrapaVectorDType::INT64)))
+			dtype = GrapaVectorDType::FLOAT64;
+		u64 m = 0, k = 0, n = 0, len = 0;
+		if (mDim == 1 && bi.mDim == 2 && mCounts[0] == bi.mCounts[0])
+		{
+			m = 1; k = mCounts[0]; n = len = bi.mCounts[1];
+		}
+		else if (mDim == 2 && bi.mDim == 1 && mCounts[1] == bi.mCounts[0])
+		{
+			m = len = mCounts[0]; k = mCounts[1]; n = 1;
+		}
+		else if (mDim == 2 && bi.mDim == 2 && mCounts[1] == bi.mCounts[0])
+		{
+			m = mCounts[0]; k = mCounts[1]; n = bi.mCounts[1];
+		}
+		if (m && _vectornativedot(a, b, dtype, m, k, n, result))
+		{
+			if (len)
+			{
+				result.mDim = 1;
+				result.mCounts[0] = len;
+			}
+			return 0;
+		}
+		a.SetDType(GrapaVectorDType::DEFAULT);
+		b.SetDType(GrapaVectorDType::DEFAULT);
+		GrapaError err = a.Dot(pScriptExec, pNameSpace, b, result);
+		if (!err && !result.SetDType(dtype))
+			result.SetDType(GrapaVectorDType::FLOAT64);
+		return err;
+	}
 	GrapaInt t;
 	GrapaRuleQueue params;
 	GrapaRuleEvent* ap;
@@ -1419,6 +2904,8 @@ GrapaError GrapaVector::Dot(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace
 			result.mSize = result.mCounts[0] * result.mCounts[1];
 			result.mData = (GrapaVectorItem*)GrapaMem::Create(result.mBlock * result.mSize);
 			memset(result.mData, 0, result.mBlock * result.mSize);
+			if (_vectordotfloats(pScriptExec, *this, bi, result))
+				break;
 			for (u64 i = 0; i < mCounts[0]; i++)
 			{
 				for (u64 j = 0; j < bi.mCounts[1]; j++)
@@ -1466,6 +2953,15 @@ GrapaError GrapaVector::Dot(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace
 
 GrapaError GrapaVector::Mul(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, const GrapaVector& bi, bool pDiv)
 {
+	GrapaError err = -1;
+	if (_nativeop(bi, pDiv ? GrapaVectorOp::DIV : GrapaVectorOp::MUL, err))
+		return err;
+	if (bi.mDType)
+	{
+		GrapaVector b(bi);
+		b.SetDType(GrapaVectorDType::DEFAULT);
+		return Mul(pScriptExec, pNameSpace, b, pDiv);
+	}
 	GrapaInt t;
 	GrapaRuleQueue params;
 	GrapaRuleEvent* ap;
@@ -1595,6 +3091,15 @@ GrapaError GrapaVector::Mul(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace
 
 GrapaError GrapaVector::Pow(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, const GrapaVector& bi, bool pRoot)
 {
+	GrapaError err = -1;
+	if (_nativeop(bi, pRoot ? GrapaVectorOp::ROOT : GrapaVectorOp::POW, err))
+		return err;
+	if (bi.mDType)
+	{
+		GrapaVector b(bi);
+		b.SetDType(GrapaVectorDType::DEFAULT);
+		return Pow(pScriptExec, pNameSpace, b, pRoot);
+	}
 	GrapaInt t;
 	GrapaRuleQueue params;
 	GrapaRuleEvent* ap;
@@ -1726,6 +3231,15 @@ GrapaError GrapaVector::Pow(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace
 
 GrapaError GrapaVector::Add(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, const GrapaVector& bi, bool pSub)
 {
+	GrapaError err = -1;
+	if (_nativeop(bi, pSub ? GrapaVectorOp::SUB : GrapaVectorOp::ADD, err))
+		return err;
+	if (bi.mDType)
+	{
+		GrapaVector b(bi);
+		b.SetDType(GrapaVectorDType::DEFAULT);
+		return Add(pScriptExec, pNameSpace, b, pSub);
+	}
 	GrapaInt t;
 	GrapaRuleQueue params;
 	GrapaRuleEvent* ap;
@@ -1855,6 +3369,15 @@ GrapaError GrapaVector::Add(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace
 
 GrapaError GrapaVector::Left(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, s64 pCount, GrapaVector& result)
 {
+	if (mDType)
+	{
+		GrapaVector boxed(*this);
+		boxed.SetDType(GrapaVectorDType::DEFAULT);
+		GrapaError err = boxed.Left(pScriptExec, pNameSpace, pCount, result);
+		if (!err)
+			result.SetDType(mDType);
+		return err;
+	}
 	if (mData == NULL)
 		return -1;
 	result.CLEAR();
@@ -1910,6 +3433,15 @@ GrapaError GrapaVector::Left(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpac
 
 GrapaError GrapaVector::Right(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, s64 pCount, GrapaVector& result)
 {
+	if (mDType)
+	{
+		GrapaVector boxed(*this);
+		boxed.SetDType(GrapaVectorDType::DEFAULT);
+		GrapaError err = boxed.Right(pScriptExec, pNameSpace, pCount, result);
+		if (!err)
+			result.SetDType(mDType);
+		return err;
+	}
 	if (mData == NULL)
 		return -1;
 	result.CLEAR();
@@ -1963,8 +3495,30 @@ GrapaError GrapaVector::Right(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpa
 	return 0;
 }
 
+// Native storage solves through LU in doubles. Default storage keeps the exact Gauss-Jordan
+// elimination, so integral answers stay integers; lu() gives a reusable factorisation there.
 GrapaError GrapaVector::Solve(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, GrapaVector& result)
 {
+	if (mDType && mDim == 2 && (mCounts[0] + 1) == mCounts[1])
+	{
+		GrapaVector left, right;
+		GrapaVectorFactor lu;
+		if (!Left(pScriptExec, pNameSpace, mCounts[0], left) && !Right(pScriptExec, pNameSpace, 1, right) && lu.FROM(pScriptExec, left, GrapaVectorFactorKind::LU) && !lu.Solve(pScriptExec, right, result))
+		{
+			if (mDType)
+				result.SetDType(GrapaVectorDType::FLOAT64);
+			return 0;
+		}
+	}
+	if (mDType)
+	{
+		GrapaVector boxed(*this);
+		boxed.SetDType(GrapaVectorDType::DEFAULT);
+		GrapaError err = boxed.Solve(pScriptExec, pNameSpace, result);
+		if (!err)
+			result.SetDType(GrapaVectorDType::FLOAT64);
+		return err;
+	}
 	if (mData == NULL)
 		return -1;
 	result.CLEAR();
@@ -1986,11 +3540,36 @@ GrapaError GrapaVector::Solve(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpa
 	return 0;
 }
 
+// Solves this.x = b by LU when square, or by QR in the least squares sense when taller than wide.
+GrapaError GrapaVector::Solve(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, const GrapaVector& b, GrapaVector& result)
+{
+	result.CLEAR();
+	if (mDim != 2 || mCounts[0] < mCounts[1])
+		return -1;
+	GrapaVectorFactor f;
+	if (!f.FROM(pScriptExec, *this, mCounts[0] == mCounts[1] ? GrapaVectorFactorKind::LU : GrapaVectorFactorKind::QR))
+		return -1;
+	return f.Solve(pScriptExec, b, result);
+}
+
 GrapaError GrapaVector::Cov(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, GrapaVector& result, bool isRows)
 {
+	if (mDType && _vectornativecov(*this, result, isRows))
+		return 0;
+	if (mDType)
+	{
+		GrapaVector boxed(*this);
+		boxed.SetDType(GrapaVectorDType::DEFAULT);
+		GrapaError err = boxed.Cov(pScriptExec, pNameSpace, result, isRows);
+		if (!err)
+			result.SetDType(GrapaVectorDType::FLOAT64);
+		return err;
+	}
 	result.CLEAR();
 	if (mData == NULL)
 		return -1;
+	if (mDim == 2 && _vectorfloatcov(pScriptExec, *this, result, isRows))
+		return 0;
 	if (mDim == 2)
 	{
 		GrapaVector v(*this);
@@ -2082,76 +3661,337 @@ GrapaError GrapaVector::Cov(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace
 GrapaError GrapaVector::Sum(GrapaScriptExec* pScriptExec, GrapaVector& result, bool isRows)
 {
 	result.CLEAR();
+	if (mDType && mDim == 2)
+		return _vectornativesum(*this, result, isRows, false);
+	if (mData == NULL)
+		return -1;
+	if (mDim == 2)
+		return _vectorfloatsum(pScriptExec, *this, result, isRows, false);
+	return -1;
+}
+
+GrapaError GrapaVector::Mean(GrapaScriptExec* pScriptExec, GrapaVector& result, bool isRows)
+{
+	result.CLEAR();
+	if (mDType && mDim == 2)
+		return _vectornativesum(*this, result, isRows, true);
 	if (mData == NULL)
 		return -1;
 	if (mDim == 2)
+		return _vectorfloatsum(pScriptExec, *this, result, isRows, true);
+	return -1;
+}
+
+GrapaError GrapaVector::Norm(GrapaScriptExec* pScriptExec, GrapaFloat& pResult)
+{
+	if (mDType)
+	{
+		GrapaVector x(*this);
+		if (x.SetDType(GrapaVectorDType::FLOAT64) && !_vectorf64hasnan((const d64*)x.mNative, x.mSize))
+		{
+			pResult = _vectorfromf64(sqrt(_vectorf64total((const d64*)x.mNative, x.mSize, true, true)));
+			return 0;
+		}
+		x.FROM(*this);
+		x.SetDType(GrapaVectorDType::DEFAULT);
+		return x.Norm(pScriptExec, pResult);
+	}
+	if (mData == NULL)
+		return -1;
+	pResult = _vectorfloatnorm(pScriptExec, *this);
+	return 0;
+}
+
+GrapaError GrapaVector::Cmp(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, const GrapaVector& bi, u8 pOp, GrapaVector& result)
+{
+	GrapaError err = -1;
+	result.FROM(*this);
+	if (result._nativeop(bi, pOp, err))
+		return err;
+	if (bi.mDType)
+	{
+		GrapaVector b(bi);
+		b.SetDType(GrapaVectorDType::DEFAULT);
+		return Cmp(pScriptExec, pNameSpace, b, pOp, result);
+	}
+	u64 rows, cols;
+	u8 mode;
+	if (mData == NULL || bi.mData == NULL || !_vectorbcast(*this, bi, rows, cols, mode))
+		return -1;
+	for (u64 i = 0; i < rows; i++)
 	{
-		u64 rows = isRows ? mCounts[1] : mCounts[0];
-		u64 cols = isRows ? mCounts[0] : mCounts[1];
-		result.mDim = isRows ? 2 : 1;
-		result.mSetBlock = mSetBlock;
-		result.mBlock = mBlock;
-		result.mMaxBlock = _minvectordatablock_;
-		result.mCounts = (u64*)GrapaMem::Create(sizeof(u64) * result.mDim);
-		result.mCounts[0] = cols;
-		if (isRows) result.mCounts[1] = 1;
-		result.mSize = cols;
-		result.mData = (GrapaVectorItem*)GrapaMem::Create(result.mBlock * result.mSize);
-		memset(result.mData, 0, result.mBlock * result.mSize);
 		for (u64 j = 0; j < cols; j++)
 		{
-			GrapaFloat sum(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0);
-			for (u64 i = 0; i < rows; i++)
+			GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * cols + j));
+			GrapaVectorParam p2(pScriptExec, bi.mData, bi.mBlock, _vectorbpos(mode, cols, i, j));
+			if (p1.d->isNull || p2.d->isNull)
 			{
-				u64 pos = isRows ? (j * mCounts[1] + i) : (i * mCounts[1] + j);
-				GrapaVectorParam p1(pScriptExec, mData, mBlock, (pos));
-				sum = sum + *p1.aa;
+				result.Set(i * cols + j);
+				continue;
 			}
-			result.Set(j, sum);
+			bool v = false;
+			switch (pOp)
+			{
+			case GrapaVectorOp::GT: v = *p1.aa > *p2.aa; break;
+			case GrapaVectorOp::GTEQ: v = *p1.aa >= *p2.aa; break;
+			case GrapaVectorOp::LT: v = *p1.aa < *p2.aa; break;
+			case GrapaVectorOp::LTEQ: v = *p1.aa <= *p2.aa; break;
+			}
+			GrapaInt t(v ? 1 : 0);
+			result.Set(i * cols + j, t);
 		}
-		return 0;
 	}
-	return -1;
+	return 0;
 }
 
-GrapaError GrapaVector::Mean(GrapaScriptExec* pScriptExec, GrapaVector& result, bool isRows)
+u8 GrapaVector::ToDType(const GrapaBYTE& pName)
 {
-	result.CLEAR();
-	if (mData == NULL)
-		return -1;
-	if (mDim == 2)
+	GrapaCHAR s(pName);
+	if (s.mLength == 0 || s.Cmp("default") == 0)
+		return GrapaVectorDType::DEFAULT;
+	if (s.Cmp("float64") == 0 || s.Cmp("float") == 0)
+		return GrapaVectorDType::FLOAT64;
+	if (s.Cmp("int64") == 0 || s.Cmp("int") == 0)
+		return GrapaVectorDType::INT64;
+	return 0xFF;
+}
+
+GrapaCHAR GrapaVector::DTypeName(u8 pDType)
+{
+	switch (pDType)
+	{
+	case GrapaVectorDType::FLOAT64: return GrapaCHAR("float64");
+	case GrapaVectorDType::INT64: return GrapaCHAR("int64");
+	}
+	return GrapaCHAR("default");
+}
+
+s64 GrapaVector::SumS64(const s64* a, u64 n)
+{
+	s64 sum;
+	_vectors64sum(a, n, sum);
+	return sum;
+}
+
+// Widens pMin and pMax to take in a[0..n). SSE2 has no 64 bit integer compare, so integers
+// take AVX2 or plain loops. NaN values are not ordered and may be skipped.
+void GrapaVector::BoundsS64(const s64* a, u64 n, s64& pMin, s64& pMax)
+{
+	u64 i = 0;
+#ifdef _vectoravx2_
+	if (_vectorhasavx2())
+		i = _vectors64boundsavx2(a, n, pMin, pMax);
+#endif
+	for (; i < n; i++)
+	{
+		if (a[i] < pMin) pMin = a[i];
+		if (a[i] > pMax) pMax = a[i];
+	}
+}
+
+void GrapaVector::BoundsF64(const d64* a, u64 n, d64& pMin, d64& pMax)
+{
+	u64 i = 0;
+#ifdef _vectoravx2_
+	if (_vectorhasavx2())
+		i = _vectorf64boundsavx2(a, n, pMin, pMax);
+	else
+#endif
+#ifdef _vectorsse2_
+		i = _vectorf64boundssse2(a, n, pMin, pMax);
+#endif
+	for (; i < n; i++)
+	{
+		if (a[i] < pMin) pMin = a[i];
+		if (a[i] > pMax) pMax = a[i];
+	}
+}
+
+// Converts the storage in place. Going native fails (leaving the vector untouched) when an item
+// has no float64/int64 form: strings, ops, or for int64 a fraction or more than 63 bits. Nulls
+// become NaN for float64 and fail for int64; NaN and infinities come back as null.
+bool GrapaVector::SetDType(u8 pDType)
+{
+	if (pDType == mDType)
+		return true;
+	if (pDType > GrapaVectorDType::INT64)
+		return false;
+	if (pDType == GrapaVectorDType::DEFAULT)
+	{
+		GrapaVectorItem* data = (GrapaVectorItem*)GrapaMem::Create(_minvectorblock_ * (mSize ? mSize : 1));
+		memset(data, 0, _minvectorblock_ * (mSize ? mSize : 1));
+		void* native = mNative;
+		u8 dtype = mDType;
+		mData = data;
+		mNative = NULL;
+		mDType = GrapaVectorDType::DEFAULT;
+		mBlock = _minvectorblock_;
+		mMaxBlock = _minvectordatablock_;
+		for (u64 i = 0; i < mSize; i++)
+		{
+			if (dtype == GrapaVectorDType::INT64)
+			{
+				GrapaInt t(((s64*)native)[i]);
+				Set(i, t);
+			}
+			else if (std::isfinite(((d64*)native)[i]))
+				Set(i, _vectorfromf64(((d64*)native)[i]));
+			else
+				Set(i);
+		}
+		GrapaMem::Delete(native);
+		return true;
+	}
+	u64* native = (u64*)GrapaMem::Create(sizeof(u64) * (mSize ? mSize : 1));
+	for (u64 i = 0; i < mSize; i++)
+	{
+		bool ok = true;
+		if (mDType == GrapaVectorDType::DEFAULT)
+		{
+			GrapaBYTE v;
+			if (!_vectoritem(_datavectorpos(mData, mBlock, i), v))
+			{
+				ok = pDType == GrapaVectorDType::FLOAT64;
+				((d64*)native)[i] = NAN;
+			}
+			else if (pDType == GrapaVectorDType::FLOAT64)
+				ok = _vectortof64(v, ((d64*)native)[i]);
+			else
+				ok = _vectortos64(v, ((s64*)native)[i]);
+		}
+		else if (pDType == GrapaVectorDType::FLOAT64)
+			((d64*)native)[i] = (d64)((s64*)mNative)[i];
+		else
+		{
+			d64 v = ((d64*)mNative)[i];
+			ok = v == trunc(v) && v >= -9223372036854775808.0 && v < 9223372036854775808.0;
+			if (ok)
+				((s64*)native)[i] = (s64)v;
+		}
+		if (!ok)
+		{
+			GrapaMem::Delete(native);
+			return false;
+		}
+	}
+	if (mDType == GrapaVectorDType::DEFAULT)
+	{
+		GrapaVector items;
+		items.mData = mData;
+		items.mSize = mSize;
+		items.mBlock = mBlock;
+		mData = NULL;
+		mBlock = _minvectorblock_;
+		mMaxBlock = _minvectordatablock_;
+	}
+	else
+		GrapaMem::Delete(mNative);
+	mNative = native;
+	mDType = pDType;
+	return true;
+}
+
+GrapaRuleEvent* GrapaVector::_nativeget(u64 p)
+{
+	GrapaRuleEvent* val = NULL;
+	if (mDType == GrapaVectorDType::INT64)
+	{
+		GrapaInt t(((s64*)mNative)[p]);
+		val = new GrapaRuleEvent(0, GrapaCHAR(""), t.getBytes());
+	}
+	else if (std::isfinite(((d64*)mNative)[p]))
+		val = new GrapaRuleEvent(0, GrapaCHAR(""), _vectorfromf64(((d64*)mNative)[p]).getBytes());
+	else
+	{
+		val = new GrapaRuleEvent();
+		val->mNull = true;
+	}
+	return val;
+}
+
+// Returns false when this vector is not native, in which case the caller runs the GrapaFloat
+// path. A default bi is converted to this vector's dtype; int64 widens to float64 when bi holds
+// fractions, for division, roots, and negative powers, and when an int64 result overflows.
+// GT..LTEQ leave an int64 0/1 mask. Shapes that do not broadcast leave this vector untouched.
+bool GrapaVector::_nativeop(const GrapaVector& bi, u8 pOp, GrapaError& pErr)
+{
+	pErr = -1;
+	if (mDType == GrapaVectorDType::DEFAULT)
+		return false;
+	u64 rows, cols;
+	u8 mode;
+	if (!_vectorbcast(*this, bi, rows, cols, mode))
+		return true;
+	GrapaVector b(bi);
+	if (b.mDType == GrapaVectorDType::DEFAULT && !b.SetDType(mDType))
+	{
+		if (mDType != GrapaVectorDType::INT64 || !b.SetDType(GrapaVectorDType::FLOAT64))
+		{
+			SetDType(GrapaVectorDType::DEFAULT);
+			return false;
+		}
+	}
+	u8 dtype = mDType;
+	if (b.mDType == GrapaVectorDType::FLOAT64 || pOp == GrapaVectorOp::DIV || pOp == GrapaVectorOp::ROOT)
+		dtype = GrapaVectorDType::FLOAT64;
+	if (dtype == GrapaVectorDType::INT64 && pOp == GrapaVectorOp::POW)
 	{
-		u64 rows = isRows ? mCounts[1] : mCounts[0];
-		u64 cols = isRows ? mCounts[0] : mCounts[1];
-		result.mDim = isRows ? 2 : 1;
-		result.mSetBlock = mSetBlock;
-		result.mBlock = mBlock;
-		result.mMaxBlock = _minvectordatablock_;
-		result.mCounts = (u64*)GrapaMem::Create(sizeof(u64) * result.mDim);
-		result.mCounts[0] = cols;
-		if (isRows) result.mCounts[1] = 1;
-		result.mSize = cols;
-		result.mData = (GrapaVectorItem*)GrapaMem::Create(result.mBlock * result.mSize);
-		memset(result.mData, 0, result.mBlock * result.mSize);
-		for (u64 j = 0; j < cols; j++)
+		for (u64 i = 0; i < b.mSize; i++)
 		{
-			GrapaFloat sum(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0);
-			for (u64 i = 0; i < rows; i++)
+			if (((s64*)b.mNative)[i] < 0)
 			{
-				u64 pos = isRows ? (j * mCounts[1] + i) : (i * mCounts[1] + j);
-				GrapaVectorParam p1(pScriptExec, mData, mBlock, (pos));
-				sum = sum + *p1.aa;
+				dtype = GrapaVectorDType::FLOAT64;
+				break;
 			}
-			result.Set(j, sum/rows);
 		}
-		return 0;
 	}
-	return -1;
+	SetDType(dtype);
+	b.SetDType(dtype);
+	bool isCmp = pOp >= GrapaVectorOp::GT && pOp <= GrapaVectorOp::LTEQ;
+	// int64 results go to a new buffer, so an overflow can start over from the operands.
+	bool isNew = isCmp || dtype == GrapaVectorDType::INT64;
+	u64* out = isNew ? (u64*)GrapaMem::Create(sizeof(u64) * (mSize ? mSize : 1)) : (u64*)mNative;
+	u64* a = (u64*)mNative;
+	u64* bb = (u64*)b.mNative;
+	if (mode == GrapaVectorBCast::SCALAR || mode == GrapaVectorBCast::FULL)
+	{
+		rows = 1;
+		cols = mSize;
+	}
+	bool bs = mode == GrapaVectorBCast::SCALAR || mode == GrapaVectorBCast::COL;
+	bool overflow = false;
+	for (u64 i = 0; i < rows && !overflow; i++)
+	{
+		u64 n = cols, p = i * cols;
+		u64* bp = bb + _vectorbpos(mode, cols, i, 0);
+		if (isCmp && dtype == GrapaVectorDType::FLOAT64)
+			_vectorf64cmp(pOp, (d64*)a + p, (d64*)bp, bs, (s64*)out + p, n);
+		else if (isCmp)
+			_vectors64cmp(pOp, (s64*)a + p, (s64*)bp, bs, (s64*)out + p, n);
+		else if (dtype == GrapaVectorDType::FLOAT64)
+			_vectorf64op(pOp, (d64*)a + p, (d64*)bp, bs, (d64*)out + p, n);
+		else
+			overflow = !_vectors64op(pOp, (s64*)a + p, (s64*)bp, bs, (s64*)out + p, n);
+	}
+	if (overflow)
+	{
+		GrapaMem::Delete(out);
+		SetDType(GrapaVectorDType::FLOAT64);
+		return _nativeop(bi, pOp, pErr);
+	}
+	if (isNew)
+	{
+		GrapaMem::Delete(mNative);
+		mNative = out;
+		mDType = GrapaVectorDType::INT64;
+	}
+	pErr = 0;
+	return true;
 }
 
 GrapaRuleEvent* GrapaVector::ToArray()
 {
-	if (mData == NULL)
+	if (mData == NULL && mNative == NULL)
 		return NULL;
 	u64 p = 0;
 	return _toarray(0, p);
@@ -2172,6 +4012,8 @@ GrapaRuleEvent* GrapaVector::_toarray(u64 pos, u64& p)
 		GrapaRuleEvent* val = NULL;
 		if ((pos + 1) < mDim)
 			val = _toarray(pos + 1, p);
+		else if (mNative)
+			val = _nativeget(p++);
 		else
 		{
 			GrapaVectorItem* d1 = _datavectorpos(mData, mBlock, p);
@@ -2215,7 +4057,7 @@ GrapaRuleEvent* GrapaVector::_toarray(u64 pos, u64& p)
 
 GrapaRuleEvent* GrapaVector::ToTuple()
 {
-	if (mData == NULL)
+	if (mData == NULL && mNative == NULL)
 		return NULL;
 	u64 p = 0;
 	return _totuple(0, p);
@@ -2236,6 +4078,8 @@ GrapaRuleEvent* GrapaVector::_totuple(u64 pos, u64& p)
 		GrapaRuleEvent* val = NULL;
 		if ((pos + 1) < mDim)
 			val = _totuple(pos + 1, p);
+		else if (mNative)
+			val = _nativeget(p++);
 		else
 		{
 			GrapaVectorItem* d1 = _datavectorpos(mData, mBlock, p);
@@ -2285,6 +4129,13 @@ GrapaBYTE GrapaVector::getBytes()
 
 bool GrapaVector::Extend(const GrapaVector& bi)
 {
+	GrapaVectorBox box(this);
+	if (bi.mDType)
+	{
+		GrapaVector b(bi);
+		b.SetDType(GrapaVectorDType::DEFAULT);
+		return Extend(b);
+	}
 	switch (mDim)
 	{
 	case 2:
@@ -2367,6 +4218,18 @@ GrapaRuleEvent* GrapaVector::Split(u64 num, u64 axis)
 {
 	GrapaRuleEvent* result = NULL;
 
+	if (mDType)
+	{
+		GrapaVector boxed(*this);
+		boxed.SetDType(GrapaVectorDType::DEFAULT);
+		result = boxed.Split(num, axis);
+		GrapaRuleEvent* ev = (result && result->vQueue) ? result->vQueue->Head() : NULL;
+		for (; ev; ev = ev->Next())
+			if (ev->vVector)
+				ev->vVector->SetDType(mDType);
+		return result;
+	}
+
 	if (mDim == 2)
 	{
 		result = new GrapaRuleEvent(0, GrapaCHAR(""), GrapaCHAR(""));
@@ -2476,6 +4339,18 @@ bool GrapaVector::Join(GrapaRuleEvent* event)
 {
 	CLEAR();
 
+	if (_vectorlistdtype(event, false))
+	{
+		GrapaRuleEvent* boxed = GrapaScriptExec::CopyItem(event);
+		u8 dtype = _vectorlistdtype(boxed, true);
+		bool ok = Join(boxed);
+		boxed->CLEAR();
+		delete boxed;
+		if (ok && !SetDType(dtype))
+			SetDType(GrapaVectorDType::FLOAT64);
+		return ok;
+	}
+
 	if (event == NULL || !(event->mValue.mToken == GrapaTokenType::ARRAY || event->mValue.mToken == GrapaTokenType::TUPLE || event->mValue.mToken == GrapaTokenType::LIST))
 		return false;
 
@@ -2572,6 +4447,18 @@ bool GrapaVector::JoinH(GrapaRuleEvent* event)
 {
 	CLEAR();
 
+	if (_vectorlistdtype(event, false))
+	{
+		GrapaRuleEvent* boxed = GrapaScriptExec::CopyItem(event);
+		u8 dtype = _vectorlistdtype(boxed, true);
+		bool ok = JoinH(boxed);
+		boxed->CLEAR();
+		delete boxed;
+		if (ok && !SetDType(dtype))
+			SetDType(GrapaVectorDType::FLOAT64);
+		return ok;
+	}
+
 	if (event == NULL || !(event->mValue.mToken == GrapaTokenType::ARRAY || event->mValue.mToken == GrapaTokenType::TUPLE || event->mValue.mToken == GrapaTokenType::LIST))
 		return false;
 
@@ -2770,6 +4657,18 @@ bool GrapaVector::Transpose()
 	if (mDim != 2)
 		return false;
 
+	if (mNative)
+	{
+		u64* native = (u64*)GrapaMem::Create(sizeof(u64) * (mSize ? mSize : 1));
+		_vectortranspose64((u64*)mNative, native, mCounts[0], mCounts[1]);
+		GrapaMem::Delete(mNative);
+		mNative = native;
+		u64 rows = mCounts[0];
+		mCounts[0] = mCounts[1];
+		mCounts[1] = rows;
+		return true;
+	}
+
 	GrapaVectorItem* data = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
 	memcpy(data, mData, mSize * mBlock);
 	u64* counts = (u64*)GrapaMem::Create(mDim * sizeof(u64));
@@ -2843,6 +4742,30 @@ bool GrapaVector::Sort(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, Gra
 {
 	pResult.CLEAR();
 
+	if (mDType || (pOther && pOther->mDType) || (pIndices && pIndices->mDType))
+	{
+		u8 dtype = mDType;
+		GrapaVector a(*this), o, x;
+		a.SetDType(GrapaVectorDType::DEFAULT);
+		if (pOther)
+		{
+			o.FROM(*pOther);
+			o.SetDType(GrapaVectorDType::DEFAULT);
+		}
+		if (pIndices)
+		{
+			x.FROM(*pIndices);
+			x.SetDType(GrapaVectorDType::DEFAULT);
+		}
+		bool ok = a.Sort(pScriptExec, pNameSpace, pOther ? &o : NULL, pIndices ? &x : NULL, pReturnIndices, rowvar, pZero, pDecend, pOp, pResult);
+		if (&pResult != this)
+			FROM(a);
+		SetDType(dtype);
+		if (ok && dtype)
+			pResult.SetDType(dtype);
+		return ok;
+	}
+
 	bool isT = false;
 	if (mDim == 1)
 	{
@@ -2916,780 +4839,1850 @@ bool GrapaVector::Sort(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, Gra
 		pResult.mCounts = (u64*)GrapaMem::Create(pResult.mDim * sizeof(u64));
 		if (rowvar)
 		{
-			pResult.mCounts[0] = pIndices->mCounts[0];
-			pResult.mCounts[1] = mCounts[1];
+			pResult.mCounts[0] = pIndices->mCounts[0];
+			pResult.mCounts[1] = mCounts[1];
+		}
+		else
+		{
+			pResult.mCounts[0] = mCounts[0];
+			pResult.mCounts[1] = pIndices->mCounts[0];
+		}
+		pResult.mSize = pResult.mCounts[0] * pResult.mCounts[1];
+		pResult.mData = (GrapaVectorItem*)GrapaMem::Create(pResult.mBlock * pResult.mSize);
+		memset(pResult.mData, 0, pResult.mBlock * pResult.mSize);
+
+		s64 rescols = rowvar ? (s64)pResult.mCounts[1] : (s64)pResult.mCounts[0];
+
+		for (u64 i = 0; i < pIndices->mCounts[0]; i++)
+		{
+			GrapaVectorParam p1(pScriptExec, pIndices->mData, pIndices->mBlock, (i));
+			s64 pos = -1;
+			GrapaCHAR posName;
+			GrapaRuleEvent* defaultValue = NULL;
+			if (!p1.d->isNull && p1.a)
+			{
+				u8 token = p1.d->isValue ? (p1.a->isRaw ? p1.a->b->mToken : p1.a->e->mValue.mToken) : p1.d->mToken;
+				if (token == GrapaTokenType::INT)
+				{
+					GrapaInt posInt = p1.aa->ToInt();
+					posName = posInt.ToString();
+					pos = posInt.LongValue();
+					if (pos < 0) pos = rowcount + pos;
+					if (pos < 0) pos = 0;
+					if (pos > rowcount) pos = rowcount;
+				}
+				else if (token == GrapaTokenType::STR || token == GrapaTokenType::ID)
+				{
+					GrapaRuleEvent* a = p1.a->Get();
+					if (a)
+					{
+						posName.FROM(a->mValue);
+						s64 index = 0;
+						GrapaRuleEvent* b = mLabels.Search(a->mValue, index);
+						if (b)
+							pos = index;
+						delete a;
+					}
+					else
+					{
+						posName.FROM("NULL");
+					}
+				}
+				else if (token == GrapaTokenType::LIST)
+				{
+					GrapaRuleEvent* a = p1.a->Get();
+					if (a && a->vQueue->mCount)
+					{
+						defaultValue = a;
+					}
+					else
+					{
+						delete a;
+						posName = GrapaInt(i).ToString();
+					}
+				}
+				else
+				{
+					posName = GrapaInt(i).ToString();
+				}
+			}
+			else
+			{
+				posName = GrapaInt(i).ToString();
+			}
+			if (pos >= 0 && pos < rowcount)
+			{
+				if (!rowvar)
+				{
+					GrapaRuleEvent* label = mLabels.Head(pos);
+					if (label)
+						pResult.mLabels.PushTail(pScriptExec->CopyItem(label));
+					else
+						pResult.mLabels.PushTail(new GrapaRuleEvent(0, posName, GrapaCHAR()));
+				}
+				for (s64 j = 0; j < rescols; j++)
+				{
+					GrapaVectorParam p1(pScriptExec, mData, mBlock, rowvar ? (pos * mCounts[1] + j) : (j * mCounts[1] + pos));
+					pResult.Set(rowvar ? i * pResult.mCounts[1] + j : j * pResult.mCounts[1] + i, p1);
+				}
+			}
+			else if (defaultValue)
+			{
+				if (!rowvar)
+				{
+					posName.FROM(defaultValue->vQueue->Head()->mName);
+					pResult.mLabels.PushTail(new GrapaRuleEvent(0, posName, GrapaCHAR()));
+				}
+				for (s64 j = 0; j < rescols; j++)
+				{
+					pResult.Set(rowvar ? i * pResult.mCounts[1] + j : j * pResult.mCounts[1] + i, defaultValue->vQueue->Head());
+				}
+			}
+			else
+			{
+				if (!rowvar)
+					pResult.mLabels.PushTail(new GrapaRuleEvent(0, posName,GrapaCHAR()));
+				for (s64 j = 0; j < rescols; j++)
+				{
+					pResult.Set(rowvar ? i * pResult.mCounts[1] + j : j * pResult.mCounts[1] + i);
+				}
+			}
+			if (defaultValue)
+			{
+				delete defaultValue;
+			}
+		}
+	}
+	else
+	{
+		GrapaRuleQueue pq;
+		{
+			pq.PushTail(new GrapaRuleEvent(GrapaTokenType::FLOAT, 0, "", ""));
+			pq.PushTail(new GrapaRuleEvent(GrapaTokenType::FLOAT, 0, "", ""));
+		}
+
+		GrapaVectorStruct* rows = (GrapaVectorStruct*)GrapaMem::Create(rowcount * sizeof(GrapaVectorStruct));
+		for (s64 i = 0; i < rowcount; i++)
+		{
+			rows[i].vScriptExec = pScriptExec;
+			rows[i].vNameSpace = pNameSpace;
+			rows[i].vOp = pOp;
+			rows[i].vParams = &pq;
+			rows[i].mData2 = mData;
+			rows[i].mBlock = mBlock;
+			rows[i].mZero = pZero;
+			rows[i].mDecend = pDecend;
+			rows[i].mRows = mCounts[0];
+			rows[i].mCols = mCounts[1];
+			if (rowvar)
+				rows[i].isCol = false;
+			else
+				rows[i].isCol = true;
+			rows[i].mPos = i;
+		}
+
+		qsort(rows, rowcount, sizeof(GrapaVectorStruct), GrapaVectorSort);
+
+		if (hasReturnIndices)
+		{
+			pReturnIndices->mDim = 1;
+			pReturnIndices->mBlock = _minvectorblock_;
+			pReturnIndices->mMaxBlock = _minvectordatablock_;
+			pReturnIndices->mSetBlock = 0;
+			pReturnIndices->mCounts = (u64*)GrapaMem::Create(pReturnIndices->mDim * sizeof(u64));
+			pReturnIndices->mCounts[0] = mCounts[0];
+			pReturnIndices->mSize = mCounts[0];
+			pReturnIndices->mData = (GrapaVectorItem*)GrapaMem::Create(pReturnIndices->mBlock * pReturnIndices->mSize);
+			for (u64 i = 0; i < mCounts[0]; i++)
+			{
+				GrapaFloat sum(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, rows[i].mPos);
+				pReturnIndices->Set(i, sum);
+			}
+		}
+		else
+		{
+			pResult.mDim = mDim;
+			pResult.mBlock = mBlock;
+			pResult.mMaxBlock = mMaxBlock;
+			pResult.mSetBlock = mSetBlock;
+			pResult.mCounts = (u64*)GrapaMem::Create(pResult.mDim * sizeof(u64));
+			pResult.mCounts[0] = mCounts[0];
+			pResult.mCounts[1] = mCounts[1];
+			pResult.mSize = pResult.mCounts[0] * pResult.mCounts[1];
+			pResult.mData = (GrapaVectorItem*)GrapaMem::Create(pResult.mBlock * pResult.mSize);
+			memset(pResult.mData, 0, pResult.mBlock* pResult.mSize);
+			GrapaVectorItem* dataOther = NULL;
+			if (hasOther)
+			{
+				dataOther = pOther->mData;
+				pOther->mData = (GrapaVectorItem*)GrapaMem::Create(pOther->mBlock * pOther->mSize);
+			}
+			for (s64 i = 0; i < rowcount; i++)
+			{
+				for (s64 j = 0; j < colcount; j++)
+				{
+					GrapaVectorParam p1(pScriptExec, mData, mBlock, rowvar ? (rows[i].mPos * mCounts[1] + j) : (j * mCounts[1] + rows[i].mPos));
+					pResult.Set(rowvar ? i * mCounts[1] + j : j * mCounts[1] + i, *p1.aa);
+				}
+				if (hasOther)
+				{
+					if (rowvar)
+						memcpy(_datavectorpos(pOther->mData, pOther->mBlock, (i * pOther->mCounts[1])), _datavectorpos(dataOther, pOther->mBlock, (rows[i].mPos * pOther->mCounts[1])), pOther->mBlock * pOther->mCounts[1]);
+					else
+						for (u64 j = 0; j < pOther->mCounts[0]; j++)
+							memcpy(_datavectorpos(pOther->mData, pOther->mBlock, (j * pOther->mCounts[1] + i)), _datavectorpos(dataOther, pOther->mBlock, (j * pOther->mCounts[1] + rows[i].mPos)), pOther->mBlock);
+
+				}
+			}
+			if (hasOther)
+				GrapaMem::Delete(dataOther);
+		}
+
+		GrapaMem::Delete(rows);
+	}
+
+	if (isT)
+	{
+		if (rowvar)
+		{
+			mDim = 1;
+			pResult.mDim = 1;
 		}
-		else
+		else if (mDim == 2 && mCounts[0] == 1)
 		{
-			pResult.mCounts[0] = mCounts[0];
-			pResult.mCounts[1] = pIndices->mCounts[0];
+			mCounts[0] = mCounts[1];
+			mDim = 1;
+			pResult.mCounts[0] = pResult.mCounts[1];
+			pResult.mDim = 1;
 		}
-		pResult.mSize = pResult.mCounts[0] * pResult.mCounts[1];
-		pResult.mData = (GrapaVectorItem*)GrapaMem::Create(pResult.mBlock * pResult.mSize);
-		memset(pResult.mData, 0, pResult.mBlock * pResult.mSize);
 
-		s64 rescols = rowvar ? (s64)pResult.mCounts[1] : (s64)pResult.mCounts[0];
+	}
 
-		for (u64 i = 0; i < pIndices->mCounts[0]; i++)
+	return true;
+}
+
+bool GrapaVector::Reverse(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace)
+{
+	GrapaVectorBox box(this);
+	if (mDim != 2)
+		return false;
+
+	GrapaVectorItem* data = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
+	memcpy(data, mData, mSize * mBlock);
+
+	for (u64 i = 0; i < mCounts[0]; i++)
+		memcpy(_datavectorpos(mData, mBlock, (i * mCounts[1])), _datavectorpos(data, mBlock, ((mCounts[0] - i - 1) * mCounts[1])), mBlock * mCounts[1]);
+
+	GrapaMem::Delete(data);
+
+	return true;
+}
+
+bool GrapaVector::Ref(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, bool reduce)
+{
+	GrapaVectorBox box(this);
+	if (mDim != 2)
+		return false;
+
+	for (u64 i = 0; i < mCounts[0] - 1; i++)
+	{
+		for (u64 j = 0; j < mCounts[1]; j++)
 		{
-			GrapaVectorParam p1(pScriptExec, pIndices->mData, pIndices->mBlock, (i));
-			s64 pos = -1;
-			GrapaCHAR posName;
-			GrapaRuleEvent* defaultValue = NULL;
-			if (!p1.d->isNull && p1.a)
+			GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + j));
+			if (p1.a && p1.aa->IsZero())
+				continue;
+			for (u64 l = i + 1; l < mCounts[0]; l++)
 			{
-				u8 token = p1.d->isValue ? (p1.a->isRaw ? p1.a->b->mToken : p1.a->e->mValue.mToken) : p1.d->mToken;
-				if (token == GrapaTokenType::INT)
-				{
-					GrapaInt posInt = p1.aa->ToInt();
-					posName = posInt.ToString();
-					pos = posInt.LongValue();
-					if (pos < 0) pos = rowcount + pos;
-					if (pos < 0) pos = 0;
-					if (pos > rowcount) pos = rowcount;
-				}
-				else if (token == GrapaTokenType::STR || token == GrapaTokenType::ID)
+				GrapaVectorParam p2(pScriptExec, mData, mBlock, (l * mCounts[1] + j));
+				Set((l * mCounts[1] + j), GrapaFloat(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0));
+				for (u64 m = j + 1; m < mCounts[1]; m++)
 				{
-					GrapaRuleEvent* a = p1.a->Get();
-					if (a)
-					{
-						posName.FROM(a->mValue);
-						s64 index = 0;
-						GrapaRuleEvent* b = mLabels.Search(a->mValue, index);
-						if (b)
-							pos = index;
-						delete a;
-					}
-					else
-					{
-						posName.FROM("NULL");
-					}
+					GrapaVectorParam p3(pScriptExec, mData, mBlock, (i * mCounts[1] + m));
+					GrapaVectorParam p4(pScriptExec, mData, mBlock, (l * mCounts[1] + m));
+					GrapaFloat f = (*p4.aa * *p1.aa) - (*p3.aa * *p2.aa);
+					Set((l * mCounts[1] + m), f);
 				}
-				else if (token == GrapaTokenType::LIST)
+			}
+			break;
+		}
+	}
+
+	if (reduce)
+	{
+		GrapaVector vv(*this);
+		vv.Sort(pScriptExec, pNameSpace, NULL, NULL, NULL, true, true, true, NULL, *this);
+		for (u64 i = 0; i < mCounts[0]; i++)
+		{
+			for (u64 j = 0; j < mCounts[1]; j++)
+			{
+				GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + j));
+				if (p1.a && p1.aa->IsZero())
 				{
-					GrapaRuleEvent* a = p1.a->Get();
-					if (a && a->vQueue->mCount)
-					{
-						defaultValue = a;
-					}
-					else
+					if (j + 1 == mCounts[1])
 					{
-						delete a;
-						posName = GrapaInt(i).ToString();
+						for (u64 k = i * mCounts[1]; k < mSize; k++)
+						{
+							GrapaVectorItem* d1 = _datavectorpos(mData, mBlock, k);
+							if (d1->isValue)
+							{
+								GrapaVectorValue* d = 0L;
+								memcpy(&d, d1->d, sizeof(GrapaVectorValue*));
+								d1->isValue = 0;
+								d1->isNull = 0;
+								d1->mLen = 0;
+								d1->mToken = 0;
+								if (d)
+								{
+									d->CLEAR();
+									delete d;
+								}
+							}
+						}
+						mCounts[0] = i;
+						mSize = mCounts[0] * mCounts[1];
+						GrapaVectorItem* data = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
+						memcpy(data, mData, mSize * mBlock);
+						GrapaMem::Delete(mData);
+						mData = data;
 					}
 				}
 				else
 				{
-					posName = GrapaInt(i).ToString();
+					j = mCounts[1];
 				}
 			}
-			else
-			{
-				posName = GrapaInt(i).ToString();
-			}
-			if (pos >= 0 && pos < rowcount)
+		}
+	}
+
+	return true;
+}
+
+bool GrapaVector::Rref(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace)
+{
+	GrapaVectorBox box(this);
+	if (mDim != 2)
+		return false;
+
+	for (u64 i = 0; i < mCounts[0]-1; i++)
+	{
+		GrapaVector vv(*this);
+		vv.Sort(pScriptExec, pNameSpace, NULL, NULL, NULL, true, true, true, NULL, *this);
+		for (u64 j = 0; j < mCounts[1]; j++)
+		{
+			GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + j));
+			if (p1.a && p1.aa->IsZero())
+				continue;
+			for (u64 l = i + 1; l < mCounts[0]; l++)
 			{
-				if (!rowvar)
-				{
-					GrapaRuleEvent* label = mLabels.Head(pos);
-					if (label)
-						pResult.mLabels.PushTail(pScriptExec->CopyItem(label));
-					else
-						pResult.mLabels.PushTail(new GrapaRuleEvent(0, posName, GrapaCHAR()));
-				}
-				for (s64 j = 0; j < rescols; j++)
+				GrapaVectorParam p2(pScriptExec, mData, mBlock, (l * mCounts[1] + j));
+				Set((l * mCounts[1] + j), GrapaFloat(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0));
+				for (u64 m = j+1; m < mCounts[1]; m++)
 				{
-					GrapaVectorParam p1(pScriptExec, mData, mBlock, rowvar ? (pos * mCounts[1] + j) : (j * mCounts[1] + pos));
-					pResult.Set(rowvar ? i * pResult.mCounts[1] + j : j * pResult.mCounts[1] + i, p1);
+					GrapaVectorParam p3(pScriptExec, mData, mBlock, (i * mCounts[1] + m));
+					GrapaVectorParam p4(pScriptExec, mData, mBlock, (l * mCounts[1] + m));
+					GrapaFloat f = (*p4.aa * *p1.aa) - (*p3.aa * *p2.aa);
+					Set((l * mCounts[1] + m), f);
 				}
 			}
-			else if (defaultValue)
+			break;
+		}
+	}
+	for (u64 i = 0; i < mCounts[0]; i++)
+	{
+		for (u64 j = 0; j < mCounts[1]; j++)
+		{
+			GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + j));
+			if (p1.a && p1.aa->IsZero())
 			{
-				if (!rowvar)
-				{
-					posName.FROM(defaultValue->vQueue->Head()->mName);
-					pResult.mLabels.PushTail(new GrapaRuleEvent(0, posName, GrapaCHAR()));
-				}
-				for (s64 j = 0; j < rescols; j++)
+				if (j + 1 == mCounts[1])
 				{
-					pResult.Set(rowvar ? i * pResult.mCounts[1] + j : j * pResult.mCounts[1] + i, defaultValue->vQueue->Head());
+					for (u64 k = i * mCounts[1]; k < mSize; k++)
+					{
+						GrapaVectorItem* d1 = _datavectorpos(mData, mBlock, k);
+						if (d1->isValue)
+						{
+							GrapaVectorValue* d = 0L;
+							memcpy(&d, d1->d, sizeof(GrapaVectorValue*));
+							d1->isValue = 0;
+							d1->isNull = 0;
+							d1->mLen = 0;
+							d1->mToken = 0;
+							if (d)
+							{
+								d->CLEAR();
+								delete d;
+							}
+						}
+					}
+					mCounts[0] = i;
+					mSize = mCounts[0] * mCounts[1];
+					GrapaVectorItem* data = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
+					memcpy(data, mData, mSize * mBlock);
+					GrapaMem::Delete(mData);
+					mData = data;
 				}
 			}
 			else
 			{
-				if (!rowvar)
-					pResult.mLabels.PushTail(new GrapaRuleEvent(0, posName,GrapaCHAR()));
-				for (s64 j = 0; j < rescols; j++)
+				j = mCounts[1];
+			}
+		}
+	}
+
+	for (s64 i = mCounts[0] - 1; i >= 0; i--)
+	{
+		GrapaVector vv(*this);
+		vv.Sort(pScriptExec, pNameSpace, NULL, NULL, NULL, true, true, true, NULL, *this);
+		for (u64 j = 0; j < mCounts[1]; j++)
+		{
+			GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + j));
+			if (p1.a && p1.aa->IsZero())
+				continue;
+			for (u64 m = j + 1; m < mCounts[1]; m++)
+			{
+				GrapaVectorParam p3(pScriptExec, mData, mBlock, (i * mCounts[1] + m));
+				GrapaFloat f = (*p3.aa / *p1.aa);
+				Set((i * mCounts[1] + m), f);
+			}
+			Set((i * mCounts[1] + j), GrapaFloat(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 1));
+			for (s64 n = i - 1; n >= 0; n--)
+			{
+				GrapaVectorParam p2(pScriptExec, mData, mBlock, (n * mCounts[1] + j));
+				for (u64 m = j + 1; m < mCounts[1]; m++)
 				{
-					pResult.Set(rowvar ? i * pResult.mCounts[1] + j : j * pResult.mCounts[1] + i);
+					GrapaVectorParam p3(pScriptExec, mData, mBlock, (n * mCounts[1] + m));
+					GrapaVectorParam p4(pScriptExec, mData, mBlock, (i * mCounts[1] + m));
+					GrapaFloat f = *p3.aa - *p2.aa * *p4.aa;
+					Set((n * mCounts[1] + m), f);
 				}
+				Set((n * mCounts[1] + j), GrapaFloat(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0));
 			}
-			if (defaultValue)
-			{
-				delete defaultValue;
-			}
+			break;
 		}
 	}
-	else
+
+	return true;
+}
+
+// Native storage inverts through LU, default storage by exact Gauss-Jordan, as Solve does.
+bool GrapaVector::Inv(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace)
+{
+	if (mDType && mDim == 2 && mCounts[0] == mCounts[1])
 	{
-		GrapaRuleQueue pq;
+		GrapaVectorFactor lu;
+		GrapaVector r;
+		if (lu.FROM(pScriptExec, *this, GrapaVectorFactorKind::LU) && lu.Inv(pScriptExec, r))
 		{
-			pq.PushTail(new GrapaRuleEvent(GrapaTokenType::FLOAT, 0, "", ""));
-			pq.PushTail(new GrapaRuleEvent(GrapaTokenType::FLOAT, 0, "", ""));
+			if (mDType)
+				r.SetDType(GrapaVectorDType::FLOAT64);
+			FROM(r);
+			return true;
 		}
+	}
+	GrapaVectorBox box(this);
+	if (mDim != 2)
+		return false;
 
-		GrapaVectorStruct* rows = (GrapaVectorStruct*)GrapaMem::Create(rowcount * sizeof(GrapaVectorStruct));
-		for (s64 i = 0; i < rowcount; i++)
+	if (mCounts[0] != mCounts[1])
+		return false;
+
+	GrapaVectorItem* data = mData;
+	mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize * 2);
+	for (u64 i = 0; i < mCounts[0]; i++)
+	{
+		memcpy(_datavectorpos(mData, mBlock, (i * mCounts[1] * 2)), _datavectorpos(data, mBlock, (i * mCounts[1])), mCounts[1] * mBlock);
+		for (u64 j = 0; j < mCounts[1]; j++)
 		{
-			rows[i].vScriptExec = pScriptExec;
-			rows[i].vNameSpace = pNameSpace;
-			rows[i].vOp = pOp;
-			rows[i].vParams = &pq;
-			rows[i].mData2 = mData;
-			rows[i].mBlock = mBlock;
-			rows[i].mZero = pZero;
-			rows[i].mDecend = pDecend;
-			rows[i].mRows = mCounts[0];
-			rows[i].mCols = mCounts[1];
-			if (rowvar)
-				rows[i].isCol = false;
+			if (i==j)
+				Set((i * mCounts[1] * 2 + mCounts[1] + j), GrapaFloat(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 1));
 			else
-				rows[i].isCol = true;
-			rows[i].mPos = i;
+				Set((i * mCounts[1] * 2 + mCounts[1] + j), GrapaFloat(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0));
 		}
+	}
+	GrapaMem::Delete(data);
+	mSize *= 2;
+	mCounts[1] *= 2;
 
-		qsort(rows, rowcount, sizeof(GrapaVectorStruct), GrapaVectorSort);
+	Rref(pScriptExec, pNameSpace);
 
-		if (hasReturnIndices)
-		{
-			pReturnIndices->mDim = 1;
-			pReturnIndices->mBlock = _minvectorblock_;
-			pReturnIndices->mMaxBlock = _minvectordatablock_;
-			pReturnIndices->mSetBlock = 0;
-			pReturnIndices->mCounts = (u64*)GrapaMem::Create(pReturnIndices->mDim * sizeof(u64));
-			pReturnIndices->mCounts[0] = mCounts[0];
-			pReturnIndices->mSize = mCounts[0];
-			pReturnIndices->mData = (GrapaVectorItem*)GrapaMem::Create(pReturnIndices->mBlock * pReturnIndices->mSize);
-			for (u64 i = 0; i < mCounts[0]; i++)
-			{
-				GrapaFloat sum(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, rows[i].mPos);
-				pReturnIndices->Set(i, sum);
-			}
-		}
-		else
-		{
-			pResult.mDim = mDim;
-			pResult.mBlock = mBlock;
-			pResult.mMaxBlock = mMaxBlock;
-			pResult.mSetBlock = mSetBlock;
-			pResult.mCounts = (u64*)GrapaMem::Create(pResult.mDim * sizeof(u64));
-			pResult.mCounts[0] = mCounts[0];
-			pResult.mCounts[1] = mCounts[1];
-			pResult.mSize = pResult.mCounts[0] * pResult.mCounts[1];
-			pResult.mData = (GrapaVectorItem*)GrapaMem::Create(pResult.mBlock * pResult.mSize);
-			memset(pResult.mData, 0, pResult.mBlock* pResult.mSize);
-			GrapaVectorItem* dataOther = NULL;
-			if (hasOther)
-			{
-				dataOther = pOther->mData;
-				pOther->mData = (GrapaVectorItem*)GrapaMem::Create(pOther->mBlock * pOther->mSize);
-			}
-			for (s64 i = 0; i < rowcount; i++)
-			{
-				for (s64 j = 0; j < colcount; j++)
-				{
-					GrapaVectorParam p1(pScriptExec, mData, mBlock, rowvar ? (rows[i].mPos * mCounts[1] + j) : (j * mCounts[1] + rows[i].mPos));
-					pResult.Set(rowvar ? i * mCounts[1] + j : j * mCounts[1] + i, *p1.aa);
-				}
-				if (hasOther)
-				{
-					if (rowvar)
-						memcpy(_datavectorpos(pOther->mData, pOther->mBlock, (i * pOther->mCounts[1])), _datavectorpos(dataOther, pOther->mBlock, (rows[i].mPos * pOther->mCounts[1])), pOther->mBlock * pOther->mCounts[1]);
-					else
-						for (u64 j = 0; j < pOther->mCounts[0]; j++)
-							memcpy(_datavectorpos(pOther->mData, pOther->mBlock, (j * pOther->mCounts[1] + i)), _datavectorpos(dataOther, pOther->mBlock, (j * pOther->mCounts[1] + rows[i].mPos)), pOther->mBlock);
+	mSize /= 2;
+	mCounts[1] /= 2;
+	data = mData;
+	mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
+	for (u64 i = 0; i < mCounts[0]; i++)
+		memcpy(_datavectorpos(mData, mBlock, (i * mCounts[1])), _datavectorpos(data, mBlock, (i * mCounts[1] * 2 + mCounts[1])), mCounts[1] * mBlock);
+	GrapaMem::Delete(data);
 
-				}
-			}
-			if (hasOther)
-				GrapaMem::Delete(dataOther);
-		}
+	return true;
+}
 
-		GrapaMem::Delete(rows);
+// https://www.codesansar.com/c-programming-examples/matrix-determinant.htm
+// https://cpp.hotexamples.com/examples/-/Matrix/Det/cpp-matrix-det-method-examples.html
+
+GrapaFloat GrapaVector::Determinant(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace)
+{
+	GrapaFloat f(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 1);
+
+	if (mDim!=2 || mCounts[0] != mCounts[1])
+	{
+		f.FromInt(0);
+		return(f);
 	}
 
-	if (isT)
+	GrapaVectorFactor lu;
+	if (lu.FROM(pScriptExec, *this, GrapaVectorFactorKind::LU) && lu.Determinant(pScriptExec, f))
+		return f;
+
+	GrapaVector v(*this);
+	v.SetDType(GrapaVectorDType::DEFAULT);
+
+	bool isErr = false;
+
+	// Gauss Elimination, transforming matrix to upper triangular matrix
+
+	for (u64 i = 0; i < v.mCounts[0]; i++)
 	{
-		if (rowvar)
+		GrapaVectorParam p1(pScriptExec, v.mData, v.mBlock, (i * v.mCounts[1] + i));
+		if (p1.aa->IsZero())
 		{
-			mDim = 1;
-			pResult.mDim = 1;
+			isErr = true;
+			break;
 		}
-		else if (mDim == 2 && mCounts[0] == 1)
+		for (u64 j = i + 1; j < v.mCounts[0]; j++)
 		{
-			mCounts[0] = mCounts[1];
-			mDim = 1;
-			pResult.mCounts[0] = pResult.mCounts[1];
-			pResult.mDim = 1;
+			GrapaVectorParam p2(pScriptExec, v.mData, v.mBlock, (j * v.mCounts[1] + i));
+			f = *p2.aa / *p1.aa;
+
+			for (u64 k = 0; k < mCounts[1]; k++)
+			{
+				GrapaVectorParam p3(pScriptExec, v.mData, v.mBlock, (j * v.mCounts[1] + k));
+				GrapaVectorParam p4(pScriptExec, v.mData, v.mBlock, (i * v.mCounts[1] + k));
+				v.Set((j * mCounts[1] + k), *p3.aa - f * *p4.aa);
+			}
 		}
+	}
 
+	if (isErr)
+	{
+		f.FromInt(0);
+		return(f);
 	}
 
-	return true;
+	f.FromInt(1);
+
+	for (u64 i = 0; i < v.mCounts[0]; i++)
+	{
+		GrapaVectorParam p1(pScriptExec, v.mData, v.mBlock, (i * v.mCounts[1] + i));
+		f = f * *p1.aa;
+	}
+
+	return f;
 }
 
-bool GrapaVector::Reverse(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace)
+GrapaInt GrapaVector::Rank(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace)
 {
 	if (mDim != 2)
-		return false;
+		return 0;
 
-	GrapaVectorItem* data = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
-	memcpy(data, mData, mSize * mBlock);
+	GrapaVector v(*this);
+	v.SetDType(GrapaVectorDType::DEFAULT);
+	v.Ref(pScriptExec, pNameSpace, true);
 
-	for (u64 i = 0; i < mCounts[0]; i++)
-		memcpy(_datavectorpos(mData, mBlock, (i * mCounts[1])), _datavectorpos(data, mBlock, ((mCounts[0] - i - 1) * mCounts[1])), mBlock * mCounts[1]);
+	return v.mCounts[0];
+}
 
-	GrapaMem::Delete(data);
+void GrapaVector::Identity(GrapaScriptExec* pScriptExec, u64 n)
+{
+	CLEAR();
+	GrapaFloat zero(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0);
+	GrapaFloat one(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 1);
+	mBlock = _minvectorblock_;
+	mMaxBlock = _minvectordatablock_;
+	mSetBlock = 0;
+	mDim = 2;
+	mCounts = (u64*)GrapaMem::Create(mDim * sizeof(u64));
+	mCounts[0] = n;
+	mCounts[1] = n;
+	mSize = n * n;
+	mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
+	for (u64 i = 0; i < n; i++)
+	{
+		for (u64 j = 0; j < n; j++)
+		{
+			if (i==j)
+				Set((i * mCounts[1] + j), one);
+			else
+				Set((i * mCounts[1] + j), zero);
+		}
+	}
+}
 
+bool GrapaVector::Diagonal(GrapaScriptExec* pScriptExec, s64 n, GrapaVector& result)
+{
+	if (mDType)
+	{
+		GrapaVector boxed(*this);
+		boxed.SetDType(GrapaVectorDType::DEFAULT);
+		bool ok = boxed.Diagonal(pScriptExec, n, result);
+		if (ok)
+			result.SetDType(mDType);
+		return ok;
+	}
+	result.CLEAR();
+	if (mDim != 2)
+		return false;
+	result.mBlock = _minvectorblock_;
+	result.mMaxBlock = _minvectordatablock_;
+	result.mSetBlock = 0;
+	result.mDim = 1;
+	u64 size = 0;
+	if (n >= 0)
+	{
+		size = mCounts[1];
+		if (n > (s64)size)
+			size = 0;
+		else
+			size -= n;
+		if (size > mCounts[0])
+			size = mCounts[0];
+	}
+	else
+	{
+		size = mCounts[0];
+		if ((-n) > (s64)size)
+			size = 0;
+		else
+			size += n;
+		if (size > mCounts[1])
+			size = mCounts[1];
+	}
+	result.mSize = size;
+	result.mCounts = (u64*)GrapaMem::Create(result.mDim * sizeof(u64));
+	result.mCounts[0] = size;
+	result.mData = (GrapaVectorItem*)GrapaMem::Create(result.mBlock * result.mSize);
+	if (n >= 0)
+	{
+		for (u64 i = 0; i < size; i++)
+		{
+			GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + i + n));
+			result.Set((i), *p1.aa);
+		}
+	}
+	else
+	{
+		for (u64 i = 0; i < size; i++)
+		{
+			GrapaVectorParam p1(pScriptExec, mData, mBlock, ((i-n) * mCounts[1] + i));
+			result.Set((i), *p1.aa);
+		}
+	}
 	return true;
 }
 
-bool GrapaVector::Ref(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, bool reduce)
+bool GrapaVector::TriU(GrapaScriptExec* pScriptExec, s64 n, GrapaVector& result)
 {
+	if (mDType)
+	{
+		GrapaVector boxed(*this);
+		boxed.SetDType(GrapaVectorDType::DEFAULT);
+		bool ok = boxed.TriU(pScriptExec, n, result);
+		if (ok)
+			result.SetDType(mDType);
+		return ok;
+	}
+	result.CLEAR();
 	if (mDim != 2)
 		return false;
-
-	for (u64 i = 0; i < mCounts[0] - 1; i++)
+	GrapaFloat zero(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0);
+	result.mBlock = mBlock;
+	result.mMaxBlock = mMaxBlock;
+	result.mSetBlock = 0;
+	result.mDim = 2;
+	result.mCounts = (u64*)GrapaMem::Create(mDim * sizeof(u64));
+	result.mCounts[0] = mCounts[0];
+	result.mCounts[1] = mCounts[1];
+	result.mSize = mCounts[0] * mCounts[1];
+	result.mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
+	memset(result.mData, 0, mSize * mBlock);
+	memcpy(result.mCounts, mCounts, mDim * sizeof(u64));
+	for (s64 i = 0; i < (s64)mCounts[0]; i++)
 	{
-		for (u64 j = 0; j < mCounts[1]; j++)
+		for (s64 j = 0; j < (s64)mCounts[1]; j++)
 		{
-			GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + j));
-			if (p1.a && p1.aa->IsZero())
-				continue;
-			for (u64 l = i + 1; l < mCounts[0]; l++)
+			if ((j - i) < n)
+				result.Set((i * result.mCounts[1] + j), zero);
+			else
 			{
-				GrapaVectorParam p2(pScriptExec, mData, mBlock, (l * mCounts[1] + j));
-				Set((l * mCounts[1] + j), GrapaFloat(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0));
-				for (u64 m = j + 1; m < mCounts[1]; m++)
-				{
-					GrapaVectorParam p3(pScriptExec, mData, mBlock, (i * mCounts[1] + m));
-					GrapaVectorParam p4(pScriptExec, mData, mBlock, (l * mCounts[1] + m));
-					GrapaFloat f = (*p4.aa * *p1.aa) - (*p3.aa * *p2.aa);
-					Set((l * mCounts[1] + m), f);
-				}
+				GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + j));
+				result.Set((i * result.mCounts[1] + j), *p1.aa);
 			}
-			break;
 		}
 	}
+	return true;
+}
 
-	if (reduce)
+bool GrapaVector::TriL(GrapaScriptExec* pScriptExec, s64 n, GrapaVector& result)
+{
+	if (mDType)
 	{
-		GrapaVector vv(*this);
-		vv.Sort(pScriptExec, pNameSpace, NULL, NULL, NULL, true, true, true, NULL, *this);
-		for (u64 i = 0; i < mCounts[0]; i++)
+		GrapaVector boxed(*this);
+		boxed.SetDType(GrapaVectorDType::DEFAULT);
+		bool ok = boxed.TriL(pScriptExec, n, result);
+		if (ok)
+			result.SetDType(mDType);
+		return ok;
+	}
+	result.CLEAR();
+	if (mDim != 2)
+		return false;
+	GrapaFloat zero(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0);
+	result.mBlock = mBlock;
+	result.mMaxBlock = mMaxBlock;
+	result.mSetBlock = 0;
+	result.mDim = 2;
+	result.mCounts = (u64*)GrapaMem::Create(mDim * sizeof(u64));
+	result.mCounts[0] = mCounts[0];
+	result.mCounts[1] = mCounts[1];
+	result.mSize = mCounts[0] * mCounts[1];
+	result.mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
+	memset(result.mData, 0, mSize * mBlock);
+	memcpy(result.mCounts, mCounts, mDim * sizeof(u64));
+	for (s64 i = 0; i < (s64)mCounts[0]; i++)
+	{
+		for (s64 j = 0; j < (s64)mCounts[1]; j++)
 		{
-			for (u64 j = 0; j < mCounts[1]; j++)
+			if ((j - i) < (n + 1))
 			{
 				GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + j));
-				if (p1.a && p1.aa->IsZero())
-				{
-					if (j + 1 == mCounts[1])
-					{
-						for (u64 k = i * mCounts[1]; k < mSize; k++)
-						{
-							GrapaVectorItem* d1 = _datavectorpos(mData, mBlock, k);
-							if (d1->isValue)
-							{
-								GrapaVectorValue* d = 0L;
-								memcpy(&d, d1->d, sizeof(GrapaVectorValue*));
-								d1->isValue = 0;
-								d1->isNull = 0;
-								d1->mLen = 0;
-								d1->mToken = 0;
-								if (d)
-								{
-									d->CLEAR();
-									delete d;
-								}
-							}
-						}
-						mCounts[0] = i;
-						mSize = mCounts[0] * mCounts[1];
-						GrapaVectorItem* data = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
-						memcpy(data, mData, mSize * mBlock);
-						GrapaMem::Delete(mData);
-						mData = data;
-					}
-				}
-				else
-				{
-					j = mCounts[1];
-				}
+				result.Set((i * result.mCounts[1] + j), *p1.aa);
 			}
+			else
+				result.Set((i * result.mCounts[1] + j), zero);
 		}
 	}
-
 	return true;
 }
 
-bool GrapaVector::Rref(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace)
+bool GrapaVector::EigH(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, GrapaVector& w, GrapaVector& p)
 {
+	if (mDType)
+	{
+		GrapaVector boxed(*this);
+		boxed.SetDType(GrapaVectorDType::DEFAULT);
+		bool ok = boxed.EigH(pScriptExec, pNameSpace, w, p);
+		if (ok)
+		{
+			w.SetDType(GrapaVectorDType::FLOAT64);
+			p.SetDType(GrapaVectorDType::FLOAT64);
+		}
+		return ok;
+	}
+	w.CLEAR();
+	p.CLEAR();
 	if (mDim != 2)
 		return false;
 
-	for (u64 i = 0; i < mCounts[0]-1; i++)
+	GrapaVector A(*this);
+
+	u64 n = A.mCounts[0];
+	u64 maxRot = 5 * (n * n);
+	p.Identity(pScriptExec, n);
+	GrapaFloat zero(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0);
+	GrapaFloat one(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 1);
+	GrapaFloat two(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 2);
+	GrapaFloat ten(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 10);
+	GrapaFloat tol = ten.Pow(-9);
+	GrapaFloat tenm36 = ten.Pow(-36);
+	for (u64 i = 0; i < maxRot; i++)
 	{
-		GrapaVector vv(*this);
-		vv.Sort(pScriptExec, pNameSpace, NULL, NULL, NULL, true, true, true, NULL, *this);
-		for (u64 j = 0; j < mCounts[1]; j++)
+		GrapaFloat Amax = zero;
+		u64 k = 0;
+		u64 l = 0;
+		for (u64 ii = 0; ii < (n - 1); ii++)
 		{
-			GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + j));
-			if (p1.a && p1.aa->IsZero())
-				continue;
-			for (u64 l = i + 1; l < mCounts[0]; l++)
+			for (u64 jj = ii + 1; jj < n; jj++)
 			{
-				GrapaVectorParam p2(pScriptExec, mData, mBlock, (l * mCounts[1] + j));
-				Set((l * mCounts[1] + j), GrapaFloat(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0));
-				for (u64 m = j+1; m < mCounts[1]; m++)
+				GrapaVectorParam p1(pScriptExec, A.mData, A.mBlock, (ii * A.mCounts[1] + jj));
+				if (p1.aa->Abs() >= Amax)
 				{
-					GrapaVectorParam p3(pScriptExec, mData, mBlock, (i * mCounts[1] + m));
-					GrapaVectorParam p4(pScriptExec, mData, mBlock, (l * mCounts[1] + m));
-					GrapaFloat f = (*p4.aa * *p1.aa) - (*p3.aa * *p2.aa);
-					Set((l * mCounts[1] + m), f);
-				}
+					Amax = p1.aa->Abs();
+					k = ii;
+					l = jj;
+				};
 			}
-			break;
 		}
-	}
-	for (u64 i = 0; i < mCounts[0]; i++)
-	{
-		for (u64 j = 0; j < mCounts[1]; j++)
+		if (Amax < tol)
 		{
-			GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + j));
-			if (p1.a && p1.aa->IsZero())
+			A.Diagonal(pScriptExec, 0, w);
+			GrapaVector vv(w);
+			vv.Sort(pScriptExec, pNameSpace, &p, NULL, NULL, false, true, true, NULL, w);
+			return true;
+		}
+		else
+		{
+			GrapaVectorParam ll(pScriptExec, A.mData, A.mBlock, (l * A.mCounts[1] + l));
+			GrapaVectorParam kk(pScriptExec, A.mData, A.mBlock, (k * A.mCounts[1] + k));
+			GrapaVectorParam kl(pScriptExec, A.mData, A.mBlock, (k * A.mCounts[1] + l));
+			GrapaFloat Adiff = *ll.aa - *kk.aa;
+			GrapaFloat t = zero;
+			if (kl.aa->Abs() < (Adiff.Abs() * tenm36))
+				t = *kl.aa / Adiff;
+			else
 			{
-				if (j + 1 == mCounts[1])
-				{
-					for (u64 k = i * mCounts[1]; k < mSize; k++)
-					{
-						GrapaVectorItem* d1 = _datavectorpos(mData, mBlock, k);
-						if (d1->isValue)
-						{
-							GrapaVectorValue* d = 0L;
-							memcpy(&d, d1->d, sizeof(GrapaVectorValue*));
-							d1->isValue = 0;
-							d1->isNull = 0;
-							d1->mLen = 0;
-							d1->mToken = 0;
-							if (d)
-							{
-								d->CLEAR();
-								delete d;
-							}
-						}
-					}
-					mCounts[0] = i;
-					mSize = mCounts[0] * mCounts[1];
-					GrapaVectorItem* data = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
-					memcpy(data, mData, mSize * mBlock);
-					GrapaMem::Delete(mData);
-					mData = data;
-				}
+				GrapaFloat phi = Adiff / (*kl.aa * two);
+				t = one / (phi.Abs() + ((phi * phi + one).Root(2)));
+				if (phi < zero) t = -t;
 			}
-			else
+			GrapaFloat c = one / ((t * t + one).Root(2));
+			GrapaFloat s = t * c;
+			GrapaFloat tau = s / (one + c);
+			GrapaFloat temp = *kl.aa;
+			A.Set((k * A.mCounts[1] + l), zero);
+			A.Set((k * A.mCounts[1] + k), *kk.aa - t * temp);
+			A.Set((l * A.mCounts[1] + l), *ll.aa + t * temp);
+			for (u64 ii = 0; ii < k; ii++)
 			{
-				j = mCounts[1];
+				GrapaVectorParam ik(pScriptExec, A.mData, A.mBlock, (ii * A.mCounts[1] + k));
+				GrapaVectorParam il(pScriptExec, A.mData, A.mBlock, (ii * A.mCounts[1] + l));
+				GrapaFloat temp = *ik.aa;
+				A.Set((ii * A.mCounts[1] + k), temp - s * (*il.aa + tau * temp));
+				A.Set((ii * A.mCounts[1] + l), *il.aa + s * (temp - tau * *il.aa));
+			}
+			for (u64 ii = (k + 1); ii < l; ii++)
+			{
+				GrapaVectorParam ki(pScriptExec, A.mData, A.mBlock, (k * A.mCounts[1] + ii));
+				GrapaVectorParam il(pScriptExec, A.mData, A.mBlock, (ii * A.mCounts[1] + l));
+				GrapaFloat temp = *ki.aa;
+				A.Set((k * A.mCounts[1] + ii), temp - s * (*il.aa + tau * *ki.aa));
+				A.Set((ii * A.mCounts[1] + l), *il.aa + s * (temp - tau * *il.aa));
+			}
+			for (u64 ii = (l + 1); ii < n; ii++)
+			{
+				GrapaVectorParam ki(pScriptExec, A.mData, A.mBlock, (k * A.mCounts[1] + ii));
+				GrapaVectorParam li(pScriptExec, A.mData, A.mBlock, (l * A.mCounts[1] + ii));
+				GrapaFloat temp = *ki.aa;
+				A.Set((k * A.mCounts[1] + ii), temp - s * (*li.aa + tau * temp));
+				A.Set((l * A.mCounts[1] + ii), *li.aa + s * (temp - tau * *li.aa));
+			}
+			for (u64 ii = 0; ii < n; ii++)
+			{
+				GrapaVectorParam ik(pScriptExec, p.mData, p.mBlock, (ii * p.mCounts[1] + k));
+				GrapaVectorParam il(pScriptExec, p.mData, p.mBlock, (ii * p.mCounts[1] + l));
+				GrapaFloat temp = *ik.aa;
+				p.Set((ii * p.mCounts[1] + k), temp - s * (*il.aa + tau * *ik.aa));
+				p.Set((ii * p.mCounts[1] + l), *il.aa + s * (temp - tau * *il.aa));
 			}
 		}
 	}
+	return false;
+}
 
-	for (s64 i = mCounts[0] - 1; i >= 0; i--)
+// Matrix factorisations. The kernels are written once for d64 and GrapaFloat; the overloads
+// below supply what differs (absolute value, square root, zero test, and SIMD row updates).
+
+static d64 _vectorabs(d64 a) { return fabs(a); }
+static GrapaFloat _vectorabs(const GrapaFloat& a) { return a.Abs(); }
+static d64 _vectorsqrt(d64 a) { return sqrt(a); }
+static GrapaFloat _vectorsqrt(const GrapaFloat& a) { return a.Root(2); }
+static bool _vectoriszero(d64 a) { return a == 0.0; }
+static bool _vectoriszero(GrapaFloat& a) { return a.IsZero(); }
+static u64 _vectorwork(const d64* a) { return 1; }
+static u64 _vectorwork(const GrapaFloat* a) { return _vectorfloatwork_; }
+static void _vectorconst(GrapaScriptExec* pScriptExec, s64 v, d64& r) { r = (d64)v; }
+static void _vectorconst(GrapaScriptExec* pScriptExec, s64 v, GrapaFloat& r) { r = GrapaFloat(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, v); }
+
+// c -= f * b
+template <class T> static void _vectorrowsub(T f, const T* b, T* c, u64 n)
+{
+	for (u64 i = 0; i < n; i++)
+		c[i] = c[i] - f * b[i];
+}
+static void _vectorrowsub(d64 f, const d64* b, d64* c, u64 n) { _vectorf64axpy(-f, b, c, n); }
+
+template <class T> static T _vectorrowdot(const T* a, const T* b, u64 n, T zero)
+{
+	for (u64 i = 0; i < n; i++)
+		zero = zero + a[i] * b[i];
+	return zero;
+}
+static d64 _vectorrowdot(const d64* a, const d64* b, u64 n, d64 zero) { return _vectorf64dot(a, b, n); }
+
+// In place LU of the n x n matrix a with partial pivoting: the unit lower factor below the
+// diagonal, U on and above it. p[i] is the source row of row i. A zero pivot is left in place
+// for the solves to report.
+template <class T> static void _vectorlu(T* a, u64 n, std::vector<u64>& p, s64& sign)
+{
+	sign = 1;
+	p.resize(n);
+	for (u64 i = 0; i < n; i++)
+		p[i] = i;
+	for (u64 k = 0; k < n; k++)
 	{
-		GrapaVector vv(*this);
-		vv.Sort(pScriptExec, pNameSpace, NULL, NULL, NULL, true, true, true, NULL, *this);
-		for (u64 j = 0; j < mCounts[1]; j++)
+		u64 r = k;
+		T best = _vectorabs(a[k * n + k]);
+		for (u64 i = k + 1; i < n; i++)
 		{
-			GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + j));
-			if (p1.a && p1.aa->IsZero())
-				continue;
-			for (u64 m = j + 1; m < mCounts[1]; m++)
-			{
-				GrapaVectorParam p3(pScriptExec, mData, mBlock, (i * mCounts[1] + m));
-				GrapaFloat f = (*p3.aa / *p1.aa);
-				Set((i * mCounts[1] + m), f);
-			}
-			Set((i * mCounts[1] + j), GrapaFloat(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 1));
-			for (s64 n = i - 1; n >= 0; n--)
+			T v = _vectorabs(a[i * n + k]);
+			if (v > best)
 			{
-				GrapaVectorParam p2(pScriptExec, mData, mBlock, (n * mCounts[1] + j));
-				for (u64 m = j + 1; m < mCounts[1]; m++)
-				{
-					GrapaVectorParam p3(pScriptExec, mData, mBlock, (n * mCounts[1] + m));
-					GrapaVectorParam p4(pScriptExec, mData, mBlock, (i * mCounts[1] + m));
-					GrapaFloat f = *p3.aa - *p2.aa * *p4.aa;
-					Set((n * mCounts[1] + m), f);
-				}
-				Set((n * mCounts[1] + j), GrapaFloat(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0));
+				best = v;
+				r = i;
 			}
-			break;
 		}
+		if (r != k)
+		{
+			for (u64 j = 0; j < n; j++)
+				std::swap(a[k * n + j], a[r * n + j]);
+			std::swap(p[k], p[r]);
+			sign = -sign;
+		}
+		if (_vectoriszero(a[k * n + k]))
+			continue;
+		u64 rest = n - k - 1;
+		_vectorparallel(rest, rest * rest * _vectorwork(a), [&](u64 t) {
+			T* row = a + (k + 1 + t) * n;
+			row[k] = row[k] / a[k * n + k];
+			_vectorrowsub(row[k], a + k * n + k + 1, row + k + 1, rest);
+			});
 	}
-
-	return true;
 }
 
-bool GrapaVector::Inv(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace)
+// Householder QR of the m x n matrix a in place: a becomes R, and q (m x m) receives Q.
+template <class T> static void _vectorqr(T* a, u64 m, u64 n, T* q, T zero, T one)
 {
-	if (mDim != 2)
-		return false;
-
-	if (mCounts[0] != mCounts[1])
-		return false;
+	for (u64 i = 0; i < m; i++)
+		for (u64 j = 0; j < m; j++)
+			q[i * m + j] = i == j ? one : zero;
+	std::vector<T> v(m, zero);
+	u64 steps = m ? (m - 1 < n ? m - 1 : n) : 0;
+	for (u64 k = 0; k < steps; k++)
+	{
+		T norm = zero;
+		for (u64 i = k; i < m; i++)
+			norm = norm + a[i * n + k] * a[i * n + k];
+		if (_vectoriszero(norm))
+			continue;
+		norm = _vectorsqrt(norm);
+		T alpha = a[k * n + k] < zero ? norm : -norm;
+		for (u64 i = k; i < m; i++)
+			v[i] = a[i * n + k];
+		v[k] = v[k] - alpha;
+		T vv = _vectorrowdot(v.data() + k, v.data() + k, m - k, zero);
+		if (_vectoriszero(vv))
+			continue;
+		T scale = one + one;
+		scale = scale / vv;
+		_vectorparallel(n - k, (m - k) * (n - k) * _vectorwork(a), [&](u64 t) {
+			u64 j = k + t;
+			T s = zero;
+			for (u64 i = k; i < m; i++)
+				s = s + v[i] * a[i * n + j];
+			s = s * scale;
+			for (u64 i = k; i < m; i++)
+				a[i * n + j] = a[i * n + j] - s * v[i];
+			});
+		_vectorparallel(m, m * (m - k) * _vectorwork(a), [&](u64 r) {
+			T s = _vectorrowdot(q + r * m + k, v.data() + k, m - k, zero);
+			s = s * scale;
+			_vectorrowsub(s, v.data() + k, q + r * m + k, m - k);
+			});
+		for (u64 i = k + 1; i < m; i++)
+			a[i * n + k] = zero;
+		a[k * n + k] = alpha;
+	}
+}
 
-	GrapaVectorItem* data = mData;
-	mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize * 2);
-	for (u64 i = 0; i < mCounts[0]; i++)
+// In place Cholesky factor of the symmetric n x n matrix a: L in the lower triangle, zeros
+// above. Only the lower triangle of a is read. Returns false when a is not positive definite.
+template <class T> static bool _vectorcholesky(T* a, u64 n, T zero)
+{
+	for (u64 j = 0; j < n; j++)
 	{
-		memcpy(_datavectorpos(mData, mBlock, (i * mCounts[1] * 2)), _datavectorpos(data, mBlock, (i * mCounts[1])), mCounts[1] * mBlock);
-		for (u64 j = 0; j < mCounts[1]; j++)
-		{
-			if (i==j)
-				Set((i * mCounts[1] * 2 + mCounts[1] + j), GrapaFloat(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 1));
-			else
-				Set((i * mCounts[1] * 2 + mCounts[1] + j), GrapaFloat(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0));
-		}
+		T d = a[j * n + j] - _vectorrowdot(a + j * n, a + j * n, j, zero);
+		if (!(d > zero))
+			return false;
+		a[j * n + j] = _vectorsqrt(d);
+		u64 rest = n - j - 1;
+		_vectorparallel(rest, rest * j * _vectorwork(a), [&](u64 t) {
+			u64 i = j + 1 + t;
+			T s = a[i * n + j] - _vectorrowdot(a + i * n, a + j * n, j, zero);
+			a[i * n + j] = s / a[j * n + j];
+			});
+		for (u64 k = j + 1; k < n; k++)
+			a[j * n + k] = zero;
 	}
-	GrapaMem::Delete(data);
-	mSize *= 2;
-	mCounts[1] *= 2;
+	return true;
+}
 
-	Rref(pScriptExec, pNameSpace);
+// Solves t.x = b in place, t being the n x n lower or upper triangle (of its transpose when
+// pTrans) and b n x c. Columns of b are split across threads. False on a zero diagonal.
+template <class T> static bool _vectortrisolve(T* t, u64 n, T* b, u64 c, bool pLower, bool pTrans, bool pUnit)
+{
+	if (!pUnit)
+		for (u64 i = 0; i < n; i++)
+			if (_vectoriszero(t[i * n + i]))
+				return false;
+	bool lower = pLower != pTrans;
+	u64 chunks = (c + _vectorgemmcols_ - 1) / _vectorgemmcols_;
+	_vectorparallel(chunks, n * n * c * _vectorwork(t) / 2, [&](u64 ch) {
+		u64 j0 = ch * _vectorgemmcols_;
+		u64 w = (c - j0) < _vectorgemmcols_ ? (c - j0) : _vectorgemmcols_;
+		for (u64 s = 0; s < n; s++)
+		{
+			u64 i = lower ? s : n - 1 - s;
+			T* bi = b + i * c + j0;
+			u64 k0 = lower ? 0 : i + 1;
+			u64 k1 = lower ? i : n;
+			for (u64 k = k0; k < k1; k++)
+				_vectorrowsub(pTrans ? t[k * n + i] : t[i * n + k], b + k * c + j0, bi, w);
+			if (!pUnit)
+				for (u64 j = 0; j < w; j++)
+					bi[j] = bi[j] / t[i * n + i];
+		}
+		});
+	return true;
+}
 
-	mSize /= 2;
-	mCounts[1] /= 2;
-	data = mData;
-	mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
-	for (u64 i = 0; i < mCounts[0]; i++)
-		memcpy(_datavectorpos(mData, mBlock, (i * mCounts[1])), _datavectorpos(data, mBlock, (i * mCounts[1] * 2 + mCounts[1])), mCounts[1] * mBlock);
-	GrapaMem::Delete(data);
+static bool _vectorload(GrapaScriptExec* pScriptExec, const GrapaVector& a, std::vector<d64>& r)
+{
+	GrapaVector x(a);
+	if (!x.SetDType(GrapaVectorDType::FLOAT64) || _vectorf64hasnan((const d64*)x.mNative, x.mSize))
+		return false;
+	r.assign((const d64*)x.mNative, (const d64*)x.mNative + x.mSize);
+	return true;
+}
 
+// Null cells load as zero, the same as the Gauss-Jordan routines treat them.
+static bool _vectorload(GrapaScriptExec* pScriptExec, const GrapaVector& a, std::vector<GrapaFloat>& r)
+{
+	GrapaVector x(a);
+	if (!x.SetDType(GrapaVectorDType::DEFAULT))
+		return false;
+	GrapaFloat** v = _vectorfloats(pScriptExec, x);
+	if (v == NULL)
+		return false;
+	GrapaFloat zero;
+	_vectorconst(pScriptExec, 0, zero);
+	r.assign(x.mSize, zero);
+	for (u64 i = 0; i < x.mSize; i++)
+		if (v[i])
+			r[i] = *v[i];
+	_vectorfloatsfree(v, x.mSize);
 	return true;
 }
 
-// https://www.codesansar.com/c-programming-examples/matrix-determinant.htm
-// https://cpp.hotexamples.com/examples/-/Matrix/Det/cpp-matrix-det-method-examples.html
+static void _vectorstoreshape(GrapaVector& r, u64 rows, u64 cols, u8 dim)
+{
+	r.CLEAR();
+	r.mDim = dim;
+	r.mCounts = (u64*)GrapaMem::Create(sizeof(u64) * dim);
+	r.mCounts[0] = rows;
+	if (dim == 2)
+		r.mCounts[1] = cols;
+	r.mSize = rows * cols;
+	r.mBlock = _minvectorblock_;
+	r.mMaxBlock = _minvectordatablock_;
+	r.mSetBlock = 0;
+}
 
-GrapaFloat GrapaVector::Determinant(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace)
+static void _vectorstore(GrapaScriptExec* pScriptExec, GrapaVector& r, std::vector<d64>& v, u64 rows, u64 cols, u8 dim)
 {
-	GrapaFloat f(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 1);
+	_vectorstoreshape(r, rows, cols, dim);
+	r.mNative = GrapaMem::Create(sizeof(d64) * (r.mSize ? r.mSize : 1));
+	memcpy(r.mNative, v.data(), sizeof(d64) * r.mSize);
+	r.mDType = GrapaVectorDType::FLOAT64;
+}
 
-	if (mDim!=2 || mCounts[0] != mCounts[1])
+static void _vectorstore(GrapaScriptExec* pScriptExec, GrapaVector& r, std::vector<GrapaFloat>& v, u64 rows, u64 cols, u8 dim)
+{
+	_vectorstoreshape(r, rows, cols, dim);
+	r.mData = (GrapaVectorItem*)GrapaMem::Create(r.mBlock * (r.mSize ? r.mSize : 1));
+	memset(r.mData, 0, r.mBlock * (r.mSize ? r.mSize : 1));
+	for (u64 i = 0; i < r.mSize; i++)
+		r.Set(i, v[i]);
+}
+
+static bool _vectorloadpivot(const GrapaVector& a, std::vector<u64>& p)
+{
+	GrapaVector x(a);
+	if (x.mDim != 1 || !x.SetDType(GrapaVectorDType::INT64))
+		return false;
+	p.assign(x.mSize, 0);
+	std::vector<bool> seen(x.mSize, false);
+	for (u64 i = 0; i < x.mSize; i++)
 	{
-		f.FromInt(0);
-		return(f);
+		s64 v = ((s64*)x.mNative)[i];
+		if (v < 0 || (u64)v >= x.mSize || seen[v])
+			return false;
+		seen[v] = true;
+		p[i] = (u64)v;
 	}
+	return true;
+}
 
-	GrapaVector v(*this);
-
-	bool isErr = false;
-
-	// Gauss Elimination, transforming matrix to upper triangular matrix
+static bool _vectorsquare(const GrapaVector& a, u64 n)
+{
+	return a.mDim == 2 && a.mCounts[0] == n && a.mCounts[1] == n;
+}
 
-	for (u64 i = 0; i < v.mCounts[0]; i++)
+template <class T> static bool _vectorfactorize(GrapaScriptExec* pScriptExec, const GrapaVector& pMatrix, u8 pKind, GrapaVectorFactor& f)
+{
+	if (pMatrix.mDim != 2)
+		return false;
+	u64 m = pMatrix.mCounts[0], n = pMatrix.mCounts[1];
+	if (pKind != GrapaVectorFactorKind::QR && m != n)
+		return false;
+	std::vector<T> a;
+	if (!_vectorload(pScriptExec, pMatrix, a))
+		return false;
+	T zero, one;
+	_vectorconst(pScriptExec, 0, zero);
+	_vectorconst(pScriptExec, 1, one);
+	f.CLEAR();
+	switch (pKind)
 	{
-		GrapaVectorParam p1(pScriptExec, v.mData, v.mBlock, (i * v.mCounts[1] + i));
-		if (p1.aa->IsZero())
-		{
-			isErr = true;
-			break;
-		}
-		for (u64 j = i + 1; j < v.mCounts[0]; j++)
+	case GrapaVectorFactorKind::LU:
+	{
+		std::vector<u64> p;
+		s64 sign;
+		_vectorlu(a.data(), n, p, sign);
+		std::vector<T> l(n * n, zero);
+		for (u64 i = 0; i < n; i++)
 		{
-			GrapaVectorParam p2(pScriptExec, v.mData, v.mBlock, (j * v.mCounts[1] + i));
-			f = *p2.aa / *p1.aa;
-
-			for (u64 k = 0; k < mCounts[1]; k++)
+			for (u64 j = 0; j < i; j++)
 			{
-				GrapaVectorParam p3(pScriptExec, v.mData, v.mBlock, (j * v.mCounts[1] + k));
-				GrapaVectorParam p4(pScriptExec, v.mData, v.mBlock, (i * v.mCounts[1] + k));
-				v.Set((j * mCounts[1] + k), *p3.aa - f * *p4.aa);
+				l[i * n + j] = a[i * n + j];
+				a[i * n + j] = zero;
 			}
+			l[i * n + i] = one;
 		}
+		_vectorstore(pScriptExec, f.mL, l, n, n, 2);
+		_vectorstore(pScriptExec, f.mU, a, n, n, 2);
+		_vectorstoreshape(f.mP, n, 1, 1);
+		f.mP.mNative = GrapaMem::Create(sizeof(s64) * (n ? n : 1));
+		for (u64 i = 0; i < n; i++)
+			((s64*)f.mP.mNative)[i] = (s64)p[i];
+		f.mP.mDType = GrapaVectorDType::INT64;
+		break;
+	}
+	case GrapaVectorFactorKind::QR:
+	{
+		std::vector<T> q(m * m, zero);
+		_vectorqr(a.data(), m, n, q.data(), zero, one);
+		_vectorstore(pScriptExec, f.mQ, q, m, m, 2);
+		_vectorstore(pScriptExec, f.mR, a, m, n, 2);
+		break;
+	}
+	case GrapaVectorFactorKind::CHOLESKY:
+		if (!_vectorcholesky(a.data(), n, zero))
+			return false;
+		_vectorstore(pScriptExec, f.mL, a, n, n, 2);
+		break;
+	default:
+		return false;
 	}
+	f.mKind = pKind;
+	return true;
+}
 
-	if (isErr)
+// Solves A.x = b for the rows x c right hand side b, replacing b with x (n x c). For the QR of
+// a tall A this is the least squares solution.
+template <class T> static bool _vectorfactorsolve(GrapaScriptExec* pScriptExec, const GrapaVectorFactor& f, std::vector<T>& b, u64 rows, u64 c, u64& n)
+{
+	T zero;
+	_vectorconst(pScriptExec, 0, zero);
+	switch (f.mKind)
 	{
-		f.FromInt(0);
-		return(f);
+	case GrapaVectorFactorKind::LU:
+	{
+		std::vector<T> l, u;
+		std::vector<u64> p;
+		if (!_vectorloadpivot(f.mP, p))
+			return false;
+		n = p.size();
+		if (rows != n || !_vectorsquare(f.mL, n) || !_vectorsquare(f.mU, n) || !_vectorload(pScriptExec, f.mL, l) || !_vectorload(pScriptExec, f.mU, u))
+			return false;
+		std::vector<T> x(n * c, zero);
+		for (u64 i = 0; i < n; i++)
+			for (u64 j = 0; j < c; j++)
+				x[i * c + j] = b[p[i] * c + j];
+		if (!_vectortrisolve(l.data(), n, x.data(), c, true, false, true) || !_vectortrisolve(u.data(), n, x.data(), c, false, false, false))
+			return false;
+		b.swap(x);
+		return true;
+	}
+	case GrapaVectorFactorKind::QR:
+	{
+		std::vector<T> q, r;
+		if (f.mQ.mDim != 2 || f.mR.mDim != 2)
+			return false;
+		u64 m = f.mQ.mCounts[0];
+		n = f.mR.mCounts[1];
+		if (rows != m || m < n || !_vectorsquare(f.mQ, m) || f.mR.mCounts[0] != m || !_vectorload(pScriptExec, f.mQ, q) || !_vectorload(pScriptExec, f.mR, r))
+			return false;
+		std::vector<T> y(n * c, zero);
+		_vectorparallel(n, m * n * c * _vectorwork(q.data()), [&](u64 i) {
+			for (u64 k = 0; k < m; k++)
+				_vectorrowsub(-q[k * m + i], b.data() + k * c, y.data() + i * c, c);
+			});
+		if (!_vectortrisolve(r.data(), n, y.data(), c, false, false, false))
+			return false;
+		b.swap(y);
+		return true;
+	}
+	case GrapaVectorFactorKind::CHOLESKY:
+	{
+		std::vector<T> l;
+		if (f.mL.mDim != 2)
+			return false;
+		n = f.mL.mCounts[0];
+		if (rows != n || !_vectorsquare(f.mL, n) || !_vectorload(pScriptExec, f.mL, l))
+			return false;
+		return _vectortrisolve(l.data(), n, b.data(), c, true, false, false) && _vectortrisolve(l.data(), n, b.data(), c, true, true, false);
 	}
+	}
+	return false;
+}
 
-	f.FromInt(1);
+template <class T> static bool _vectorfactorinv(GrapaScriptExec* pScriptExec, const GrapaVectorFactor& f, GrapaVector& result)
+{
+	const GrapaVector& a = f.mKind == GrapaVectorFactorKind::QR ? f.mR : f.mL;
+	if (a.mDim != 2 || a.mCounts[0] != a.mCounts[1])
+		return false;
+	u64 n = a.mCounts[0];
+	T zero, one;
+	_vectorconst(pScriptExec, 0, zero);
+	_vectorconst(pScriptExec, 1, one);
+	std::vector<T> b(n * n, zero);
+	for (u64 i = 0; i < n; i++)
+		b[i * n + i] = one;
+	if (!_vectorfactorsolve(pScriptExec, f, b, n, n, n))
+		return false;
+	_vectorstore(pScriptExec, result, b, n, n, 2);
+	return true;
+}
 
-	for (u64 i = 0; i < v.mCounts[0]; i++)
+// det(P) is the parity of the pivot permutation; det(Q) is not kept, so QR has no determinant.
+template <class T> static bool _vectorfactordet(GrapaScriptExec* pScriptExec, const GrapaVectorFactor& f, T& result)
+{
+	std::vector<T> a;
+	_vectorconst(pScriptExec, 1, result);
+	switch (f.mKind)
 	{
-		GrapaVectorParam p1(pScriptExec, v.mData, v.mBlock, (i * v.mCounts[1] + i));
-		f = f * *p1.aa;
+	case GrapaVectorFactorKind::LU:
+	{
+		std::vector<u64> p;
+		if (!_vectorloadpivot(f.mP, p) || !_vectorsquare(f.mU, p.size()) || !_vectorload(pScriptExec, f.mU, a))
+			return false;
+		u64 n = p.size(), swaps = 0;
+		for (u64 i = 0; i < n; i++)
+			result = result * a[i * n + i];
+		std::vector<bool> seen(n, false);
+		for (u64 i = 0; i < n; i++)
+		{
+			u64 len = 0;
+			for (u64 j = i; !seen[j]; j = p[j], len++)
+				seen[j] = true;
+			if (len)
+				swaps += len - 1;
+		}
+		if (swaps % 2)
+			result = -result;
+		return true;
 	}
-
-	return f;
+	case GrapaVectorFactorKind::CHOLESKY:
+	{
+		if (f.mL.mDim != 2 || !_vectorsquare(f.mL, f.mL.mCounts[0]) || !_vectorload(pScriptExec, f.mL, a))
+			return false;
+		u64 n = f.mL.mCounts[0];
+		for (u64 i = 0; i < n; i++)
+			result = result * a[i * n + i];
+		result = result * result;
+		return true;
+	}
+	}
+	return false;
 }
 
-GrapaInt GrapaVector::Rank(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace)
+static bool _vectorfactornative(const GrapaVectorFactor& f)
 {
-	if (mDim != 2)
-		return 0;
+	return (f.mKind == GrapaVectorFactorKind::QR ? f.mQ.mDType : f.mL.mDType) == GrapaVectorDType::FLOAT64;
+}
 
-	GrapaVector v(*this);
-	v.Ref(pScriptExec, pNameSpace, true);
+void GrapaVectorFactor::CLEAR()
+{
+	mKind = GrapaVectorFactorKind::NONE;
+	mL.CLEAR();
+	mU.CLEAR();
+	mP.CLEAR();
+	mQ.CLEAR();
+	mR.CLEAR();
+}
 
-	return v.mCounts[0];
+bool GrapaVectorFactor::FROM(GrapaScriptExec* pScriptExec, const GrapaVector& pMatrix, u8 pKind)
+{
+	if (pMatrix.mDType && _vectorfactorize<d64>(pScriptExec, pMatrix, pKind, *this))
+		return true;
+	return _vectorfactorize<GrapaFloat>(pScriptExec, pMatrix, pKind, *this);
 }
 
-void GrapaVector::Identity(GrapaScriptExec* pScriptExec, u64 n)
+// Reads back the list made by ToList, or by hand: {l,u,p} is LU, {q,r} is QR and {l} Cholesky.
+bool GrapaVectorFactor::FROM(GrapaScriptExec* pScriptExec, GrapaRuleEvent* pList)
 {
 	CLEAR();
-	GrapaFloat zero(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0);
-	GrapaFloat one(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 1);
-	mBlock = _minvectorblock_;
-	mMaxBlock = _minvectordatablock_;
-	mSetBlock = 0;
-	mDim = 2;
-	mCounts = (u64*)GrapaMem::Create(mDim * sizeof(u64));
-	mCounts[0] = n;
-	mCounts[1] = n;
-	mSize = n * n;
-	mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
-	for (u64 i = 0; i < n; i++)
+	if (pList == NULL || pList->mValue.mToken != GrapaTokenType::LIST || pList->vQueue == NULL)
+		return false;
+	for (GrapaRuleEvent* ev = pList->vQueue->Head(); ev; ev = ev->Next())
 	{
-		for (u64 j = 0; j < n; j++)
+		GrapaVector* v = NULL;
+		if (ev->mName.Cmp("l") == 0) v = &mL;
+		else if (ev->mName.Cmp("u") == 0) v = &mU;
+		else if (ev->mName.Cmp("p") == 0) v = &mP;
+		else if (ev->mName.Cmp("q") == 0) v = &mQ;
+		else if (ev->mName.Cmp("r") == 0) v = &mR;
+		if (v == NULL)
+			continue;
+		if (ev->mValue.mToken == GrapaTokenType::VECTOR && ev->vVector)
+			v->FROM(*ev->vVector);
+		else if (ev->mValue.mToken == GrapaTokenType::ARRAY || ev->mValue.mToken == GrapaTokenType::TUPLE)
+			v->FROM(pScriptExec, ev, 0);
+	}
+	if (mQ.mSize && mR.mSize)
+		mKind = GrapaVectorFactorKind::QR;
+	else if (mL.mSize && mU.mSize && mP.mSize)
+		mKind = GrapaVectorFactorKind::LU;
+	else if (mL.mSize)
+		mKind = GrapaVectorFactorKind::CHOLESKY;
+	return mKind != GrapaVectorFactorKind::NONE;
+}
+
+GrapaRuleEvent* GrapaVectorFactor::ToList()
+{
+	GrapaRuleEvent* result = new GrapaRuleEvent(GrapaTokenType::LIST, 0, "", "");
+	result->vQueue = new GrapaRuleQueue();
+	const char* names[3] = { "l", "u", "p" };
+	GrapaVector* parts[3] = { &mL, &mU, &mP };
+	if (mKind == GrapaVectorFactorKind::QR)
+	{
+		names[0] = "q";
+		parts[0] = &mQ;
+		names[1] = "r";
+		parts[1] = &mR;
+	}
+	u64 count = mKind == GrapaVectorFactorKind::LU ? 3 : (mKind == GrapaVectorFactorKind::QR ? 2 : 1);
+	for (u64 i = 0; i < count; i++)
+	{
+		GrapaRuleEvent* v = new GrapaRuleEvent(GrapaTokenType::VECTOR, 0, names[i], "");
+		v->vVector = new GrapaVector(*parts[i]);
+		result->vQueue->PushTail(v);
+	}
+	return result;
+}
+
+// b is a vector of n values or an n x c matrix, and the result takes the same form.
+GrapaError GrapaVectorFactor::Solve(GrapaScriptExec* pScriptExec, const GrapaVector& b, GrapaVector& result)
+{
+	if (b.mDim != 1 && b.mDim != 2)
+		return -1;
+	u64 rows = b.mCounts[0];
+	u64 c = b.mDim == 2 ? b.mCounts[1] : 1;
+	u64 n = 0;
+	if (_vectorfactornative(*this))
+	{
+		std::vector<d64> x;
+		if (_vectorload(pScriptExec, b, x) && _vectorfactorsolve(pScriptExec, *this, x, rows, c, n))
 		{
-			if (i==j)
-				Set((i * mCounts[1] + j), one);
-			else
-				Set((i * mCounts[1] + j), zero);
+			_vectorstore(pScriptExec, result, x, n, c, b.mDim);
+			return 0;
+		}
+	}
+	std::vector<GrapaFloat> x;
+	if (_vectorload(pScriptExec, b, x) && _vectorfactorsolve(pScriptExec, *this, x, rows, c, n))
+	{
+		_vectorstore(pScriptExec, result, x, n, c, b.mDim);
+		return 0;
+	}
+	return -1;
+}
+
+bool GrapaVectorFactor::Inv(GrapaScriptExec* pScriptExec, GrapaVector& result)
+{
+	if (_vectorfactornative(*this) && _vectorfactorinv<d64>(pScriptExec, *this, result))
+		return true;
+	return _vectorfactorinv<GrapaFloat>(pScriptExec, *this, result);
+}
+
+bool GrapaVectorFactor::Determinant(GrapaScriptExec* pScriptExec, GrapaFloat& result)
+{
+	if (_vectorfactornative(*this))
+	{
+		d64 d;
+		if (_vectorfactordet(pScriptExec, *this, d))
+		{
+			result = _vectorfromf64(d);
+			return true;
 		}
 	}
+	return _vectorfactordet(pScriptExec, *this, result);
 }
 
-bool GrapaVector::Diagonal(GrapaScriptExec* pScriptExec, s64 n, GrapaVector& result)
+// Symmetric eigensolver. The matrix is reduced to tridiagonal form by Householder reflections
+// and the tridiagonal is diagonalised by implicit QL, both in hardware doubles (after the
+// EISPACK tred2/tql2 routines). Default storage can then be refined in GrapaFloat by Jacobi
+// sweeps, which converge quadratically from the nearly diagonal start.
+
+// a (n x n, row major, lower triangle read) is replaced by the orthogonal transformation, d gets
+// the diagonal and e[1..n-1] the subdiagonal.
+static void _vectortred2(d64* a, u64 n, d64* d, d64* e)
 {
-	result.CLEAR();
-	if (mDim != 2)
-		return false;
-	result.mBlock = _minvectorblock_;
-	result.mMaxBlock = _minvectordatablock_;
-	result.mSetBlock = 0;
-	result.mDim = 1;
-	u64 size = 0;
-	if (n >= 0)
-	{
-		size = mCounts[1];
-		if (n > (s64)size)
-			size = 0;
-		else
-			size -= n;
-		if (size > mCounts[0])
-			size = mCounts[0];
-	}
-	else
+	for (u64 j = 0; j < n; j++)
+		d[j] = a[(n - 1) * n + j];
+	for (u64 i = n - 1; i > 0; i--)
 	{
-		size = mCounts[0];
-		if ((-n) > (s64)size)
-			size = 0;
+		d64 scale = 0.0, h = 0.0;
+		for (u64 k = 0; k < i; k++)
+			scale += fabs(d[k]);
+		if (scale == 0.0)
+		{
+			e[i] = d[i - 1];
+			for (u64 j = 0; j < i; j++)
+			{
+				d[j] = a[(i - 1) * n + j];
+				a[i * n + j] = 0.0;
+				a[j * n + i] = 0.0;
+			}
+		}
 		else
-			size += n;
-		if (size > mCounts[1])
-			size = mCounts[1];
+		{
+			for (u64 k = 0; k < i; k++)
+			{
+				d[k] /= scale;
+				h += d[k] * d[k];
+			}
+			d64 f = d[i - 1];
+			d64 g = sqrt(h);
+			if (f > 0)
+				g = -g;
+			e[i] = scale * g;
+			h = h - f * g;
+			d[i - 1] = f - g;
+			for (u64 j = 0; j < i; j++)
+				e[j] = 0.0;
+			for (u64 j = 0; j < i; j++)
+			{
+				f = d[j];
+				a[j * n + i] = f;
+				g = e[j] + a[j * n + j] * f;
+				for (u64 k = j + 1; k < i; k++)
+				{
+					g += a[k * n + j] * d[k];
+					e[k] += a[k * n + j] * f;
+				}
+				e[j] = g;
+			}
+			f = 0.0;
+			for (u64 j = 0; j < i; j++)
+			{
+				e[j] /= h;
+				f += e[j] * d[j];
+			}
+			d64 hh = f / (h + h);
+			for (u64 j = 0; j < i; j++)
+				e[j] -= hh * d[j];
+			for (u64 j = 0; j < i; j++)
+			{
+				f = d[j];
+				g = e[j];
+				for (u64 k = j; k < i; k++)
+					a[k * n + j] -= (f * e[k] + g * d[k]);
+				d[j] = a[(i - 1) * n + j];
+				a[i * n + j] = 0.0;
+			}
+		}
+		d[i] = h;
 	}
-	result.mSize = size;
-	result.mCounts = (u64*)GrapaMem::Create(result.mDim * sizeof(u64));
-	result.mCounts[0] = size;
-	result.mData = (GrapaVectorItem*)GrapaMem::Create(result.mBlock * result.mSize);
-	if (n >= 0)
+	for (u64 i = 0; i + 1 < n; i++)
 	{
-		for (u64 i = 0; i < size; i++)
+		a[(n - 1) * n + i] = a[i * n + i];
+		a[i * n + i] = 1.0;
+		d64 h = d[i + 1];
+		if (h != 0.0)
 		{
-			GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + i + n));
-			result.Set((i), *p1.aa);
+			for (u64 k = 0; k <= i; k++)
+				d[k] = a[k * n + i + 1] / h;
+			_vectorparallel(i + 1, (i + 1) * (i + 1), [&](u64 j) {
+				d64 g = 0.0;
+				for (u64 k = 0; k <= i; k++)
+					g += a[k * n + i + 1] * a[k * n + j];
+				for (u64 k = 0; k <= i; k++)
+					a[k * n + j] -= g * d[k];
+				});
 		}
+		for (u64 k = 0; k <= i; k++)
+			a[k * n + i + 1] = 0.0;
 	}
-	else
+	for (u64 j = 0; j < n; j++)
 	{
-		for (u64 i = 0; i < size; i++)
+		d[j] = a[(n - 1) * n + j];
+		a[(n - 1) * n + j] = 0.0;
+	}
+	a[(n - 1) * n + n - 1] = 1.0;
+	e[0] = 0.0;
+}
+
+// Diagonalises the tridiagonal from _vectortred2, accumulating the rotations into a. Returns
+// false if an eigenvalue fails to converge.
+static bool _vectortql2(d64* a, u64 n, d64* d, d64* e)
+{
+	for (u64 i = 1; i < n; i++)
+		e[i - 1] = e[i];
+	e[n - 1] = 0.0;
+	d64 f = 0.0, tst1 = 0.0;
+	d64 eps = ldexp(1.0, -52);
+	for (u64 l = 0; l < n; l++)
+	{
+		if (tst1 < fabs(d[l]) + fabs(e[l]))
+			tst1 = fabs(d[l]) + fabs(e[l]);
+		u64 m = l;
+		while (m < n - 1 && fabs(e[m]) > eps * tst1)
+			m++;
+		if (m > l)
 		{
-			GrapaVectorParam p1(pScriptExec, mData, mBlock, ((i-n) * mCounts[1] + i));
-			result.Set((i), *p1.aa);
+			u64 iter = 0;
+			do
+			{
+				if (++iter > 30 * n)
+					return false;
+				d64 g = d[l];
+				d64 p = (d[l + 1] - g) / (2.0 * e[l]);
+				d64 r = hypot(p, 1.0);
+				if (p < 0)
+					r = -r;
+				d[l] = e[l] / (p + r);
+				d[l + 1] = e[l] * (p + r);
+				d64 dl1 = d[l + 1];
+				d64 h = g - d[l];
+				for (u64 i = l + 2; i < n; i++)
+					d[i] -= h;
+				f = f + h;
+				p = d[m];
+				d64 c = 1.0, c2 = c, c3 = c;
+				d64 el1 = e[l + 1];
+				d64 s = 0.0, s2 = 0.0;
+				for (u64 i = m; i-- > l;)
+				{
+					c3 = c2;
+					c2 = c;
+					s2 = s;
+					g = c * e[i];
+					h = c * p;
+					r = hypot(p, e[i]);
+					e[i + 1] = s * r;
+					s = e[i] / r;
+					c = p / r;
+					p = c * d[i] - s * g;
+					d[i + 1] = h + s * (c * g + s * d[i]);
+					for (u64 k = 0; k < n; k++)
+					{
+						h = a[k * n + i + 1];
+						a[k * n + i + 1] = s * a[k * n + i] + c * h;
+						a[k * n + i] = c * a[k * n + i] - s * h;
+					}
+				}
+				p = -s * s2 * c3 * el1 * e[l] / dl1;
+				e[l] = s * p;
+				d[l] = c * p;
+			} while (fabs(e[l]) > eps * tst1);
 		}
+		d[l] = d[l] + f;
+		e[l] = 0.0;
 	}
 	return true;
 }
 
-bool GrapaVector::TriU(GrapaScriptExec* pScriptExec, s64 n, GrapaVector& result)
+// Cyclic Jacobi sweeps on the symmetric n x n matrix a, applying each rotation to the columns
+// of v as well, until no off diagonal entry is above tol.
+template <class T> static void _vectorjacobi(T* a, T* v, u64 n, T tol, T zero, T one)
 {
-	result.CLEAR();
-	if (mDim != 2)
-		return false;
-	GrapaFloat zero(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0);
-	result.mBlock = mBlock;
-	result.mMaxBlock = mMaxBlock;
-	result.mSetBlock = 0;
-	result.mDim = 2;
-	result.mCounts = (u64*)GrapaMem::Create(mDim * sizeof(u64));
-	result.mCounts[0] = mCounts[0];
-	result.mCounts[1] = mCounts[1];
-	result.mSize = mCounts[0] * mCounts[1];
-	result.mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
-	memset(result.mData, 0, mSize * mBlock);
-	memcpy(result.mCounts, mCounts, mDim * sizeof(u64));
-	for (s64 i = 0; i < (s64)mCounts[0]; i++)
+	for (u64 sweep = 0; sweep < 20; sweep++)
 	{
-		for (s64 j = 0; j < (s64)mCounts[1]; j++)
+		bool done = true;
+		for (u64 k = 0; k + 1 < n; k++)
 		{
-			if ((j - i) < n)
-				result.Set((i * result.mCounts[1] + j), zero);
-			else
+			for (u64 l = k + 1; l < n; l++)
 			{
-				GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + j));
-				result.Set((i * result.mCounts[1] + j), *p1.aa);
+				T akl = a[k * n + l];
+				if (!(_vectorabs(akl) > tol))
+					continue;
+				done = false;
+				T two = one + one;
+				T theta = a[l * n + l] - a[k * n + k];
+				theta = theta / (two * akl);
+				T t = one / (_vectorabs(theta) + _vectorsqrt(theta * theta + one));
+				if (theta < zero)
+					t = -t;
+				T c = one / _vectorsqrt(t * t + one);
+				T s = t * c;
+				for (u64 i = 0; i < n; i++)
+				{
+					T ik = a[i * n + k], il = a[i * n + l];
+					a[i * n + k] = c * ik - s * il;
+					a[i * n + l] = s * ik + c * il;
+				}
+				for (u64 i = 0; i < n; i++)
+				{
+					T ki = a[k * n + i], li = a[l * n + i];
+					a[k * n + i] = c * ki - s * li;
+					a[l * n + i] = s * ki + c * li;
+					T vk = v[i * n + k], vl = v[i * n + l];
+					v[i * n + k] = c * vk - s * vl;
+					v[i * n + l] = s * vk + c * vl;
+				}
 			}
 		}
+		if (done)
+			break;
 	}
-	return true;
 }
 
-bool GrapaVector::TriL(GrapaScriptExec* pScriptExec, s64 n, GrapaVector& result)
+// Orders the eigenpairs by decreasing magnitude, as the Jacobi routine always has, and turns
+// each eigenvector so its largest component is positive.
+template <class T> static void _vectoreigorder(std::vector<T>& v, std::vector<T>& w, u64 n, T zero)
 {
-	result.CLEAR();
-	if (mDim != 2)
-		return false;
-	GrapaFloat zero(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0);
-	result.mBlock = mBlock;
-	result.mMaxBlock = mMaxBlock;
-	result.mSetBlock = 0;
-	result.mDim = 2;
-	result.mCounts = (u64*)GrapaMem::Create(mDim * sizeof(u64));
-	result.mCounts[0] = mCounts[0];
-	result.mCounts[1] = mCounts[1];
-	result.mSize = mCounts[0] * mCounts[1];
-	result.mData = (GrapaVectorItem*)GrapaMem::Create(mBlock * mSize);
-	memset(result.mData, 0, mSize * mBlock);
-	memcpy(result.mCounts, mCounts, mDim * sizeof(u64));
-	for (s64 i = 0; i < (s64)mCounts[0]; i++)
+	std::vector<T> mag(n, zero);
+	for (u64 i = 0; i < n; i++)
+		mag[i] = _vectorabs(w[i]);
+	std::vector<u64> idx(n);
+	for (u64 i = 0; i < n; i++)
+		idx[i] = i;
+	std::stable_sort(idx.begin(), idx.end(), [&](u64 x, u64 y) { return mag[x] > mag[y]; });
+	std::vector<T> sv(v), sw(w);
+	for (u64 j = 0; j < n; j++)
 	{
-		for (s64 j = 0; j < (s64)mCounts[1]; j++)
+		u64 src = idx[j];
+		w[j] = sw[src];
+		u64 big = 0;
+		T best = zero;
+		for (u64 i = 0; i < n; i++)
 		{
-			if ((j - i) < (n + 1))
+			T m = _vectorabs(sv[i * n + src]);
+			if (m > best)
 			{
-				GrapaVectorParam p1(pScriptExec, mData, mBlock, (i * mCounts[1] + j));
-				result.Set((i * result.mCounts[1] + j), *p1.aa);
+				best = m;
+				big = i;
 			}
-			else
-				result.Set((i * result.mCounts[1] + j), zero);
 		}
+		bool flip = sv[big * n + src] < zero;
+		for (u64 i = 0; i < n; i++)
+			v[i * n + j] = flip ? -sv[i * n + src] : sv[i * n + src];
 	}
-	return true;
 }
 
-bool GrapaVector::EigH(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, GrapaVector& w, GrapaVector& p)
+// a (n x n) is replaced by the eigenvectors as columns, w receives the eigenvalues.
+static bool _vectoreigh(GrapaScriptExec* pScriptExec, std::vector<d64>& a, u64 n, std::vector<d64>& w)
 {
-	w.CLEAR();
-	p.CLEAR();
-	if (mDim != 2)
+	std::vector<d64> e(n, 0.0);
+	w.assign(n, 0.0);
+	if (n == 0)
+		return true;
+	_vectortred2(a.data(), n, w.data(), e.data());
+	if (!_vectortql2(a.data(), n, w.data(), e.data()))
 		return false;
+	_vectoreigorder(a, w, n, 0.0);
+	return true;
+}
 
-	GrapaVector A(*this);
+// c (m x n) = a (m x k) . b (k x n)
+template <class T> static void _vectormatmul(const T* a, const T* b, T* c, u64 m, u64 k, u64 n, T zero)
+{
+	_vectorparallel(m, m * k * n * _vectorwork(a), [&](u64 r) {
+		T* row = c + r * n;
+		for (u64 j = 0; j < n; j++)
+			row[j] = zero;
+		for (u64 i = 0; i < k; i++)
+			_vectorrowsub(-a[r * k + i], b + i * n, row, n);
+		});
+}
 
-	u64 n = A.mCounts[0];
-	u64 maxRot = 5 * (n * n);
-	p.Identity(pScriptExec, n);
-	GrapaFloat zero(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 0);
-	GrapaFloat one(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 1);
-	GrapaFloat two(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 2);
-	GrapaFloat ten(pScriptExec->vScriptState->mItemState.mFloatFix, pScriptExec->vScriptState->mItemState.mFloatMax, pScriptExec->vScriptState->mItemState.mFloatExtra, 10);
-	GrapaFloat tol = ten.Pow(-9);
-	GrapaFloat tenm36 = ten.Pow(-36);
-	for (u64 i = 0; i < maxRot; i++)
+// The double solution rotated back into GrapaFloat, V'.A.V, is nearly diagonal; Jacobi sweeps
+// remove what is left to the working precision.
+static bool _vectoreigh(GrapaScriptExec* pScriptExec, std::vector<GrapaFloat>& a, u64 n, std::vector<GrapaFloat>& w)
+{
+	GrapaVector x;
+	std::vector<d64> fa, fw;
+	_vectorstore(pScriptExec, x, a, n, n, 2);
+	if (!_vectorload(pScriptExec, x, fa) || !_vectoreigh(pScriptExec, fa, n, fw))
+		return false;
+	std::vector<GrapaFloat> v;
+	_vectorstore(pScriptExec, x, fa, n, n, 2);
+	if (!_vectorload(pScriptExec, x, v))
+		return false;
+	GrapaFloat zero, one;
+	_vectorconst(pScriptExec, 0, zero);
+	_vectorconst(pScriptExec, 1, one);
+	std::vector<GrapaFloat> av(n * n, zero), vt(n * n, zero), b(n * n, zero);
+	_vectormatmul(a.data(), v.data(), av.data(), n, n, n, zero);
+	for (u64 i = 0; i < n; i++)
+		for (u64 j = 0; j < n; j++)
+			vt[j * n + i] = v[i * n + j];
+	_vectormatmul(vt.data(), av.data(), b.data(), n, n, n, zero);
+	GrapaFloat scale = zero;
+	for (u64 i = 0; i < n; i++)
+		if (_vectorabs(b[i * n + i]) > scale)
+			scale = _vectorabs(b[i * n + i]);
+	GrapaFloat two;
+	_vectorconst(pScriptExec, 2, two);
+	GrapaFloat tol = scale * two.Pow(GrapaInt(-(s64)(pScriptExec->vScriptState->mItemState.mFloatMax - 8)));
+	_vectorjacobi(b.data(), v.data(), n, tol, zero, one);
+	w.assign(n, zero);
+	for (u64 i = 0; i < n; i++)
+		w[i] = b[i * n + i];
+	_vectoreigorder(v, w, n, zero);
+	a = v;
+	return true;
+}
+
+// Thin SVD of the m x n matrix a with m >= n, from the eigenvectors V of a'.a: the columns of
+// a.V are orthogonal with norms s, and normalising them (re-orthogonalised against earlier
+// columns so that small and zero s still give an orthonormal u) gives u. ut is n x m (the
+// columns of u as rows), s has n entries and v is n x n.
+template <class T> static bool _vectorsvd(GrapaScriptExec* pScriptExec, const std::vector<T>& a, u64 m, u64 n, std::vector<T>& ut, std::vector<T>& s, std::vector<T>& v)
+{
+	T zero, one;
+	_vectorconst(pScriptExec, 0, zero);
+	_vectorconst(pScriptExec, 1, one);
+	std::vector<T> at(n * m, zero);
+	for (u64 i = 0; i < m; i++)
+		for (u64 j = 0; j < n; j++)
+			at[j * m + i] = a[i * n + j];
+	v.assign(n * n, zero);
+	_vectorparallel(n, n * n * m * _vectorwork(a.data()), [&](u64 i) {
+		for (u64 j = 0; j <= i; j++)
+			v[i * n + j] = v[j * n + i] = _vectorrowdot(at.data() + i * m, at.data() + j * m, m, zero);
+		});
+	std::vector<T> w;
+	if (!_vectoreigh(pScriptExec, v, n, w))
+		return false;
+	std::vector<T> vt(n * n, zero);
+	for (u64 i = 0; i < n; i++)
+		for (u64 j = 0; j < n; j++)
+			vt[j * n + i] = v[i * n + j];
+	ut.assign(n * m, zero);
+	_vectorparallel(n, n * n * m * _vectorwork(a.data()), [&](u64 j) {
+		for (u64 r = 0; r < m; r++)
+			ut[j * m + r] = _vectorrowdot(a.data() + r * n, vt.data() + j * n, n, zero);
+		});
+	s.assign(n, zero);
+	for (u64 j = 0; j < n; j++)
 	{
-		GrapaFloat Amax = zero;
-		u64 k = 0;
-		u64 l = 0;
-		for (u64 ii = 0; ii < (n - 1); ii++)
+		T* u = ut.data() + j * m;
+		s[j] = _vectorsqrt(_vectorrowdot(u, u, m, zero));
+		for (u64 e = 0; ; e++)
 		{
-			for (u64 jj = ii + 1; jj < n; jj++)
+			for (u64 pass = 0; pass < 2; pass++)
+				for (u64 i = 0; i < j; i++)
+					_vectorrowsub(_vectorrowdot(ut.data() + i * m, u, m, zero), ut.data() + i * m, u, m);
+			T norm = _vectorsqrt(_vectorrowdot(u, u, m, zero));
+			T half = one / (one + one);
+			if (e > 0 ? norm > half : norm > s[j] * half && !_vectoriszero(norm))
 			{
-				GrapaVectorParam p1(pScriptExec, A.mData, A.mBlock, (ii * A.mCounts[1] + jj));
-				if (p1.aa->Abs() >= Amax)
-				{
-					Amax = p1.aa->Abs();
-					k = ii;
-					l = jj;
-				};
+				for (u64 r = 0; r < m; r++)
+					u[r] = u[r] / norm;
+				break;
 			}
+			if (e >= m)
+				return false;
+			for (u64 r = 0; r < m; r++)
+				u[r] = r == e ? one : zero;
 		}
-		if (Amax < tol)
+	}
+	return true;
+}
+
+bool GrapaVector::EigH(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, GrapaVector& w, GrapaVector& p, bool pRefine)
+{
+	if (mDim == 2 && mCounts[0] == mCounts[1])
+	{
+		u64 n = mCounts[0];
+		if (mDType || !pRefine)
 		{
-			A.Diagonal(pScriptExec, 0, w);
-			GrapaVector vv(w);
-			vv.Sort(pScriptExec, pNameSpace, &p, NULL, NULL, false, true, true, NULL, w);
-			return true;
+			std::vector<d64> a, d;
+			if (_vectorload(pScriptExec, *this, a) && _vectoreigh(pScriptExec, a, n, d))
+			{
+				_vectorstore(pScriptExec, w, d, n, 1, 1);
+				_vectorstore(pScriptExec, p, a, n, n, 2);
+				if (mDType == GrapaVectorDType::DEFAULT)
+				{
+					w.SetDType(GrapaVectorDType::DEFAULT);
+					p.SetDType(GrapaVectorDType::DEFAULT);
+				}
+				return true;
+			}
 		}
 		else
 		{
-			GrapaVectorParam ll(pScriptExec, A.mData, A.mBlock, (l * A.mCounts[1] + l));
-			GrapaVectorParam kk(pScriptExec, A.mData, A.mBlock, (k * A.mCounts[1] + k));
-			GrapaVectorParam kl(pScriptExec, A.mData, A.mBlock, (k * A.mCounts[1] + l));
-			GrapaFloat Adiff = *ll.aa - *kk.aa;
-			GrapaFloat t = zero;
-			if (kl.aa->Abs() < (Adiff.Abs() * tenm36))
-				t = *kl.aa / Adiff;
-			else
-			{
-				GrapaFloat phi = Adiff / (*kl.aa * two);
-				t = one / (phi.Abs() + ((phi * phi + one).Root(2)));
-				if (phi < zero) t = -t;
-			}
-			GrapaFloat c = one / ((t * t + one).Root(2));
-			GrapaFloat s = t * c;
-			GrapaFloat tau = s / (one + c);
-			GrapaFloat temp = *kl.aa;
-			A.Set((k * A.mCounts[1] + l), zero);
-			A.Set((k * A.mCounts[1] + k), *kk.aa - t * temp);
-			A.Set((l * A.mCounts[1] + l), *ll.aa + t * temp);
-			for (u64 ii = 0; ii < k; ii++)
-			{
-				GrapaVectorParam ik(pScriptExec, A.mData, A.mBlock, (ii * A.mCounts[1] + k));
-				GrapaVectorParam il(pScriptExec, A.mData, A.mBlock, (ii * A.mCounts[1] + l));
-				GrapaFloat temp = *ik.aa;
-				A.Set((ii * A.mCounts[1] + k), temp - s * (*il.aa + tau * temp));
-				A.Set((ii * A.mCounts[1] + l), *il.aa + s * (temp - tau * *il.aa));
-			}
-			for (u64 ii = (k + 1); ii < l; ii++)
-			{
-				GrapaVectorParam ki(pScriptExec, A.mData, A.mBlock, (k * A.mCounts[1] + ii));
-				GrapaVectorParam il(pScriptExec, A.mData, A.mBlock, (ii * A.mCounts[1] + l));
-				GrapaFloat temp = *ki.aa;
-				A.Set((k * A.mCounts[1] + ii), temp - s * (*il.aa + tau * *ki.aa));
-				A.Set((ii * A.mCounts[1] + l), *il.aa + s * (temp - tau * *il.aa));
-			}
-			for (u64 ii = (l + 1); ii < n; ii++)
-			{
-				GrapaVectorParam ki(pScriptExec, A.mData, A.mBlock, (k * A.mCounts[1] + ii));
-				GrapaVectorParam li(pScriptExec, A.mData, A.mBlock, (l * A.mCounts[1] + ii));
-				GrapaFloat temp = *ki.aa;
-				A.Set((k * A.mCounts[1] + ii), temp - s * (*li.aa + tau * temp));
-				A.Set((l * A.mCounts[1] + ii), *li.aa + s * (temp - tau * *li.aa));
-			}
-			for (u64 ii = 0; ii < n; ii++)
+			std::vector<GrapaFloat> a, d;
+			if (_vectorload(pScriptExec, *this, a) && _vectoreigh(pScriptExec, a, n, d))
 			{
-				GrapaVectorParam ik(pScriptExec, p.mData, p.mBlock, (ii * p.mCounts[1] + k));
-				GrapaVectorParam il(pScriptExec, p.mData, p.mBlock, (ii * p.mCounts[1] + l));
-				GrapaFloat temp = *ik.aa;
-				p.Set((ii * p.mCounts[1] + k), temp - s * (*il.aa + tau * *ik.aa));
-				p.Set((ii * p.mCounts[1] + l), *il.aa + s * (temp - tau * *il.aa));
+				_vectorstore(pScriptExec, w, d, n, 1, 1);
+				_vectorstore(pScriptExec, p, a, n, n, 2);
+				return true;
 			}
 		}
 	}
-	return false;
+	return EigH(pScriptExec, pNameSpace, w, p);
+}
+
+template <class T> static bool _vectorsvd(GrapaScriptExec* pScriptExec, const GrapaVector& pMatrix, GrapaVector& u, GrapaVector& s, GrapaVector& v)
+{
+	std::vector<T> a;
+	if (!_vectorload(pScriptExec, pMatrix, a))
+		return false;
+	u64 m = pMatrix.mCounts[0], n = pMatrix.mCounts[1];
+	bool wide = m < n;
+	if (wide)
+	{
+		std::vector<T> at(a);
+		for (u64 i = 0; i < m; i++)
+			for (u64 j = 0; j < n; j++)
+				a[j * m + i] = at[i * n + j];
+		std::swap(m, n);
+	}
+	std::vector<T> ut, sv, vv;
+	if (!_vectorsvd(pScriptExec, a, m, n, ut, sv, vv))
+		return false;
+	std::vector<T> uu(ut);
+	for (u64 i = 0; i < m; i++)
+		for (u64 j = 0; j < n; j++)
+			uu[i * n + j] = ut[j * m + i];
+	_vectorstore(pScriptExec, wide ? v : u, uu, m, n, 2);
+	_vectorstore(pScriptExec, wide ? u : v, vv, n, n, 2);
+	_vectorstore(pScriptExec, s, sv, n, 1, 1);
+	return true;
+}
+
+// a = u.diag(s).v' with u (m x k) and v (n x k) having orthonormal columns, k = min(m, n), and s
+// decreasing. Computed in doubles unless pRefine asks for GrapaFloat precision on default storage.
+bool GrapaVector::Svd(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, GrapaVector& u, GrapaVector& s, GrapaVector& v, bool pRefine)
+{
+	u.CLEAR();
+	s.CLEAR();
+	v.CLEAR();
+	if (mDim != 2 || mSize == 0)
+		return false;
+	if (mDType || !pRefine)
+	{
+		if (!_vectorsvd<d64>(pScriptExec, *this, u, s, v))
+			return false;
+		if (mDType == GrapaVectorDType::DEFAULT)
+		{
+			u.SetDType(GrapaVectorDType::DEFAULT);
+			s.SetDType(GrapaVectorDType::DEFAULT);
+			v.SetDType(GrapaVectorDType::DEFAULT);
+		}
+		return true;
+	}
+	return _vectorsvd<GrapaFloat>(pScriptExec, *this, u, s, v);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -45,6 +45,27 @@ public:
 	GrapaRuleEvent* Get();
 };
 
+class GrapaVectorDType {
+public: enum {
+	DEFAULT = 0,
+	FLOAT64 = 1,
+	INT64 = 2,
+}; };
+
+class GrapaVectorOp {
+public: enum {
+	ADD = 0,
+	SUB = 1,
+	MUL = 2,
+	DIV = 3,
+	POW = 4,
+	GT = 5,
+	GTEQ = 6,
+	LT = 7,
+	LTEQ = 8,
+	ROOT = 9,
+}; };
+
 struct GrapaVectorItem
 {
 	u8 isValue : 1;
@@ -80,6 +101,8 @@ public:
 	GrapaVectorItem* mData;
 	u64 mSize;
 	u8 mDim, mBlock, mMaxBlock, mSetBlock;
+	u8 mDType;
+	void* mNative;
 	GrapaRuleQueue mLabels;
 	GrapaVector();
 	GrapaVector(const GrapaVector& bi, u8 pBlock = 0);
@@ -102,9 +125,22 @@ public:
 	GrapaError Left(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, s64 pCount, GrapaVector& result);
 	GrapaError Right(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, s64 pCount, GrapaVector& result);
 	GrapaError Solve(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, GrapaVector& result);
+	GrapaError Solve(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, const GrapaVector& b, GrapaVector& result);
 	GrapaError Cov(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, GrapaVector& result, bool rowvar=true);
 	GrapaError Sum(GrapaScriptExec* pScriptExec, GrapaVector& result, bool rowvar = true);
 	GrapaError Mean(GrapaScriptExec* pScriptExec, GrapaVector& result, bool rowvar = true);
+	GrapaError Norm(GrapaScriptExec* pScriptExec, GrapaFloat& pResult);
+	GrapaError Cmp(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, const GrapaVector& bi, u8 pOp, GrapaVector& result);
+	virtual bool SetDType(u8 pDType);
+	static u8 ToDType(const GrapaBYTE& pName);
+	static GrapaCHAR DTypeName(u8 pDType);
+	// The native kernels over a plain array, for values held outside a vector such as a column scan.
+	// SumS64 expects a sum that fits in s64.
+	static s64 SumS64(const s64* a, u64 n);
+	static void BoundsS64(const s64* a, u64 n, s64& pMin, s64& pMax);
+	static void BoundsF64(const d64* a, u64 n, d64& pMin, d64& pMax);
+	bool _nativeop(const GrapaVector& bi, u8 pOp, GrapaError& pErr);
+	GrapaRuleEvent* _nativeget(u64 p);
 	virtual GrapaRuleEvent* ToArray();
 	virtual GrapaRuleEvent* _toarray(u64 pos, u64& p);
 	virtual GrapaRuleEvent* ToTuple();
@@ -137,6 +173,34 @@ public:
 	virtual bool TriU(GrapaScriptExec* pScriptExec, s64 n, GrapaVector& result);
 	virtual bool TriL(GrapaScriptExec* pScriptExec, s64 n, GrapaVector& result);
 	virtual bool EigH(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, GrapaVector& w, GrapaVector& p);
+	virtual bool EigH(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, GrapaVector& w, GrapaVector& p, bool pRefine);
+	virtual bool Svd(GrapaScriptExec* pScriptExec, GrapaNames* pNameSpace, GrapaVector& u, GrapaVector& s, GrapaVector& v, bool pRefine);
+};
+
+class GrapaVectorFactorKind {
+public: enum {
+	NONE = 0,
+	LU = 1,
+	QR = 2,
+	CHOLESKY = 3,
+}; };
+
+// A matrix factorisation kept so that solves, inverses and determinants reuse it. LU is
+// A[mP] = mL.mU with partial pivoting, QR is A = mQ.mR by Householder reflections, and Cholesky
+// is A = mL.mL.t(). float64 and int64 input factorises in hardware doubles, the rest in GrapaFloat.
+class GrapaVectorFactor
+{
+public:
+	u8 mKind;
+	GrapaVector mL, mU, mP, mQ, mR;
+	GrapaVectorFactor() { mKind = GrapaVectorFactorKind::NONE; };
+	virtual void CLEAR();
+	virtual bool FROM(GrapaScriptExec* pScriptExec, const GrapaVector& pMatrix, u8 pKind);
+	virtual bool FROM(GrapaScriptExec* pScriptExec, GrapaRuleEvent* pList);
+	virtual GrapaRuleEvent* ToList();
+	virtual GrapaError Solve(GrapaScriptExec* pScriptExec, const GrapaVector& b, GrapaVector& result);
+	virtual bool Inv(GrapaScriptExec* pScriptExec, GrapaVector& result);
+	virtual bool Determinant(GrapaScriptExec* pScriptExec, GrapaFloat& result);
 };
 
 #endif //_GrapaVector_
@@ -2678,6 +2678,7 @@ GrapaRuleEvent* GrapaWidget::Set(GrapaRuleEvent* attr)
 							{
 								g->mDeleteVector = true;
 								g->vVector = new GrapaVector(*data->vVector);
+								g->vVector->SetDType(GrapaVectorDType::DEFAULT);
 							}
 						}
 						if (g->vVector)